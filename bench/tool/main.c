@@ -0,0 +1,722 @@
+//***************************************************************************
+// "main.c"
+// Program entry point, parses command line and runs the benchmark
+//***************************************************************************
+// Compression benchmark tool
+//
+// This file is part of the mdbench tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "run.h"
+
+// Default number of times each tool is run (we keep the fastest run)
+#define DEFAULT_REPEAT 5
+
+// Which tool handles a codec
+enum {
+   TOOL_SLZ,               // slz
+   TOOL_UFTC,              // uftc
+   NUM_TOOLS
+};
+
+// Description of each codec we benchmark
+typedef struct {
+   const char *name;       // Name shown in the report
+   int tool;               // Which tool handles it
+   const char *format;     // Switch selecting the format
+   const char *parse;      // Extra compression switch (or NULL)
+   const char *source;     // 68000 routine source file
+   const char *routine;    // 68000 routine name
+   size_t limit;           // Largest file the format can hold
+   int tiles;              // Set if it only takes tiles
+   const char *setup;      // cycles68k switch to set up registers (or NULL)
+} Codec;
+
+static const Codec codecs[] = {
+   { "slz16",      TOOL_SLZ,  "-16", NULL,  "slz.68k",
+     "DecompressSlz",    0xFFFF,       0, NULL },
+   { "slz16-b",    TOOL_SLZ,  "-16", "-b",  "slz.68k",
+     "DecompressSlz",    0xFFFF,       0, NULL },
+   { "slz16-bs",   TOOL_SLZ,  "-16", "-bs", "slz.68k",
+     "DecompressSlz",    0xFFFF,       0, NULL },
+   { "slz24",      TOOL_SLZ,  "-24", NULL,  "slz24.68k",
+     "DecompressSlz24",  0xFFFFFF,     0, NULL },
+   { "slzx",       TOOL_SLZ,  "-x",  NULL,  "slzx.68k",
+     "DecompressSlzx",   0xFFFF,       0, NULL },
+   { "slzx-b",     TOOL_SLZ,  "-x",  "-b",  "slzx.68k",
+     "DecompressSlzx",   0xFFFF,       0, NULL },
+   { "uftc16",     TOOL_UFTC, "-16", NULL,  "uftc.68k",
+     "DecompressUftc",   0x2000 * 32,  1, "-u" },
+   { "uftc16-b",   TOOL_UFTC, "-16", "-b",  "uftc.68k",
+     "DecompressUftc",   0x2000 * 32,  1, "-u" },
+   { "uftc15",     TOOL_UFTC, "-15", NULL,  "uftc15.68k",
+     "DecompressUftc15", 0x1000 * 32,  1, "-u" },
+   { "uftcx",      TOOL_UFTC, "-x",  NULL,  "uftcx.68k",
+     "DecompressUftcX",  0x2000 * 32,  1, "-x" },
+   { "uftcx-b",    TOOL_UFTC, "-x",  "-b",  "uftcx.68k",
+     "DecompressUftcX",  0x2000 * 32,  1, "-x" },
+};
+#define NUM_CODECS (sizeof(codecs) / sizeof(codecs[0]))
+
+// Where everything is, relative to the repository root
+static const char *const tool_paths[NUM_TOOLS] = {
+   "slz/tool/slz",
+   "uftc/tool/uftc",
+};
+static const char *const routine_dirs[NUM_TOOLS] = {
+   "slz/md",
+   "uftc/md",
+};
+#define CYCLES_PATH "cycles68k/tool/cycles68k"
+
+// Everything we need while running the benchmark
+typedef struct {
+   char *tools[NUM_TOOLS];    // Path to each tool
+   char *routines[NUM_TOOLS]; // Path to the 68000 routines of each tool
+   char *cycles;              // Path to cycles68k
+   double startup[NUM_TOOLS]; // How long each tool takes to start up
+   char *packed;              // Temporary file for compressed data
+   char *unpacked;            // Temporary file for decompressed data
+   char *md;                  // Temporary file for what the 68000 output
+   int repeat;                // How many times to run each tool
+} Bench;
+
+// What we found out about a file with a codec
+typedef struct {
+   long size;                 // Original size
+   long packed;               // Compressed size
+   double comp_time;          // Time spent compressing (seconds)
+   double decomp_time;        // Time spent decompressing (seconds)
+   long comp_memory;          // Peak memory while compressing (KB)
+   long decomp_memory;        // Peak memory while decompressing (KB)
+   unsigned long long cycles; // 68000 cycles spent decompressing
+} Result;
+
+// Function prototypes
+static char *join_path(const char *, const char *);
+static int is_selected(const Codec *, const char **, int);
+static int bench_file(Bench *, const Codec *, const char *, Result *);
+static int run_best(Bench *, char *const *, Measure *);
+static int same_files(const char *, const char *);
+static void print_result(const char *, const char *, const Codec *,
+                         const Result *);
+static void print_speed(long, double);
+static int skip_entry(const struct dirent *);
+static const char *get_error_msg(int);
+
+//***************************************************************************
+// Program entry point
+//***************************************************************************
+
+int main(int argc, char **argv) {
+   // To know if there was an error or not
+   int errcode = 0;
+
+   // Scan all arguments
+   int show_help = 0;
+   int show_ver = 0;
+   int repeat = DEFAULT_REPEAT;
+   const char *rootdir = "../..";
+   const char *corpusdir = NULL;
+
+   // Codec filters can come in any amount
+   const char **filters = (const char **) malloc(sizeof(char *) * argc);
+   int numfilters = 0;
+   if (filters == NULL) {
+      fprintf(stderr, "Error: ran out of memory\n");
+      return EXIT_FAILURE;
+   }
+
+   int scan_ok = 1;
+
+   int curr_arg;
+   for (curr_arg = 1; curr_arg < argc; curr_arg++) {
+      // Get pointer to argument, to make our lives easier
+      const char *arg = argv[curr_arg];
+
+      // If it's an option, parse it
+      if (scan_ok && arg[0] == '-') {
+         // Stop parsing options?
+         if (!strcmp(arg, "--"))
+            scan_ok = 0;
+
+         // Show help or version?
+         else if (!strcmp(arg, "-h") || !strcmp(arg, "--help"))
+            show_help = 1;
+         else if (!strcmp(arg, "-v") || !strcmp(arg, "--version"))
+            show_ver = 1;
+
+         // Only run some codecs?
+         else if (!strcmp(arg, "-c") || !strcmp(arg, "--codec")) {
+            if (curr_arg + 1 < argc)
+               filters[numfilters++] = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a codec name\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Where are the tools?
+         else if (!strcmp(arg, "-r") || !strcmp(arg, "--root")) {
+            if (curr_arg + 1 < argc)
+               rootdir = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a directory\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // How many times to run each tool?
+         else if (!strcmp(arg, "-n") || !strcmp(arg, "--repeat")) {
+            if (curr_arg + 1 < argc) {
+               char *endptr;
+               repeat = (int) strtol(argv[++curr_arg], &endptr, 10);
+               if (*endptr != '\0' || repeat < 1) {
+                  fprintf(stderr, "Error: invalid repeat count\n");
+                  errcode = 1;
+               }
+            } else {
+               fprintf(stderr, "Error: \"%s\" needs a number\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Unknown argument
+         else {
+            fprintf(stderr, "Error: unknown option \"%s\"\n", arg);
+            errcode = 1;
+         }
+      }
+
+      // Corpus directory?
+      else if (corpusdir == NULL)
+         corpusdir = arg;
+
+      // Too many directories?
+      else {
+         fprintf(stderr, "Error: too many directories specified\n");
+         errcode = 1;
+      }
+   }
+
+   // Look for error conditions
+   if (!show_help && !show_ver) {
+      if (corpusdir == NULL) {
+         errcode = 1;
+         fprintf(stderr, "Error: corpus directory missing\n");
+      }
+      int i;
+      for (i = 0; i < numfilters; i++) {
+         size_t j;
+         for (j = 0; j < NUM_CODECS; j++)
+            if (is_selected(&codecs[j], filters + i, 1)) break;
+         if (j == NUM_CODECS) {
+            errcode = 1;
+            fprintf(stderr, "Error: no codec matches \"%s\"\n", filters[i]);
+         }
+      }
+   }
+
+   // If there was an error then quit
+   if (errcode) {
+      free(filters);
+      return EXIT_FAILURE;
+   }
+
+   // Show tool version?
+   if (show_ver) {
+      puts("1.0");
+      free(filters);
+      return EXIT_SUCCESS;
+   }
+
+   // Show tool usage?
+   if (show_help) {
+      printf("Usage:\n"
+             "  %s [options] <corpusdir>\n"
+             "\n"
+             "Options:\n"
+             "  -c or --codec <name> . Only run codecs starting with <name>\n"
+             "  -r or --root <dir> ... Where the repository is (default ../..)\n"
+             "  -n or --repeat <n> ... Run each tool <n> times (default %d)\n"
+             "  -h or --help ......... Show this help\n"
+             "  -v or --version ...... Show tool version\n"
+             "\n"
+             "Every subdirectory of <corpusdir> is a class of data, and\n"
+             "every file in it gets run through every codec that can take\n"
+             "it. The report is written to stdout as tab separated values.\n",
+             argv[0], DEFAULT_REPEAT);
+      free(filters);
+      return EXIT_SUCCESS;
+   }
+
+   // Work out where everything is
+   Bench bench;
+   memset(&bench, 0, sizeof(bench));
+   bench.repeat = repeat;
+
+   char tmpdir[] = "/tmp/mdbenchXXXXXX";
+   int have_tmpdir = mkdtemp(tmpdir) != NULL;
+
+   int i;
+   for (i = 0; i < NUM_TOOLS; i++) {
+      bench.tools[i] = join_path(rootdir, tool_paths[i]);
+      bench.routines[i] = join_path(rootdir, routine_dirs[i]);
+   }
+   bench.cycles = join_path(rootdir, CYCLES_PATH);
+   bench.packed = join_path(tmpdir, "packed");
+   bench.unpacked = join_path(tmpdir, "unpacked");
+   bench.md = join_path(tmpdir, "md");
+
+   if (bench.cycles == NULL || bench.packed == NULL ||
+   bench.unpacked == NULL || bench.md == NULL)
+      errcode = ERR_NOMEMORY;
+   for (i = 0; i < NUM_TOOLS; i++) {
+      if (bench.tools[i] == NULL || bench.routines[i] == NULL)
+         errcode = ERR_NOMEMORY;
+   }
+   if (!errcode && !have_tmpdir) {
+      fprintf(stderr, "Error: can't create temporary directory\n");
+      errcode = ERR_UNKNOWN;
+   } else if (errcode)
+      fprintf(stderr, "Error: %s\n", get_error_msg(errcode));
+
+   // Make sure the tools are there
+   if (!errcode) {
+      for (i = 0; i < NUM_TOOLS; i++) {
+         if (access(bench.tools[i], X_OK)) {
+            fprintf(stderr, "Error: can't find \"%s\" (build it first)\n",
+               bench.tools[i]);
+            errcode = ERR_CANTRUN;
+         }
+      }
+      if (access(bench.cycles, X_OK)) {
+         fprintf(stderr, "Error: can't find \"%s\" (build it first)\n",
+            bench.cycles);
+         errcode = ERR_CANTRUN;
+      }
+   }
+
+   // Find out how long it takes for each tool to just start up, so we
+   // can take it out of the measurements (otherwise small files would be
+   // all about how long it takes to spawn a process)
+   for (i = 0; i < NUM_TOOLS && !errcode; i++) {
+      char *args[] = { bench.tools[i], "-v", NULL };
+      Measure measure;
+      errcode = run_best(&bench, args, &measure);
+      bench.startup[i] = measure.time;
+      if (errcode)
+         fprintf(stderr, "Error: \"%s\": %s\n", bench.tools[i],
+            get_error_msg(errcode));
+   }
+
+   // Go through every class in the corpus
+   struct dirent **classes = NULL;
+   int numclasses = 0;
+   if (!errcode) {
+      numclasses = scandir(corpusdir, &classes, skip_entry, alphasort);
+      if (numclasses < 0) {
+         fprintf(stderr, "Error: can't read directory \"%s\"\n", corpusdir);
+         errcode = ERR_CANTREAD;
+         numclasses = 0;
+      }
+   }
+
+   if (!errcode) {
+      printf("class\tfile\tcodec\tsize\tpacked\tratio\t"
+             "comp_mbps\tdecomp_mbps\tcomp_kb\tdecomp_kb\t"
+             "cycles\tcycles_per_byte\tframes_ntsc\n");
+   }
+
+   int c;
+   for (c = 0; c < numclasses && !errcode; c++) {
+      const char *classname = classes[c]->d_name;
+      char *classdir = join_path(corpusdir, classname);
+      if (classdir == NULL) {
+         fprintf(stderr, "Error: %s\n", get_error_msg(ERR_NOMEMORY));
+         errcode = ERR_NOMEMORY;
+         break;
+      }
+
+      // Skip anything that isn't a directory
+      struct stat info;
+      if (stat(classdir, &info) || !S_ISDIR(info.st_mode)) {
+         free(classdir);
+         continue;
+      }
+
+      // Go through every file in the class
+      struct dirent **files;
+      int numfiles = scandir(classdir, &files, skip_entry, alphasort);
+      if (numfiles < 0) {
+         fprintf(stderr, "Error: can't read directory \"%s\"\n", classdir);
+         errcode = ERR_CANTREAD;
+         free(classdir);
+         break;
+      }
+
+      int f;
+      for (f = 0; f < numfiles && !errcode; f++) {
+         const char *filename = files[f]->d_name;
+         char *path = join_path(classdir, filename);
+         if (path == NULL) {
+            fprintf(stderr, "Error: %s\n", get_error_msg(ERR_NOMEMORY));
+            errcode = ERR_NOMEMORY;
+            break;
+         }
+         if (stat(path, &info) || !S_ISREG(info.st_mode) ||
+         info.st_size == 0) {
+            free(path);
+            continue;
+         }
+
+         // Try every codec that can take this file
+         size_t j;
+         for (j = 0; j < NUM_CODECS && !errcode; j++) {
+            const Codec *codec = &codecs[j];
+            if (numfilters > 0 && !is_selected(codec, filters, numfilters))
+               continue;
+            if ((uintmax_t) info.st_size > codec->limit)
+               continue;
+            if (codec->tiles && info.st_size % 32 != 0)
+               continue;
+
+            fprintf(stderr, "%s/%s: %s\n", classname, filename,
+               codec->name);
+            Result result;
+            errcode = bench_file(&bench, codec, path, &result);
+            if (errcode) {
+               fprintf(stderr, "Error: \"%s\" with %s: %s\n", path,
+                  codec->name, get_error_msg(errcode));
+               break;
+            }
+            print_result(classname, filename, codec, &result);
+         }
+
+         free(path);
+      }
+
+      for (f = 0; f < numfiles; f++)
+         free(files[f]);
+      free(files);
+      free(classdir);
+   }
+
+   // Clean up
+   for (c = 0; c < numclasses; c++)
+      free(classes[c]);
+   free(classes);
+
+   if (have_tmpdir) {
+      if (bench.packed) remove(bench.packed);
+      if (bench.unpacked) remove(bench.unpacked);
+      if (bench.md) remove(bench.md);
+      remove(tmpdir);
+   }
+
+   for (i = 0; i < NUM_TOOLS; i++) {
+      free(bench.tools[i]);
+      free(bench.routines[i]);
+   }
+   free(bench.cycles);
+   free(bench.packed);
+   free(bench.unpacked);
+   free(bench.md);
+   free(filters);
+
+   // Quit program
+   return errcode ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//***************************************************************************
+// join_path [internal]
+// Puts together a directory and a filename
+//---------------------------------------------------------------------------
+// param dir: directory
+// param name: filename
+// return: allocated path (or NULL if out of memory)
+//***************************************************************************
+
+static char *join_path(const char *dir, const char *name) {
+   size_t len = strlen(dir) + 1 + strlen(name) + 1;
+   char *path = (char *) malloc(len);
+   if (path == NULL) return NULL;
+   snprintf(path, len, "%s/%s", dir, name);
+   return path;
+}
+
+//***************************************************************************
+// is_selected [internal]
+// Checks if a codec was picked by the filters in the command line
+//---------------------------------------------------------------------------
+// param codec: codec to check
+// param filters: list of filters (codec names or prefixes)
+// param numfilters: number of filters
+// return: non-zero if selected, zero otherwise
+//***************************************************************************
+
+static int is_selected(const Codec *codec, const char **filters,
+int numfilters) {
+   int i;
+   for (i = 0; i < numfilters; i++) {
+      if (!strncmp(codec->name, filters[i], strlen(filters[i])))
+         return 1;
+   }
+   return 0;
+}
+
+//***************************************************************************
+// bench_file [internal]
+// Runs a file through a codec: compresses it, decompresses it on the host
+// and on the 68000 (checking both give back the original) and measures how
+// long everything took
+//---------------------------------------------------------------------------
+// param bench: benchmark state
+// param codec: codec to use
+// param filename: file to test
+// param result: where to store the results
+// return: error code
+//***************************************************************************
+
+static int bench_file(Bench *bench, const Codec *codec, const char *filename,
+Result *result) {
+   int errcode;
+   Measure measure;
+   struct stat info;
+
+   char *tool = bench->tools[codec->tool];
+   char *format = (char *) codec->format;
+   char *parse = (char *) codec->parse;
+
+   if (stat(filename, &info))
+      return ERR_CANTREAD;
+   result->size = (long) info.st_size;
+
+   // Compress
+   char *comp_args[] = { tool, "-c", format, parse, NULL, NULL, NULL };
+   int argpos = parse != NULL ? 4 : 3;
+   comp_args[argpos] = (char *) filename;
+   comp_args[argpos + 1] = bench->packed;
+
+   errcode = run_best(bench, comp_args, &measure);
+   if (errcode) return errcode;
+   result->comp_time = measure.time - bench->startup[codec->tool];
+   result->comp_memory = measure.memory;
+
+   if (stat(bench->packed, &info))
+      return ERR_CANTREAD;
+   result->packed = (long) info.st_size;
+
+   // Decompress on the host
+   char *decomp_args[] = { tool, "-d", format, bench->packed,
+                           bench->unpacked, NULL };
+   errcode = run_best(bench, decomp_args, &measure);
+   if (errcode) return errcode;
+   result->decomp_time = measure.time - bench->startup[codec->tool];
+   result->decomp_memory = measure.memory;
+
+   errcode = same_files(filename, bench->unpacked);
+   if (errcode) return errcode;
+
+   // Decompress on the 68000
+   char *source = join_path(bench->routines[codec->tool], codec->source);
+   if (source == NULL)
+      return ERR_NOMEMORY;
+
+   char *cycles_args[] = { bench->cycles, "-a", source, "-o", bench->md,
+                           NULL, NULL, NULL, NULL };
+   argpos = 5;
+   if (codec->setup != NULL)
+      cycles_args[argpos++] = (char *) codec->setup;
+   cycles_args[argpos++] = (char *) codec->routine;
+   cycles_args[argpos] = bench->packed;
+
+   char report[0x400];
+   errcode = run_tool(cycles_args, report, sizeof(report), &measure);
+   free(source);
+   if (errcode) return errcode;
+
+   // The report has a comment line then a line with the results
+   const char *line = report;
+   while (*line == '#') {
+      line = strchr(line, '\n');
+      if (line == NULL) return ERR_BADREPORT;
+      line++;
+   }
+   const char *space = strchr(line, ' ');
+   if (space == NULL)
+      return ERR_BADREPORT;
+   char *endptr;
+   result->cycles = strtoull(space + 1, &endptr, 10);
+   if (endptr == space + 1)
+      return ERR_BADREPORT;
+
+   return same_files(filename, bench->md);
+}
+
+//***************************************************************************
+// run_best [internal]
+// Runs a tool as many times as requested and keeps the fastest time and
+// the highest memory usage
+//---------------------------------------------------------------------------
+// param bench: benchmark state
+// param argv: arguments to run the tool
+// param measure: where to store the measurements
+// return: error code
+//***************************************************************************
+
+static int run_best(Bench *bench, char *const *argv, Measure *measure) {
+   measure->time = 0.0;
+   measure->memory = 0;
+
+   int i;
+   for (i = 0; i < bench->repeat; i++) {
+      Measure current;
+      int errcode = run_tool(argv, NULL, 0, &current);
+      if (errcode) return errcode;
+
+      if (i == 0 || current.time < measure->time)
+         measure->time = current.time;
+      if (current.memory > measure->memory)
+         measure->memory = current.memory;
+   }
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// same_files [internal]
+// Checks that two files have the same contents
+//---------------------------------------------------------------------------
+// param filename1: first file
+// param filename2: second file
+// return: ERR_NONE if they match, ERR_MISMATCH if not, or another error code
+//***************************************************************************
+
+static int same_files(const char *filename1, const char *filename2) {
+   FILE *file1 = fopen(filename1, "rb");
+   if (file1 == NULL)
+      return ERR_CANTREAD;
+   FILE *file2 = fopen(filename2, "rb");
+   if (file2 == NULL) {
+      fclose(file1);
+      return ERR_CANTREAD;
+   }
+
+   int errcode = ERR_NONE;
+   for (;;) {
+      int byte1 = fgetc(file1);
+      int byte2 = fgetc(file2);
+      if (byte1 != byte2) {
+         errcode = ERR_MISMATCH;
+         break;
+      }
+      if (byte1 == EOF)
+         break;
+   }
+
+   if (ferror(file1) || ferror(file2))
+      errcode = ERR_CANTREAD;
+   fclose(file1);
+   fclose(file2);
+   return errcode;
+}
+
+//***************************************************************************
+// print_result [internal]
+// Writes a line of the report
+//---------------------------------------------------------------------------
+// param classname: class of the file
+// param filename: name of the file
+// param codec: codec used
+// param result: what we measured
+//***************************************************************************
+
+static void print_result(const char *classname, const char *filename,
+const Codec *codec, const Result *result) {
+   printf("%s\t%s\t%s\t%ld\t%ld\t%.4f\t", classname, filename, codec->name,
+      result->size, result->packed,
+      (double) result->packed / result->size);
+   print_speed(result->size, result->comp_time);
+   putchar('\t');
+   print_speed(result->size, result->decomp_time);
+   printf("\t%ld\t%ld\t%llu\t%.2f\t%.3f\n",
+      result->comp_memory, result->decomp_memory, result->cycles,
+      (double) result->cycles / result->size,
+      (double) result->cycles / CYCLES_NTSC);
+}
+
+//***************************************************************************
+// print_speed [internal]
+// Writes how many MB/s were processed. If the time is too short to tell
+// apart from how long the tool takes to start up, writes "-" instead.
+//---------------------------------------------------------------------------
+// param size: bytes processed
+// param time: time taken (in seconds, without the startup time)
+//***************************************************************************
+
+static void print_speed(long size, double time) {
+   if (time <= 0.0)
+      fputs("-", stdout);
+   else
+      printf("%.2f", (double) size / time / 1e6);
+}
+
+//***************************************************************************
+// skip_entry [internal]
+// Filter for scandir that leaves out hidden files (and . and ..)
+//---------------------------------------------------------------------------
+// param entry: directory entry
+// return: non-zero to keep it, zero to skip it
+//***************************************************************************
+
+static int skip_entry(const struct dirent *entry) {
+   return entry->d_name[0] != '.';
+}
+
+//***************************************************************************
+// get_error_msg [internal]
+// Gets the message to show for an error code
+//---------------------------------------------------------------------------
+// param errcode: error code
+// return: message
+//***************************************************************************
+
+static const char *get_error_msg(int errcode) {
+   switch (errcode) {
+      case ERR_CANTREAD: return "can't read from file";
+      case ERR_CANTWRITE: return "can't write to file";
+      case ERR_CANTRUN: return "can't run tool";
+      case ERR_TOOLFAILED: return "tool failed";
+      case ERR_MISMATCH: return "decompressed data doesn't match";
+      case ERR_BADREPORT: return "can't understand cycles68k's report";
+      case ERR_NOMEMORY: return "ran out of memory";
+      default: return "unknown error";
+   }
+}
@@ -0,0 +1,46 @@
+//***************************************************************************
+// "main.h"
+// Some common definitions and such
+//***************************************************************************
+// Compression benchmark tool
+//
+// This file is part of the mdbench tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+#ifndef MAIN_H
+#define MAIN_H
+
+// Cycles available in a frame (same as in cycles68k)
+#define CYCLES_NTSC  127841      // 7670453 Hz / 60 Hz
+
+// Error codes
+enum {
+   ERR_NONE,            // No error
+   ERR_CANTREAD,        // Can't read from file
+   ERR_CANTWRITE,       // Can't write into file
+   ERR_CANTRUN,         // Can't run a tool
+   ERR_TOOLFAILED,      // A tool returned an error
+   ERR_MISMATCH,        // Decompressed data doesn't match the original
+   ERR_BADREPORT,       // Couldn't make sense of cycles68k's report
+   ERR_NOMEMORY,        // Ran out of memory
+   ERR_UNKNOWN          // Unknown error
+};
+
+#endif
@@ -0,0 +1,126 @@
+//***************************************************************************
+// "run.c"
+// Runs the tools and measures them
+//***************************************************************************
+// Compression benchmark tool
+//
+// This file is part of the mdbench tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "main.h"
+#include "run.h"
+
+//***************************************************************************
+// run_tool
+// Runs a tool and waits for it to finish, measuring how long it took and
+// how much memory it needed. Its standard output can be captured.
+//---------------------------------------------------------------------------
+// param argv: arguments (argv[0] is the executable, NULL terminated)
+// param output: where to store standard output (NULL to discard it)
+// param outsize: size of output buffer (output is always nul terminated)
+// param measure: where to store the measurements
+// return: error code
+//***************************************************************************
+
+int run_tool(char *const *argv, char *output, size_t outsize,
+Measure *measure) {
+   // Make a pipe to read the output if needed
+   int fds[2] = { -1, -1 };
+   if (output != NULL && pipe(fds))
+      return ERR_CANTRUN;
+
+   // Start the timer right before spawning the process so the time it
+   // takes to start up is counted (mdbench subtracts it later)
+   struct timespec start;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   pid_t pid = fork();
+   if (pid == -1) {
+      if (output != NULL) {
+         close(fds[0]);
+         close(fds[1]);
+      }
+      return ERR_CANTRUN;
+   }
+
+   // Child process? Hook up stdout and run the tool
+   // Standard error is left alone so the tool's own errors are shown
+   if (pid == 0) {
+      int null = open("/dev/null", O_RDWR);
+      if (null != -1) dup2(null, STDIN_FILENO);
+      if (output != NULL) {
+         dup2(fds[1], STDOUT_FILENO);
+         close(fds[0]);
+         close(fds[1]);
+      } else if (null != -1)
+         dup2(null, STDOUT_FILENO);
+      execv(argv[0], argv);
+      _exit(127);
+   }
+
+   // Collect the output
+   if (output != NULL) {
+      close(fds[1]);
+      size_t pos = 0;
+      for (;;) {
+         char buffer[0x100];
+         ssize_t got = read(fds[0], buffer, sizeof(buffer));
+         if (got <= 0) break;
+
+         size_t i;
+         for (i = 0; i < (size_t) got && pos + 1 < outsize; i++)
+            output[pos++] = buffer[i];
+      }
+      output[pos] = '\0';
+      close(fds[0]);
+   }
+
+   // Wait for it to finish
+   int status;
+   struct rusage usage;
+   if (wait4(pid, &status, 0, &usage) == -1)
+      return ERR_CANTRUN;
+
+   struct timespec end;
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   // Store the measurements
+   measure->time = (double)(end.tv_sec - start.tv_sec) +
+                   (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+   measure->memory = usage.ru_maxrss;
+
+   // Did it work?
+   if (!WIFEXITED(status))
+      return ERR_TOOLFAILED;
+   if (WEXITSTATUS(status) == 127)
+      return ERR_CANTRUN;
+   if (WEXITSTATUS(status) != 0)
+      return ERR_TOOLFAILED;
+   return ERR_NONE;
+}
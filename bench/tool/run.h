@@ -0,0 +1,42 @@
+//***************************************************************************
+// "run.h"
+// Runs the tools and measures them
+//***************************************************************************
+// Compression benchmark tool
+//
+// This file is part of the mdbench tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+#ifndef RUN_H
+#define RUN_H
+
+// Required headers
+#include <stddef.h>
+
+// What we measured from running a tool
+typedef struct {
+   double time;         // Wall clock time (in seconds)
+   long memory;         // Peak resident memory (in KB)
+} Measure;
+
+// Function prototypes
+int run_tool(char *const *, char *, size_t, Measure *);
+
+#endif
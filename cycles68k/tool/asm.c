@@ -0,0 +1,1478 @@
+//***************************************************************************
+// "asm.c"
+// Assembles the routines to be measured
+//***************************************************************************
+// 68000 cycle counting tool
+//
+// This file is part of the cycles68k tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "asm.h"
+
+// Longest symbol name allowed
+#define MAX_NAME 0x100
+
+// Most operands an instruction or directive can take
+#define MAX_OPERANDS 0x40
+
+// Line of source code
+typedef struct {
+   char *text;                // Contents of the line
+   const char *file;          // File it came from
+   unsigned line;             // Line number
+} Line;
+
+// Where the assembler is at
+typedef struct {
+   Program *prog;             // Where the output goes
+   int pass;                  // Current pass (1 or 2)
+   uint32_t pc;               // Current address
+   const Line *line;          // Line being assembled
+   char scope[MAX_NAME];      // Last global label (for local labels)
+   size_t instr_alloc;        // Space allocated for instructions
+   size_t data_alloc;         // Space allocated for data
+   int failed;                // Set if there was an error
+} State;
+
+// Conditions (in the order the 68000 encodes them)
+static const char *const conditions[] = {
+   "t", "f", "hi", "ls", "cc", "cs", "ne", "eq",
+   "vc", "vs", "pl", "mi", "ge", "lt", "gt", "le"
+};
+
+// Instructions with a fixed name
+static const struct {
+   const char *name;          // Mnemonic
+   int op;                    // Instruction
+} mnemonics[] = {
+   { "move", OP_MOVE }, { "movea", OP_MOVEA }, { "moveq", OP_MOVEQ },
+   { "movem", OP_MOVEM }, { "lea", OP_LEA }, { "pea", OP_PEA },
+   { "add", OP_ADD }, { "adda", OP_ADDA }, { "addi", OP_ADDI },
+   { "addq", OP_ADDQ }, { "sub", OP_SUB }, { "suba", OP_SUBA },
+   { "subi", OP_SUBI }, { "subq", OP_SUBQ }, { "cmp", OP_CMP },
+   { "cmpa", OP_CMPA }, { "cmpi", OP_CMPI }, { "and", OP_AND },
+   { "andi", OP_ANDI }, { "or", OP_OR }, { "ori", OP_ORI },
+   { "eor", OP_EOR }, { "eori", OP_EORI }, { "neg", OP_NEG },
+   { "not", OP_NOT }, { "clr", OP_CLR }, { "tst", OP_TST },
+   { "ext", OP_EXT }, { "swap", OP_SWAP }, { "exg", OP_EXG },
+   { "lsl", OP_LSL }, { "lsr", OP_LSR }, { "asl", OP_ASL },
+   { "asr", OP_ASR }, { "rol", OP_ROL }, { "ror", OP_ROR },
+   { "mulu", OP_MULU }, { "muls", OP_MULS }, { "btst", OP_BTST },
+   { "bchg", OP_BCHG }, { "bclr", OP_BCLR }, { "bset", OP_BSET },
+   { "bra", OP_BRA }, { "bsr", OP_BSR }, { "jmp", OP_JMP },
+   { "jsr", OP_JSR }, { "rts", OP_RTS }, { "nop", OP_NOP },
+   { "dbra", OP_DBCC }, { "blo", OP_BCC }, { "bhs", OP_BCC },
+   { "dblo", OP_DBCC }, { "dbhs", OP_DBCC },
+   { NULL, 0 }
+};
+
+// Function prototypes
+static int load_source(const char *, Line **, size_t *, size_t *);
+static void run_block(State *, const Line *, size_t, size_t);
+static void split_line(char *, char **, char **, char **);
+static void define_label(State *, const char *, uint32_t);
+static void do_directive(State *, const char *, char *);
+static int do_instruction(State *, const char *, char *);
+static int split_operands(char *, char **);
+static void parse_operand(State *, const char *, Operand *);
+static int parse_register(const char *);
+static int parse_reglist(const char *);
+static int32_t eval(State *, const char *);
+static int32_t eval_expr(State *, const char **, int);
+static int32_t eval_atom(State *, const char **);
+static uint32_t ext_length(const Operand *, int);
+static void emit_byte(State *, uint8_t);
+static void error(State *, const char *, ...);
+
+//***************************************************************************
+// assemble
+// Assembles a list of source files into a program
+//---------------------------------------------------------------------------
+// param files: list of filenames
+// param numfiles: number of files
+// param prog: where to store the program
+// return: error code
+//***************************************************************************
+
+int assemble(const char **files, int numfiles, Program *prog) {
+   // Start with an empty program
+   prog->instr = NULL;
+   prog->num_instr = 0;
+   prog->symbols = NULL;
+   prog->num_symbols = 0;
+   prog->data = NULL;
+   prog->size = 0;
+
+   // Load all the source code (it's assembled as if it was a single file)
+   Line *lines = NULL;
+   size_t num_lines = 0;
+   size_t alloc = 0;
+   int i;
+   for (i = 0; i < numfiles; i++) {
+      int errcode = load_source(files[i], &lines, &num_lines, &alloc);
+      if (errcode) {
+         if (errcode == ERR_CANTREAD)
+            fprintf(stderr, "Error: can't read \"%s\"\n", files[i]);
+         for (size_t j = 0; j < num_lines; j++)
+            free(lines[j].text);
+         free(lines);
+         return errcode;
+      }
+   }
+
+   // The first pass works out where every label goes (the size of the
+   // instructions never depends on the value of a label), the second pass
+   // generates the instructions proper
+   State state;
+   state.prog = prog;
+   state.instr_alloc = 0;
+   state.data_alloc = 0;
+   state.failed = 0;
+   for (state.pass = 1; state.pass <= 2 && !state.failed; state.pass++) {
+      state.pc = CODE_ADDR;
+      state.line = NULL;
+      state.scope[0] = '\0';
+      run_block(&state, lines, 0, num_lines);
+   }
+   prog->size = state.pc - CODE_ADDR;
+
+   // Done with the source code
+   size_t j;
+   for (j = 0; j < num_lines; j++)
+      free(lines[j].text);
+   free(lines);
+
+   // Error messages were already shown
+   if (state.failed) {
+      free_program(prog);
+      return ERR_ASSEMBLE;
+   }
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// get_symbol
+// Looks up the value of a symbol
+//---------------------------------------------------------------------------
+// param prog: program to look into
+// param name: name of the symbol
+// param value: where to store its value
+// return: non-zero if found, zero if not
+//***************************************************************************
+
+int get_symbol(const Program *prog, const char *name, uint32_t *value) {
+   size_t i;
+   for (i = 0; i < prog->num_symbols; i++) {
+      if (!strcmp(prog->symbols[i].name, name)) {
+         *value = prog->symbols[i].value;
+         return 1;
+      }
+   }
+   return 0;
+}
+
+//***************************************************************************
+// free_program
+// Deallocates everything the assembler generated
+//---------------------------------------------------------------------------
+// param prog: program to deallocate
+//***************************************************************************
+
+void free_program(Program *prog) {
+   size_t i;
+   for (i = 0; i < prog->num_symbols; i++)
+      free(prog->symbols[i].name);
+   free(prog->symbols);
+   free(prog->instr);
+   free(prog->data);
+   prog->symbols = NULL;
+   prog->instr = NULL;
+   prog->data = NULL;
+   prog->num_symbols = 0;
+   prog->num_instr = 0;
+   prog->size = 0;
+}
+
+//***************************************************************************
+// load_source [internal]
+// Reads all the lines of a source file
+//---------------------------------------------------------------------------
+// param filename: name of the file
+// param lines: pointer to list of lines (gets appended to)
+// param num_lines: pointer to number of lines
+// param alloc: pointer to space allocated for lines
+// return: error code
+//***************************************************************************
+
+static int load_source(const char *filename, Line **lines,
+size_t *num_lines, size_t *alloc) {
+   // Open file
+   FILE *file = fopen(filename, "r");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   // Read every line
+   char buffer[0x400];
+   unsigned line_num = 0;
+   while (fgets(buffer, sizeof(buffer), file) != NULL) {
+      line_num++;
+
+      // Get rid of the newline
+      buffer[strcspn(buffer, "\r\n")] = '\0';
+
+      // Make room for the line
+      if (*num_lines == *alloc) {
+         size_t new_alloc = *alloc ? *alloc * 2 : 0x100;
+         Line *temp = (Line *) realloc(*lines, sizeof(Line) * new_alloc);
+         if (temp == NULL) {
+            fclose(file);
+            return ERR_NOMEMORY;
+         }
+         *lines = temp;
+         *alloc = new_alloc;
+      }
+
+      // Store the line
+      Line *line = &(*lines)[*num_lines];
+      line->text = (char *) malloc(strlen(buffer) + 1);
+      if (line->text == NULL) {
+         fclose(file);
+         return ERR_NOMEMORY;
+      }
+      strcpy(line->text, buffer);
+      line->file = filename;
+      line->line = line_num;
+      (*num_lines)++;
+   }
+
+   // Done with the file
+   int failed = ferror(file);
+   fclose(file);
+   return failed ? ERR_CANTREAD : ERR_NONE;
+}
+
+//***************************************************************************
+// run_block [internal]
+// Assembles a range of lines (rept blocks make this recursive)
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param lines: list of lines
+// param start: first line
+// param end: line right after the last one
+//***************************************************************************
+
+static void run_block(State *state, const Line *lines, size_t start,
+size_t end) {
+   char buffer[0x400];
+   size_t i;
+
+   for (i = start; i < end && !state->failed; i++) {
+      // Split the line into its parts
+      char *label, *mnemonic, *operands;
+      state->line = &lines[i];
+      strcpy(buffer, lines[i].text);
+      split_line(buffer, &label, &mnemonic, &operands);
+
+      // Equates take the label as their name
+      if (mnemonic != NULL && !strcmp(mnemonic, "equ")) {
+         if (label == NULL)
+            error(state, "equ without a name");
+         else
+            define_label(state, label, (uint32_t) eval(state, operands));
+         continue;
+      }
+
+      // Define label if present
+      if (label != NULL)
+         define_label(state, label, state->pc);
+      if (mnemonic == NULL)
+         continue;
+
+      // Repeated block?
+      if (!strcmp(mnemonic, "rept")) {
+         int32_t count = eval(state, operands);
+         if (state->failed) return;
+
+         // Look for where the block ends (it may have other blocks
+         // inside it)
+         size_t j;
+         int depth = 1;
+         for (j = i + 1; j < end; j++) {
+            char temp[0x400];
+            char *l, *m, *o;
+            strcpy(temp, lines[j].text);
+            split_line(temp, &l, &m, &o);
+            if (m == NULL) continue;
+            if (!strcmp(m, "rept")) depth++;
+            if (!strcmp(m, "endr") && --depth == 0) break;
+         }
+         if (j == end) {
+            error(state, "rept without endr");
+            return;
+         }
+
+         // Assemble it as many times as needed
+         int32_t n;
+         for (n = 0; n < count && !state->failed; n++)
+            run_block(state, lines, i + 1, j);
+         i = j;
+         continue;
+      }
+      if (!strcmp(mnemonic, "endr")) {
+         error(state, "endr without rept");
+         return;
+      }
+
+      // Directive or instruction?
+      if (!do_instruction(state, mnemonic, operands))
+         do_directive(state, mnemonic, operands);
+   }
+}
+
+//***************************************************************************
+// split_line [internal]
+// Splits a line into label, mnemonic and operands. Comments are removed
+// and the mnemonic is made lowercase. Missing parts are set to NULL.
+//---------------------------------------------------------------------------
+// param text: line to split (gets modified)
+// param label: where to store the label
+// param mnemonic: where to store the mnemonic
+// param operands: where to store the operands
+//***************************************************************************
+
+static void split_line(char *text, char **label, char **mnemonic,
+char **operands) {
+   *label = NULL;
+   *mnemonic = NULL;
+   *operands = NULL;
+
+   // Get rid of the comment (if any)
+   char *ptr;
+   int quoted = 0;
+   for (ptr = text; *ptr; ptr++) {
+      if (*ptr == '"' || *ptr == '\'') quoted = !quoted;
+      if (*ptr == ';' && !quoted) { *ptr = '\0'; break; }
+   }
+   for (ptr = text + strlen(text); ptr > text && isspace(ptr[-1]); ptr--)
+      ptr[-1] = '\0';
+
+   // Label? Those start in the first column or end with a colon
+   ptr = text;
+   if (*ptr != '\0' && !isspace(*ptr)) {
+      *label = ptr;
+      while (*ptr != '\0' && *ptr != ':' && !isspace(*ptr)) ptr++;
+      if (*ptr == ':') *ptr++ = '\0';
+      else if (*ptr != '\0') *ptr++ = '\0';
+   }
+   while (isspace(*ptr)) ptr++;
+   if (*ptr == '\0') return;
+
+   // Mnemonic
+   *mnemonic = ptr;
+   while (*ptr != '\0' && !isspace(*ptr)) {
+      *ptr = tolower(*ptr);
+      ptr++;
+   }
+   if (ptr[-1] == ':' && *label == NULL) {
+      ptr[-1] = '\0';
+      *label = *mnemonic;
+      *mnemonic = NULL;
+      while (isspace(*ptr)) ptr++;
+      if (*ptr == '\0') return;
+      *mnemonic = ptr;
+      while (*ptr != '\0' && !isspace(*ptr)) {
+         *ptr = tolower(*ptr);
+         ptr++;
+      }
+   }
+   if (*ptr != '\0') *ptr++ = '\0';
+
+   // Operands
+   while (isspace(*ptr)) ptr++;
+   *operands = ptr;
+}
+
+//***************************************************************************
+// define_label [internal]
+// Defines a new label (or checks it during the second pass)
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param name: name of the label
+// param value: value of the label
+//***************************************************************************
+
+static void define_label(State *state, const char *name, uint32_t value) {
+   // Local labels belong to the last global label
+   char fullname[MAX_NAME * 2 + 1];
+   if (name[0] == '@')
+      sprintf(fullname, "%s%s", state->scope, name);
+   else {
+      if (strlen(name) >= MAX_NAME) {
+         error(state, "label \"%s\" is too long", name);
+         return;
+      }
+      strcpy(state->scope, name);
+      strcpy(fullname, name);
+   }
+
+   // Labels only need to be defined once
+   Program *prog = state->prog;
+   uint32_t old_value;
+   if (state->pass == 2) {
+      if (get_symbol(prog, fullname, &old_value) && old_value != value)
+         error(state, "label \"%s\" moved between passes", name);
+      return;
+   }
+   if (get_symbol(prog, fullname, &old_value)) {
+      error(state, "label \"%s\" is defined twice", name);
+      return;
+   }
+
+   // Add it to the list
+   Symbol *temp = (Symbol *) realloc(prog->symbols,
+                  sizeof(Symbol) * (prog->num_symbols + 1));
+   char *copy = (char *) malloc(strlen(fullname) + 1);
+   if (temp == NULL || copy == NULL) {
+      if (temp != NULL) prog->symbols = temp;
+      free(copy);
+      error(state, "ran out of memory");
+      return;
+   }
+   strcpy(copy, fullname);
+   prog->symbols = temp;
+   prog->symbols[prog->num_symbols].name = copy;
+   prog->symbols[prog->num_symbols].value = value;
+   prog->num_symbols++;
+}
+
+//***************************************************************************
+// do_directive [internal]
+// Processes a directive
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param mnemonic: name of the directive
+// param operands: its operands
+//***************************************************************************
+
+static void do_directive(State *state, const char *mnemonic,
+char *operands) {
+   // Pad to an even address?
+   if (!strcmp(mnemonic, "even")) {
+      if (state->pc & 1)
+         emit_byte(state, 0);
+      return;
+   }
+
+   // Reserve space?
+   if (!strcmp(mnemonic, "ds.b") || !strcmp(mnemonic, "ds.w") ||
+   !strcmp(mnemonic, "ds.l")) {
+      int size = mnemonic[3] == 'b' ? 1 : mnemonic[3] == 'w' ? 2 : 4;
+      int32_t count = eval(state, operands);
+      if (size > 1 && (state->pc & 1))
+         error(state, "data at odd address");
+      for (; count > 0; count--) {
+         int i;
+         for (i = 0; i < size; i++)
+            emit_byte(state, 0);
+      }
+      return;
+   }
+
+   // Data?
+   if (!strcmp(mnemonic, "dc.b") || !strcmp(mnemonic, "dc.w") ||
+   !strcmp(mnemonic, "dc.l")) {
+      int size = mnemonic[3] == 'b' ? 1 : mnemonic[3] == 'w' ? 2 : 4;
+      if (size > 1 && (state->pc & 1))
+         error(state, "data at odd address");
+
+      char *list[MAX_OPERANDS];
+      int count = split_operands(operands, list);
+      if (count < 0) {
+         error(state, "too many operands");
+         return;
+      }
+
+      int i;
+      for (i = 0; i < count; i++) {
+         // Strings go byte by byte
+         const char *ptr = list[i];
+         if (size == 1 && ptr[0] == '"') {
+            for (ptr++; *ptr != '\0' && *ptr != '"'; ptr++)
+               emit_byte(state, (uint8_t) *ptr);
+            continue;
+         }
+
+         // Anything else is a number
+         uint32_t value = (uint32_t) eval(state, ptr);
+         int shift;
+         for (shift = (size - 1) * 8; shift >= 0; shift -= 8)
+            emit_byte(state, (uint8_t)(value >> shift));
+      }
+      return;
+   }
+
+   // Huh?
+   error(state, "unknown instruction \"%s\"", mnemonic);
+}
+
+//***************************************************************************
+// do_instruction [internal]
+// Assembles an instruction
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param mnemonic: mnemonic (with size, if any)
+// param operands: its operands
+// return: non-zero if it was an instruction, zero otherwise
+//***************************************************************************
+
+static int do_instruction(State *state, const char *mnemonic,
+char *operands) {
+   // Separate the size from the mnemonic
+   char name[0x10];
+   int size = 0;
+   int is_short = 0;
+   const char *dot = strchr(mnemonic, '.');
+   size_t len = dot ? (size_t)(dot - mnemonic) : strlen(mnemonic);
+   if (len >= sizeof(name))
+      return 0;
+   memcpy(name, mnemonic, len);
+   name[len] = '\0';
+   if (dot != NULL) {
+      if (!strcmp(dot, ".b")) size = 1;
+      else if (!strcmp(dot, ".w")) size = 2;
+      else if (!strcmp(dot, ".l")) size = 4;
+      else if (!strcmp(dot, ".s")) is_short = 1;
+      else return 0;
+   }
+
+   // Figure out which instruction it is
+   Instr instr;
+   memset(&instr, 0, sizeof(Instr));
+   instr.cond = 0;
+   int i;
+   for (i = 0; mnemonics[i].name != NULL; i++) {
+      if (!strcmp(mnemonics[i].name, name)) {
+         instr.op = mnemonics[i].op;
+         break;
+      }
+   }
+   if (mnemonics[i].name != NULL) {
+      // Aliases for some conditions
+      if (!strcmp(name, "dbra")) instr.cond = 1;
+      if (!strcmp(name, "blo") || !strcmp(name, "dblo")) instr.cond = 5;
+      if (!strcmp(name, "bhs") || !strcmp(name, "dbhs")) instr.cond = 4;
+   } else {
+      // Conditional branches
+      int cond;
+      for (cond = 0; cond < 16; cond++) {
+         if (name[0] == 'b' && cond >= 2 &&
+         !strcmp(name + 1, conditions[cond])) {
+            instr.op = OP_BCC;
+            break;
+         }
+         if (name[0] == 'd' && name[1] == 'b' &&
+         !strcmp(name + 2, conditions[cond])) {
+            instr.op = OP_DBCC;
+            break;
+         }
+      }
+      if (cond == 16)
+         return 0;
+      instr.cond = cond;
+   }
+
+   // Only branches can be short
+   int is_branch = instr.op == OP_BRA || instr.op == OP_BSR ||
+                   instr.op == OP_BCC;
+   if (is_short && !is_branch) {
+      error(state, "\"%s\" can't be short", name);
+      return 1;
+   }
+
+   // Parse the operands
+   char *list[MAX_OPERANDS];
+   int count = split_operands(operands, list);
+   if (count < 0 || count > 2) {
+      error(state, "too many operands");
+      return 1;
+   }
+   instr.src.mode = EA_NONE;
+   instr.dst.mode = EA_NONE;
+   if (count >= 1) parse_operand(state, list[0], &instr.src);
+   if (count >= 2) parse_operand(state, list[1], &instr.dst);
+   if (state->failed) return 1;
+
+   // How many operands each instruction takes
+   int expected = 2;
+   switch (instr.op) {
+      case OP_RTS: case OP_NOP:
+         expected = 0; break;
+      case OP_NEG: case OP_NOT: case OP_CLR: case OP_TST: case OP_EXT:
+      case OP_SWAP: case OP_BRA: case OP_BSR: case OP_BCC: case OP_JMP:
+      case OP_JSR: case OP_PEA:
+         expected = 1; break;
+      case OP_LSL: case OP_LSR: case OP_ASL: case OP_ASR: case OP_ROL:
+      case OP_ROR:
+         expected = count == 1 ? 1 : 2; break;
+   }
+   if (count != expected) {
+      error(state, "\"%s\" takes %d operand%s", name, expected,
+         expected == 1 ? "" : "s");
+      return 1;
+   }
+
+   // Work out the default size
+   if (size == 0) {
+      switch (instr.op) {
+         case OP_MOVEQ: case OP_LEA: case OP_PEA: case OP_EXG:
+            size = 4; break;
+         case OP_BTST: case OP_BCHG: case OP_BCLR: case OP_BSET:
+            size = instr.dst.mode == EA_DREG ? 4 : 1; break;
+         default:
+            size = 2; break;
+      }
+   }
+   instr.size = size;
+
+   // Pick the specific version of generic instructions
+   const Operand *src = &instr.src;
+   const Operand *dst = &instr.dst;
+   switch (instr.op) {
+      case OP_MOVE:
+         if (dst->mode == EA_AREG) instr.op = OP_MOVEA;
+         break;
+      case OP_ADD:
+         if (dst->mode == EA_AREG) instr.op = OP_ADDA;
+         else if (src->mode == EA_IMM) instr.op = OP_ADDI;
+         break;
+      case OP_SUB:
+         if (dst->mode == EA_AREG) instr.op = OP_SUBA;
+         else if (src->mode == EA_IMM) instr.op = OP_SUBI;
+         break;
+      case OP_CMP:
+         if (dst->mode == EA_AREG) instr.op = OP_CMPA;
+         else if (src->mode == EA_IMM) instr.op = OP_CMPI;
+         break;
+      case OP_AND:
+         if (src->mode == EA_IMM) instr.op = OP_ANDI;
+         break;
+      case OP_OR:
+         if (src->mode == EA_IMM) instr.op = OP_ORI;
+         break;
+      case OP_EOR:
+         if (src->mode == EA_IMM) instr.op = OP_EORI;
+         break;
+   }
+
+   // Check that the operands make sense and work out how long the
+   // instruction is (this only depends on the addressing modes)
+   int is_quick = 0;
+   instr.length = 2;
+   switch (instr.op) {
+      case OP_MOVE:
+      case OP_ADD: case OP_SUB: case OP_CMP:
+      case OP_AND: case OP_OR: case OP_EOR:
+         if (dst->mode == EA_IMM || dst->mode >= EA_PCDISP ||
+         (dst->mode == EA_AREG && instr.op != OP_MOVE)) {
+            error(state, "invalid destination");
+            return 1;
+         }
+         if (instr.op != OP_MOVE && instr.op != OP_CMP &&
+         src->mode != EA_DREG && dst->mode != EA_DREG) {
+            error(state, "one of the operands must be a data register");
+            return 1;
+         }
+         if (instr.op == OP_EOR && src->mode != EA_DREG) {
+            error(state, "source must be a data register");
+            return 1;
+         }
+         if (instr.op == OP_CMP && dst->mode != EA_DREG) {
+            error(state, "destination must be a data register");
+            return 1;
+         }
+         if (size == 1 && src->mode == EA_AREG) {
+            error(state, "address registers can't be used as bytes");
+            return 1;
+         }
+         break;
+
+      case OP_MOVEA: case OP_ADDA: case OP_SUBA: case OP_CMPA:
+         if (dst->mode != EA_AREG || size == 1) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         break;
+
+      case OP_ADDI: case OP_SUBI: case OP_CMPI:
+      case OP_ANDI: case OP_ORI: case OP_EORI:
+         if (dst->mode == EA_AREG || dst->mode >= EA_PCDISP) {
+            error(state, "invalid destination");
+            return 1;
+         }
+         break;
+
+      case OP_MOVEQ:
+         if (src->mode != EA_IMM || dst->mode != EA_DREG) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         if (state->pass == 2 && (src->value < -0x80 || src->value > 0xFF)) {
+            error(state, "moveq value out of range");
+            return 1;
+         }
+         is_quick = 1;
+         break;
+
+      case OP_ADDQ: case OP_SUBQ:
+         if (src->mode != EA_IMM || dst->mode >= EA_PCDISP) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         if (state->pass == 2 && (src->value < 1 || src->value > 8)) {
+            error(state, "quick value out of range");
+            return 1;
+         }
+         is_quick = 1;
+         break;
+
+      case OP_LSL: case OP_LSR: case OP_ASL:
+      case OP_ASR: case OP_ROL: case OP_ROR:
+         if (count == 1) {
+            // Memory shift (always one bit, always word)
+            if (src->mode < EA_IND || src->mode >= EA_PCDISP || size != 2) {
+               error(state, "invalid operand");
+               return 1;
+            }
+            instr.dst = instr.src;
+            instr.src.mode = EA_NONE;
+         } else if (dst->mode != EA_DREG ||
+         (src->mode != EA_IMM && src->mode != EA_DREG)) {
+            error(state, "invalid operands");
+            return 1;
+         } else if (src->mode == EA_IMM) {
+            if (state->pass == 2 && (src->value < 1 || src->value > 8)) {
+               error(state, "shift count out of range");
+               return 1;
+            }
+            is_quick = 1;
+         }
+         break;
+
+      case OP_NEG: case OP_NOT: case OP_CLR: case OP_TST:
+         if (src->mode == EA_AREG || src->mode == EA_IMM ||
+         (src->mode >= EA_PCDISP && instr.op != OP_TST)) {
+            error(state, "invalid operand");
+            return 1;
+         }
+         instr.dst = instr.src;
+         instr.src.mode = EA_NONE;
+         break;
+
+      case OP_EXT: case OP_SWAP:
+         if (src->mode != EA_DREG || (instr.op == OP_EXT && size == 1)) {
+            error(state, "invalid operand");
+            return 1;
+         }
+         instr.dst = instr.src;
+         instr.src.mode = EA_NONE;
+         break;
+
+      case OP_EXG:
+         if ((src->mode != EA_DREG && src->mode != EA_AREG) ||
+         (dst->mode != EA_DREG && dst->mode != EA_AREG)) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         break;
+
+      case OP_MULU: case OP_MULS:
+         if (dst->mode != EA_DREG || src->mode == EA_AREG) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         instr.size = 2;
+         break;
+
+      case OP_BTST: case OP_BCHG: case OP_BCLR: case OP_BSET:
+         if ((src->mode != EA_DREG && src->mode != EA_IMM) ||
+         dst->mode == EA_AREG || dst->mode == EA_IMM) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         if (src->mode == EA_IMM) {
+            instr.length += 2;
+            is_quick = 1;
+         }
+         break;
+
+      case OP_LEA: case OP_PEA: case OP_JMP: case OP_JSR:
+         if (src->mode < EA_IND || src->mode == EA_POSTINC ||
+         src->mode == EA_PREDEC || src->mode == EA_IMM ||
+         src->mode == EA_REGLIST) {
+            error(state, "invalid operand");
+            return 1;
+         }
+         if (instr.op == OP_LEA && dst->mode != EA_AREG) {
+            error(state, "destination must be an address register");
+            return 1;
+         }
+         break;
+
+      case OP_MOVEM: {
+         // Find out which operand is the register list
+         Operand *list = &instr.src;
+         Operand *mem = &instr.dst;
+         if (mem->mode == EA_DREG || mem->mode == EA_AREG ||
+         mem->mode == EA_REGLIST) {
+            list = &instr.dst;
+            mem = &instr.src;
+         }
+         if (list->mode == EA_DREG)
+            list->value = 1 << list->reg;
+         else if (list->mode == EA_AREG)
+            list->value = 0x100 << list->reg;
+         else if (list->mode != EA_REGLIST) {
+            error(state, "register list missing");
+            return 1;
+         }
+         list->mode = EA_REGLIST;
+         if (mem->mode < EA_IND || mem->mode == EA_IMM ||
+         mem->mode == EA_REGLIST ||
+         (list == &instr.src && (mem->mode == EA_POSTINC ||
+         mem->mode >= EA_PCDISP)) ||
+         (list == &instr.dst && mem->mode == EA_PREDEC) || size == 1) {
+            error(state, "invalid operands");
+            return 1;
+         }
+         instr.length += 2;
+      } break;
+
+      case OP_BRA: case OP_BSR: case OP_BCC:
+         instr.length = is_short ? 2 : 4;
+         if (state->pass == 2) {
+            int32_t disp = src->value - (int32_t)(state->pc + 2);
+            if (is_short ? (disp < -0x80 || disp > 0x7F || disp == 0)
+                         : (disp < -0x8000 || disp > 0x7FFF)) {
+               error(state, "branch out of range");
+               return 1;
+            }
+         }
+         instr.size = is_short ? 1 : 2;
+         break;
+
+      case OP_DBCC:
+         if (src->mode != EA_DREG) {
+            error(state, "counter must be a data register");
+            return 1;
+         }
+         instr.length = 4;
+         if (state->pass == 2) {
+            int32_t disp = dst->value - (int32_t)(state->pc + 2);
+            if (disp < -0x8000 || disp > 0x7FFF) {
+               error(state, "branch out of range");
+               return 1;
+            }
+         }
+         instr.size = 2;
+         break;
+   }
+
+   // Add the extension words for the operands
+   if (instr.op != OP_BRA && instr.op != OP_BSR && instr.op != OP_BCC &&
+   instr.op != OP_DBCC) {
+      if (!is_quick)
+         instr.length += ext_length(&instr.src, instr.size);
+      instr.length += ext_length(&instr.dst, instr.size);
+   }
+
+   // PC-relative operands are stored as a displacement from the
+   // extension word (which always comes right after the opcode, since
+   // only the source can be PC-relative)
+   if (instr.src.mode == EA_PCDISP || instr.src.mode == EA_PCINDEX) {
+      instr.src.value -= state->pc + 2;
+      if (state->pass == 2 && (instr.src.mode == EA_PCDISP ?
+      (instr.src.value < -0x8000 || instr.src.value > 0x7FFF) :
+      (instr.src.value < -0x80 || instr.src.value > 0x7F))) {
+         error(state, "displacement out of range");
+         return 1;
+      }
+   }
+
+   // Instructions must be at even addresses
+   if (state->pc & 1) {
+      error(state, "instruction at odd address");
+      return 1;
+   }
+
+   // Store the instruction during the second pass
+   if (state->pass == 2) {
+      Program *prog = state->prog;
+      if (prog->num_instr == state->instr_alloc) {
+         size_t new_alloc = state->instr_alloc ?
+                            state->instr_alloc * 2 : 0x100;
+         Instr *temp = (Instr *) realloc(prog->instr,
+                                         sizeof(Instr) * new_alloc);
+         if (temp == NULL) {
+            error(state, "ran out of memory");
+            return 1;
+         }
+         prog->instr = temp;
+         state->instr_alloc = new_alloc;
+      }
+      instr.addr = state->pc;
+      instr.file = state->line->file;
+      instr.line = state->line->line;
+      prog->instr[prog->num_instr++] = instr;
+   }
+
+   // Leave room for the instruction in memory (its contents don't matter
+   // since the code is never read as data)
+   uint32_t j;
+   for (j = 0; j < instr.length; j++)
+      emit_byte(state, 0);
+   return 1;
+}
+
+//***************************************************************************
+// split_operands [internal]
+// Splits the operands of an instruction (commas inside parenthesis or
+// quotes don't count)
+//---------------------------------------------------------------------------
+// param text: text with the operands (gets modified)
+// param list: where to store the operands
+// return: number of operands, or -1 if too many
+//***************************************************************************
+
+static int split_operands(char *text, char **list) {
+   if (text == NULL || *text == '\0')
+      return 0;
+
+   int count = 0;
+   int depth = 0;
+   int quoted = 0;
+   list[count++] = text;
+   for (; *text != '\0'; text++) {
+      if (*text == '"') quoted = !quoted;
+      if (quoted) continue;
+      if (*text == '(') depth++;
+      if (*text == ')') depth--;
+      if (*text == ',' && depth == 0) {
+         if (count == MAX_OPERANDS)
+            return -1;
+         *text = '\0';
+         list[count++] = text + 1;
+      }
+   }
+
+   // Trim whitespace around each operand
+   int i;
+   for (i = 0; i < count; i++) {
+      while (isspace(*list[i])) list[i]++;
+      char *end = list[i] + strlen(list[i]);
+      while (end > list[i] && isspace(end[-1])) *--end = '\0';
+   }
+   return count;
+}
+
+//***************************************************************************
+// parse_operand [internal]
+// Parses an operand into its addressing mode and values
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param text: operand text
+// param op: where to store the operand
+//***************************************************************************
+
+static void parse_operand(State *state, const char *text, Operand *op) {
+   char buffer[0x100];
+   if (strlen(text) >= sizeof(buffer)) {
+      error(state, "operand too long");
+      return;
+   }
+   strcpy(buffer, text);
+   size_t len = strlen(buffer);
+
+   op->mode = EA_NONE;
+   op->reg = 0;
+   op->index = 0;
+   op->index_long = 0;
+   op->value = 0;
+
+   // Immediate?
+   if (buffer[0] == '#') {
+      op->mode = EA_IMM;
+      op->value = eval(state, buffer + 1);
+      return;
+   }
+
+   // Register?
+   int reg = parse_register(buffer);
+   if (reg >= 0 && reg < 16) {
+      op->mode = reg < 8 ? EA_DREG : EA_AREG;
+      op->reg = reg & 7;
+      return;
+   }
+
+   // Register list?
+   int list = parse_reglist(buffer);
+   if (list >= 0) {
+      op->mode = EA_REGLIST;
+      op->value = list;
+      return;
+   }
+
+   // Predecrement?
+   if (len > 3 && buffer[0] == '-' && buffer[1] == '(' &&
+   buffer[len-1] == ')') {
+      buffer[len-1] = '\0';
+      reg = parse_register(buffer + 2);
+      if (reg >= 8 && reg < 16) {
+         op->mode = EA_PREDEC;
+         op->reg = reg & 7;
+         return;
+      }
+      buffer[len-1] = ')';
+   }
+
+   // Postincrement?
+   if (len > 3 && buffer[0] == '(' && buffer[len-2] == ')' &&
+   buffer[len-1] == '+') {
+      buffer[len-2] = '\0';
+      reg = parse_register(buffer + 1);
+      if (reg >= 8 && reg < 16) {
+         op->mode = EA_POSTINC;
+         op->reg = reg & 7;
+         return;
+      }
+      buffer[len-2] = ')';
+   }
+
+   // Absolute address with an explicit size?
+   int absw = 0;
+   if (len > 2 && buffer[len-2] == '.' &&
+   tolower(buffer[len-1]) == 'w') {
+      buffer[len-2] = '\0';
+      absw = 1;
+   } else if (len > 2 && buffer[len-2] == '.' &&
+   tolower(buffer[len-1]) == 'l') {
+      buffer[len-2] = '\0';
+   }
+   len = strlen(buffer);
+
+   // Register indirect? Look at what's inside the last parenthesis
+   if (!absw && len > 0 && buffer[len-1] == ')') {
+      int depth = 0;
+      char *open;
+      for (open = &buffer[len-1]; open > buffer; open--) {
+         if (*open == ')') depth++;
+         if (*open == '(' && --depth == 0) break;
+      }
+
+      // If it isn't a register then it's an expression
+      char inside[0x100];
+      strcpy(inside, open + 1);
+      inside[strlen(inside) - 1] = '\0';
+      char *comma = strchr(inside, ',');
+      if (comma) *comma = '\0';
+
+      reg = parse_register(inside);
+      if (*open == '(' && reg >= 8) {
+         // Displacement goes before the parenthesis
+         *open = '\0';
+         int32_t disp = buffer[0] != '\0' ? eval(state, buffer) : 0;
+
+         // Index register?
+         if (comma != NULL) {
+            char *index = comma + 1;
+            while (isspace(*index)) index++;
+            size_t index_len = strlen(index);
+            if (index_len > 2 && index[index_len-2] == '.') {
+               op->index_long = tolower(index[index_len-1]) == 'l';
+               if (!op->index_long && tolower(index[index_len-1]) != 'w') {
+                  error(state, "invalid index size");
+                  return;
+               }
+               index[index_len-2] = '\0';
+            }
+            op->index = parse_register(index);
+            if (op->index < 0 || op->index >= 16) {
+               error(state, "invalid index register");
+               return;
+            }
+            op->mode = reg == 16 ? EA_PCINDEX : EA_INDEX;
+            if (op->mode == EA_INDEX && state->pass == 2 &&
+            (disp < -0x80 || disp > 0x7F)) {
+               error(state, "displacement out of range");
+               return;
+            }
+         } else {
+            op->mode = reg == 16 ? EA_PCDISP : EA_DISP;
+            if (op->mode == EA_DISP && state->pass == 2 &&
+            (disp < -0x8000 || disp > 0x7FFF)) {
+               error(state, "displacement out of range");
+               return;
+            }
+            if (op->mode == EA_DISP && buffer[0] == '\0')
+               op->mode = EA_IND;
+         }
+         op->reg = reg & 7;
+         op->value = disp;
+         return;
+      }
+   }
+
+   // Absolute address then
+   op->mode = absw ? EA_ABSW : EA_ABSL;
+   op->value = eval(state, buffer);
+   if (absw && state->pass == 2 &&
+   (op->value < -0x8000 || op->value > 0x7FFF) &&
+   (op->value < 0xFF8000 || op->value > 0xFFFFFF)) {
+      error(state, "address out of range for abs.w");
+      return;
+   }
+   if (absw)
+      op->value = (int16_t)(op->value);
+}
+
+//***************************************************************************
+// parse_register [internal]
+// Parses the name of a register
+//---------------------------------------------------------------------------
+// param text: text to parse
+// return: 0-7 for d0-d7, 8-15 for a0-a7, 16 for pc, -1 if not a register
+//***************************************************************************
+
+static int parse_register(const char *text) {
+   while (isspace(*text)) text++;
+   size_t len = strlen(text);
+   while (len > 0 && isspace(text[len-1])) len--;
+   if (len != 2)
+      return -1;
+
+   int c1 = tolower(text[0]);
+   int c2 = tolower(text[1]);
+   if (c1 == 's' && c2 == 'p') return 15;
+   if (c1 == 'p' && c2 == 'c') return 16;
+   if (c2 < '0' || c2 > '7') return -1;
+   if (c1 == 'd') return c2 - '0';
+   if (c1 == 'a') return c2 - '0' + 8;
+   return -1;
+}
+
+//***************************************************************************
+// parse_reglist [internal]
+// Parses a register list (e.g. "d0-d3/a2")
+//---------------------------------------------------------------------------
+// param text: text to parse
+// return: register mask (d0 = bit 0, a7 = bit 15), -1 if not a list
+//***************************************************************************
+
+static int parse_reglist(const char *text) {
+   char buffer[0x100];
+   strcpy(buffer, text);
+
+   int mask = 0;
+   char *part = strtok(buffer, "/");
+   while (part != NULL) {
+      char *dash = strchr(part, '-');
+      if (dash) *dash = '\0';
+      int first = parse_register(part);
+      int last = dash ? parse_register(dash + 1) : first;
+      if (first < 0 || first >= 16 || last < first || last >= 16)
+         return -1;
+      for (; first <= last; first++)
+         mask |= 1 << first;
+      part = strtok(NULL, "/");
+   }
+   return mask;
+}
+
+//***************************************************************************
+// eval [internal]
+// Evaluates an expression
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param text: expression to evaluate
+// return: its value
+//***************************************************************************
+
+static int32_t eval(State *state, const char *text) {
+   if (text == NULL || *text == '\0') {
+      error(state, "missing value");
+      return 0;
+   }
+
+   int32_t value = eval_expr(state, &text, 0);
+   while (isspace(*text)) text++;
+   if (*text != '\0' && !state->failed)
+      error(state, "invalid expression");
+   return value;
+}
+
+//***************************************************************************
+// eval_expr [internal]
+// Evaluates binary operators from a given precedence level onwards
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param text: pointer to text (gets advanced)
+// param level: precedence level (0 = lowest)
+// return: value
+//***************************************************************************
+
+static int32_t eval_expr(State *state, const char **text, int level) {
+   // Operators for each precedence level, from lowest to highest
+   static const char *const levels[][4] = {
+      { "|", NULL }, { "^", NULL }, { "&", NULL },
+      { "<<", ">>", NULL }, { "+", "-", NULL }, { "*", "/", "%", NULL }
+   };
+   if (level == 6)
+      return eval_atom(state, text);
+
+   int32_t value = eval_expr(state, text, level + 1);
+   for (;;) {
+      while (isspace(**text)) (*text)++;
+
+      const char *op = NULL;
+      int i;
+      for (i = 0; levels[level][i] != NULL; i++) {
+         size_t len = strlen(levels[level][i]);
+         if (!strncmp(*text, levels[level][i], len)) {
+            op = levels[level][i];
+            *text += len;
+            break;
+         }
+      }
+      if (op == NULL)
+         return value;
+
+      int32_t rhs = eval_expr(state, text, level + 1);
+      switch (op[0]) {
+         case '|': value |= rhs; break;
+         case '^': value ^= rhs; break;
+         case '&': value &= rhs; break;
+         case '<': value = (int32_t)((uint32_t) value << (rhs & 31)); break;
+         case '>': value = (int32_t)((uint32_t) value >> (rhs & 31)); break;
+         case '+': value += rhs; break;
+         case '-': value -= rhs; break;
+         case '*': value *= rhs; break;
+         case '/': case '%':
+            if (rhs == 0) {
+               error(state, "division by zero");
+               return 0;
+            }
+            value = op[0] == '/' ? value / rhs : value % rhs;
+            break;
+      }
+   }
+}
+
+//***************************************************************************
+// eval_atom [internal]
+// Evaluates a single value (number, symbol, unary operator or expression
+// within parenthesis)
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param text: pointer to text (gets advanced)
+// return: value
+//***************************************************************************
+
+static int32_t eval_atom(State *state, const char **text) {
+   while (isspace(**text)) (*text)++;
+   const char *ptr = *text;
+   int32_t value = 0;
+
+   // Unary operators
+   if (*ptr == '-' || *ptr == '~' || *ptr == '+') {
+      *text = ptr + 1;
+      value = eval_atom(state, text);
+      return *ptr == '-' ? -value : *ptr == '~' ? ~value : value;
+   }
+
+   // Parenthesis
+   if (*ptr == '(') {
+      *text = ptr + 1;
+      value = eval_expr(state, text, 0);
+      while (isspace(**text)) (*text)++;
+      if (**text != ')') {
+         error(state, "missing closing parenthesis");
+         return 0;
+      }
+      (*text)++;
+      return value;
+   }
+
+   // Current address
+   if (*ptr == '*') {
+      *text = ptr + 1;
+      return (int32_t) state->pc;
+   }
+
+   // Hexadecimal, binary or decimal number
+   if (*ptr == '$' || *ptr == '%' || isdigit(*ptr)) {
+      int base = *ptr == '$' ? 16 : *ptr == '%' ? 2 : 10;
+      if (!isdigit(*ptr)) ptr++;
+      const char *start = ptr;
+      for (;; ptr++) {
+         int digit;
+         if (isdigit(*ptr)) digit = *ptr - '0';
+         else if (isalpha(*ptr)) digit = tolower(*ptr) - 'a' + 10;
+         else break;
+         if (digit >= base) break;
+         value = value * base + digit;
+      }
+      if (ptr == start) {
+         error(state, "invalid number");
+         return 0;
+      }
+      *text = ptr;
+      return value;
+   }
+
+   // Character
+   if (*ptr == '\'' && ptr[1] != '\0' && ptr[2] == '\'') {
+      *text = ptr + 3;
+      return (uint8_t) ptr[1];
+   }
+
+   // Symbol
+   if (isalpha(*ptr) || *ptr == '_' || *ptr == '@') {
+      char name[MAX_NAME];
+      size_t len = 0;
+      while (isalnum(*ptr) || *ptr == '_' || *ptr == '@' || *ptr == '?') {
+         if (len == MAX_NAME - 1) {
+            error(state, "symbol name too long");
+            return 0;
+         }
+         name[len++] = *ptr++;
+      }
+      name[len] = '\0';
+      *text = ptr;
+
+      // Local labels belong to the last global label
+      char fullname[MAX_NAME * 2 + 1];
+      if (name[0] == '@')
+         sprintf(fullname, "%s%s", state->scope, name);
+      else
+         strcpy(fullname, name);
+
+      // Labels defined later than this aren't known during the first
+      // pass, but the value doesn't matter there yet
+      uint32_t result;
+      if (get_symbol(state->prog, fullname, &result))
+         return (int32_t) result;
+      if (state->pass == 2)
+         error(state, "unknown symbol \"%s\"", name);
+      return 0;
+   }
+
+   // Huh?
+   error(state, "invalid expression");
+   return 0;
+}
+
+//***************************************************************************
+// ext_length [internal]
+// Works out how many bytes of extension words an operand needs
+//---------------------------------------------------------------------------
+// param op: operand
+// param size: operation size
+// return: length in bytes
+//***************************************************************************
+
+static uint32_t ext_length(const Operand *op, int size) {
+   switch (op->mode) {
+      case EA_DISP: case EA_INDEX: case EA_ABSW:
+      case EA_PCDISP: case EA_PCINDEX:
+         return 2;
+      case EA_ABSL:
+         return 4;
+      case EA_IMM:
+         return size == 4 ? 4 : 2;
+      default:
+         return 0;
+   }
+}
+
+//***************************************************************************
+// emit_byte [internal]
+// Outputs a byte at the current address
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param value: byte to output
+//***************************************************************************
+
+static void emit_byte(State *state, uint8_t value) {
+   // The memory image is only generated during the second pass
+   if (state->pass == 2) {
+      Program *prog = state->prog;
+      size_t pos = state->pc - CODE_ADDR;
+      if (CODE_ADDR + pos >= DICT_ADDR) {
+         error(state, "code is too large");
+         return;
+      }
+      if (pos >= state->data_alloc) {
+         size_t new_alloc = state->data_alloc ?
+                            state->data_alloc * 2 : 0x1000;
+         uint8_t *temp = (uint8_t *) realloc(prog->data, new_alloc);
+         if (temp == NULL) {
+            error(state, "ran out of memory");
+            return;
+         }
+         prog->data = temp;
+         state->data_alloc = new_alloc;
+      }
+      prog->data[pos] = value;
+   }
+   state->pc++;
+}
+
+//***************************************************************************
+// error [internal]
+// Shows an error message for the current line
+//---------------------------------------------------------------------------
+// param state: assembler state
+// param fmt: printf-style message
+//***************************************************************************
+
+static void error(State *state, const char *fmt, ...) {
+   if (state->failed)
+      return;
+   state->failed = 1;
+
+   if (state->line != NULL)
+      fprintf(stderr, "Error: %s:%u: ", state->line->file,
+         state->line->line);
+   else
+      fprintf(stderr, "Error: ");
+
+   va_list args;
+   va_start(args, fmt);
+   vfprintf(stderr, fmt, args);
+   va_end(args);
+   fputc('\n', stderr);
+}
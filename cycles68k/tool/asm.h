@@ -0,0 +1,112 @@
+//***************************************************************************
+// "asm.h"
+// Definitions for the assembler
+//***************************************************************************
+// 68000 cycle counting tool
+//
+// This file is part of the cycles68k tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+#ifndef ASM_H
+#define ASM_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+
+// Possible instructions
+// Generic instructions with an immediate source (e.g. "and #1,d0") get
+// turned into their immediate versions (e.g. "andi #1,d0"), and the ones
+// with an address register as destination get turned into their address
+// versions (e.g. "adda")
+enum {
+   OP_MOVE, OP_MOVEA, OP_MOVEQ, OP_MOVEM, OP_LEA, OP_PEA,
+   OP_ADD, OP_ADDA, OP_ADDI, OP_ADDQ,
+   OP_SUB, OP_SUBA, OP_SUBI, OP_SUBQ,
+   OP_CMP, OP_CMPA, OP_CMPI,
+   OP_AND, OP_ANDI, OP_OR, OP_ORI, OP_EOR, OP_EORI,
+   OP_NEG, OP_NOT, OP_CLR, OP_TST, OP_EXT, OP_SWAP, OP_EXG,
+   OP_LSL, OP_LSR, OP_ASL, OP_ASR, OP_ROL, OP_ROR,
+   OP_MULU, OP_MULS,
+   OP_BTST, OP_BCHG, OP_BCLR, OP_BSET,
+   OP_BRA, OP_BSR, OP_BCC, OP_DBCC, OP_JMP, OP_JSR, OP_RTS, OP_NOP
+};
+
+// Possible addressing modes
+enum {
+   EA_NONE,             // No operand
+   EA_DREG,             // Dn
+   EA_AREG,             // An
+   EA_IND,              // (An)
+   EA_POSTINC,          // (An)+
+   EA_PREDEC,           // -(An)
+   EA_DISP,             // d16(An)
+   EA_INDEX,            // d8(An,Xn)
+   EA_ABSW,             // abs.w
+   EA_ABSL,             // abs.l
+   EA_PCDISP,           // d16(PC)
+   EA_PCINDEX,          // d8(PC,Xn)
+   EA_IMM,              // #imm
+   EA_REGLIST           // Register list (for movem)
+};
+
+// Instruction operand
+typedef struct {
+   int mode;            // Addressing mode
+   int reg;             // Register (0-7)
+   int index;           // Index register (0-7 = Dn, 8-15 = An)
+   int index_long;      // Set if index register is used as long
+   int32_t value;       // Displacement, address, immediate or list
+} Operand;
+
+// Assembled instruction
+typedef struct {
+   uint32_t addr;       // Address of the instruction
+   uint32_t length;     // Length in bytes
+   int op;              // Instruction (OP_*)
+   int size;            // Operation size (1, 2 or 4 bytes)
+   int cond;            // Condition (for Bcc and DBcc)
+   Operand src;         // Source operand
+   Operand dst;         // Destination operand
+   const char *file;    // File where it came from
+   unsigned line;       // Line where it came from
+} Instr;
+
+// Symbol (label or equate)
+typedef struct {
+   char *name;          // Full name (local labels include their parent)
+   uint32_t value;      // Value
+} Symbol;
+
+// Everything the assembler generated
+typedef struct {
+   Instr *instr;        // List of instructions
+   size_t num_instr;    // Number of instructions
+   Symbol *symbols;     // List of symbols
+   size_t num_symbols;  // Number of symbols
+   uint8_t *data;       // Contents of memory from CODE_ADDR onwards
+   size_t size;         // Size of the assembled code and data
+} Program;
+
+// Function prototypes
+int assemble(const char **, int, Program *);
+int get_symbol(const Program *, const char *, uint32_t *);
+void free_program(Program *);
+
+#endif
@@ -0,0 +1,920 @@
+//***************************************************************************
+// "cpu.c"
+// Runs 68000 code and counts how many cycles it takes
+//***************************************************************************
+// 68000 cycle counting tool
+//
+// This file is part of the cycles68k tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "asm.h"
+#include "cpu.h"
+
+// Where an operand ended up pointing to
+typedef struct {
+   int mode;                  // Addressing mode (EA_*)
+   int reg;                   // Register (for register direct)
+   uint32_t addr;             // Address (for memory)
+   uint32_t value;            // Value (for immediate)
+} Loc;
+
+// Function prototypes
+static int step(Cpu *, const Instr *);
+static int resolve(Cpu *, const Instr *, const Operand *, int, Loc *);
+static int read_loc(Cpu *, const Loc *, int, uint32_t *);
+static int write_loc(Cpu *, const Loc *, int, uint32_t);
+static int read_mem(Cpu *, uint32_t, int, uint32_t *);
+static int write_mem(Cpu *, uint32_t, int, uint32_t);
+static unsigned ea_cycles(int, int);
+static unsigned write_cycles(int, int);
+static unsigned control_cycles(int, const unsigned *);
+static int test_cond(const Cpu *, int);
+
+// Size masks and sign bits
+#define MASK(size) ((size) == 4 ? 0xFFFFFFFF : (1U << ((size) * 8)) - 1)
+#define SIGN(size) (1U << ((size) * 8 - 1))
+
+//***************************************************************************
+// init_cpu
+// Sets up a 68000 to run a program
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param prog: program to run
+// return: error code
+//***************************************************************************
+
+int init_cpu(Cpu *cpu, const Program *prog) {
+   memset(cpu, 0, sizeof(Cpu));
+   cpu->prog = prog;
+
+   // Allocate the whole address space
+   cpu->mem = (uint8_t *) calloc(MEM_SIZE, 1);
+   if (cpu->mem == NULL)
+      return ERR_NOMEMORY;
+   if (prog->size > 0)
+      memcpy(&cpu->mem[CODE_ADDR], prog->data, prog->size);
+
+   // Make a table to quickly find the instruction at every address
+   size_t words = (prog->size + 1) / 2;
+   cpu->map = (int32_t *) malloc(sizeof(int32_t) * (words + 1));
+   if (cpu->map == NULL) {
+      free(cpu->mem);
+      return ERR_NOMEMORY;
+   }
+   size_t i;
+   for (i = 0; i < words; i++)
+      cpu->map[i] = -1;
+   for (i = 0; i < prog->num_instr; i++)
+      cpu->map[(prog->instr[i].addr - CODE_ADDR) >> 1] = (int32_t) i;
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// run_routine
+// Calls a subroutine and runs it until it returns. The registers must be
+// set up beforehand (except for the stack pointer). The cycles taken are
+// added to the cycle counter (this includes the final rts, but not the
+// jsr that would call the subroutine).
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param entry: address of the subroutine
+// param limit: give up after this many cycles
+// return: error code
+//***************************************************************************
+
+int run_routine(Cpu *cpu, uint32_t entry, uint64_t limit) {
+   const Program *prog = cpu->prog;
+   cpu->fault = NULL;
+
+   // Push the return address
+   cpu->a[7] = STACK_ADDR - 4;
+   write_mem(cpu, cpu->a[7], 4, RETURN_ADDR);
+   cpu->pc = entry;
+
+   // Keep running until the subroutine returns
+   uint64_t end = cpu->cycles + limit;
+   while (cpu->pc != RETURN_ADDR) {
+      // Find which instruction is here
+      uint32_t offset = cpu->pc - CODE_ADDR;
+      if ((cpu->pc & 1) || cpu->pc < CODE_ADDR || offset >= prog->size ||
+      cpu->map[offset >> 1] < 0)
+         return ERR_BADPC;
+      const Instr *instr = &prog->instr[cpu->map[offset >> 1]];
+
+      // Run it
+      int errcode = step(cpu, instr);
+      if (errcode) {
+         cpu->fault = instr;
+         return errcode;
+      }
+      if (cpu->cycles > end)
+         return ERR_TIMEOUT;
+   }
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// deinit_cpu
+// Frees up the resources used by a 68000
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+//***************************************************************************
+
+void deinit_cpu(Cpu *cpu) {
+   free(cpu->mem);
+   free(cpu->map);
+   cpu->mem = NULL;
+   cpu->map = NULL;
+}
+
+//***************************************************************************
+// step [internal]
+// Executes a single instruction
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param instr: instruction to execute
+// return: error code
+//***************************************************************************
+
+static int step(Cpu *cpu, const Instr *instr) {
+   // Timings for the control addressing modes, in the order (An), d16(An),
+   // d8(An,Xn), abs.w, abs.l, d16(PC), d8(PC,Xn)
+   static const unsigned jmp_cycles[] = { 8, 10, 14, 10, 12, 10, 14 };
+   static const unsigned jsr_cycles[] = { 16, 18, 22, 18, 20, 18, 22 };
+   static const unsigned lea_cycles[] = { 4, 8, 12, 8, 12, 8, 12 };
+   static const unsigned pea_cycles[] = { 12, 16, 20, 16, 20, 16, 20 };
+   static const unsigned movem_w_cycles[] = { 8, 12, 14, 12, 16, 0, 0 };
+   static const unsigned movem_r_cycles[] = { 12, 16, 18, 16, 20, 16, 18 };
+
+   int errcode = ERR_NONE;
+   int size = instr->size;
+   uint32_t mask = MASK(size);
+   uint32_t sign = SIGN(size);
+   int src_mode = instr->src.mode;
+   int dst_mode = instr->dst.mode;
+   Loc src, dst;
+   uint32_t s = 0, d = 0, r = 0;
+   unsigned cycles = 0;
+
+   // Where the next instruction is (branches will change this)
+   cpu->pc = instr->addr + instr->length;
+
+   switch (instr->op) {
+      // Moves
+      case OP_MOVE:
+         if ((errcode = resolve(cpu, instr, &instr->src, size, &src))) break;
+         if ((errcode = read_loc(cpu, &src, size, &s))) break;
+         if ((errcode = resolve(cpu, instr, &instr->dst, size, &dst))) break;
+         if ((errcode = write_loc(cpu, &dst, size, s))) break;
+         cpu->n = (s & sign) != 0;
+         cpu->z = (s & mask) == 0;
+         cpu->v = cpu->c = 0;
+         cycles = 4 + ea_cycles(src_mode, size) + write_cycles(dst_mode, size);
+         break;
+
+      case OP_MOVEA:
+         if ((errcode = resolve(cpu, instr, &instr->src, size, &src))) break;
+         if ((errcode = read_loc(cpu, &src, size, &s))) break;
+         cpu->a[instr->dst.reg] = size == 2 ? (uint32_t)(int16_t) s : s;
+         cycles = 4 + ea_cycles(src_mode, size);
+         break;
+
+      case OP_MOVEQ:
+         r = (uint32_t)(int8_t)(instr->src.value);
+         cpu->d[instr->dst.reg] = r;
+         cpu->n = (r & 0x80000000) != 0;
+         cpu->z = r == 0;
+         cpu->v = cpu->c = 0;
+         cycles = 4;
+         break;
+
+      case OP_MOVEM: {
+         // Register list goes in one operand, memory in the other
+         int to_mem = src_mode == EA_REGLIST;
+         const Operand *mem_op = to_mem ? &instr->dst : &instr->src;
+         unsigned list = (unsigned)(to_mem ? instr->src.value :
+                                             instr->dst.value);
+         int mode = mem_op->mode;
+         uint32_t addr;
+         int count = 0;
+         int i;
+
+         // Get the starting address without pre/postincrement (those
+         // are handled below)
+         if (mode == EA_PREDEC || mode == EA_POSTINC)
+            addr = cpu->a[mem_op->reg];
+         else {
+            if ((errcode = resolve(cpu, instr, mem_op, size, &dst))) break;
+            addr = dst.addr;
+         }
+
+         if (mode == EA_PREDEC) {
+            // Predecrement stores registers backwards (from a7 to d0)
+            for (i = 15; i >= 0; i--) {
+               if (!(list & (1 << i))) continue;
+               addr -= size;
+               uint32_t value = i < 8 ? cpu->d[i] : cpu->a[i - 8];
+               if ((errcode = write_mem(cpu, addr, size, value))) break;
+               count++;
+            }
+            cpu->a[mem_op->reg] = addr;
+         } else {
+            for (i = 0; i < 16; i++) {
+               if (!(list & (1 << i))) continue;
+               if (to_mem) {
+                  uint32_t value = i < 8 ? cpu->d[i] : cpu->a[i - 8];
+                  if ((errcode = write_mem(cpu, addr, size, value))) break;
+               } else {
+                  uint32_t value;
+                  if ((errcode = read_mem(cpu, addr, size, &value))) break;
+                  if (size == 2) value = (uint32_t)(int16_t) value;
+                  if (i < 8) cpu->d[i] = value;
+                  else cpu->a[i - 8] = value;
+               }
+               addr += size;
+               count++;
+            }
+            if (mode == EA_POSTINC)
+               cpu->a[mem_op->reg] = addr;
+         }
+         if (errcode) break;
+
+         // Predecrement and postincrement take as long as (An)
+         int ctrl = mode == EA_PREDEC || mode == EA_POSTINC ? EA_IND : mode;
+         cycles = control_cycles(ctrl, to_mem ? movem_w_cycles :
+                                                movem_r_cycles) +
+                  count * (size == 4 ? 8 : 4);
+      } break;
+
+      case OP_LEA:
+         if ((errcode = resolve(cpu, instr, &instr->src, 4, &src))) break;
+         cpu->a[instr->dst.reg] = src.addr;
+         cycles = control_cycles(src_mode, lea_cycles);
+         break;
+
+      case OP_PEA:
+         if ((errcode = resolve(cpu, instr, &instr->src, 4, &src))) break;
+         cpu->a[7] -= 4;
+         if ((errcode = write_mem(cpu, cpu->a[7], 4, src.addr))) break;
+         cycles = control_cycles(src_mode, pea_cycles);
+         break;
+
+      // Arithmetic and logic
+      case OP_ADD: case OP_SUB: case OP_AND: case OP_OR: case OP_EOR:
+      case OP_ADDI: case OP_SUBI: case OP_ANDI: case OP_ORI: case OP_EORI:
+      case OP_ADDQ: case OP_SUBQ:
+      case OP_CMP: case OP_CMPI: {
+         // Address registers as destination always use the whole
+         // register and don't change the flags
+         if (dst_mode == EA_AREG) {
+            s = (uint32_t)(instr->src.value);
+            if (instr->op == OP_ADDQ) cpu->a[instr->dst.reg] += s;
+            else cpu->a[instr->dst.reg] -= s;
+            cycles = 8;
+            break;
+         }
+
+         if ((errcode = resolve(cpu, instr, &instr->src, size, &src))) break;
+         if ((errcode = read_loc(cpu, &src, size, &s))) break;
+         if ((errcode = resolve(cpu, instr, &instr->dst, size, &dst))) break;
+         if ((errcode = read_loc(cpu, &dst, size, &d))) break;
+         s &= mask;
+         d &= mask;
+
+         int is_add = instr->op == OP_ADD || instr->op == OP_ADDI ||
+                      instr->op == OP_ADDQ;
+         int is_sub = instr->op == OP_SUB || instr->op == OP_SUBI ||
+                      instr->op == OP_SUBQ || instr->op == OP_CMP ||
+                      instr->op == OP_CMPI;
+         if (is_add) {
+            r = (d + s) & mask;
+            cpu->c = (uint64_t) d + s > mask;
+            cpu->v = ((d ^ r) & (s ^ r) & sign) != 0;
+            cpu->x = cpu->c;
+         } else if (is_sub) {
+            r = (d - s) & mask;
+            cpu->c = s > d;
+            cpu->v = ((d ^ s) & (d ^ r) & sign) != 0;
+            if (instr->op != OP_CMP && instr->op != OP_CMPI)
+               cpu->x = cpu->c;
+         } else {
+            if (instr->op == OP_AND || instr->op == OP_ANDI) r = d & s;
+            else if (instr->op == OP_OR || instr->op == OP_ORI) r = d | s;
+            else r = d ^ s;
+            cpu->v = cpu->c = 0;
+         }
+         cpu->n = (r & sign) != 0;
+         cpu->z = r == 0;
+         if (instr->op != OP_CMP && instr->op != OP_CMPI)
+            if ((errcode = write_loc(cpu, &dst, size, r))) break;
+
+         // Now work out how long did it take
+         int reg_src = src_mode == EA_DREG || src_mode == EA_AREG ||
+                       src_mode == EA_IMM;
+         switch (instr->op) {
+            case OP_ADD: case OP_SUB: case OP_AND: case OP_OR:
+               if (dst_mode == EA_DREG)
+                  cycles = (size == 4 ? (reg_src ? 8 : 6) : 4) +
+                           ea_cycles(src_mode, size);
+               else
+                  cycles = (size == 4 ? 12 : 8) + ea_cycles(dst_mode, size);
+               break;
+            case OP_EOR:
+               if (dst_mode == EA_DREG)
+                  cycles = size == 4 ? 8 : 4;
+               else
+                  cycles = (size == 4 ? 12 : 8) + ea_cycles(dst_mode, size);
+               break;
+            case OP_CMP:
+               cycles = (size == 4 ? 6 : 4) + ea_cycles(src_mode, size);
+               break;
+            case OP_CMPI:
+               if (dst_mode == EA_DREG)
+                  cycles = size == 4 ? 14 : 8;
+               else
+                  cycles = (size == 4 ? 12 : 8) + ea_cycles(dst_mode, size);
+               break;
+            case OP_ANDI:
+               if (dst_mode == EA_DREG)
+                  cycles = size == 4 ? 14 : 8;
+               else
+                  cycles = (size == 4 ? 20 : 12) + ea_cycles(dst_mode, size);
+               break;
+            case OP_ADDI: case OP_SUBI: case OP_ORI: case OP_EORI:
+               if (dst_mode == EA_DREG)
+                  cycles = size == 4 ? 16 : 8;
+               else
+                  cycles = (size == 4 ? 20 : 12) + ea_cycles(dst_mode, size);
+               break;
+            case OP_ADDQ: case OP_SUBQ:
+               if (dst_mode == EA_DREG)
+                  cycles = size == 4 ? 8 : 4;
+               else
+                  cycles = (size == 4 ? 12 : 8) + ea_cycles(dst_mode, size);
+               break;
+         }
+      } break;
+
+      case OP_ADDA: case OP_SUBA: case OP_CMPA:
+         if ((errcode = resolve(cpu, instr, &instr->src, size, &src))) break;
+         if ((errcode = read_loc(cpu, &src, size, &s))) break;
+         if (size == 2) s = (uint32_t)(int16_t) s;
+         d = cpu->a[instr->dst.reg];
+         if (instr->op == OP_ADDA)
+            cpu->a[instr->dst.reg] = d + s;
+         else if (instr->op == OP_SUBA)
+            cpu->a[instr->dst.reg] = d - s;
+         else {
+            r = d - s;
+            cpu->c = s > d;
+            cpu->v = ((d ^ s) & (d ^ r) & 0x80000000) != 0;
+            cpu->n = (r & 0x80000000) != 0;
+            cpu->z = r == 0;
+         }
+         if (instr->op == OP_CMPA)
+            cycles = 6 + ea_cycles(src_mode, size);
+         else if (size == 2)
+            cycles = 8 + ea_cycles(src_mode, size);
+         else
+            cycles = (src_mode == EA_DREG || src_mode == EA_AREG ||
+                      src_mode == EA_IMM ? 8 : 6) + ea_cycles(src_mode, size);
+         break;
+
+      // Single operand instructions
+      case OP_NEG: case OP_NOT: case OP_CLR: case OP_TST:
+         if ((errcode = resolve(cpu, instr, &instr->dst, size, &dst))) break;
+         if (instr->op != OP_CLR)
+            if ((errcode = read_loc(cpu, &dst, size, &d))) break;
+         d &= mask;
+         switch (instr->op) {
+            case OP_NEG:
+               r = (0 - d) & mask;
+               cpu->c = cpu->x = d != 0;
+               cpu->v = (d & r & sign) != 0;
+               break;
+            case OP_NOT:
+               r = ~d & mask;
+               cpu->v = cpu->c = 0;
+               break;
+            case OP_CLR:
+               r = 0;
+               cpu->v = cpu->c = 0;
+               break;
+            default:
+               r = d;
+               cpu->v = cpu->c = 0;
+               break;
+         }
+         cpu->n = (r & sign) != 0;
+         cpu->z = r == 0;
+         if (instr->op != OP_TST)
+            if ((errcode = write_loc(cpu, &dst, size, r))) break;
+         if (instr->op == OP_TST)
+            cycles = 4 + ea_cycles(dst_mode, size);
+         else if (dst_mode == EA_DREG)
+            cycles = size == 4 ? 6 : 4;
+         else
+            cycles = (size == 4 ? 12 : 8) + ea_cycles(dst_mode, size);
+         break;
+
+      case OP_EXT:
+         d = cpu->d[instr->dst.reg];
+         if (size == 2) {
+            r = (uint32_t)(int8_t) d & 0xFFFF;
+            cpu->d[instr->dst.reg] = (d & 0xFFFF0000) | r;
+         } else {
+            r = (uint32_t)(int16_t) d;
+            cpu->d[instr->dst.reg] = r;
+         }
+         cpu->n = (r & sign) != 0;
+         cpu->z = r == 0;
+         cpu->v = cpu->c = 0;
+         cycles = 4;
+         break;
+
+      case OP_SWAP:
+         d = cpu->d[instr->dst.reg];
+         r = d << 16 | d >> 16;
+         cpu->d[instr->dst.reg] = r;
+         cpu->n = (r & 0x80000000) != 0;
+         cpu->z = r == 0;
+         cpu->v = cpu->c = 0;
+         cycles = 4;
+         break;
+
+      case OP_EXG: {
+         uint32_t *reg1 = src_mode == EA_DREG ? &cpu->d[instr->src.reg] :
+                                                &cpu->a[instr->src.reg];
+         uint32_t *reg2 = dst_mode == EA_DREG ? &cpu->d[instr->dst.reg] :
+                                                &cpu->a[instr->dst.reg];
+         uint32_t temp = *reg1;
+         *reg1 = *reg2;
+         *reg2 = temp;
+         cycles = 6;
+      } break;
+
+      // Shifts and rotations
+      case OP_LSL: case OP_LSR: case OP_ASL:
+      case OP_ASR: case OP_ROL: case OP_ROR: {
+         unsigned count;
+         if (src_mode == EA_NONE)
+            count = 1;
+         else if (src_mode == EA_IMM)
+            count = (unsigned)(instr->src.value);
+         else
+            count = cpu->d[instr->src.reg] & 63;
+
+         if ((errcode = resolve(cpu, instr, &instr->dst, size, &dst))) break;
+         if ((errcode = read_loc(cpu, &dst, size, &d))) break;
+         d &= mask;
+
+         // Shift one bit at a time, it's easier to get the flags right
+         int carry = 0;
+         int overflow = 0;
+         unsigned i;
+         for (i = 0; i < count; i++) {
+            switch (instr->op) {
+               case OP_LSL: case OP_ASL:
+                  carry = (d & sign) != 0;
+                  d = (d << 1) & mask;
+                  if (((d & sign) != 0) != carry) overflow = 1;
+                  break;
+               case OP_LSR:
+                  carry = d & 1;
+                  d >>= 1;
+                  break;
+               case OP_ASR:
+                  carry = d & 1;
+                  d = (d >> 1) | (d & sign);
+                  break;
+               case OP_ROL:
+                  carry = (d & sign) != 0;
+                  d = ((d << 1) | carry) & mask;
+                  break;
+               case OP_ROR:
+                  carry = d & 1;
+                  d = (d >> 1) | (carry ? sign : 0);
+                  break;
+            }
+         }
+
+         // Rotations don't touch X, and an empty shift leaves it alone too
+         cpu->c = carry;
+         if (count > 0 && instr->op != OP_ROL && instr->op != OP_ROR)
+            cpu->x = carry;
+         if (count == 0 && instr->op != OP_ROL && instr->op != OP_ROR)
+            cpu->c = 0;
+         cpu->v = instr->op == OP_ASL ? overflow : 0;
+         cpu->n = (d & sign) != 0;
+         cpu->z = d == 0;
+         if ((errcode = write_loc(cpu, &dst, size, d))) break;
+
+         if (dst_mode == EA_DREG)
+            cycles = (size == 4 ? 8 : 6) + 2 * count;
+         else
+            cycles = 8 + ea_cycles(dst_mode, size);
+      } break;
+
+      // Multiplications (these depend on the value of the source)
+      case OP_MULU: case OP_MULS: {
+         if ((errcode = resolve(cpu, instr, &instr->src, 2, &src))) break;
+         if ((errcode = read_loc(cpu, &src, 2, &s))) break;
+         d = cpu->d[instr->dst.reg];
+         unsigned bits = 0;
+         unsigned i;
+         if (instr->op == OP_MULU) {
+            r = (s & 0xFFFF) * (d & 0xFFFF);
+            for (i = 0; i < 16; i++)
+               bits += (s >> i) & 1;
+         } else {
+            r = (uint32_t)((int32_t)(int16_t) s * (int32_t)(int16_t) d);
+            uint32_t pattern = (s << 1) & 0x1FFFF;
+            for (i = 0; i < 16; i++)
+               bits += ((pattern >> i) & 3) == 1 || ((pattern >> i) & 3) == 2;
+         }
+         cpu->d[instr->dst.reg] = r;
+         cpu->n = (r & 0x80000000) != 0;
+         cpu->z = r == 0;
+         cpu->v = cpu->c = 0;
+         cycles = 38 + 2 * bits + ea_cycles(src_mode, 2);
+      } break;
+
+      // Bit manipulation
+      case OP_BTST: case OP_BCHG: case OP_BCLR: case OP_BSET: {
+         unsigned bit = src_mode == EA_IMM ? (unsigned)(instr->src.value) :
+                        cpu->d[instr->src.reg];
+         bit &= dst_mode == EA_DREG ? 31 : 7;
+
+         if ((errcode = resolve(cpu, instr, &instr->dst, size, &dst))) break;
+         if ((errcode = read_loc(cpu, &dst, size, &d))) break;
+         cpu->z = !(d & (1U << bit));
+         switch (instr->op) {
+            case OP_BCHG: d ^= 1U << bit; break;
+            case OP_BCLR: d &= ~(1U << bit); break;
+            case OP_BSET: d |= 1U << bit; break;
+         }
+         if (instr->op != OP_BTST)
+            if ((errcode = write_loc(cpu, &dst, size, d))) break;
+
+         // Static versions take 4 more cycles to read the bit number,
+         // register versions take 2 more cycles for bits 16 to 31
+         unsigned extra = src_mode == EA_IMM ? 4 : 0;
+         if (dst_mode == EA_DREG) {
+            if (instr->op == OP_BTST)
+               cycles = 6 + extra;
+            else
+               cycles = (instr->op == OP_BCLR ? 8 : 6) + extra +
+                        (bit >= 16 ? 2 : 0);
+         } else
+            cycles = (instr->op == OP_BTST ? 4 : 8) + extra +
+                     ea_cycles(dst_mode, 1);
+      } break;
+
+      // Branches
+      case OP_BRA:
+         cpu->pc = (uint32_t)(instr->src.value);
+         cycles = 10;
+         break;
+
+      case OP_BSR:
+         cpu->a[7] -= 4;
+         if ((errcode = write_mem(cpu, cpu->a[7], 4, cpu->pc))) break;
+         cpu->pc = (uint32_t)(instr->src.value);
+         cycles = 18;
+         break;
+
+      case OP_BCC:
+         if (test_cond(cpu, instr->cond)) {
+            cpu->pc = (uint32_t)(instr->src.value);
+            cycles = 10;
+         } else
+            cycles = size == 1 ? 8 : 12;
+         break;
+
+      case OP_DBCC:
+         if (test_cond(cpu, instr->cond))
+            cycles = 12;
+         else {
+            uint32_t *reg = &cpu->d[instr->src.reg];
+            uint16_t counter = (uint16_t)(*reg) - 1;
+            *reg = (*reg & 0xFFFF0000) | counter;
+            if (counter != 0xFFFF) {
+               cpu->pc = (uint32_t)(instr->dst.value);
+               cycles = 10;
+            } else
+               cycles = 14;
+         }
+         break;
+
+      case OP_JMP:
+         if ((errcode = resolve(cpu, instr, &instr->src, 4, &src))) break;
+         cpu->pc = src.addr;
+         cycles = control_cycles(src_mode, jmp_cycles);
+         break;
+
+      case OP_JSR:
+         if ((errcode = resolve(cpu, instr, &instr->src, 4, &src))) break;
+         cpu->a[7] -= 4;
+         if ((errcode = write_mem(cpu, cpu->a[7], 4, cpu->pc))) break;
+         cpu->pc = src.addr;
+         cycles = control_cycles(src_mode, jsr_cycles);
+         break;
+
+      case OP_RTS:
+         if ((errcode = read_mem(cpu, cpu->a[7], 4, &cpu->pc))) break;
+         cpu->pc &= MEM_MASK;
+         cpu->a[7] += 4;
+         cycles = 16;
+         break;
+
+      case OP_NOP:
+         cycles = 4;
+         break;
+
+      // Shouldn't happen
+      default:
+         errcode = ERR_UNSUPPORTED;
+         break;
+   }
+
+   cpu->cycles += cycles;
+   return errcode;
+}
+
+//***************************************************************************
+// resolve [internal]
+// Works out where an operand is (pre/postincrement are applied here)
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param instr: instruction the operand belongs to
+// param op: operand
+// param size: operation size
+// param loc: where to store the location
+// return: error code
+//***************************************************************************
+
+static int resolve(Cpu *cpu, const Instr *instr, const Operand *op,
+int size, Loc *loc) {
+   loc->mode = op->mode;
+   loc->reg = op->reg;
+   loc->addr = 0;
+   loc->value = (uint32_t)(op->value);
+
+   // The stack pointer always moves by words even with bytes
+   uint32_t step = size == 1 && op->reg == 7 ? 2 : (uint32_t) size;
+   uint32_t index = 0;
+   if (op->mode == EA_INDEX || op->mode == EA_PCINDEX) {
+      index = op->index < 8 ? cpu->d[op->index] : cpu->a[op->index - 8];
+      if (!op->index_long) index = (uint32_t)(int16_t) index;
+   }
+
+   switch (op->mode) {
+      case EA_IND:
+         loc->addr = cpu->a[op->reg];
+         break;
+      case EA_POSTINC:
+         loc->addr = cpu->a[op->reg];
+         cpu->a[op->reg] += step;
+         break;
+      case EA_PREDEC:
+         cpu->a[op->reg] -= step;
+         loc->addr = cpu->a[op->reg];
+         break;
+      case EA_DISP:
+      case EA_INDEX:
+         loc->addr = cpu->a[op->reg] + (uint32_t)(op->value) + index;
+         break;
+      case EA_ABSW:
+      case EA_ABSL:
+         loc->addr = (uint32_t)(op->value);
+         break;
+      case EA_PCDISP:
+      case EA_PCINDEX:
+         loc->addr = instr->addr + 2 + (uint32_t)(op->value) + index;
+         break;
+      case EA_DREG: case EA_AREG: case EA_IMM:
+         break;
+      default:
+         return ERR_UNSUPPORTED;
+   }
+
+   loc->addr &= MEM_MASK;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// read_loc [internal]
+// Reads the value of an operand
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param loc: where the operand is
+// param size: operation size
+// param value: where to store the value
+// return: error code
+//***************************************************************************
+
+static int read_loc(Cpu *cpu, const Loc *loc, int size, uint32_t *value) {
+   switch (loc->mode) {
+      case EA_DREG: *value = cpu->d[loc->reg] & MASK(size); break;
+      case EA_AREG: *value = cpu->a[loc->reg] & MASK(size); break;
+      case EA_IMM: *value = loc->value & MASK(size); break;
+      default: return read_mem(cpu, loc->addr, size, value);
+   }
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// write_loc [internal]
+// Writes the value of an operand
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param loc: where the operand is
+// param size: operation size
+// param value: value to write
+// return: error code
+//***************************************************************************
+
+static int write_loc(Cpu *cpu, const Loc *loc, int size, uint32_t value) {
+   uint32_t mask = MASK(size);
+   switch (loc->mode) {
+      case EA_DREG:
+         cpu->d[loc->reg] = (cpu->d[loc->reg] & ~mask) | (value & mask);
+         break;
+      case EA_AREG:
+         cpu->a[loc->reg] = value;
+         break;
+      case EA_IMM:
+         return ERR_UNSUPPORTED;
+      default:
+         return write_mem(cpu, loc->addr, size, value);
+   }
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// read_mem [internal]
+// Reads a value from memory (big endian)
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param addr: address to read from
+// param size: how many bytes
+// param value: where to store the value
+// return: error code
+//***************************************************************************
+
+static int read_mem(Cpu *cpu, uint32_t addr, int size, uint32_t *value) {
+   if (size > 1 && (addr & 1))
+      return ERR_BADADDR;
+
+   uint32_t result = 0;
+   int i;
+   for (i = 0; i < size; i++)
+      result = result << 8 | cpu->mem[(addr + i) & MEM_MASK];
+   *value = result;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// write_mem [internal]
+// Writes a value into memory (big endian)
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param addr: address to write to
+// param size: how many bytes
+// param value: value to write
+// return: error code
+//***************************************************************************
+
+static int write_mem(Cpu *cpu, uint32_t addr, int size, uint32_t value) {
+   if (size > 1 && (addr & 1))
+      return ERR_BADADDR;
+
+   int i;
+   for (i = size - 1; i >= 0; i--) {
+      cpu->mem[(addr + i) & MEM_MASK] = (uint8_t) value;
+      value >>= 8;
+   }
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// ea_cycles [internal]
+// How long it takes to compute an effective address and read from it
+//---------------------------------------------------------------------------
+// param mode: addressing mode
+// param size: operation size
+// return: cycles taken
+//***************************************************************************
+
+static unsigned ea_cycles(int mode, int size) {
+   unsigned extra = size == 4 ? 4 : 0;
+   switch (mode) {
+      case EA_IND: case EA_POSTINC: return 4 + extra;
+      case EA_PREDEC: return 6 + extra;
+      case EA_DISP: case EA_PCDISP: case EA_ABSW: return 8 + extra;
+      case EA_INDEX: case EA_PCINDEX: return 10 + extra;
+      case EA_ABSL: return 12 + extra;
+      case EA_IMM: return 4 + extra;
+      default: return 0;
+   }
+}
+
+//***************************************************************************
+// write_cycles [internal]
+// How long it takes to write the destination of a move
+//---------------------------------------------------------------------------
+// param mode: addressing mode
+// param size: operation size
+// return: cycles taken
+//***************************************************************************
+
+static unsigned write_cycles(int mode, int size) {
+   unsigned extra = size == 4 ? 4 : 0;
+   switch (mode) {
+      case EA_IND: case EA_POSTINC: case EA_PREDEC: return 4 + extra;
+      case EA_DISP: case EA_ABSW: return 8 + extra;
+      case EA_INDEX: return 10 + extra;
+      case EA_ABSL: return 12 + extra;
+      default: return 0;
+   }
+}
+
+//***************************************************************************
+// control_cycles [internal]
+// Looks up the timing of an instruction that uses a control addressing
+// mode (these don't follow the usual effective address timings)
+//---------------------------------------------------------------------------
+// param mode: addressing mode
+// param table: timings for (An), d16(An), d8(An,Xn), abs.w, abs.l,
+//              d16(PC), d8(PC,Xn)
+// return: cycles taken
+//***************************************************************************
+
+static unsigned control_cycles(int mode, const unsigned *table) {
+   switch (mode) {
+      case EA_IND: return table[0];
+      case EA_DISP: return table[1];
+      case EA_INDEX: return table[2];
+      case EA_ABSW: return table[3];
+      case EA_ABSL: return table[4];
+      case EA_PCDISP: return table[5];
+      case EA_PCINDEX: return table[6];
+      default: return 0;
+   }
+}
+
+//***************************************************************************
+// test_cond [internal]
+// Checks whether a condition is true
+//---------------------------------------------------------------------------
+// param cpu: pointer to 68000
+// param cond: condition (in the order the 68000 encodes them)
+// return: non-zero if true, zero if false
+//***************************************************************************
+
+static int test_cond(const Cpu *cpu, int cond) {
+   switch (cond) {
+      case 0: return 1;                                     // t
+      case 1: return 0;                                     // f
+      case 2: return !cpu->c && !cpu->z;                    // hi
+      case 3: return cpu->c || cpu->z;                      // ls
+      case 4: return !cpu->c;                               // cc
+      case 5: return cpu->c;                                // cs
+      case 6: return !cpu->z;                               // ne
+      case 7: return cpu->z;                                // eq
+      case 8: return !cpu->v;                               // vc
+      case 9: return cpu->v;                                // vs
+      case 10: return !cpu->n;                              // pl
+      case 11: return cpu->n;                               // mi
+      case 12: return cpu->n == cpu->v;                     // ge
+      case 13: return cpu->n != cpu->v;                     // lt
+      case 14: return !cpu->z && cpu->n == cpu->v;          // gt
+      case 15: return cpu->z || cpu->n != cpu->v;           // le
+      default: return 0;
+   }
+}
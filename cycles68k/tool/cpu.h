@@ -0,0 +1,52 @@
+//***************************************************************************
+// "cpu.h"
+// Definitions for the 68000 core
+//***************************************************************************
+// 68000 cycle counting tool
+//
+// This file is part of the cycles68k tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+#ifndef CPU_H
+#define CPU_H
+
+// Required headers
+#include <stdint.h>
+#include "asm.h"
+
+// State of the 68000
+typedef struct {
+   uint32_t d[8];             // Data registers
+   uint32_t a[8];             // Address registers
+   uint32_t pc;               // Program counter
+   int x, n, z, v, c;         // Flags
+   uint64_t cycles;           // Cycles taken so far
+   uint8_t *mem;              // Memory (whole address space)
+   const Program *prog;       // Code being run
+   int32_t *map;              // Instruction at each word of the code
+   const Instr *fault;        // Instruction that failed (if any)
+} Cpu;
+
+// Function prototypes
+int init_cpu(Cpu *, const Program *);
+int run_routine(Cpu *, uint32_t, uint64_t);
+void deinit_cpu(Cpu *);
+
+#endif
@@ -0,0 +1,398 @@
+//***************************************************************************
+// "main.c"
+// Program entry point, parses command line and runs stuff as required
+//***************************************************************************
+// 68000 cycle counting tool
+//
+// This file is part of the cycles68k tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "asm.h"
+#include "cpu.h"
+
+// Give up if a routine takes longer than this (it's probably stuck)
+#define MAX_CYCLES 10000000000ULL
+
+// Function prototypes
+static int load_file(const char *, uint8_t *, size_t, size_t *);
+static uint32_t count_uftcx_tiles(const uint8_t *, size_t);
+static const char *get_error_msg(int);
+
+//***************************************************************************
+// Program entry point
+//***************************************************************************
+
+int main(int argc, char **argv) {
+   // To know if there was an error or not
+   int errcode = 0;
+
+   // Scan all arguments
+   int show_help = 0;
+   int show_ver = 0;
+   int uftc = 0;
+   int uftcx = 0;
+   const char *dictfilename = NULL;
+   const char *outfilename = NULL;
+
+   // Source files and input files can come in any amount
+   const char **sources = (const char **) malloc(sizeof(char *) * argc);
+   const char **filenames = (const char **) malloc(sizeof(char *) * argc);
+   int numsources = 0;
+   int numfiles = 0;
+   if (sources == NULL || filenames == NULL) {
+      fprintf(stderr, "Error: ran out of memory\n");
+      free(sources);
+      free(filenames);
+      return EXIT_FAILURE;
+   }
+
+   int scan_ok = 1;
+
+   int curr_arg;
+   for (curr_arg = 1; curr_arg < argc; curr_arg++) {
+      // Get pointer to argument, to make our lives easier
+      const char *arg = argv[curr_arg];
+
+      // If it's an option, parse it
+      if (scan_ok && arg[0] == '-') {
+         // Stop parsing options?
+         if (!strcmp(arg, "--"))
+            scan_ok = 0;
+
+         // Show help or version?
+         else if (!strcmp(arg, "-h") || !strcmp(arg, "--help"))
+            show_help = 1;
+         else if (!strcmp(arg, "-v") || !strcmp(arg, "--version"))
+            show_ver = 1;
+
+         // Source file?
+         else if (!strcmp(arg, "-a") || !strcmp(arg, "--asm")) {
+            if (curr_arg + 1 < argc)
+               sources[numsources++] = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Use dictionary?
+         else if (!strcmp(arg, "-D") || !strcmp(arg, "--dict")) {
+            if (curr_arg + 1 < argc)
+               dictfilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Write output?
+         else if (!strcmp(arg, "-o") || !strcmp(arg, "--output")) {
+            if (curr_arg + 1 < argc)
+               outfilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Set up registers for UFTC?
+         else if (!strcmp(arg, "-u") || !strcmp(arg, "--uftc"))
+            uftc = 1;
+         else if (!strcmp(arg, "-x") || !strcmp(arg, "--uftcx"))
+            uftcx = 1;
+
+         // Unknown argument
+         else {
+            fprintf(stderr, "Error: unknown option \"%s\"\n", arg);
+            errcode = 1;
+         }
+      }
+
+      // Routine or filename?
+      else
+         filenames[numfiles++] = arg;
+   }
+
+   // Look for error conditions
+   if (!show_help && !show_ver) {
+      if (numsources == 0) {
+         errcode = 1;
+         fprintf(stderr, "Error: no source files specified\n");
+      }
+      if (numfiles == 0) {
+         errcode = 1;
+         fprintf(stderr, "Error: routine name missing\n");
+      } else if (numfiles == 1) {
+         errcode = 1;
+         fprintf(stderr, "Error: input filename missing\n");
+      } else if (outfilename != NULL && numfiles > 2) {
+         errcode = 1;
+         fprintf(stderr, "Error: can't write output with more than one "
+            "input file\n");
+      }
+   }
+
+   // If there was an error then quit
+   if (errcode) {
+      free(sources);
+      free(filenames);
+      return EXIT_FAILURE;
+   }
+
+   // Show tool version?
+   if (show_ver) {
+      puts("1.0");
+      free(sources);
+      free(filenames);
+      return EXIT_SUCCESS;
+   }
+
+   // Show tool usage?
+   if (show_help) {
+      printf("Usage:\n"
+             "  %s -a <source> [options] <routine> <infile> [<infile> ...]\n"
+             "\n"
+             "Options:\n"
+             "  -a or --asm <file> ... Assemble this file (can be repeated)\n"
+             "  -D or --dict <file> .. Pass a dictionary in a4 and d7\n"
+             "  -u or --uftc ......... Pass 0 in d7 and tile count in d6\n"
+             "  -x or --uftcx ........ Same as -u but for UFTC-X\n"
+             "  -o or --output <file>  Write what the routine output\n"
+             "  -h or --help ......... Show this help\n"
+             "  -v or --version ...... Show tool version\n"
+             "\n"
+             "The input goes in a6 and the output buffer in a5. After the\n"
+             "routine returns, a5 must point right after the output.\n",
+             argv[0]);
+      free(sources);
+      free(filenames);
+      return EXIT_SUCCESS;
+   }
+
+   // Assemble the code
+   Program prog;
+   errcode = assemble(sources, numsources, &prog);
+   free(sources);
+   if (errcode) {
+      if (errcode != ERR_ASSEMBLE)
+         fprintf(stderr, "Error: %s\n", get_error_msg(errcode));
+      free(filenames);
+      return EXIT_FAILURE;
+   }
+
+   // Look for the routine
+   const char *routine = filenames[0];
+   uint32_t entry;
+   if (!get_symbol(&prog, routine, &entry)) {
+      fprintf(stderr, "Error: %s\n", get_error_msg(ERR_NOROUTINE));
+      free_program(&prog);
+      free(filenames);
+      return EXIT_FAILURE;
+   }
+
+   // Get the 68000 ready
+   Cpu cpu;
+   errcode = init_cpu(&cpu, &prog);
+   if (errcode) {
+      fprintf(stderr, "Error: %s\n", get_error_msg(errcode));
+      free_program(&prog);
+      free(filenames);
+      return EXIT_FAILURE;
+   }
+
+   // Load the dictionary if needed
+   size_t dictsize = 0;
+   if (dictfilename != NULL) {
+      errcode = load_file(dictfilename, &cpu.mem[DICT_ADDR], MAX_DICT,
+                          &dictsize);
+      if (errcode) {
+         fprintf(stderr, "Error: \"%s\": %s\n", dictfilename,
+            get_error_msg(errcode));
+         deinit_cpu(&cpu);
+         free_program(&prog);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Run the routine on every file
+   printf("# file cycles bytes cycles/byte frames(ntsc) frames(pal)\n");
+   int i;
+   for (i = 1; i < numfiles; i++) {
+      const char *filename = filenames[i];
+
+      // Load the input
+      size_t insize;
+      errcode = load_file(filename, &cpu.mem[INPUT_ADDR], MAX_INPUT,
+                          &insize);
+      if (errcode) break;
+
+      // Set up the registers
+      memset(cpu.d, 0, sizeof(cpu.d));
+      memset(cpu.a, 0, sizeof(cpu.a));
+      cpu.a[6] = INPUT_ADDR;
+      cpu.a[5] = OUTPUT_ADDR;
+      if (dictfilename != NULL) {
+         cpu.a[4] = DICT_ADDR;
+         cpu.d[7] = (uint32_t) dictsize;
+      }
+      if (uftc && dictfilename != NULL) {
+         cpu.d[7] = 0;
+         cpu.d[6] = (uint32_t)(insize / 8);
+      } else if (uftc) {
+         const uint8_t *in = &cpu.mem[INPUT_ADDR];
+         size_t dicsize = insize >= 2 ? (size_t)(in[0] << 8 | in[1]) : 0;
+         cpu.d[7] = 0;
+         cpu.d[6] = insize >= 2 + dicsize ? (insize - 2 - dicsize) / 8 : 0;
+      } else if (uftcx) {
+         cpu.d[7] = 0;
+         cpu.d[6] = count_uftcx_tiles(&cpu.mem[INPUT_ADDR], insize);
+      }
+
+      // Run it!
+      cpu.cycles = 0;
+      errcode = run_routine(&cpu, entry, MAX_CYCLES);
+      if (errcode) break;
+
+      // Report how long it took
+      uint32_t outsize = (cpu.a[5] - OUTPUT_ADDR) & MEM_MASK;
+      printf("%s %llu %lu %.2f %.2f %.2f\n", filename,
+             (unsigned long long) cpu.cycles, (unsigned long) outsize,
+             outsize ? (double) cpu.cycles / outsize : 0.0,
+             (double) cpu.cycles / CYCLES_NTSC,
+             (double) cpu.cycles / CYCLES_PAL);
+
+      // Write the output if requested
+      if (outfilename != NULL) {
+         FILE *file = fopen(outfilename, "wb");
+         if (file == NULL) {
+            errcode = ERR_CANTWRITE;
+            break;
+         }
+         if (fwrite(&cpu.mem[OUTPUT_ADDR], 1, outsize, file) < outsize) {
+            fclose(file);
+            errcode = ERR_CANTWRITE;
+            break;
+         }
+         if (fclose(file)) {
+            errcode = ERR_CANTWRITE;
+            break;
+         }
+      }
+   }
+
+   // If there was an error, show a message
+   if (errcode) {
+      const char *filename = i < numfiles ? filenames[i] : "";
+      if (cpu.fault != NULL)
+         fprintf(stderr, "Error: \"%s\": %s (%s:%u)\n", filename,
+            get_error_msg(errcode), cpu.fault->file, cpu.fault->line);
+      else
+         fprintf(stderr, "Error: \"%s\": %s\n", filename,
+            get_error_msg(errcode));
+   }
+
+   // Quit program
+   deinit_cpu(&cpu);
+   free_program(&prog);
+   free(filenames);
+   return errcode ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//***************************************************************************
+// load_file [internal]
+// Loads a whole file into memory
+//---------------------------------------------------------------------------
+// param filename: name of file to load
+// param buffer: where to store the file
+// param limit: largest size allowed
+// param size: where to store the size of the file
+// return: error code
+//***************************************************************************
+
+static int load_file(const char *filename, uint8_t *buffer, size_t limit,
+size_t *size) {
+   // Open file
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   // Read as much as it fits (plus one byte to tell if it's too large)
+   *size = fread(buffer, 1, limit, file);
+   int failed = ferror(file);
+   int too_large = fgetc(file) != EOF;
+   fclose(file);
+
+   if (failed) return ERR_CANTREAD;
+   if (too_large) return ERR_TOOLARGE;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// count_uftcx_tiles [internal]
+// Counts how many tiles there are in UFTC-X data (repeated tiles take up a
+// word and the others four words, so we need to go through all of them)
+//---------------------------------------------------------------------------
+// param in: UFTC-X data
+// param insize: size of data
+// return: number of tiles
+//***************************************************************************
+
+static uint32_t count_uftcx_tiles(const uint8_t *in, size_t insize) {
+   if (insize < 2)
+      return 0;
+
+   size_t pos = 2 + (in[0] << 8 | in[1]);
+   uint32_t count = 0;
+   while (pos + 2 <= insize) {
+      pos += in[pos] & 0x80 ? 2 : 8;
+      count++;
+   }
+   return count;
+}
+
+//***************************************************************************
+// get_error_msg [internal]
+// Gets the message to show for an error code
+//---------------------------------------------------------------------------
+// param errcode: error code
+// return: message
+//***************************************************************************
+
+static const char *get_error_msg(int errcode) {
+   switch (errcode) {
+      case ERR_CANTREAD: return "can't read from file";
+      case ERR_CANTWRITE: return "can't write to output file";
+      case ERR_TOOLARGE: return "file is too large";
+      case ERR_NOROUTINE: return "routine not found";
+      case ERR_BADPC: return "jumped somewhere that isn't code";
+      case ERR_BADADDR: return "word or long access at an odd address";
+      case ERR_UNSUPPORTED: return "unsupported instruction";
+      case ERR_TIMEOUT: return "routine never returned";
+      case ERR_NOMEMORY: return "ran out of memory";
+      default: return "unknown error";
+   }
+}
@@ -0,0 +1,69 @@
+//***************************************************************************
+// "main.h"
+// Some common definitions and such
+//***************************************************************************
+// 68000 cycle counting tool
+//
+// This file is part of the cycles68k tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+#ifndef MAIN_H
+#define MAIN_H
+
+// Required headers
+#include <stdint.h>
+
+// Memory map used when running a routine
+// The stack goes right below the code, and returning to address 0 is how
+// we know the routine is over
+#define MEM_SIZE     0x1000000   // Size of the address space
+#define MEM_MASK     0xFFFFFF    // Mask for valid addresses
+#define RETURN_ADDR  0x000000    // Where the routine returns to
+#define STACK_ADDR   0x000400    // Initial stack pointer
+#define CODE_ADDR    0x000400    // Where the code gets assembled
+#define DICT_ADDR    0x100000    // Where the dictionary gets loaded
+#define INPUT_ADDR   0x200000    // Where the input data gets loaded
+#define OUTPUT_ADDR  0x800000    // Where the routine writes its output
+
+// Largest files that fit in the memory map
+#define MAX_DICT     (INPUT_ADDR - DICT_ADDR)
+#define MAX_INPUT    (OUTPUT_ADDR - INPUT_ADDR)
+#define MAX_OUTPUT   (MEM_SIZE - OUTPUT_ADDR)
+
+// Cycles available in a frame (used to put the results in perspective)
+#define CYCLES_NTSC  127841      // 7670453 Hz / 60 Hz
+#define CYCLES_PAL   152008      // 7600489 Hz / 50 Hz
+
+// Error codes
+enum {
+   ERR_NONE,            // No error
+   ERR_CANTREAD,        // Can't read from file
+   ERR_CANTWRITE,       // Can't write into file
+   ERR_TOOLARGE,        // File doesn't fit in memory
+   ERR_ASSEMBLE,        // Couldn't assemble the code
+   ERR_NOROUTINE,       // Routine doesn't exist
+   ERR_BADPC,           // Tried to run something that isn't code
+   ERR_BADADDR,         // Word or long access at an odd address
+   ERR_UNSUPPORTED,     // Instruction not supported
+   ERR_TIMEOUT,         // Routine never returned
+   ERR_NOMEMORY,        // Ran out of memory
+   ERR_UNKNOWN          // Unknown error
+};
+
+#endif
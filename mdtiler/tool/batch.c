@@ -28,9 +28,14 @@
 #include <ctype.h>
 #include "main.h"
 #include "bitmap.h"
+#include "cache.h"
+#include "codec.h"
 #include "offset.h"
+#include "manifest.h"
 #include "map.h"
 #include "palette.h"
+#include "pool.h"
+#include "prefetch.h"
 #include "sprite.h"
 #include "tiles.h"
 
@@ -46,6 +51,30 @@ typedef struct {
    unsigned num_tokens;       // Number of tokens
 } TokenList;
 
+// State of an incremental build (using a manifest)
+typedef struct {
+   const char *filename;         // Manifest file (NULL if not used)
+   Manifest manifest;            // What was built last time
+   ManifestSegment *segment;     // Segment being recorded or replayed
+   int replaying;                // Set if replaying the segment
+   size_t next_step;             // Next step to replay
+   uint64_t in_key;              // Hash of the input bitmap
+   char *pending;                // Input bitmap that wasn't loaded
+   uint16_t pending_pal[16];     // Palette it would have been loaded with
+   unsigned pending_lines;       // Palette lines it would have generated
+} Incremental;
+
+// Where an output file really goes if it's compressed (everything is
+// written into a temporary file, which is compressed when it's closed)
+typedef struct {
+   Codec codec;                  // How to compress it (CODEC_NONE if not)
+   char *filename;               // Name of the actual output file
+   size_t line;                  // Line where it was opened (for errors)
+} OutputCodec;
+
+// Stands in for input bitmaps that weren't loaded when replaying a segment
+static Bitmap placeholder = { 0, 0, NULL, NULL, 0, { 0 }, 0 };
+
 // Function prototypes
 static int read_line(FILE *, char **);
 static int split_tokens(const char *, TokenList *);
@@ -55,16 +84,29 @@ static int is_integer(const char *);
 static int is_color(const char *);
 static unsigned string_to_integer(const char *);
 static char *make_path(const char *, const char *);
+static int scan_inputs(FILE *, Prefetcher *, int);
+static int begin_segment(Incremental *, FILE *, const char *, Layout, int,
+   Bitmap **, int *);
+static void end_segment(Incremental *, int);
+static long tell_output(FILE *);
+static int record_step(Incremental *, FILE *[2], const long [2]);
+static int replay_step(Incremental *, FILE *[2]);
+static uint64_t hash_input(const char *);
+static int close_output(FILE *, OutputCodec *, const char *, int, int *);
 
 //***************************************************************************
 // build_batch
 // Performs a batch build
 //---------------------------------------------------------------------------
 // param infilename: name of batch file
+// param jobs: how many threads to use to load bitmaps
+// param cache_size: how much memory to use for reusing loaded bitmaps
+// param manifest: manifest file for incremental builds (NULL if none)
 // return: error code
 //***************************************************************************
 
-int build_batch(const char *infilename) {
+int build_batch(const char *infilename, int jobs, size_t cache_size,
+const char *manifest) {
    // To store error codes
    int errcode;
 
@@ -78,7 +120,12 @@ int build_batch(const char *infilename) {
 
    // Current state
    Bitmap *in = NULL;                  // Input bitmap
+   int in_cached = 0;                  // Set if input bitmap is in cache
    FILE *out[2] = { NULL, NULL };      // Output blobs
+   OutputCodec out_codec[2] = {        // How to compress them
+      { CODEC_NONE, NULL, 0 },
+      { CODEC_NONE, NULL, 0 }
+   };
    Layout layout = LAYOUT_TILEMAP;     // Tile ordering
 
    // Default base directory
@@ -89,6 +136,45 @@ int build_batch(const char *infilename) {
    }
    strcpy(basedir, ".");
 
+   // Bitmaps that were already loaded
+   BitmapCache cache;
+   init_cache(&cache, cache_size);
+
+   // Load what was built last time if doing an incremental build
+   Incremental inc;
+   inc.filename = manifest;
+   inc.segment = NULL;
+   inc.replaying = 0;
+   inc.in_key = 0;
+   inc.pending = NULL;
+   if (manifest != NULL) {
+      errcode = load_manifest(&inc.manifest, manifest);
+      if (errcode) {
+         free(basedir);
+         fclose(file);
+         return errcode;
+      }
+   } else {
+      init_manifest(&inc.manifest);
+   }
+
+   // If we can use more threads, go through the whole batch first to find
+   // out which bitmaps will be needed and start loading them right away.
+   // Everything else is still done in order so the output is the same.
+   Prefetcher prefetch;
+   init_prefetcher(&prefetch);
+   if (jobs > 1) {
+      errcode = scan_inputs(file, &prefetch, cache_size > 0);
+      if (errcode) {
+         free_prefetcher(&prefetch);
+         free_manifest(&inc.manifest);
+         free(basedir);
+         fclose(file);
+         return errcode;
+      }
+      start_prefetcher(&prefetch, jobs);
+   }
+
    // Go through all lines
    for (size_t curr_line = 1; !feof(file); curr_line++) {
       // Get next line
@@ -156,9 +242,11 @@ int build_batch(const char *infilename) {
 
          // Set input file if arguments are valid
          else {
-            // Close old bitmap if needed
-            if (in != NULL)
+            // Close old bitmap if needed (unless the cache has it)
+            if (in != NULL && !in_cached)
                destroy_bitmap(in);
+            in = NULL;
+            in_cached = 0;
 
             // Attempt to load input bitmap
             char *filename = make_path(basedir, args.tokens[1]);
@@ -166,7 +254,63 @@ int build_batch(const char *infilename) {
                errcode = ERR_NOMEMORY;
                goto panic;
             }
-            in = load_bitmap(filename);
+
+            // Replaying a segment? Then don't bother loading the bitmap
+            // unless a later segment needs it
+            if (inc.replaying) {
+               errcode = replay_step(&inc, out);
+               if (errcode) {
+                  free(filename);
+                  free_tokens(&args);
+                  goto panic;
+               }
+
+               free(inc.pending);
+               inc.pending = filename;
+               get_fallback_palette(inc.pending_pal);
+               inc.pending_lines = get_auto_palette();
+               inc.in_key = hash_input(filename);
+               in = &placeholder;
+               in_cached = 1;
+               free_tokens(&args);
+               continue;
+            }
+
+            // Maybe another thread already loaded it for us
+            Bitmap *prefetched = NULL;
+            int was_prefetched = take_prefetched_bitmap(&prefetch,
+               curr_line, filename, &prefetched);
+
+            // If it was loaded before, just reuse it
+            in = find_cached_bitmap(&cache, filename);
+            if (in != NULL) {
+               in_cached = 1;
+               use_bitmap_palette(in);
+               if (prefetched != NULL)
+                  destroy_bitmap(prefetched);
+            }
+
+            // Nope, load it now (unless it was loaded already)
+            else {
+               if (was_prefetched) {
+                  in = prefetched;
+                  if (in != NULL)
+                     use_bitmap_palette(in);
+               } else {
+                  in = load_bitmap(filename);
+               }
+
+               // Keep it around in case it gets loaded again
+               if (in != NULL && cache.max_memory > 0) {
+                  errcode = add_cached_bitmap(&cache, filename, in);
+                  if (errcode) {
+                     free(filename);
+                     free_tokens(&args);
+                     goto panic;
+                  }
+                  in_cached = 1;
+               }
+            }
 
             // Oops?
             if (in == NULL) {
@@ -175,14 +319,30 @@ int build_batch(const char *infilename) {
                failed = 1;
             }
 
+            // Remember it for the manifest
+            if (inc.filename != NULL) {
+               long pos[2] = { tell_output(out[0]), tell_output(out[1]) };
+               inc.in_key = hash_input(filename);
+               errcode = record_step(&inc, out, pos);
+               if (errcode) {
+                  free(filename);
+                  free_tokens(&args);
+                  goto panic;
+               }
+            }
+
             free(filename);
          }
       }
 
       // Set main output files?
       else if (!strcmp(command, "output") || !strcmp(command, "output2")) {
+         // Is the output compressed?
+         Codec codec = num_args == 3 ?
+            get_codec(args.tokens[2]) : CODEC_NONE;
+
          // Check number of arguments
-         if (num_args != 2) {
+         if (num_args != 2 && num_args != 3) {
             // Determine error message
             const char *msg = num_args == 1 ?
                "output filename not specified\n" :
@@ -194,15 +354,35 @@ int build_batch(const char *infilename) {
             failed = 1;
          }
 
+         // Check codec
+         else if (codec == CODEC_UNKNOWN) {
+            print_error_line(curr_line, infilename);
+            fprintf(stderr, "unknown codec \"%s\"\n", args.tokens[2]);
+            failed = 1;
+         }
+
          // Set output file if arguments are valid
          else {
             // Determine which output file to mess with
             // Yeah, this looks hackish XD but it's correct
             int which = (command[6] == '2') ? 1 : 0;
 
+            // New tiles file means a new segment of the batch
+            if (which == 0)
+               end_segment(&inc, failed);
+
             // Close old file if needed
-            if (out[which] != NULL)
-               fclose(out[which]);
+            errcode = close_output(out[which], &out_codec[which],
+               infilename, jobs, &failed);
+            out[which] = NULL;
+            if (errcode) {
+               free_tokens(&args);
+               goto panic;
+            }
+
+            // Tiles in the new file can't be reused by sprites
+            if (which == 0)
+               reset_sprite_pool();
 
             // Attempt to open output file
             char *filename = make_path(basedir, args.tokens[1]);
@@ -210,7 +390,20 @@ int build_batch(const char *infilename) {
                errcode = ERR_NOMEMORY;
                goto panic;
             }
-            out[which] = fopen(filename, "wb");
+            // (if making a manifest, we need to read back what was written)
+            if (codec == CODEC_NONE)
+               out[which] = fopen(filename, inc.filename ? "w+b" : "wb");
+
+            // If it's compressed, it's written into a temporary file first
+            // (which gets compressed when the output file is closed)
+            else {
+               out[which] = tmpfile();
+               if (out[which] != NULL) {
+                  out_codec[which].codec = codec;
+                  out_codec[which].filename = filename;
+                  out_codec[which].line = curr_line;
+               }
+            }
 
             // Oops?
             if (out[which] == NULL) {
@@ -220,14 +413,60 @@ int build_batch(const char *infilename) {
                failed = 1;
             }
 
-            free(filename);
+            if (out_codec[which].filename != filename)
+               free(filename);
+
+            // Check if the new segment can be reused from the last build
+            if (which == 0 && out[0] != NULL && inc.filename != NULL) {
+               int skipped = in == &placeholder;
+               errcode = begin_segment(&inc, file, basedir, layout,
+                  out[1] != NULL, &in, &in_cached);
+               if (errcode) {
+                  free_tokens(&args);
+                  goto panic;
+               }
+               if (skipped && in == NULL) {
+                  print_error_line(curr_line, infilename);
+                  fprintf(stderr, "can't load input bitmap \"%s\"\n",
+                     inc.pending);
+                  failed = 1;
+               }
+            }
          }
       }
 
       // Set palette?
       else if (!strcmp(command, "palette")) {
+         // Generate the palette for each bitmap?
+         if (num_args >= 2 && !strcmp(args.tokens[1], "auto")) {
+            // Get how many palette lines can be used
+            unsigned lines = MAX_PAL_LINES;
+            int valid = 1;
+            if (num_args > 3) {
+               print_error_line(curr_line, infilename);
+               fputs("too many parameters\n", stderr);
+               valid = 0;
+            } else if (num_args == 3) {
+               const char *arg = args.tokens[2];
+               if (is_integer(arg))
+                  lines = string_to_integer(arg);
+               if (!is_integer(arg) || lines < 1 || lines > MAX_PAL_LINES) {
+                  print_error_line(curr_line, infilename);
+                  fprintf(stderr, "number of palette lines must be "
+                     "between 1 and %d\n", MAX_PAL_LINES);
+                  valid = 0;
+               }
+            }
+
+            // Start generating palettes
+            if (valid)
+               set_auto_palette(lines);
+            else
+               failed = 1;
+         }
+
          // Check number of arguments
-         if (num_args != 17) {
+         else if (num_args != 17) {
             // Determine error message
             const char *msg;
             if (num_args == 1)
@@ -386,7 +625,18 @@ int build_batch(const char *infilename) {
             int height = string_to_integer(args.tokens[4]);
 
             // Process tiles and write them in the output file
-            switch (layout) {
+            // If there's a pool then it takes care of writing them (so
+            // later commands can reuse the tiles)
+            long pos[2] = { tell_output(out[0]), tell_output(out[1]) };
+            TilePool *pool = get_shared_pool();
+            if (inc.replaying) {
+               errcode = replay_step(&inc, out);
+            }
+            else if (pool != NULL) {
+               errcode = write_pool_block(pool, in, out[0], x, y,
+                  width, height, layout == LAYOUT_SPRITE);
+            }
+            else switch (layout) {
                // Tilemap ordering
                case LAYOUT_TILEMAP:
                   errcode = write_tilemap(in, out[0], x, y, width, height);
@@ -397,6 +647,8 @@ int build_batch(const char *infilename) {
                   errcode = write_sprite(in, out[0], x, y, width, height);
                   break;
             }
+            if (!errcode && !inc.replaying)
+               errcode = record_step(&inc, out, pos);
 
             // Gah!
             if (errcode) {
@@ -458,8 +710,15 @@ int build_batch(const char *infilename) {
             int height = string_to_integer(args.tokens[4]);
 
             // Generate map
-            errcode = generate_map(in, out[0], out[1], x, y, width, height,
-               layout == LAYOUT_SPRITE);
+            long pos[2] = { tell_output(out[0]), tell_output(out[1]) };
+            if (inc.replaying)
+               errcode = replay_step(&inc, out);
+            else {
+               errcode = generate_map(in, out[0], out[1], x, y,
+                  width, height, layout == LAYOUT_SPRITE);
+               if (!errcode)
+                  errcode = record_step(&inc, out, pos);
+            }
 
             // Gah!
             if (errcode) {
@@ -481,7 +740,14 @@ int build_batch(const char *infilename) {
 
          // End of sprite?
          else if (num_args == 2 && strcmp(args.tokens[1], "end") == 0) {
-            errcode = generate_sprite_end(out[1]);
+            long pos[2] = { tell_output(out[0]), tell_output(out[1]) };
+            if (inc.replaying)
+               errcode = replay_step(&inc, out);
+            else {
+               errcode = generate_sprite_end(out[1]);
+               if (!errcode)
+                  errcode = record_step(&inc, out, pos);
+            }
             if (errcode) {
                free_tokens(&args);
                goto panic;
@@ -539,8 +805,15 @@ int build_batch(const char *infilename) {
             int height = string_to_integer(args.tokens[4]);
 
             // Generate sprite mapping
-            errcode = generate_sprite(in, out[0], out[1],
-               x, y, width, height);
+            long pos[2] = { tell_output(out[0]), tell_output(out[1]) };
+            if (inc.replaying)
+               errcode = replay_step(&inc, out);
+            else {
+               errcode = generate_sprite(in, out[0], out[1],
+                  x, y, width, height);
+               if (!errcode)
+                  errcode = record_step(&inc, out, pos);
+            }
             if (errcode) {
                free_tokens(&args);
                goto panic;
@@ -586,12 +859,67 @@ int build_batch(const char *infilename) {
             }
          }
 
+         // Tile IDs in a pool are relative to the offset when the pool
+         // started, so don't let it change in the middle
+         if (!failed && !done && get_shared_pool() != NULL) {
+            print_error_line(curr_line, infilename);
+            fputs("can't change offset while a tile pool is active\n",
+               stderr);
+            failed = 1;
+         }
+
          // All OK, set new offset
          if (!failed && !done) {
             set_map_offset(string_to_integer(args.tokens[1]));
          }
       }
 
+      // Start or end a tile pool?
+      else if (!strcmp(command, "pool")) {
+         // Check number of arguments
+         if (num_args != 2) {
+            // Determine error message
+            const char *msg = num_args == 1 ?
+               "missing \"begin\" or \"end\"\n" :
+               "too many parameters\n";
+
+            // Show message on screen
+            print_error_line(curr_line, infilename);
+            fputs(msg, stderr);
+            failed = 1;
+         }
+
+         // Start pool?
+         else if (!strcmp(args.tokens[1], "begin")) {
+            if (get_shared_pool() != NULL) {
+               print_error_line(curr_line, infilename);
+               fputs("there's already a tile pool active\n", stderr);
+               failed = 1;
+            } else {
+               begin_shared_pool();
+            }
+         }
+
+         // End pool?
+         else if (!strcmp(args.tokens[1], "end")) {
+            if (get_shared_pool() == NULL) {
+               print_error_line(curr_line, infilename);
+               fputs("there isn't any tile pool active\n", stderr);
+               failed = 1;
+            } else {
+               end_shared_pool();
+            }
+         }
+
+         // Nope
+         else {
+            print_error_line(curr_line, infilename);
+            fprintf(stderr, "unknown pool action \"%s\"\n",
+               args.tokens[1]);
+            failed = 1;
+         }
+      }
+
       // Set origin for sprite mappings?
       else if (!strcmp(command, "origin")) {
          // Check number of arguments
@@ -734,10 +1062,33 @@ int build_batch(const char *infilename) {
       free_tokens(&args);
    }
 
+   // If a pool was left open then close it now
+   if (get_shared_pool() != NULL)
+      end_shared_pool();
+
+   // Close the output files (compressing them if needed)
+   for (unsigned i = 0; i < 2; i++) {
+      errcode = close_output(out[i], &out_codec[i], infilename, jobs,
+         &failed);
+      out[i] = NULL;
+      if (errcode) goto panic;
+   }
+
+   // Save what was built for next time (only if everything went OK,
+   // otherwise we'd be keeping outdated stuff around)
+   end_segment(&inc, failed);
+   if (inc.filename != NULL && !failed) {
+      errcode = save_manifest(&inc.manifest, inc.filename);
+      if (errcode) goto panic;
+   }
+   free_manifest(&inc.manifest);
+   free(inc.pending);
+
    // Done with the resources
-   if (in) destroy_bitmap(in);
-   if (out[0]) fclose(out[0]);
-   if (out[1]) fclose(out[1]);
+   reset_sprite_pool();
+   free_prefetcher(&prefetch);
+   if (in && !in_cached) destroy_bitmap(in);
+   free_cache(&cache);
 
    // We're done
    free(basedir);
@@ -746,9 +1097,17 @@ int build_batch(const char *infilename) {
 
    // If we get here then something went SERIOUSLY wrong
 panic:
-   if (in) destroy_bitmap(in);
+   if (get_shared_pool() != NULL) abort_shared_pool();
+   free_manifest(&inc.manifest);
+   free(inc.pending);
+   reset_sprite_pool();
+   free_prefetcher(&prefetch);
+   if (in && !in_cached) destroy_bitmap(in);
+   free_cache(&cache);
    if (out[0]) fclose(out[0]);
    if (out[1]) fclose(out[1]);
+   free(out_codec[0].filename);
+   free(out_codec[1].filename);
    free(basedir);
    fclose(file);
    return errcode;
@@ -1122,3 +1481,454 @@ static char *make_path(const char *basedir, const char *filename)
    sprintf(buffer, "%s/%s", basedir, filename);
    return buffer;
 }
+
+//***************************************************************************
+// scan_inputs [internal]
+// Goes through the whole batch file looking for "input" commands, and adds
+// the bitmaps they load to the prefetcher (keeping track of the base
+// directory and palette they'd be loaded with). Errors in the batch are
+// left for later, they'll be reported when the batch is processed. The
+// file is rewound when done.
+//---------------------------------------------------------------------------
+// param file: batch file
+// param prefetch: pointer to prefetcher
+// param cached: set to skip bitmaps that will be in the cache already
+// return: error code
+//***************************************************************************
+
+static int scan_inputs(FILE *file, Prefetcher *prefetch, int cached) {
+   // To store error codes
+   int errcode = ERR_NONE;
+
+   // Bitmaps start being converted with whatever palette is set now
+   // (or with palettes generated for them)
+   const uint8_t *table = add_prefetch_table(prefetch, NULL);
+   if (table == NULL)
+      return ERR_NOMEMORY;
+   unsigned auto_lines = get_auto_palette();
+
+   // Default base directory
+   char *basedir = malloc(2);
+   if (basedir == NULL)
+      return ERR_NOMEMORY;
+   strcpy(basedir, ".");
+
+   // Go through all lines
+   for (size_t curr_line = 1; !feof(file); curr_line++) {
+      // Get next line
+      char *line;
+      errcode = read_line(file, &line);
+      if (errcode) break;
+
+      // Get a list of the arguments in this line
+      // Ignore any syntax errors (they're reported later)
+      TokenList args;
+      errcode = split_tokens(line, &args);
+      free(line);
+      if (errcode == ERR_BADQUOTE || errcode == ERR_NOQUOTE) {
+         errcode = ERR_NONE;
+         continue;
+      }
+      if (errcode) break;
+      if (args.num_tokens == 0)
+         continue;
+
+      // Retrieve what command is it
+      const char *command = args.tokens[0];
+      size_t num_args = args.num_tokens;
+
+      // Bitmap to load?
+      if (!strcmp(command, "input") && num_args == 2) {
+         char *filename = make_path(basedir, args.tokens[1]);
+         if (filename == NULL)
+            errcode = ERR_NOMEMORY;
+         else if (cached && has_prefetch_job(prefetch, filename, table,
+         auto_lines))
+            free(filename);
+         else {
+            errcode = add_prefetch_job(prefetch, curr_line, filename,
+               table, auto_lines);
+            free(filename);
+         }
+      }
+
+      // New palette for following bitmaps?
+      else if (!strcmp(command, "palette") && num_args == 17) {
+         uint16_t palette[0x10];
+         for (unsigned i = 0; i < 0x10; i++)
+            palette[i] = strtoul(args.tokens[i + 1], NULL, 0x10);
+
+         table = add_prefetch_table(prefetch, palette);
+         if (table == NULL)
+            errcode = ERR_NOMEMORY;
+         auto_lines = 0;
+      }
+
+      // Generate palettes for following bitmaps?
+      else if (!strcmp(command, "palette") && num_args >= 2 &&
+      num_args <= 3 && !strcmp(args.tokens[1], "auto")) {
+         unsigned lines = num_args == 3 ?
+            string_to_integer(args.tokens[2]) : MAX_PAL_LINES;
+         if (lines >= 1 && lines <= MAX_PAL_LINES)
+            auto_lines = lines;
+      }
+
+      // New base directory?
+      else if (!strcmp(command, "basedir") && num_args == 2) {
+         free(basedir);
+         basedir = malloc(strlen(args.tokens[1]) + 1);
+         if (basedir == NULL)
+            errcode = ERR_NOMEMORY;
+         else
+            strcpy(basedir, args.tokens[1]);
+      }
+
+      free_tokens(&args);
+      if (errcode) break;
+   }
+
+   // Go back to the beginning for the real thing
+   free(basedir);
+   rewind(file);
+   return errcode;
+}
+
+//***************************************************************************
+// begin_segment [internal]
+// Called when a new segment of the batch starts (i.e. right after an
+// "output" command). Looks ahead at the commands in the segment to work out
+// everything its output depends on, then checks if the manifest already
+// has it (in which case it gets replayed instead of built). If it doesn't,
+// the segment gets recorded as it's built.
+//---------------------------------------------------------------------------
+// param inc: pointer to incremental build state
+// param file: batch file (right after the "output" command)
+// param basedir: current base directory
+// param layout: current tile ordering
+// param has_out2: set if there's a secondary output file
+// param in: pointer to input bitmap (may get loaded if it was skipped)
+// param in_cached: pointer to flag telling if bitmap belongs to cache
+// return: error code
+//***************************************************************************
+
+static int begin_segment(Incremental *inc, FILE *file, const char *basedir,
+Layout layout, int has_out2, Bitmap **in, int *in_cached) {
+   inc->segment = NULL;
+   inc->replaying = 0;
+   inc->next_step = 0;
+
+   // Start with the state everything is in now
+   uint64_t key = HASH_INIT;
+   int32_t state[0x18];
+   int origin_x, origin_y;
+   get_sprite_origin(&origin_x, &origin_y);
+   state[0] = get_map_offset();
+   state[1] = is_continuous_offset();
+   state[2] = get_output_format();
+   state[3] = layout;
+   state[4] = has_out2;
+   state[5] = origin_x;
+   state[6] = origin_y;
+   for (unsigned i = 0; i < 0x10; i++)
+      state[7 + i] = get_palette_mapping(i);
+   state[7 + 0x10] = get_auto_palette();
+   key = hash_data(key, state, sizeof(int32_t) * (8 + 0x10));
+
+   uint16_t palette[0x10*MAX_PAL_LINES];
+   get_fallback_palette(palette);
+   key = hash_data(key, palette, sizeof(uint16_t) * 0x10);
+   uint32_t lines = get_bitmap_palette(palette);
+   key = hash_data(key, palette, sizeof(palette));
+   key = hash_data(key, &lines, sizeof(lines));
+   key = hash_string(key, basedir);
+
+   // Segments in the middle of a pool or a sprite mapping depend on what
+   // was done before them, so they can't be reused
+   int reusable = get_shared_pool() == NULL && !is_sprite_pending();
+
+   // Base directory used by the segment
+   char *dir = (char *) malloc(strlen(basedir) + 1);
+   if (dir == NULL)
+      return ERR_NOMEMORY;
+   strcpy(dir, basedir);
+
+   // Go through all the commands in the segment
+   int errcode = ERR_NONE;
+   int needs_input = 0;
+   int has_input = 0;
+
+   long start = ftell(file);
+   if (start < 0) {
+      free(dir);
+      return ERR_CANTREAD;
+   }
+
+   while (!feof(file)) {
+      // Get next line
+      char *line;
+      errcode = read_line(file, &line);
+      if (errcode) break;
+
+      // Split it into tokens (if it has errors, it'll fail later anyway)
+      TokenList args;
+      errcode = split_tokens(line, &args);
+      free(line);
+      if (errcode == ERR_BADQUOTE || errcode == ERR_NOQUOTE) {
+         errcode = ERR_NONE;
+         reusable = 0;
+         continue;
+      }
+      if (errcode) break;
+      if (args.num_tokens == 0)
+         continue;
+
+      // Reached the next segment?
+      const char *command = args.tokens[0];
+      size_t num_args = args.num_tokens;
+      if (!strcmp(command, "output")) {
+         free_tokens(&args);
+         break;
+      }
+
+      // Add the command into the hash
+      key = hash_data(key, &num_args, sizeof(num_args));
+      for (size_t i = 0; i < num_args; i++)
+         key = hash_string(key, args.tokens[i]);
+
+      // Bitmaps being loaded also depend on their contents
+      if (!strcmp(command, "input") && num_args == 2) {
+         char *filename = make_path(dir, args.tokens[1]);
+         if (filename == NULL)
+            errcode = ERR_NOMEMORY;
+         else {
+            key = hash_file(key, filename);
+            free(filename);
+         }
+         has_input = 1;
+      }
+
+      // Base directory changed?
+      else if (!strcmp(command, "basedir") && num_args == 2) {
+         free(dir);
+         dir = (char *) malloc(strlen(args.tokens[1]) + 1);
+         if (dir == NULL)
+            errcode = ERR_NOMEMORY;
+         else
+            strcpy(dir, args.tokens[1]);
+      }
+
+      // Pools depend on everything inside them
+      else if (!strcmp(command, "pool"))
+         reusable = 0;
+
+      // Commands that use the bitmap from before the segment?
+      else if (!has_input && (!strcmp(command, "tiles") ||
+      !strcmp(command, "map") || (!strcmp(command, "sprite") &&
+      num_args != 2)))
+         needs_input = 1;
+
+      free_tokens(&args);
+      if (errcode) break;
+   }
+
+   // Go back to where we were
+   free(dir);
+   if (fseek(file, start, SEEK_SET) && !errcode)
+      errcode = ERR_CANTREAD;
+   if (errcode)
+      return errcode;
+
+   // The bitmap from before only matters if it gets used
+   if (needs_input)
+      key = hash_data(key, &inc->in_key, sizeof(inc->in_key));
+
+   // Built before? Then just replay it
+   if (reusable) {
+      inc->segment = find_manifest_segment(&inc->manifest, key);
+      if (inc->segment != NULL) {
+         inc->replaying = 1;
+         return ERR_NONE;
+      }
+   }
+
+   // If an earlier segment was replayed and this one needs the bitmap it
+   // skipped, then it's time to load it (the caller will complain if it
+   // can't be loaded)
+   if (*in == &placeholder && needs_input) {
+      uint8_t *table = (uint8_t *) malloc(PALTABLE_SIZE);
+      if (table == NULL)
+         return ERR_NOMEMORY;
+      make_palette_table(inc->pending_pal, table);
+      *in = decode_bitmap(inc->pending, table, inc->pending_lines);
+      *in_cached = 0;
+      free(table);
+   }
+
+   // Record it as it's built
+   if (reusable) {
+      inc->segment = add_manifest_segment(&inc->manifest, key);
+      if (inc->segment == NULL)
+         return ERR_NOMEMORY;
+   }
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// end_segment [internal]
+// Called when a segment of the batch ends. If it was being recorded but it
+// turns out it can't be reused (e.g. there were errors), it's dropped.
+//---------------------------------------------------------------------------
+// param inc: pointer to incremental build state
+// param failed: set if there were errors in the batch
+//***************************************************************************
+
+static void end_segment(Incremental *inc, int failed) {
+   if (inc->segment != NULL && !inc->replaying) {
+      if (failed || get_shared_pool() != NULL || is_sprite_pending())
+         drop_manifest_segment(&inc->manifest, inc->segment);
+   }
+
+   inc->segment = NULL;
+   inc->replaying = 0;
+}
+
+//***************************************************************************
+// tell_output [internal]
+// Gets the current position in an output file
+//---------------------------------------------------------------------------
+// param file: output file (can be NULL)
+// return: current position (0 if there isn't a file)
+//***************************************************************************
+
+static long tell_output(FILE *file) {
+   return file != NULL ? ftell(file) : 0;
+}
+
+//***************************************************************************
+// record_step [internal]
+// Stores what a command did into the segment being recorded (if any)
+//---------------------------------------------------------------------------
+// param inc: pointer to incremental build state
+// param out: output files
+// param pos: position of each output file before the command
+// return: error code
+//***************************************************************************
+
+static int record_step(Incremental *inc, FILE *out[2], const long pos[2]) {
+   // Not recording?
+   if (inc->segment == NULL || inc->replaying)
+      return ERR_NONE;
+
+   ManifestStep *step = add_manifest_step(inc->segment);
+   if (step == NULL)
+      return ERR_NOMEMORY;
+
+   for (unsigned i = 0; i < 2; i++) {
+      int errcode = read_back_output(out[i], pos[i],
+         &step->data[i], &step->size[i]);
+      if (errcode) return errcode;
+   }
+
+   step->offset = get_map_offset();
+   step->num_lines = get_bitmap_palette(step->palette);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// replay_step [internal]
+// Does what a command in the segment being replayed did last time
+//---------------------------------------------------------------------------
+// param inc: pointer to incremental build state
+// param out: output files
+// return: error code
+//***************************************************************************
+
+static int replay_step(Incremental *inc, FILE *out[2]) {
+   // Shouldn't happen unless two segments ended up with the same hash
+   if (inc->next_step == inc->segment->num_steps)
+      return ERR_UNKNOWN;
+   const ManifestStep *step = &inc->segment->steps[inc->next_step++];
+
+   // Write the same bytes as last time
+   for (unsigned i = 0; i < 2; i++) {
+      if (step->size[i] == 0)
+         continue;
+      if (out[i] == NULL ||
+      fwrite(step->data[i], 1, step->size[i], out[i]) != step->size[i])
+         return i ? ERR_CANTWRITEMAP : ERR_CANTWRITEGFX;
+   }
+
+   // Leave everything as it was last time
+   set_map_offset(step->offset);
+   set_bitmap_palette(step->palette, step->num_lines);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// hash_input [internal]
+// Computes the hash identifying an input bitmap (its contents and how true
+// color bitmaps would be converted)
+//---------------------------------------------------------------------------
+// param filename: name of bitmap file
+// return: hash
+//***************************************************************************
+
+static uint64_t hash_input(const char *filename) {
+   uint16_t palette[0x10];
+   get_fallback_palette(palette);
+   uint32_t auto_lines = get_auto_palette();
+   uint64_t key = hash_data(HASH_INIT, palette, sizeof(palette));
+   key = hash_data(key, &auto_lines, sizeof(auto_lines));
+   return hash_file(key, filename);
+}
+
+//***************************************************************************
+// close_output [internal]
+// Closes an output file. If it's compressed, this is when it gets
+// compressed and written into the actual file.
+//---------------------------------------------------------------------------
+// param file: output file (can be NULL)
+// param codec: how it's compressed (reset when done)
+// param infilename: name of batch file (for error messages)
+// param jobs: how many threads the compressor can use
+// param failed: set if the compression fails
+// return: error code (only for serious errors)
+//***************************************************************************
+
+static int close_output(FILE *file, OutputCodec *codec,
+const char *infilename, int jobs, int *failed) {
+   // Compress it if needed
+   int errcode = ERR_NONE;
+   if (file != NULL && codec->codec != CODEC_NONE) {
+      errcode = write_compressed(file, codec->filename, codec->codec, jobs);
+
+      // Report what went wrong (unless it's serious)
+      const char *msg = NULL;
+      switch (errcode) {
+         case ERR_NONE: break;
+         case ERR_NOMEMORY: break;
+         case ERR_TOOLARGE: msg = "too large to compress"; break;
+         case ERR_NOTTILES: msg = "must be whole tiles to compress"; break;
+         case ERR_OPENOUTPUT: msg = "can't open"; break;
+         case ERR_CANTWRITE: msg = "can't write"; break;
+         case ERR_CANTREADBACK: msg = "can't read back"; break;
+         default: msg = "can't compress"; break;
+      }
+      if (msg != NULL) {
+         print_error_line(codec->line, infilename);
+         fprintf(stderr, "output \"%s\": %s\n", codec->filename, msg);
+         *failed = 1;
+         errcode = ERR_NONE;
+      }
+   }
+
+   // Done with it
+   if (file != NULL)
+      fclose(file);
+   free(codec->filename);
+   codec->codec = CODEC_NONE;
+   codec->filename = NULL;
+   codec->line = 0;
+   return errcode;
+}
@@ -24,7 +24,10 @@
 #ifndef BATCH_H
 #define BATCH_H
 
+// Required headers
+#include <stddef.h>
+
 // Function prototypes
-int build_batch(const char *);
+int build_batch(const char *, int, size_t, const char *);
 
 #endif
@@ -30,6 +30,7 @@
 #include <png.h>
 #include "bitmap.h"
 #include "palette.h"
+#include "quantize.h"
 
 // Prototype of callback function used by libpng
 static void read_callback(png_structp, png_bytep, png_size_t);
@@ -44,6 +45,30 @@ static void read_callback(png_structp, png_bytep, png_size_t);
 //***************************************************************************
 
 Bitmap *load_bitmap(const char *filename) {
+   // Convert it with the current palette
+   Bitmap *ptr = decode_bitmap(filename, pal_table, get_auto_palette());
+   if (ptr == NULL)
+      return NULL;
+
+   // Save the palette in case 'dumppal' gets used later
+   use_bitmap_palette(ptr);
+   return ptr;
+}
+
+//***************************************************************************
+// decode_bitmap
+// Does the actual work of load_bitmap, but without touching any global
+// state, so it's safe to call it from other threads.
+//---------------------------------------------------------------------------
+// param filename: name of file to load from
+// param table: palette look-up table for true color bitmaps
+// param auto_lines: if not 0, generate a palette for true color bitmaps with
+//                   up to this many lines instead of using the table
+// return: pointer to bitmap or NULL on failure
+//***************************************************************************
+
+Bitmap *decode_bitmap(const char *filename, const uint8_t *table,
+unsigned auto_lines) {
    // Open file
    FILE *file = fopen(filename, "rb");
    if (file == NULL)
@@ -93,6 +118,20 @@ Bitmap *load_bitmap(const char *filename) {
    int32_t height = png_get_image_height(png_ptr, info_ptr);
    int type = png_get_color_type(png_ptr, info_ptr);
 
+   // Create structure to hold the bitmap object
+   Bitmap *ptr = (Bitmap *) malloc(sizeof(Bitmap));
+   if (ptr == NULL) {
+      png_destroy_read_struct(&png_ptr, NULL, NULL);
+      fclose(file);
+      return NULL;
+   }
+   ptr->width = width;
+   ptr->height = height;
+   ptr->data = NULL;
+   ptr->rows = NULL;
+   ptr->paletted = 0;
+   ptr->num_lines = 0;
+
    // Get palette, if any
    if (type == PNG_COLOR_TYPE_PALETTE) {
       // Read palette from PNG file
@@ -105,35 +144,17 @@ Bitmap *load_bitmap(const char *filename) {
       if (max_colors > num_colors)
          max_colors = num_colors;
 
-      uint16_t md_palette[16] = { 0 };
+      for (int i = 0; i < 16; i++)
+         ptr->palette[i] = 0;
       for (int i = 0; i < max_colors; i++) {
          uint8_t r = png_palette[i].red >> 5;
          uint8_t g = png_palette[i].green >> 5;
          uint8_t b = png_palette[i].blue >> 5;
-         md_palette[i] = b << 9 | g << 5 | r << 1;
+         ptr->palette[i] = b << 9 | g << 5 | r << 1;
       }
-
-      // Save the palette in case 'dumppal' gets used later
-      set_bitmap_palette(md_palette);
-   }
-
-   // Bitmap wasn't palette, load whatever was used with the 'palette' command
-   // (i.e. the palette the bitmap was converted with)
-   else {
-      set_fallback_palette();
-   }
-
-   // Create structure to hold the bitmap object
-   Bitmap *ptr = (Bitmap *) malloc(sizeof(Bitmap));
-   if (ptr == NULL) {
-      png_destroy_read_struct(&png_ptr, NULL, NULL);
-      fclose(file);
-      return NULL;
+      ptr->paletted = 1;
+      ptr->num_lines = 1;
    }
-   ptr->width = width;
-   ptr->height = height;
-   ptr->data = NULL;
-   ptr->rows = NULL;
 
    // Allocate enough memory to hold the pixel data
    ptr->data = (uint8_t *) malloc(width * height);
@@ -157,6 +178,47 @@ Bitmap *load_bitmap(const char *filename) {
    for (int i = 0; i < height; i++)
       ptr->rows[i] = &ptr->data[i * width];
 
+   // Generating the palette? (then true color bitmaps go through the
+   // quantizer instead of the look-up table)
+   if (auto_lines != 0 && type != PNG_COLOR_TYPE_PALETTE) {
+      uint16_t *pixels = (uint16_t *) malloc(sizeof(uint16_t) *
+         width * height);
+      if (pixels == NULL) {
+         png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+         destroy_bitmap(ptr);
+         fclose(file);
+         return NULL;
+      }
+
+      uint16_t *color = pixels;
+      for (int y = 0; y < height; y++) {
+         const uint8_t *src = rows[y];
+         for (int x = 0; x < width; x++) {
+            if (type == PNG_COLOR_TYPE_GRAY) {
+               uint16_t val = *src++ >> 3;
+               *color++ = val << 10 | val << 5 | val;
+            } else {
+               uint16_t r = (*src++ & 0xF8) >> 3;
+               uint16_t g = (*src++ & 0xF8) << 2;
+               uint16_t b = (*src++ & 0xF8) << 7;
+               *color++ = b|g|r;
+            }
+         }
+      }
+
+      ptr->num_lines = quantize_bitmap(pixels, width, height, auto_lines,
+         ptr->data, ptr->palette);
+      free(pixels);
+      png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+      fclose(file);
+
+      if (ptr->num_lines == 0) {
+         destroy_bitmap(ptr);
+         return NULL;
+      }
+      return ptr;
+   }
+
    // Copy data into the bitmap object
    uint8_t *dest = ptr->data;
    switch (type) {
@@ -175,7 +237,7 @@ Bitmap *load_bitmap(const char *filename) {
             const uint8_t *src = rows[y];
             for (int x = 0; x < width; x++) {
                uint8_t val = *src++ >> 5;
-               *dest++ = pal_table[val << 6 | val << 3 | val];
+               *dest++ = table[val << 6 | val << 3 | val];
             }
          }
          break;
@@ -188,7 +250,7 @@ Bitmap *load_bitmap(const char *filename) {
                uint16_t r = (*src++ & 0xF8) >> 3;
                uint16_t g = (*src++ & 0xF8) << 2;
                uint16_t b = (*src++ & 0xF8) << 7;
-               *dest++ = pal_table[b|g|r];
+               *dest++ = table[b|g|r];
             }
          }
          break;
@@ -200,6 +262,23 @@ Bitmap *load_bitmap(const char *filename) {
    return ptr;
 }
 
+//***************************************************************************
+// use_bitmap_palette
+// Makes the palette of a bitmap the one used by 'dumppal'. If the bitmap
+// wasn't paletted (and didn't get a palette generated), then whatever was
+// used with the 'palette' command is used instead (i.e. the palette the
+// bitmap was converted with).
+//---------------------------------------------------------------------------
+// param ptr: pointer to bitmap
+//***************************************************************************
+
+void use_bitmap_palette(const Bitmap *ptr) {
+   if (ptr->num_lines != 0)
+      set_bitmap_palette(ptr->palette, ptr->num_lines);
+   else
+      set_fallback_palette();
+}
+
 //***************************************************************************
 // read_callback [internal]
 // Callback function used by libpng to read from the PNG file.
@@ -26,6 +26,7 @@
 
 // Required headers
 #include <stdint.h>
+#include "palette.h"
 
 // Definition of a bitmap
 typedef struct {
@@ -33,11 +34,17 @@ typedef struct {
    int height;             // Height in pixels
    uint8_t *data;          // Bitmap data
    uint8_t **rows;         // Pointers to each row
+   int paletted;           // Set if the PNG had its own palette
+   uint16_t palette[16*MAX_PAL_LINES]; // The PNG's palette (if it had one)
+                                       // or the generated one
+   unsigned num_lines;     // Palette lines in the above (0 if neither)
 } Bitmap;
 
 // Function prototypes
 void set_palette(const uint16_t *);
 Bitmap *load_bitmap(const char *);
+Bitmap *decode_bitmap(const char *, const uint8_t *, unsigned);
+void use_bitmap_palette(const Bitmap *);
 uint8_t get_pixel(const Bitmap *, int, int);
 void destroy_bitmap(Bitmap *);
 
@@ -0,0 +1,210 @@
+//***************************************************************************
+// "cache.c"
+// Keeps loaded bitmaps around in case they're loaded again
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "main.h"
+#include "bitmap.h"
+#include "cache.h"
+#include "palette.h"
+
+// Function prototypes
+static size_t get_bitmap_memory(const Bitmap *);
+static void evict_bitmap(BitmapCache *);
+
+//***************************************************************************
+// init_cache
+// Initializes a bitmap cache (starts empty)
+//---------------------------------------------------------------------------
+// param cache: pointer to cache
+// param max_memory: how many bytes the bitmaps can take up
+//***************************************************************************
+
+void init_cache(BitmapCache *cache, size_t max_memory) {
+   cache->entries = NULL;
+   cache->num_entries = 0;
+   cache->memory = 0;
+   cache->max_memory = max_memory;
+   cache->clock = 0;
+}
+
+//***************************************************************************
+// find_cached_bitmap
+// Looks for a bitmap in the cache. It only counts if the file didn't change
+// since it was loaded, and (for true color bitmaps) if it was converted
+// with the current palette (or had its palette generated the same way).
+//---------------------------------------------------------------------------
+// param cache: pointer to cache
+// param filename: name of file to load
+// return: pointer to bitmap (owned by the cache), or NULL if not there
+//***************************************************************************
+
+Bitmap *find_cached_bitmap(BitmapCache *cache, const char *filename) {
+   // Nothing to look for?
+   if (cache->num_entries == 0)
+      return NULL;
+
+   // Check which file is it now
+   struct stat info;
+   if (stat(filename, &info))
+      return NULL;
+
+   uint16_t palette[16];
+   get_fallback_palette(palette);
+   unsigned auto_lines = get_auto_palette();
+
+   // Look for it
+   for (size_t i = 0; i < cache->num_entries; i++) {
+      CacheEntry *entry = &cache->entries[i];
+
+      if (strcmp(entry->filename, filename)) continue;
+      if (entry->device != (uint64_t) info.st_dev) continue;
+      if (entry->inode != (uint64_t) info.st_ino) continue;
+      if (entry->filesize != (uint64_t) info.st_size) continue;
+      if (entry->modified != info.st_mtime) continue;
+      if (!entry->bitmap->paletted &&
+      (memcmp(entry->palette, palette, sizeof(palette)) ||
+      entry->auto_lines != auto_lines))
+         continue;
+
+      // Found it!
+      entry->last_used = ++cache->clock;
+      return entry->bitmap;
+   }
+
+   // Nope, not there
+   return NULL;
+}
+
+//***************************************************************************
+// add_cached_bitmap
+// Adds a just loaded bitmap to the cache, which takes ownership of it. If
+// the cache goes above its memory limit, the least recently used bitmaps
+// are thrown away (except the one just added, which is about to be used).
+//---------------------------------------------------------------------------
+// param cache: pointer to cache
+// param filename: name of file it was loaded from
+// param bitmap: pointer to bitmap
+// return: error code (if it fails, the bitmap isn't taken)
+//***************************************************************************
+
+int add_cached_bitmap(BitmapCache *cache, const char *filename,
+Bitmap *bitmap) {
+   // Make room for the new entry
+   CacheEntry *temp = (CacheEntry *) realloc(cache->entries,
+      sizeof(CacheEntry) * (cache->num_entries + 1));
+   if (temp == NULL)
+      return ERR_NOMEMORY;
+   cache->entries = temp;
+
+   // Fill it in
+   CacheEntry *entry = &cache->entries[cache->num_entries];
+   entry->filename = (char *) malloc(strlen(filename) + 1);
+   if (entry->filename == NULL)
+      return ERR_NOMEMORY;
+   strcpy(entry->filename, filename);
+
+   // If we can't tell which file is it then it'll never be matched, but
+   // that's harmless (it'll eventually be thrown away)
+   struct stat info;
+   if (stat(filename, &info))
+      memset(&info, 0, sizeof(info));
+   entry->device = info.st_dev;
+   entry->inode = info.st_ino;
+   entry->filesize = info.st_size;
+   entry->modified = info.st_mtime;
+
+   get_fallback_palette(entry->palette);
+   entry->auto_lines = get_auto_palette();
+   entry->bitmap = bitmap;
+   entry->memory = get_bitmap_memory(bitmap);
+   entry->last_used = ++cache->clock;
+
+   cache->num_entries++;
+   cache->memory += entry->memory;
+
+   // Make sure we don't go over the limit
+   while (cache->memory > cache->max_memory && cache->num_entries > 1)
+      evict_bitmap(cache);
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// free_cache
+// Gets rid of all the bitmaps in the cache
+//---------------------------------------------------------------------------
+// param cache: pointer to cache
+//***************************************************************************
+
+void free_cache(BitmapCache *cache) {
+   for (size_t i = 0; i < cache->num_entries; i++) {
+      destroy_bitmap(cache->entries[i].bitmap);
+      free(cache->entries[i].filename);
+   }
+   free(cache->entries);
+   init_cache(cache, cache->max_memory);
+}
+
+//***************************************************************************
+// get_bitmap_memory [internal]
+// Tells roughly how much memory a bitmap takes up
+//---------------------------------------------------------------------------
+// param bitmap: pointer to bitmap
+// return: size in bytes
+//***************************************************************************
+
+static size_t get_bitmap_memory(const Bitmap *bitmap) {
+   return sizeof(Bitmap) +
+          (size_t) bitmap->width * bitmap->height +
+          sizeof(uint8_t *) * bitmap->height;
+}
+
+//***************************************************************************
+// evict_bitmap [internal]
+// Throws away the least recently used bitmap in the cache
+//---------------------------------------------------------------------------
+// param cache: pointer to cache
+//***************************************************************************
+
+static void evict_bitmap(BitmapCache *cache) {
+   // Look for the bitmap that was used the longest ago
+   size_t oldest = 0;
+   for (size_t i = 1; i < cache->num_entries; i++) {
+      if (cache->entries[i].last_used < cache->entries[oldest].last_used)
+         oldest = i;
+   }
+
+   // Get rid of it (the last entry takes its place)
+   CacheEntry *entry = &cache->entries[oldest];
+   cache->memory -= entry->memory;
+   destroy_bitmap(entry->bitmap);
+   free(entry->filename);
+
+   cache->num_entries--;
+   *entry = cache->entries[cache->num_entries];
+}
@@ -0,0 +1,64 @@
+//***************************************************************************
+// "cache.h"
+// Header file for "cache.c"
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+#ifndef CACHE_H
+#define CACHE_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "bitmap.h"
+
+// Default amount of memory the cache can use (in MB)
+#define DEFAULT_CACHE_SIZE 64
+
+// A bitmap kept around in case it's loaded again
+typedef struct {
+   char *filename;            // Name of the file it was loaded from
+   uint64_t device;           // Device the file is in
+   uint64_t inode;            // Inode of the file
+   uint64_t filesize;         // Size of the file
+   time_t modified;           // When the file was last modified
+   uint16_t palette[16];      // Palette used to convert it (true color)
+   unsigned auto_lines;       // Palette lines generated for it (true color)
+   Bitmap *bitmap;            // The bitmap itself
+   size_t memory;             // Memory used by the bitmap
+   uint64_t last_used;        // When it was last used (for eviction)
+} CacheEntry;
+
+// Cache of loaded bitmaps
+typedef struct {
+   CacheEntry *entries;       // Bitmaps in the cache
+   size_t num_entries;        // Number of bitmaps in the cache
+   size_t memory;             // Memory used by all bitmaps
+   size_t max_memory;         // Memory they can use at most
+   uint64_t clock;            // Incremented every time it's used
+} BitmapCache;
+
+// Function prototypes
+void init_cache(BitmapCache *, size_t);
+Bitmap *find_cached_bitmap(BitmapCache *, const char *);
+int add_cached_bitmap(BitmapCache *, const char *, Bitmap *);
+void free_cache(BitmapCache *);
+
+#endif
@@ -0,0 +1,125 @@
+//***************************************************************************
+// "codec.c"
+// Compresses output files as they're closed
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "codec.h"
+#include "manifest.h"
+
+// Name of each codec in the batch file
+static const struct {
+   const char *name;
+   Codec codec;
+} codec_names[] = {
+   { "slz16", CODEC_SLZ16 },
+   { "slz24", CODEC_SLZ24 },
+   { "uftc15", CODEC_UFTC15 },
+   { "uftc16", CODEC_UFTC16 },
+   { NULL, CODEC_UNKNOWN }
+};
+
+//***************************************************************************
+// get_codec
+// Looks up a codec by its name
+//---------------------------------------------------------------------------
+// param name: name of codec (e.g. "slz16")
+// return: codec (CODEC_UNKNOWN if not valid)
+//***************************************************************************
+
+Codec get_codec(const char *name) {
+   for (unsigned i = 0; codec_names[i].name != NULL; i++) {
+      if (!strcmp(name, codec_names[i].name))
+         return codec_names[i].codec;
+   }
+   return CODEC_UNKNOWN;
+}
+
+//***************************************************************************
+// write_compressed
+// Takes everything written to a temporary output file, compresses it and
+// writes the result into the actual output file
+//---------------------------------------------------------------------------
+// param temp: temporary file (must be readable, left open)
+// param filename: name of actual output file
+// param codec: how to compress it
+// param threads: how many threads the compressor can use
+// return: error code
+//***************************************************************************
+
+int write_compressed(FILE *temp, const char *filename, Codec codec,
+int threads) {
+   // Get back what was written
+   uint8_t *blob;
+   size_t size;
+   int errcode = read_back_output(temp, 0, &blob, &size);
+   if (errcode) return errcode;
+
+   // Compress it
+   uint8_t *buffer;
+   size_t bufsize;
+   CodecResult result;
+   switch (codec) {
+      case CODEC_SLZ16:
+      case CODEC_SLZ24:
+         result = compress_slz(blob, size, codec, threads,
+            &buffer, &bufsize);
+         break;
+      case CODEC_UFTC15:
+      case CODEC_UFTC16:
+         result = compress_uftc(blob, size, codec, &buffer, &bufsize);
+         break;
+      default:
+         result = CODEC_FAILED;
+         break;
+   }
+   free(blob);
+
+   switch (result) {
+      case CODEC_OK: break;
+      case CODEC_TOOLARGE: return ERR_TOOLARGE;
+      case CODEC_NOTTILES: return ERR_NOTTILES;
+      case CODEC_NOMEMORY: return ERR_NOMEMORY;
+      default: return ERR_UNKNOWN;
+   }
+
+   // Write it into the output file
+   FILE *file = fopen(filename, "wb");
+   if (file == NULL) {
+      free(buffer);
+      return ERR_OPENOUTPUT;
+   }
+   if (fwrite(buffer, 1, bufsize, file) != bufsize) {
+      free(buffer);
+      fclose(file);
+      return ERR_CANTWRITE;
+   }
+
+   free(buffer);
+   if (fclose(file))
+      return ERR_CANTWRITE;
+   return ERR_NONE;
+}
@@ -0,0 +1,59 @@
+//***************************************************************************
+// "codec.h"
+// Header file for "codec.c", "codec_slz.c" and "codec_uftc.c"
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+#ifndef CODEC_H
+#define CODEC_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Possible ways to compress output files
+typedef enum {
+   CODEC_NONE,          // Not compressed
+   CODEC_SLZ16,         // SLZ16
+   CODEC_SLZ24,         // SLZ24
+   CODEC_UFTC15,        // UFTC15
+   CODEC_UFTC16,        // UFTC16
+   CODEC_UNKNOWN        // Not a valid codec
+} Codec;
+
+// What the compressors can return (they can't use our error codes since
+// they're built with the headers from their own tools)
+typedef enum {
+   CODEC_OK,            // Compressed fine
+   CODEC_TOOLARGE,      // Too large for the format
+   CODEC_NOTTILES,      // Not made up of whole tiles
+   CODEC_NOMEMORY,      // Ran out of memory
+   CODEC_FAILED         // Something else went wrong
+} CodecResult;
+
+// Function prototypes
+Codec get_codec(const char *);
+int write_compressed(FILE *, const char *, Codec, int);
+CodecResult compress_slz(const uint8_t *, size_t, Codec, int, uint8_t **,
+   size_t *);
+CodecResult compress_uftc(const uint8_t *, size_t, Codec, uint8_t **,
+   size_t *);
+
+#endif
@@ -0,0 +1,65 @@
+//***************************************************************************
+// "codec_slz.c"
+// Compresses output files into SLZ (using the compressor from the slz tool)
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// The uftc compressor uses the same names, so the Makefile renames them
+// when building the slz compressor into mdtiler
+#define compress slz_compress
+#define compress_blob slz_compress_blob
+
+// Required headers (only the ones from the slz tool, since its error codes
+// and formats clash with ours)
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../../slz/tool/main.h"
+#include "../../slz/tool/compress.h"
+#include "codec.h"
+
+//***************************************************************************
+// compress_slz
+// Compresses a blob into SLZ
+//---------------------------------------------------------------------------
+// param blob: data to compress (can be NULL if size is 0)
+// param size: size of the data
+// param codec: CODEC_SLZ16 or CODEC_SLZ24
+// param threads: how many threads to use when looking for strings
+// param output: where to store pointer to compressed data (must be freed)
+// param outsize: where to store size of compressed data
+// return: result
+//***************************************************************************
+
+CodecResult compress_slz(const uint8_t *blob, size_t size, Codec codec,
+int threads, uint8_t **output, size_t *outsize) {
+   static const uint8_t empty = 0;
+   if (blob == NULL)
+      blob = &empty;
+
+   int format = codec == CODEC_SLZ24 ? FORMAT_SLZ24 : FORMAT_SLZ16;
+   switch (slz_compress_blob(blob, size, NULL, 0, format, PARSE_GREEDY,
+   threads, output, outsize, NULL)) {
+      case ERR_NONE: return CODEC_OK;
+      case ERR_TOOLARGE16: return CODEC_TOOLARGE;
+      case ERR_TOOLARGE24: return CODEC_TOOLARGE;
+      case ERR_NOMEMORY: return CODEC_NOMEMORY;
+      default: return CODEC_FAILED;
+   }
+}
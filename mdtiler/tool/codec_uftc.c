@@ -0,0 +1,66 @@
+//***************************************************************************
+// "codec_uftc.c"
+// Compresses output files into UFTC (using the compressor from the uftc tool)
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// The slz compressor uses the same names, so the Makefile renames them
+// when building the uftc compressor into mdtiler
+#define compress uftc_compress
+#define compress_blob uftc_compress_blob
+#define train_dictionary uftc_train_dictionary
+
+// Required headers (only the ones from the uftc tool, since its error codes
+// and formats clash with ours)
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "../../uftc/tool/main.h"
+#include "../../uftc/tool/compress.h"
+#include "codec.h"
+
+//***************************************************************************
+// compress_uftc
+// Compresses a blob of tiles into UFTC
+//---------------------------------------------------------------------------
+// param blob: tiles to compress (can be NULL if size is 0)
+// param size: size of the tiles in bytes
+// param codec: CODEC_UFTC15 or CODEC_UFTC16
+// param output: where to store pointer to compressed data (must be freed)
+// param outsize: where to store size of compressed data
+// return: result
+//***************************************************************************
+
+CodecResult compress_uftc(const uint8_t *blob, size_t size, Codec codec,
+uint8_t **output, size_t *outsize) {
+   // UFTC needs at least one tile
+   if (blob == NULL || size == 0)
+      return CODEC_NOTTILES;
+
+   int format = codec == CODEC_UFTC15 ? FORMAT_UFTC15 : FORMAT_UFTC16;
+   switch (uftc_compress_blob(blob, size, format, 0, NULL, 0, NULL,
+   output, outsize, NULL, NULL)) {
+      case ERR_NONE: return CODEC_OK;
+      case ERR_BADSIZE: return CODEC_NOTTILES;
+      case ERR_TOOSMALL: return CODEC_NOTTILES;
+      case ERR_TOOBIG: return CODEC_TOOLARGE;
+      case ERR_NOMEMORY: return CODEC_NOMEMORY;
+      default: return CODEC_FAILED;
+   }
+}
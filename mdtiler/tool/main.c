@@ -28,6 +28,7 @@
 #include "main.h"
 #include "batch.h"
 #include "bitmap.h"
+#include "cache.h"
 #include "tiles.h"
 
 // Actions that may be performed
@@ -71,6 +72,10 @@ int main(int argc, char **argv) {
    const char *infilename = NULL;
    const char *outfilename = NULL;
 
+   int jobs = 1;
+   long cache_size = DEFAULT_CACHE_SIZE;
+   const char *manifest = NULL;
+
    int scan_ok = 1;
    int err_manyfiles = 0;
 
@@ -111,6 +116,40 @@ int main(int argc, char **argv) {
             format = format == FORMAT_DEFAULT ?
                      FORMAT_1BPP : FORMAT_TOOMANY;
 
+         // Specify amount of threads?
+         else if (!strcmp(arg, "-j") || !strcmp(arg, "--jobs")) {
+            char *endptr = NULL;
+            if (curr_arg + 1 < argc)
+               jobs = (int) strtol(argv[++curr_arg], &endptr, 10);
+            if (endptr == NULL || *endptr != '\0' || jobs < 1) {
+               fprintf(stderr, "Error: \"%s\" needs a number of threads\n",
+                  arg);
+               errcode = 1;
+            }
+         }
+
+         // Specify how much memory to use for caching bitmaps?
+         else if (!strcmp(arg, "-c") || !strcmp(arg, "--cache")) {
+            char *endptr = NULL;
+            if (curr_arg + 1 < argc)
+               cache_size = strtol(argv[++curr_arg], &endptr, 10);
+            if (endptr == NULL || *endptr != '\0' || cache_size < 0) {
+               fprintf(stderr, "Error: \"%s\" needs a size in MB\n",
+                  arg);
+               errcode = 1;
+            }
+         }
+
+         // Use a manifest to skip unchanged parts of the batch?
+         else if (!strcmp(arg, "-m") || !strcmp(arg, "--manifest")) {
+            if (curr_arg + 1 < argc)
+               manifest = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
          // Unknown argument
          else {
             fprintf(stderr, "Error: unknown option \"%s\"\n", arg);
@@ -187,6 +226,9 @@ int main(int argc, char **argv) {
              "  -s or --sprite .... Quick build, sprite tile order\n"
              "  -4 or --4bpp ...... Output 4bpp tiles (quick build)\n"
              "  -1 or --1bpp ...... Output 1bpp tiles (quick build)\n"
+             "  -j or --jobs <n> .. Load bitmaps with <n> threads (batch)\n"
+             "  -c or --cache <n> . Keep <n> MB of loaded bitmaps (batch)\n"
+             "  -m or --manifest <file> ... Skip unchanged parts (batch)\n"
              "  -h or --help ...... Show this help\n"
              "  -v or --version ... Show tool version\n",
              argv[0], argv[0], argv[0]);
@@ -197,7 +239,8 @@ int main(int argc, char **argv) {
    switch (action) {
       // Batch build
       case ACTION_BATCH:
-         errcode = build_batch(infilename);
+         errcode = build_batch(infilename, jobs,
+            (size_t) cache_size << 20, manifest);
          break;
 
       // Quick build (tilemap ordering)
@@ -266,6 +309,14 @@ int main(int argc, char **argv) {
             msg = "unable to process batch file";
             errfile = infilename;
             break;
+         case ERR_CANTWRITEMAN:
+            msg = "can't write manifest file";
+            errfile = manifest;
+            break;
+         case ERR_CANTREADBACK:
+            msg = "can't read back from output file";
+            errfile = infilename;
+            break;
          default: msg = "unknown error"; break;
       }
 
@@ -40,6 +40,10 @@ enum {
    ERR_PARSE,           // Parsing error
    ERR_BADQUOTE,        // Quote inside non-quoted token
    ERR_NOQUOTE,         // Missing ending quote
+   ERR_CANTWRITEMAN,    // Can't write manifest file
+   ERR_CANTREADBACK,    // Can't read back from output file
+   ERR_TOOLARGE,        // Output too large for its codec
+   ERR_NOTTILES,        // Output isn't whole tiles (needed by codec)
    ERR_UNKNOWN          // Unknown error
 };
 
@@ -0,0 +1,462 @@
+//***************************************************************************
+// "manifest.c"
+// Remembers what each part of a batch did so it can be reused next time
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "manifest.h"
+
+// Magic number at the beginning of manifest files
+static const uint8_t magic[] = { 'M', 'D', 'T', 'M', 0x02 };
+
+// Function prototypes
+static void free_segment(ManifestSegment *);
+static int read_value(FILE *, unsigned, uint64_t *);
+static int write_value(FILE *, unsigned, uint64_t);
+
+//***************************************************************************
+// init_manifest
+// Initializes a manifest (starts empty)
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+//***************************************************************************
+
+void init_manifest(Manifest *manifest) {
+   manifest->segments = NULL;
+   manifest->num_segments = 0;
+}
+
+//***************************************************************************
+// load_manifest
+// Loads a manifest from a file. If the file doesn't exist or can't be
+// understood, the manifest is left empty (everything gets built from
+// scratch, which is always safe).
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+// param filename: name of file to load from
+// return: error code
+//***************************************************************************
+
+int load_manifest(Manifest *manifest, const char *filename) {
+   init_manifest(manifest);
+
+   // Nothing to load?
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return ERR_NONE;
+
+   // Check that it's indeed a manifest
+   uint8_t header[sizeof(magic)];
+   if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+   memcmp(header, magic, sizeof(magic))) {
+      fclose(file);
+      return ERR_NONE;
+   }
+
+   // Read all segments
+   uint64_t num_segments;
+   if (read_value(file, 4, &num_segments))
+      goto corrupt;
+
+   for (uint64_t i = 0; i < num_segments; i++) {
+      uint64_t key, num_steps;
+      if (read_value(file, 8, &key) || read_value(file, 4, &num_steps))
+         goto corrupt;
+
+      ManifestSegment *segment = add_manifest_segment(manifest, key);
+      if (segment == NULL) {
+         fclose(file);
+         free_manifest(manifest);
+         return ERR_NOMEMORY;
+      }
+      segment->used = 0;
+
+      for (uint64_t j = 0; j < num_steps; j++) {
+         ManifestStep *step = add_manifest_step(segment);
+         if (step == NULL) {
+            fclose(file);
+            free_manifest(manifest);
+            return ERR_NOMEMORY;
+         }
+
+         uint64_t value;
+         if (read_value(file, 2, &value))
+            goto corrupt;
+         step->offset = value;
+         if (read_value(file, 1, &value) ||
+         value < 1 || value > MAX_PAL_LINES)
+            goto corrupt;
+         step->num_lines = value;
+         for (unsigned k = 0; k < 16 * step->num_lines; k++) {
+            if (read_value(file, 2, &value))
+               goto corrupt;
+            step->palette[k] = value;
+         }
+
+         for (unsigned k = 0; k < 2; k++) {
+            if (read_value(file, 4, &value))
+               goto corrupt;
+            if (value == 0)
+               continue;
+
+            step->data[k] = (uint8_t *) malloc(value);
+            if (step->data[k] == NULL) {
+               fclose(file);
+               free_manifest(manifest);
+               return ERR_NOMEMORY;
+            }
+            step->size[k] = value;
+            if (fread(step->data[k], 1, value, file) != value)
+               goto corrupt;
+         }
+      }
+   }
+
+   // Success!
+   fclose(file);
+   return ERR_NONE;
+
+   // Couldn't make sense of the file, start over
+corrupt:
+   fclose(file);
+   free_manifest(manifest);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// save_manifest
+// Saves the segments used in this build into a file (the ones that weren't
+// used are gone from the batch, so they're dropped)
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+// param filename: name of file to save into
+// return: error code
+//***************************************************************************
+
+int save_manifest(const Manifest *manifest, const char *filename) {
+   // Open file
+   FILE *file = fopen(filename, "wb");
+   if (file == NULL)
+      return ERR_CANTWRITEMAN;
+
+   // Count how many segments will be saved
+   uint64_t num_segments = 0;
+   for (size_t i = 0; i < manifest->num_segments; i++) {
+      if (manifest->segments[i].used)
+         num_segments++;
+   }
+
+   // Write header
+   int failed = 0;
+   if (fwrite(magic, 1, sizeof(magic), file) != sizeof(magic))
+      failed = 1;
+   failed |= write_value(file, 4, num_segments);
+
+   // Write every segment
+   for (size_t i = 0; i < manifest->num_segments && !failed; i++) {
+      const ManifestSegment *segment = &manifest->segments[i];
+      if (!segment->used)
+         continue;
+
+      failed |= write_value(file, 8, segment->key);
+      failed |= write_value(file, 4, segment->num_steps);
+
+      for (size_t j = 0; j < segment->num_steps && !failed; j++) {
+         const ManifestStep *step = &segment->steps[j];
+         failed |= write_value(file, 2, step->offset);
+         failed |= write_value(file, 1, step->num_lines);
+         for (unsigned k = 0; k < 16 * step->num_lines; k++)
+            failed |= write_value(file, 2, step->palette[k]);
+
+         for (unsigned k = 0; k < 2; k++) {
+            failed |= write_value(file, 4, step->size[k]);
+            if (step->size[k] != 0 && fwrite(step->data[k], 1,
+            step->size[k], file) != step->size[k])
+               failed = 1;
+         }
+      }
+   }
+
+   // Done with the file
+   if (fclose(file))
+      failed = 1;
+   return failed ? ERR_CANTWRITEMAN : ERR_NONE;
+}
+
+//***************************************************************************
+// free_manifest
+// Gets rid of everything in a manifest
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+//***************************************************************************
+
+void free_manifest(Manifest *manifest) {
+   for (size_t i = 0; i < manifest->num_segments; i++)
+      free_segment(&manifest->segments[i]);
+   free(manifest->segments);
+   init_manifest(manifest);
+}
+
+//***************************************************************************
+// find_manifest_segment
+// Looks for a segment in the manifest. Found segments are marked as used.
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+// param key: hash of everything the segment depends on
+// return: pointer to segment, or NULL if not there
+//***************************************************************************
+
+ManifestSegment *find_manifest_segment(Manifest *manifest, uint64_t key) {
+   for (size_t i = 0; i < manifest->num_segments; i++) {
+      ManifestSegment *segment = &manifest->segments[i];
+      if (segment->key == key) {
+         segment->used = 1;
+         return segment;
+      }
+   }
+   return NULL;
+}
+
+//***************************************************************************
+// add_manifest_segment
+// Adds a new segment to the manifest (starts without any steps, marked as
+// used). Note that adding segments may move the other ones.
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+// param key: hash of everything the segment depends on
+// return: pointer to segment, or NULL if out of memory
+//***************************************************************************
+
+ManifestSegment *add_manifest_segment(Manifest *manifest, uint64_t key) {
+   ManifestSegment *temp = (ManifestSegment *) realloc(manifest->segments,
+      sizeof(ManifestSegment) * (manifest->num_segments + 1));
+   if (temp == NULL)
+      return NULL;
+   manifest->segments = temp;
+
+   ManifestSegment *segment = &manifest->segments[manifest->num_segments++];
+   segment->key = key;
+   segment->steps = NULL;
+   segment->num_steps = 0;
+   segment->used = 1;
+   return segment;
+}
+
+//***************************************************************************
+// drop_manifest_segment
+// Gets rid of a segment (e.g. if it turned out it can't be reused). Only
+// the last segment added can be dropped.
+//---------------------------------------------------------------------------
+// param manifest: pointer to manifest
+// param segment: pointer to segment
+//***************************************************************************
+
+void drop_manifest_segment(Manifest *manifest, ManifestSegment *segment) {
+   if (segment != &manifest->segments[manifest->num_segments - 1])
+      return;
+   free_segment(segment);
+   manifest->num_segments--;
+}
+
+//***************************************************************************
+// add_manifest_step
+// Adds a new step at the end of a segment (starts without any data)
+//---------------------------------------------------------------------------
+// param segment: pointer to segment
+// return: pointer to step, or NULL if out of memory
+//***************************************************************************
+
+ManifestStep *add_manifest_step(ManifestSegment *segment) {
+   ManifestStep *temp = (ManifestStep *) realloc(segment->steps,
+      sizeof(ManifestStep) * (segment->num_steps + 1));
+   if (temp == NULL)
+      return NULL;
+   segment->steps = temp;
+
+   ManifestStep *step = &segment->steps[segment->num_steps++];
+   memset(step, 0, sizeof(ManifestStep));
+   step->data[0] = NULL;
+   step->data[1] = NULL;
+   return step;
+}
+
+//***************************************************************************
+// read_back_output
+// Reads back everything written to an output file from the given position
+// onwards (the file must have been opened for reading too)
+//---------------------------------------------------------------------------
+// param file: output file (can be NULL, then nothing was written)
+// param start: position to read from
+// param data: where to store pointer to the data (NULL if none)
+// param size: where to store the size of the data
+// return: error code
+//***************************************************************************
+
+int read_back_output(FILE *file, long start, uint8_t **data, size_t *size) {
+   *data = NULL;
+   *size = 0;
+   if (file == NULL)
+      return ERR_NONE;
+
+   // Find out how much was written
+   if (fseek(file, 0, SEEK_END))
+      return ERR_CANTREADBACK;
+   long end = ftell(file);
+   if (end < start)
+      return ERR_CANTREADBACK;
+   if (end == start)
+      return ERR_NONE;
+
+   // Read it
+   size_t len = end - start;
+   uint8_t *buffer = (uint8_t *) malloc(len);
+   if (buffer == NULL)
+      return ERR_NOMEMORY;
+   if (fseek(file, start, SEEK_SET) ||
+   fread(buffer, 1, len, file) != len ||
+   fseek(file, 0, SEEK_END)) {
+      free(buffer);
+      return ERR_CANTREADBACK;
+   }
+
+   *data = buffer;
+   *size = len;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// hash_data
+// Adds a block of data into a hash (64-bit FNV-1a)
+//---------------------------------------------------------------------------
+// param hash: current hash (HASH_INIT to start)
+// param data: pointer to data
+// param size: size of data in bytes
+// return: new hash
+//***************************************************************************
+
+uint64_t hash_data(uint64_t hash, const void *data, size_t size) {
+   const uint8_t *ptr = (const uint8_t *) data;
+   for (size_t i = 0; i < size; i++)
+      hash = (hash ^ ptr[i]) * 0x100000001B3ULL;
+   return hash;
+}
+
+//***************************************************************************
+// hash_string
+// Adds a string into a hash (including its terminating nul, so strings
+// next to each other can't be mixed up)
+//---------------------------------------------------------------------------
+// param hash: current hash
+// param str: string to add
+// return: new hash
+//***************************************************************************
+
+uint64_t hash_string(uint64_t hash, const char *str) {
+   return hash_data(hash, str, strlen(str) + 1);
+}
+
+//***************************************************************************
+// hash_file
+// Adds the contents of a file into a hash. If the file can't be read, a
+// marker saying so is added instead.
+//---------------------------------------------------------------------------
+// param hash: current hash
+// param filename: name of file
+// return: new hash
+//***************************************************************************
+
+uint64_t hash_file(uint64_t hash, const char *filename) {
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return hash_string(hash, "<missing>");
+
+   uint8_t buffer[0x4000];
+   size_t size;
+   while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      hash = hash_data(hash, buffer, size);
+
+   if (ferror(file))
+      hash = hash_string(hash, "<unreadable>");
+   fclose(file);
+   return hash;
+}
+
+//***************************************************************************
+// free_segment [internal]
+// Gets rid of all the steps in a segment
+//---------------------------------------------------------------------------
+// param segment: pointer to segment
+//***************************************************************************
+
+static void free_segment(ManifestSegment *segment) {
+   for (size_t i = 0; i < segment->num_steps; i++) {
+      free(segment->steps[i].data[0]);
+      free(segment->steps[i].data[1]);
+   }
+   free(segment->steps);
+   segment->steps = NULL;
+   segment->num_steps = 0;
+}
+
+//***************************************************************************
+// read_value [internal]
+// Reads a big endian value from a file
+//---------------------------------------------------------------------------
+// param file: file to read from
+// param size: size of the value in bytes
+// param value: where to store the value
+// return: zero on success, non-zero on failure
+//***************************************************************************
+
+static int read_value(FILE *file, unsigned size, uint64_t *value) {
+   uint8_t buffer[8];
+   if (fread(buffer, 1, size, file) != size)
+      return -1;
+
+   *value = 0;
+   for (unsigned i = 0; i < size; i++)
+      *value = *value << 8 | buffer[i];
+   return 0;
+}
+
+//***************************************************************************
+// write_value [internal]
+// Writes a big endian value into a file
+//---------------------------------------------------------------------------
+// param file: file to write into
+// param size: size of the value in bytes
+// param value: value to write
+// return: zero on success, non-zero on failure
+//***************************************************************************
+
+static int write_value(FILE *file, unsigned size, uint64_t value) {
+   uint8_t buffer[8];
+   for (unsigned i = size; i > 0; i--) {
+      buffer[i - 1] = value;
+      value >>= 8;
+   }
+   return fwrite(buffer, 1, size, file) != size ? -1 : 0;
+}
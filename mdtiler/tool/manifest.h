@@ -0,0 +1,73 @@
+//***************************************************************************
+// "manifest.h"
+// Header file for "manifest.c"
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "palette.h"
+
+// Initial value for hashes
+#define HASH_INIT 0xCBF29CE484222325ULL
+
+// What a command did (see below)
+typedef struct {
+   uint8_t *data[2];          // Bytes written to each output file
+   size_t size[2];            // Amount of bytes written to each file
+   uint16_t offset;           // Tile ID offset after the command
+   uint16_t palette[16*MAX_PAL_LINES]; // Bitmap palette after the command
+   unsigned num_lines;        // Palette lines in the above
+} ManifestStep;
+
+// Everything the commands in a segment of the batch did (a segment goes
+// from an "output" command to the next one)
+typedef struct {
+   uint64_t key;              // Hash of everything the segment depends on
+   ManifestStep *steps;       // What each command did
+   size_t num_steps;          // Number of commands
+   int used;                  // Set if used in this build
+} ManifestSegment;
+
+// Collection of segments that can be reused
+typedef struct {
+   ManifestSegment *segments; // List of segments
+   size_t num_segments;       // Number of segments
+} Manifest;
+
+// Function prototypes
+void init_manifest(Manifest *);
+int load_manifest(Manifest *, const char *);
+int save_manifest(const Manifest *, const char *);
+void free_manifest(Manifest *);
+ManifestSegment *find_manifest_segment(Manifest *, uint64_t);
+ManifestSegment *add_manifest_segment(Manifest *, uint64_t);
+void drop_manifest_segment(Manifest *, ManifestSegment *);
+ManifestStep *add_manifest_step(ManifestSegment *);
+int read_back_output(FILE *, long, uint8_t **, size_t *);
+uint64_t hash_data(uint64_t, const void *, size_t);
+uint64_t hash_string(uint64_t, const char *);
+uint64_t hash_file(uint64_t, const char *);
+
+#endif
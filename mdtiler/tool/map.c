@@ -29,6 +29,7 @@
 #include "main.h"
 #include "bitmap.h"
 #include "offset.h"
+#include "pool.h"
 #include "tiles.h"
 
 //***************************************************************************
@@ -62,19 +63,32 @@ int x, int y, int width, int height, int order) {
    // Get current offset
    uint16_t offset = get_map_offset();
 
-   // To store each tile
-   Tile *tiles = NULL;
-   uint16_t num_tiles = 0;
+   // Where unique tiles are stored. If there's a pool shared by the whole
+   // batch we use that one, otherwise every map gets its own pool.
+   TilePool local_pool;
+   TilePool *pool = get_shared_pool();
+   if (pool == NULL) {
+      pool = &local_pool;
+      init_pool(pool);
+   }
+
+   // Tiles already in the pool before this map. These are the ones we
+   // don't need to write again, and we keep track of which ones got used
+   // so we can tell how many tiles the pool saved.
+   unsigned first_tile = pool->num_tiles;
+   uint8_t *reused = NULL;
+   if (first_tile != 0) {
+      reused = (uint8_t *) calloc(first_tile, sizeof(uint8_t));
+      if (reused == NULL) {
+         if (pool == &local_pool) free_pool(pool);
+         free(mappings);
+         return ERR_NOMEMORY;
+      }
+   }
 
    // To store the tile we're just checking
    Tile curr_tile;
 
-   // Use a mask to filter out bits we don't care about depending on the
-   // format (this is used to ensure palette indices in 1bpp are treated
-   // as normally expected)
-   uint32_t mask = (get_output_format() == FORMAT_1BPP) ?
-      0x11111111 : 0xFFFFFFFF;
-
    // Scan all tiles in the tilemap
    int limit1 = order ? height : width;
    int limit2 = order ? width : height;
@@ -87,97 +101,35 @@ int x, int y, int width, int height, int order) {
       else
          get_tile(in, &curr_tile, x + (pos1 << 3), y + (pos2 << 3));
 
-      for (unsigned i = 0; i < 8; i++) {
-         curr_tile.normal[i] &= mask;
-         curr_tile.flipped[i] &= mask;
-      }
-
-      // Where we store the ID of this tile
-      uint16_t this_id = num_tiles;
+      // Get every way the tile can be flipped
+      uint32_t flips[4][8];
+      get_tile_flips(&curr_tile, flips);
 
       // Compare against all other tiles
-      uint16_t match = 0;
-      for (; match < num_tiles; match++) {
-         // To make code more readable
-         Tile *other = &tiles[match];
-
-         // Is it this tile, non flipped?
-         if (curr_tile.normal[0] == other->normal[0] &&
-             curr_tile.normal[1] == other->normal[1] &&
-             curr_tile.normal[2] == other->normal[2] &&
-             curr_tile.normal[3] == other->normal[3] &&
-             curr_tile.normal[4] == other->normal[4] &&
-             curr_tile.normal[5] == other->normal[5] &&
-             curr_tile.normal[6] == other->normal[6] &&
-             curr_tile.normal[7] == other->normal[7])
-         {
-            this_id = match;
-            break;
-         }
-
-         // Is it this tile, flipped horizontally?
-         if (curr_tile.normal[0] == other->flipped[0] &&
-             curr_tile.normal[1] == other->flipped[1] &&
-             curr_tile.normal[2] == other->flipped[2] &&
-             curr_tile.normal[3] == other->flipped[3] &&
-             curr_tile.normal[4] == other->flipped[4] &&
-             curr_tile.normal[5] == other->flipped[5] &&
-             curr_tile.normal[6] == other->flipped[6] &&
-             curr_tile.normal[7] == other->flipped[7])
-         {
-            this_id = match | 0x0800;
-            break;
-         }
-
-         // Is it this tile, flipped vertically?
-         if (curr_tile.normal[0] == other->normal[7] &&
-             curr_tile.normal[1] == other->normal[6] &&
-             curr_tile.normal[2] == other->normal[5] &&
-             curr_tile.normal[3] == other->normal[4] &&
-             curr_tile.normal[4] == other->normal[3] &&
-             curr_tile.normal[5] == other->normal[2] &&
-             curr_tile.normal[6] == other->normal[1] &&
-             curr_tile.normal[7] == other->normal[0])
-         {
-            this_id = match | 0x1000;
-            break;
-         }
-
-         // Is it this tile, flipped both ways?
-         if (curr_tile.normal[0] == other->flipped[7] &&
-             curr_tile.normal[1] == other->flipped[6] &&
-             curr_tile.normal[2] == other->flipped[5] &&
-             curr_tile.normal[3] == other->flipped[4] &&
-             curr_tile.normal[4] == other->flipped[3] &&
-             curr_tile.normal[5] == other->flipped[2] &&
-             curr_tile.normal[6] == other->flipped[1] &&
-             curr_tile.normal[7] == other->flipped[0])
-         {
-            this_id = match | 0x1800;
-            break;
-         }
-      }
+      int match = find_pool_tile(pool, flips);
+      uint16_t this_id;
 
       // Unique tile?
-      if (match == num_tiles) {
-         // Increment tile count
-         num_tiles++;
-         if (num_tiles > 0x0800) {
-            free(tiles);
+      if (match == -1) {
+         this_id = pool->num_tiles;
+         int errcode = add_pool_tile(pool, flips);
+         if (errcode) {
+            if (pool == &local_pool) free_pool(pool);
+            free(reused);
             free(mappings);
-            return ERR_MANYTILES;
+            return errcode;
          }
+      }
 
-         // Allocate memory for new tile
-         tiles = (Tile *) realloc(tiles, sizeof(Tile) * num_tiles);
-         if (tiles == NULL) {
-            free(tiles);
-            free(mappings);
-            return ERR_NOMEMORY;
-         }
+      // Repeated tile?
+      else {
+         this_id = match;
 
-         // Store tile in the list
-         memcpy(&tiles[num_tiles - 1], &curr_tile, sizeof(Tile));
+         uint16_t index = match & 0x07FF;
+         if (index < first_tile && !reused[index]) {
+            reused[index] = 1;
+            pool->saved++;
+         }
       }
 
       // Add palette and priority
@@ -187,50 +139,14 @@ int x, int y, int width, int height, int order) {
       mappings[pos2 * limit1 + pos1] = this_id;
    }
 
-   // Write all the tiles
-   for (size_t i = 0; i < num_tiles; i++) {
-      for (unsigned row = 0; row < 8; row++) {
-         // 4bpp format?
-         if (get_output_format() == FORMAT_4BPP) {
-            // Split each row into bytes
-            // We need to do this due to endianess shenanigans :P
-            uint8_t buffer[4];
-            buffer[0] = tiles[i].normal[row] >> 24;
-            buffer[1] = tiles[i].normal[row] >> 16;
-            buffer[2] = tiles[i].normal[row] >> 8;
-            buffer[3] = tiles[i].normal[row];
-
-            // Write row into file
-            if (fwrite(buffer, 1, 4, outgfx) < 4) {
-               free(tiles);
-               free(mappings);
-               return ERR_CANTWRITEGFX;
-            }
-         }
-
-         // 1bpp format?
-         else {
-            // Each row is just one byte, but so far we've been storing the
-            // tiles as 4bpp to make our life easier, so we need to convert
-            // it to 1bpp first
-            uint8_t buffer =
-               (tiles[i].normal[row] & 0x10000000 ? 0x80 : 0x00) |
-               (tiles[i].normal[row] & 0x01000000 ? 0x40 : 0x00) |
-               (tiles[i].normal[row] & 0x00100000 ? 0x20 : 0x00) |
-               (tiles[i].normal[row] & 0x00010000 ? 0x10 : 0x00) |
-               (tiles[i].normal[row] & 0x00001000 ? 0x08 : 0x00) |
-               (tiles[i].normal[row] & 0x00000100 ? 0x04 : 0x00) |
-               (tiles[i].normal[row] & 0x00000010 ? 0x02 : 0x00) |
-               (tiles[i].normal[row] & 0x00000001 ? 0x01 : 0x00);
-
-            // Write row into file
-            if (fwrite(&buffer, 1, 1, outgfx) < 1) {
-               free(tiles);
-               free(mappings);
-               return ERR_CANTWRITEGFX;
-            }
-         }
-      }
+   // Write all the new tiles
+   unsigned num_tiles = pool->num_tiles - first_tile;
+   int errcode = write_pool_tiles(pool, outgfx, first_tile);
+   free(reused);
+   if (pool == &local_pool) free_pool(pool);
+   if (errcode) {
+      free(mappings);
+      return errcode;
    }
 
    // Write the mappings
@@ -248,18 +164,17 @@ int x, int y, int width, int height, int order) {
 
       // Write word into file
       if (fwrite(buffer, 1, 2, outmap) < 2) {
-         free(tiles);
          free(mappings);
          return ERR_CANTWRITEMAP;
       }
    }
 
-   // If continuous then adjust the offset
-   if (is_continuous_offset())
+   // If continuous then adjust the offset (if there's a shared pool then
+   // it takes care of this once it's done)
+   if (is_continuous_offset() && get_shared_pool() == NULL)
       increment_offset(num_tiles);
 
    // Success!
-   free(tiles);
    free(mappings);
    return ERR_NONE;
 }
@@ -40,13 +40,19 @@ static unsigned mappings[0x10] = {
     0, 1, 2, 3, 4, 5, 6, 7
 };
 
-// Array to hold the bitmap's original palette
-static uint16_t bitmap_pal[0x10] = { 0 };
+// Array to hold the bitmap's original palette (all of its lines if the
+// palette was generated by "palette auto")
+static uint16_t bitmap_pal[0x10*MAX_PAL_LINES] = { 0 };
+static unsigned bitmap_lines = 1;
 
 // Array to hold the palette specified using the "palette" command
 // This is used so we can dump it with "dumppal" if needed
 static uint16_t fallback_pal[0x10] = { 0 };
 
+// How many palette lines to generate for true color bitmaps
+// (0 if the palette from the "palette" command is used instead)
+static unsigned auto_lines = 0;
+
 //***************************************************************************
 // set_palette
 // Sets the palette to use to convert true color bitmaps into paletted ones.
@@ -57,10 +63,52 @@ static uint16_t fallback_pal[0x10] = { 0 };
 //***************************************************************************
 
 void set_palette(const uint16_t *colors) {
+   // Stop generating palettes (if we were)
+   auto_lines = 0;
+
    // Keep a copy of the palette so we can use it with dumppal
    memcpy(fallback_pal, colors, sizeof(fallback_pal));
    set_fallback_palette();
 
+   // Build the look-up table used when loading bitmaps
+   make_palette_table(colors, pal_table);
+}
+
+//***************************************************************************
+// set_auto_palette
+// Makes true color bitmaps get their own palette generated when they're
+// loaded instead of using the one from set_palette (until set_palette is
+// called again).
+//---------------------------------------------------------------------------
+// param lines: how many palette lines can be used (1 to MAX_PAL_LINES)
+//***************************************************************************
+
+void set_auto_palette(unsigned lines) {
+   auto_lines = lines;
+}
+
+//***************************************************************************
+// get_auto_palette
+// Tells whether true color bitmaps get their own palette generated
+//---------------------------------------------------------------------------
+// return: how many palette lines can be used (0 if not generated)
+//***************************************************************************
+
+unsigned get_auto_palette(void) {
+   return auto_lines;
+}
+
+//***************************************************************************
+// make_palette_table
+// Builds a look-up table to convert true color bitmaps into paletted ones
+// (like set_palette, but storing it somewhere else and without changing
+// any other state, so it can be used for bitmaps loaded later)
+//---------------------------------------------------------------------------
+// param colors: pointer to palette (16 entries)
+// param table: where to store the table (PALTABLE_SIZE entries)
+//***************************************************************************
+
+void make_palette_table(const uint16_t *colors, uint8_t *table) {
    // Go through the entire palette
    for (uint16_t i = 0; i < PALTABLE_SIZE; i++) {
       // Get BGR components for the color to check
@@ -95,7 +143,7 @@ void set_palette(const uint16_t *colors) {
       }
 
       // Store best match into the look-up table
-      pal_table[i] = best;
+      table[i] = best;
    }
 }
 
@@ -127,11 +175,14 @@ void remap_palette(unsigned group, unsigned which) {
 // set_bitmap_palette
 // Saves a copy of the bitmap's original palette
 //---------------------------------------------------------------------------
-// param colors: pointer to palette (16 entries, Mega Drive format)
+// param colors: pointer to palette (16 entries per line, Mega Drive format)
+// param lines: number of palette lines (1 to MAX_PAL_LINES)
 //***************************************************************************
 
-void set_bitmap_palette(const uint16_t *colors) {
-   memcpy(bitmap_pal, colors, sizeof(bitmap_pal));
+void set_bitmap_palette(const uint16_t *colors, unsigned lines) {
+   memset(bitmap_pal, 0, sizeof(bitmap_pal));
+   memcpy(bitmap_pal, colors, sizeof(uint16_t) * 0x10 * lines);
+   bitmap_lines = lines;
 }
 
 //***************************************************************************
@@ -140,12 +191,38 @@ void set_bitmap_palette(const uint16_t *colors) {
 //***************************************************************************
 
 void set_fallback_palette(void) {
-   set_bitmap_palette(fallback_pal);
+   set_bitmap_palette(fallback_pal, 1);
+}
+
+//***************************************************************************
+// get_fallback_palette
+// Retrieves whatever was loaded with the last "palette" command (i.e. the
+// palette true color bitmaps are converted with)
+//---------------------------------------------------------------------------
+// param colors: where to store the palette (16 entries)
+//***************************************************************************
+
+void get_fallback_palette(uint16_t *colors) {
+   memcpy(colors, fallback_pal, sizeof(fallback_pal));
+}
+
+//***************************************************************************
+// get_bitmap_palette
+// Retrieves the bitmap's original palette (i.e. what "dumppal" would dump)
+//---------------------------------------------------------------------------
+// param colors: where to store the palette (16*MAX_PAL_LINES entries)
+// return: number of palette lines in it
+//***************************************************************************
+
+unsigned get_bitmap_palette(uint16_t *colors) {
+   memcpy(colors, bitmap_pal, sizeof(bitmap_pal));
+   return bitmap_lines;
 }
 
 //***************************************************************************
 // dump_bitmap_palette
-// Dumps the bitmap's original palette into a file.
+// Dumps the bitmap's original palette into a file (all of its lines, 32
+// bytes each).
 //---------------------------------------------------------------------------
 // param file: pointer to file handle
 // return: non-zero on success, zero on failure
@@ -153,14 +230,15 @@ void set_fallback_palette(void) {
 
 int dump_bitmap_palette(FILE *file) {
    // Reformat the bitmap into a way that doesn't rely on endianness
-   uint8_t blob[16*2];
+   uint8_t blob[16*2*MAX_PAL_LINES];
    uint8_t *ptr = blob;
-   for (int i = 0; i < 16; i++) {
+   size_t size = 16*2 * bitmap_lines;
+   for (unsigned i = 0; i < 16 * bitmap_lines; i++) {
       uint16_t value = bitmap_pal[i];
       *ptr++ = value >> 8;
       *ptr++ = value;
    }
 
    // Try to write it into the file
-   return fwrite(blob, 1, 32, file) == 32;
+   return fwrite(blob, 1, size, file) == size;
 }
@@ -31,12 +31,20 @@
 #define PALTABLE_SIZE (0x20*0x20*0x20)
 extern uint8_t pal_table[PALTABLE_SIZE];
 
+// Most palette lines a bitmap can use (i.e. all of them)
+#define MAX_PAL_LINES 4
+
 // Function prototypes
 void set_palette(const uint16_t *);
+void set_auto_palette(unsigned);
+unsigned get_auto_palette(void);
+void make_palette_table(const uint16_t *, uint8_t *);
 unsigned get_palette_mapping(unsigned);
 void remap_palette(unsigned, unsigned);
-void set_bitmap_palette(const uint16_t *);
+void set_bitmap_palette(const uint16_t *, unsigned);
+unsigned get_bitmap_palette(uint16_t *);
 void set_fallback_palette(void);
+void get_fallback_palette(uint16_t *);
 int dump_bitmap_palette(FILE *);
 
 #endif // PALETTE_H
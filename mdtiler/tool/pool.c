@@ -0,0 +1,393 @@
+//***************************************************************************
+// "pool.c"
+// Keeps track of unique tiles so repeated ones can be reused
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "bitmap.h"
+#include "offset.h"
+#include "pool.h"
+#include "tiles.h"
+
+// Marks the end of a hash chain
+#define NO_TILE 0xFFFF
+
+// Pool shared by all commands in a batch (between "pool begin" and
+// "pool end")
+static TilePool shared_pool;
+static int shared_active = 0;
+
+// Function prototypes
+static uint32_t hash_tile(const uint32_t [4][8]);
+
+//***************************************************************************
+// init_pool
+// Initializes a tile pool (starts empty)
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+//***************************************************************************
+
+void init_pool(TilePool *pool) {
+   pool->tiles = NULL;
+   pool->next = NULL;
+   pool->num_tiles = 0;
+   pool->max_tiles = 0;
+   pool->saved = 0;
+
+   for (unsigned i = 0; i < POOL_HASH_SIZE; i++)
+      pool->heads[i] = NO_TILE;
+}
+
+//***************************************************************************
+// free_pool
+// Deallocates all the memory used by a tile pool
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+//***************************************************************************
+
+void free_pool(TilePool *pool) {
+   free(pool->tiles);
+   free(pool->next);
+   init_pool(pool);
+}
+
+//***************************************************************************
+// get_tile_flips
+// Gets every way a tile can be flipped, in the order they're checked (as-is,
+// horizontally, vertically, both ways). Pixels are masked depending on the
+// output format (to ensure palette indices in 1bpp are treated as normally
+// expected).
+//---------------------------------------------------------------------------
+// param tile: tile to flip
+// param flips: where to store the rows of every way it can be flipped
+//***************************************************************************
+
+void get_tile_flips(const Tile *tile, uint32_t flips[4][8]) {
+   uint32_t mask = (get_output_format() == FORMAT_1BPP) ?
+      0x11111111 : 0xFFFFFFFF;
+
+   for (unsigned i = 0; i < 8; i++) {
+      flips[0][i] = tile->normal[i] & mask;
+      flips[1][i] = tile->flipped[i] & mask;
+      flips[2][7 - i] = flips[0][i];
+      flips[3][7 - i] = flips[1][i];
+   }
+}
+
+//***************************************************************************
+// find_pool_tile
+// Looks for a tile in the pool, flipped in any way. If it shows up more than
+// once, the earliest one is returned.
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+// param flips: every way the tile can be flipped (see get_tile_flips)
+// return: tile index + flip flags (same as VDP), or -1 if not found
+//***************************************************************************
+
+int find_pool_tile(const TilePool *pool, const uint32_t flips[4][8]) {
+   // Chains are sorted by index, so the first match is the earliest one
+   uint32_t hash = hash_tile(flips);
+   for (uint16_t match = pool->heads[hash]; match != NO_TILE;
+   match = pool->next[match]) {
+      const uint32_t *other = &pool->tiles[match * 8];
+      for (unsigned flip = 0; flip < 4; flip++) {
+         if (!memcmp(flips[flip], other, sizeof(flips[flip])))
+            return match | flip << 11;
+      }
+   }
+
+   // Nope, not there
+   return -1;
+}
+
+//***************************************************************************
+// find_pool_run
+// Looks for a run of consecutive tiles in the pool (not flipped)
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+// param run: every way each tile in the run can be flipped
+// param count: number of tiles in the run
+// return: index of the first tile, or -1 if not found
+//***************************************************************************
+
+int find_pool_run(const TilePool *pool, const uint32_t run[][4][8],
+unsigned count) {
+   // Look for every place where the first tile shows up, then check if the
+   // rest of the run follows it
+   uint32_t hash = hash_tile(run[0]);
+   for (uint16_t match = pool->heads[hash]; match != NO_TILE;
+   match = pool->next[match]) {
+      if (match + count > pool->num_tiles)
+         break;
+
+      unsigned i;
+      for (i = 0; i < count; i++) {
+         if (memcmp(run[i][0], &pool->tiles[(match + i) * 8],
+         sizeof(run[i][0])))
+            break;
+      }
+      if (i == count)
+         return match;
+   }
+
+   // Nope, not there
+   return -1;
+}
+
+//***************************************************************************
+// add_pool_tile
+// Adds a new tile at the end of the pool
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+// param flips: every way the tile can be flipped (see get_tile_flips)
+// return: error code
+//***************************************************************************
+
+int add_pool_tile(TilePool *pool, const uint32_t flips[4][8]) {
+   // Out of tile IDs?
+   if (pool->num_tiles == POOL_MAX_TILES)
+      return ERR_MANYTILES;
+
+   // Make room for more tiles if needed (grows in big steps so we don't end
+   // up reallocating for every tile)
+   if (pool->num_tiles == pool->max_tiles) {
+      uint16_t max_tiles = pool->max_tiles ? pool->max_tiles * 2 : 0x80;
+
+      uint32_t *temp_tiles = (uint32_t *) realloc(pool->tiles,
+         sizeof(uint32_t) * 8 * max_tiles);
+      if (temp_tiles == NULL)
+         return ERR_NOMEMORY;
+      pool->tiles = temp_tiles;
+
+      uint16_t *temp_next = (uint16_t *) realloc(pool->next,
+         sizeof(uint16_t) * max_tiles);
+      if (temp_next == NULL)
+         return ERR_NOMEMORY;
+      pool->next = temp_next;
+
+      pool->max_tiles = max_tiles;
+   }
+
+   // Store the tile as-is (tiles being looked up get flipped instead) and
+   // put it at the end of its hash chain
+   uint16_t id = pool->num_tiles;
+   uint32_t hash = hash_tile(flips);
+   memcpy(&pool->tiles[id * 8], flips[0], sizeof(flips[0]));
+
+   pool->next[id] = NO_TILE;
+   if (pool->heads[hash] == NO_TILE)
+      pool->heads[hash] = id;
+   else
+      pool->next[pool->tails[hash]] = id;
+   pool->tails[hash] = id;
+
+   pool->num_tiles++;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// write_pool_tiles
+// Writes the tiles in a pool from the given one onwards, using the current
+// output format
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+// param out: output file
+// param first: index of first tile to write
+// return: error code
+//***************************************************************************
+
+int write_pool_tiles(const TilePool *pool, FILE *out, unsigned first) {
+   for (size_t i = first; i < pool->num_tiles; i++) {
+      const uint32_t *tile = &pool->tiles[i * 8];
+      for (unsigned row = 0; row < 8; row++) {
+         // 4bpp format?
+         if (get_output_format() == FORMAT_4BPP) {
+            // Split each row into bytes
+            // We need to do this due to endianess shenanigans :P
+            uint8_t buffer[4];
+            buffer[0] = tile[row] >> 24;
+            buffer[1] = tile[row] >> 16;
+            buffer[2] = tile[row] >> 8;
+            buffer[3] = tile[row];
+
+            // Write row into file
+            if (fwrite(buffer, 1, 4, out) < 4)
+               return ERR_CANTWRITEGFX;
+         }
+
+         // 1bpp format?
+         else {
+            // Each row is just one byte, but so far we've been storing the
+            // tiles as 4bpp to make our life easier, so we need to convert
+            // it to 1bpp first
+            uint8_t buffer =
+               (tile[row] & 0x10000000 ? 0x80 : 0x00) |
+               (tile[row] & 0x01000000 ? 0x40 : 0x00) |
+               (tile[row] & 0x00100000 ? 0x20 : 0x00) |
+               (tile[row] & 0x00010000 ? 0x10 : 0x00) |
+               (tile[row] & 0x00001000 ? 0x08 : 0x00) |
+               (tile[row] & 0x00000100 ? 0x04 : 0x00) |
+               (tile[row] & 0x00000010 ? 0x02 : 0x00) |
+               (tile[row] & 0x00000001 ? 0x01 : 0x00);
+
+            // Write row into file
+            if (fwrite(&buffer, 1, 1, out) < 1)
+               return ERR_CANTWRITEGFX;
+         }
+      }
+   }
+
+   // Success!
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// write_pool_block
+// Takes care of the "tiles" command while a pool is active. Every tile is
+// written as-is (even if it's repeated, since whoever uses them expects them
+// in that order), but they're added to the pool so later commands can reuse
+// them.
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+// param in: input bitmap
+// param out: output file
+// param bx: base X coordinate (leftmost pixel of tile)
+// param by: base Y coordinate (topmost pixel of tile)
+// param width: width in tiles
+// param height: height in tiles
+// param order: zero for tilemap order, non-zero for sprite order
+// return: error code
+//***************************************************************************
+
+int write_pool_block(TilePool *pool, const Bitmap *in, FILE *out,
+int bx, int by, int width, int height, int order) {
+   // Tiles start going here
+   unsigned first = pool->num_tiles;
+
+   // Sprite ordering is split into strips at most 4 tiles high, tilemap
+   // ordering is just one big strip
+   while (height > 0) {
+      int strip_height = (order && height > 4) ? 4 : height;
+
+      // Add every tile in the strip
+      int limit1 = order ? strip_height : width;
+      int limit2 = order ? width : strip_height;
+
+      for (int pos2 = 0; pos2 < limit2; pos2++)
+      for (int pos1 = 0; pos1 < limit1; pos1++) {
+         Tile tile;
+         uint32_t flips[4][8];
+
+         if (order)
+            get_tile(in, &tile, bx + (pos2 << 3), by + (pos1 << 3));
+         else
+            get_tile(in, &tile, bx + (pos1 << 3), by + (pos2 << 3));
+         get_tile_flips(&tile, flips);
+
+         int errcode = add_pool_tile(pool, flips);
+         if (errcode) return errcode;
+      }
+
+      // Move onto the next strip
+      height -= strip_height;
+      by += strip_height << 3;
+   }
+
+   // Write the tiles we just added
+   return write_pool_tiles(pool, out, first);
+}
+
+//***************************************************************************
+// begin_shared_pool
+// Takes care of the "pool begin" command in mdtiler. Starts a pool shared by
+// all the commands that follow.
+//***************************************************************************
+
+void begin_shared_pool(void) {
+   init_pool(&shared_pool);
+   shared_active = 1;
+}
+
+//***************************************************************************
+// end_shared_pool
+// Takes care of the "pool end" command in mdtiler. Reports how many tiles
+// were saved and gets rid of the shared pool. If the offset is continuous
+// it skips all the tiles in the pool (commands using the pool leave it
+// alone since all their IDs are relative to where the pool started).
+//***************************************************************************
+
+void end_shared_pool(void) {
+   printf("Tile pool: %u tiles written, %u repeated tiles saved\n",
+      shared_pool.num_tiles, shared_pool.saved);
+
+   if (is_continuous_offset())
+      increment_offset(shared_pool.num_tiles);
+
+   free_pool(&shared_pool);
+   shared_active = 0;
+}
+
+//***************************************************************************
+// abort_shared_pool
+// Gets rid of the shared pool without reporting anything (used when the
+// batch has to give up halfway)
+//***************************************************************************
+
+void abort_shared_pool(void) {
+   free_pool(&shared_pool);
+   shared_active = 0;
+}
+
+//***************************************************************************
+// get_shared_pool
+// Retrieves the pool shared by all commands
+//---------------------------------------------------------------------------
+// return: pointer to pool (NULL if there isn't any)
+//***************************************************************************
+
+TilePool *get_shared_pool(void) {
+   return shared_active ? &shared_pool : NULL;
+}
+
+//***************************************************************************
+// hash_tile [internal]
+// Computes a hash of a tile that's the same no matter how it's flipped
+//---------------------------------------------------------------------------
+// param flips: tile rows flipped every possible way
+// return: hash (below POOL_HASH_SIZE)
+//***************************************************************************
+
+static uint32_t hash_tile(const uint32_t flips[4][8]) {
+   // Hash every way the tile can be flipped, then keep the smallest one
+   // (since flipping a flipped tile gives back the other ways)
+   uint32_t best = 0xFFFFFFFF;
+   for (unsigned flip = 0; flip < 4; flip++) {
+      uint32_t hash = 2166136261U;
+      for (unsigned i = 0; i < 8; i++)
+         hash = (hash ^ flips[flip][i]) * 16777619U;
+      if (hash < best) best = hash;
+   }
+   return (best ^ best >> 16) & (POOL_HASH_SIZE - 1);
+}
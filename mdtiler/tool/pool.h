@@ -0,0 +1,64 @@
+//***************************************************************************
+// "pool.h"
+// Header file for "pool.c"
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+#ifndef POOL_H
+#define POOL_H
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include "bitmap.h"
+#include "tiles.h"
+
+// Size of the hash table used to find repeated tiles (must be a power of 2)
+#define POOL_HASH_SIZE 0x1000
+
+// Maximum number of tiles in a pool (as many as tile IDs can address)
+#define POOL_MAX_TILES 0x800
+
+// Structure to hold a pool of unique tiles
+typedef struct {
+   uint32_t *tiles;        // Row data of every tile (8 rows each)
+   uint16_t *next;         // Next tile in the same hash chain
+   uint16_t num_tiles;     // Number of tiles in the pool
+   uint16_t max_tiles;     // Number of tiles there's room for
+   unsigned saved;         // Tiles that didn't have to be written again
+   uint16_t heads[POOL_HASH_SIZE];  // First tile of every hash chain
+   uint16_t tails[POOL_HASH_SIZE];  // Last tile of every hash chain
+} TilePool;
+
+// Function prototypes
+void init_pool(TilePool *);
+void free_pool(TilePool *);
+void get_tile_flips(const Tile *, uint32_t [4][8]);
+int find_pool_tile(const TilePool *, const uint32_t [4][8]);
+int find_pool_run(const TilePool *, const uint32_t [][4][8], unsigned);
+int add_pool_tile(TilePool *, const uint32_t [4][8]);
+int write_pool_tiles(const TilePool *, FILE *, unsigned);
+int write_pool_block(TilePool *, const Bitmap *, FILE *,
+   int, int, int, int, int);
+void begin_shared_pool(void);
+void end_shared_pool(void);
+void abort_shared_pool(void);
+TilePool *get_shared_pool(void);
+
+#endif
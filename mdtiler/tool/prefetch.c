@@ -0,0 +1,328 @@
+//***************************************************************************
+// "prefetch.c"
+// Loads input bitmaps on other threads ahead of time
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "main.h"
+#include "bitmap.h"
+#include "palette.h"
+#include "prefetch.h"
+
+// How many bitmaps each thread can load ahead of the batch (so we don't end
+// up with every bitmap in the batch in memory at the same time)
+#define AHEAD_PER_THREAD 2
+
+// Function prototypes
+static void *run_prefetch(void *);
+
+//***************************************************************************
+// init_prefetcher
+// Initializes a prefetcher (without any bitmaps to load)
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+//***************************************************************************
+
+void init_prefetcher(Prefetcher *prefetch) {
+   prefetch->jobs = NULL;
+   prefetch->num_jobs = 0;
+   prefetch->next_job = 0;
+   prefetch->next_take = 0;
+
+   prefetch->tables = NULL;
+   prefetch->num_tables = 0;
+
+   prefetch->threads = NULL;
+   prefetch->num_threads = 0;
+   prefetch->ahead = 0;
+   prefetch->quit = 0;
+}
+
+//***************************************************************************
+// add_prefetch_table
+// Makes a new palette look-up table for bitmaps loaded by the prefetcher
+// (the one used by load_bitmap can't be used since it changes as the batch
+// goes on)
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+// param colors: palette to use (16 entries), or NULL for the current one
+// return: pointer to table, or NULL if out of memory
+//***************************************************************************
+
+uint8_t *add_prefetch_table(Prefetcher *prefetch, const uint16_t *colors) {
+   // Make room for the new table in the list
+   uint8_t **temp = (uint8_t **) realloc(prefetch->tables,
+      sizeof(uint8_t *) * (prefetch->num_tables + 1));
+   if (temp == NULL)
+      return NULL;
+   prefetch->tables = temp;
+
+   // Allocate the table
+   uint8_t *table = (uint8_t *) malloc(PALTABLE_SIZE);
+   if (table == NULL)
+      return NULL;
+   prefetch->tables[prefetch->num_tables++] = table;
+
+   // Fill it in
+   if (colors == NULL)
+      memcpy(table, pal_table, PALTABLE_SIZE);
+   else
+      make_palette_table(colors, table);
+
+   return table;
+}
+
+//***************************************************************************
+// add_prefetch_job
+// Adds a bitmap to be loaded by the prefetcher. Bitmaps must be added in
+// the same order the batch will take them.
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+// param line: line of the "input" command
+// param filename: name of file to load
+// param table: palette look-up table to convert it with
+// param auto_lines: palette lines to generate (0 to use the table)
+// return: error code
+//***************************************************************************
+
+int add_prefetch_job(Prefetcher *prefetch, size_t line, const char *filename,
+const uint8_t *table, unsigned auto_lines) {
+   // Make room for the new job in the list
+   PrefetchJob *temp = (PrefetchJob *) realloc(prefetch->jobs,
+      sizeof(PrefetchJob) * (prefetch->num_jobs + 1));
+   if (temp == NULL)
+      return ERR_NOMEMORY;
+   prefetch->jobs = temp;
+
+   // Fill in the job
+   PrefetchJob *job = &prefetch->jobs[prefetch->num_jobs];
+   job->filename = (char *) malloc(strlen(filename) + 1);
+   if (job->filename == NULL)
+      return ERR_NOMEMORY;
+   strcpy(job->filename, filename);
+   job->line = line;
+   job->table = table;
+   job->auto_lines = auto_lines;
+   job->bitmap = NULL;
+   job->done = 0;
+
+   prefetch->num_jobs++;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// has_prefetch_job
+// Checks if a bitmap was already added to the prefetcher
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+// param filename: name of file to load
+// param table: palette look-up table to convert it with
+// param auto_lines: palette lines to generate (0 to use the table)
+// return: non-zero if it was added, zero otherwise
+//***************************************************************************
+
+int has_prefetch_job(const Prefetcher *prefetch, const char *filename,
+const uint8_t *table, unsigned auto_lines) {
+   for (size_t i = 0; i < prefetch->num_jobs; i++) {
+      if (prefetch->jobs[i].table == table &&
+      prefetch->jobs[i].auto_lines == auto_lines &&
+      !strcmp(prefetch->jobs[i].filename, filename))
+         return 1;
+   }
+   return 0;
+}
+
+//***************************************************************************
+// start_prefetcher
+// Starts the threads that load the bitmaps. If no thread can be started,
+// take_prefetched_bitmap will just tell that it doesn't have the bitmaps
+// (so they get loaded the usual way).
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+// param threads: how many threads to use
+//***************************************************************************
+
+void start_prefetcher(Prefetcher *prefetch, int threads) {
+   // No point in having more threads than bitmaps
+   if ((size_t) threads > prefetch->num_jobs)
+      threads = (int) prefetch->num_jobs;
+   if (threads < 1)
+      return;
+
+   prefetch->threads = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+   if (prefetch->threads == NULL)
+      return;
+
+   pthread_mutex_init(&prefetch->lock, NULL);
+   pthread_cond_init(&prefetch->cond, NULL);
+   prefetch->ahead = threads * AHEAD_PER_THREAD;
+
+   // Start the threads (if one fails to start, we just make do with the
+   // ones we already have)
+   for (int i = 0; i < threads; i++) {
+      if (pthread_create(&prefetch->threads[i], NULL, run_prefetch, prefetch))
+         break;
+      prefetch->num_threads++;
+   }
+
+   // Couldn't start anything?
+   if (prefetch->num_threads == 0) {
+      pthread_cond_destroy(&prefetch->cond);
+      pthread_mutex_destroy(&prefetch->lock);
+      free(prefetch->threads);
+      prefetch->threads = NULL;
+   }
+}
+
+//***************************************************************************
+// take_prefetched_bitmap
+// Retrieves a bitmap loaded by the prefetcher, waiting for it if it isn't
+// ready yet. The caller takes ownership of the bitmap.
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+// param line: line of the "input" command
+// param filename: name of the file the batch wants to load
+// param bitmap: where to store the bitmap (NULL if it failed to load)
+// return: non-zero if the bitmap was prefetched, zero otherwise
+//***************************************************************************
+
+int take_prefetched_bitmap(Prefetcher *prefetch, size_t line,
+const char *filename, Bitmap **bitmap) {
+   // Not running?
+   if (prefetch->num_threads == 0)
+      return 0;
+
+   pthread_mutex_lock(&prefetch->lock);
+
+   // Skip over any bitmaps the batch didn't end up using
+   while (prefetch->next_take < prefetch->num_jobs &&
+   prefetch->jobs[prefetch->next_take].line < line)
+      prefetch->next_take++;
+
+   // Not one of ours? (or we guessed the wrong file, which can happen if
+   // the batch has errors and stops changing the base directory)
+   if (prefetch->next_take == prefetch->num_jobs ||
+   prefetch->jobs[prefetch->next_take].line != line ||
+   strcmp(prefetch->jobs[prefetch->next_take].filename, filename)) {
+      pthread_cond_broadcast(&prefetch->cond);
+      pthread_mutex_unlock(&prefetch->lock);
+      return 0;
+   }
+
+   // Wait until it's loaded
+   PrefetchJob *job = &prefetch->jobs[prefetch->next_take];
+   while (!job->done)
+      pthread_cond_wait(&prefetch->cond, &prefetch->lock);
+
+   // Hand it over and let the threads load more
+   *bitmap = job->bitmap;
+   job->bitmap = NULL;
+   prefetch->next_take++;
+
+   pthread_cond_broadcast(&prefetch->cond);
+   pthread_mutex_unlock(&prefetch->lock);
+   return 1;
+}
+
+//***************************************************************************
+// free_prefetcher
+// Stops the threads and gets rid of everything in the prefetcher (including
+// any bitmaps that weren't taken)
+//---------------------------------------------------------------------------
+// param prefetch: pointer to prefetcher
+//***************************************************************************
+
+void free_prefetcher(Prefetcher *prefetch) {
+   // Tell all threads to stop and wait for them
+   if (prefetch->num_threads > 0) {
+      pthread_mutex_lock(&prefetch->lock);
+      prefetch->quit = 1;
+      pthread_cond_broadcast(&prefetch->cond);
+      pthread_mutex_unlock(&prefetch->lock);
+
+      for (int i = 0; i < prefetch->num_threads; i++)
+         pthread_join(prefetch->threads[i], NULL);
+
+      pthread_cond_destroy(&prefetch->cond);
+      pthread_mutex_destroy(&prefetch->lock);
+   }
+   free(prefetch->threads);
+
+   // Get rid of the jobs
+   for (size_t i = 0; i < prefetch->num_jobs; i++) {
+      if (prefetch->jobs[i].bitmap != NULL)
+         destroy_bitmap(prefetch->jobs[i].bitmap);
+      free(prefetch->jobs[i].filename);
+   }
+   free(prefetch->jobs);
+
+   // Get rid of the look-up tables
+   for (size_t i = 0; i < prefetch->num_tables; i++)
+      free(prefetch->tables[i]);
+   free(prefetch->tables);
+
+   init_prefetcher(prefetch);
+}
+
+//***************************************************************************
+// run_prefetch [internal]
+// Loop run by each thread, loads bitmaps in order until there aren't any
+// left (or until it's told to stop)
+//---------------------------------------------------------------------------
+// param ptr: pointer to prefetcher
+// return: NULL
+//***************************************************************************
+
+static void *run_prefetch(void *ptr) {
+   Prefetcher *prefetch = (Prefetcher *) ptr;
+   pthread_mutex_lock(&prefetch->lock);
+
+   for (;;) {
+      // Wait until there's a bitmap we can load (we don't go too far ahead
+      // of the batch)
+      while (!prefetch->quit && prefetch->next_job < prefetch->num_jobs &&
+      prefetch->next_job >= prefetch->next_take + prefetch->ahead)
+         pthread_cond_wait(&prefetch->cond, &prefetch->lock);
+
+      // Nothing else to do?
+      if (prefetch->quit || prefetch->next_job == prefetch->num_jobs)
+         break;
+
+      // Load the bitmap (without holding the lock, that's the whole point)
+      PrefetchJob *job = &prefetch->jobs[prefetch->next_job++];
+      pthread_mutex_unlock(&prefetch->lock);
+      Bitmap *bitmap = decode_bitmap(job->filename, job->table,
+         job->auto_lines);
+      pthread_mutex_lock(&prefetch->lock);
+
+      // Let the batch know it's ready
+      job->bitmap = bitmap;
+      job->done = 1;
+      pthread_cond_broadcast(&prefetch->cond);
+   }
+
+   pthread_mutex_unlock(&prefetch->lock);
+   return NULL;
+}
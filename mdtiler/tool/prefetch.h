@@ -0,0 +1,71 @@
+//***************************************************************************
+// "prefetch.h"
+// Header file for "prefetch.c"
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "bitmap.h"
+
+// A bitmap to load ahead of time
+typedef struct {
+   size_t line;               // Line of the "input" command
+   char *filename;            // Name of the file to load
+   const uint8_t *table;      // Palette look-up table to convert it with
+   unsigned auto_lines;       // Palette lines to generate (0 = use table)
+   Bitmap *bitmap;            // Loaded bitmap (NULL on failure)
+   int done;                  // Set once it's been loaded
+} PrefetchJob;
+
+// Loads bitmaps on other threads while the batch is being processed
+typedef struct {
+   PrefetchJob *jobs;         // List of bitmaps to load
+   size_t num_jobs;           // Number of bitmaps to load
+   size_t next_job;           // Next bitmap to be loaded by a thread
+   size_t next_take;          // Next bitmap to be taken by the batch
+
+   uint8_t **tables;          // Palette look-up tables used by the jobs
+   size_t num_tables;         // Number of look-up tables
+
+   pthread_t *threads;        // Threads doing the loading
+   int num_threads;           // Number of threads started
+   int ahead;                 // How many bitmaps can be kept loaded
+   int quit;                  // Set to tell threads to stop
+   pthread_mutex_t lock;      // Lock for everything above
+   pthread_cond_t cond;       // Signaled whenever something changes
+} Prefetcher;
+
+// Function prototypes
+void init_prefetcher(Prefetcher *);
+uint8_t *add_prefetch_table(Prefetcher *, const uint16_t *);
+int add_prefetch_job(Prefetcher *, size_t, const char *, const uint8_t *,
+   unsigned);
+int has_prefetch_job(const Prefetcher *, const char *, const uint8_t *,
+   unsigned);
+void start_prefetcher(Prefetcher *, int);
+int take_prefetched_bitmap(Prefetcher *, size_t, const char *, Bitmap **);
+void free_prefetcher(Prefetcher *);
+
+#endif
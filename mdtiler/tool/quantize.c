@@ -0,0 +1,571 @@
+//***************************************************************************
+// "quantize.c"
+// Generates palettes for true color bitmaps ("palette auto")
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "palette.h"
+#include "quantize.h"
+
+// How many times tiles can be moved around between palette lines
+#define MAX_PASSES 16
+
+// Colors used by a tile (pixels outside the bitmap don't count)
+typedef struct {
+   uint16_t colors[64];       // Each color (BGR 5.5.5)
+   uint8_t counts[64];        // How many pixels use each color
+   unsigned num_colors;       // Number of different colors
+   unsigned line;             // Palette line the tile uses
+} TileColors;
+
+// A palette line being generated
+typedef struct {
+   uint16_t colors[16];       // Each color (Mega Drive format)
+   uint16_t expanded[16];     // Each color (BGR 5.5.5)
+   uint8_t *table;            // Nearest color for each BGR 5.5.5 value
+   size_t num_tiles;          // How many tiles use this line
+} PalLine;
+
+// A color and how many pixels use it
+typedef struct {
+   uint16_t color;            // Color (BGR 5.5.5)
+   uint32_t count;            // Number of pixels
+} ColorCount;
+
+// Everything used while generating the palette
+typedef struct {
+   TileColors *tiles;         // Colors used by each tile
+   size_t num_tiles;          // Number of tiles
+   uint32_t *counts;          // Scratch counters (one per BGR 5.5.5 value)
+   ColorCount *list;          // Colors found by pool_colors
+   uint16_t background;       // Background color (Mega Drive format)
+   PalLine lines[MAX_PAL_LINES]; // Palette lines
+   unsigned num_lines;        // Number of palette lines so far
+} Quantizer;
+
+// Function prototypes
+static void count_tiles(Quantizer *, const uint16_t *, int, int);
+static size_t pool_colors(Quantizer *, int);
+static void build_line(Quantizer *, unsigned);
+static unsigned cut_colors(ColorCount *, size_t, uint16_t *, unsigned);
+static int assign_tiles(Quantizer *);
+static uint32_t get_tile_error(const TileColors *, const PalLine *);
+static uint16_t snap_color(unsigned, unsigned, unsigned);
+static uint16_t expand_color(uint16_t);
+static int compare_red(const void *, const void *);
+static int compare_green(const void *, const void *);
+static int compare_blue(const void *, const void *);
+
+//***************************************************************************
+// quantize_bitmap
+// Generates up to the given number of palette lines for a true color bitmap
+// and converts it to use them. Each 8×8 tile (as aligned to the top-left
+// corner) gets whichever line suits it best. Color 0 of every line is the
+// most common color in the bitmap, so it's meant to be the background color.
+//---------------------------------------------------------------------------
+// param pixels: pixels of the bitmap (BGR 5.5.5)
+// param width: width in pixels
+// param height: height in pixels
+// param max_lines: how many palette lines can be used (1 to MAX_PAL_LINES)
+// param out: where to store the converted pixels (line in the upper four
+//            bits, color in the lower four bits)
+// param palette: where to store the palette (16 entries per line)
+// return: number of palette lines used (0 if out of memory)
+//***************************************************************************
+
+unsigned quantize_bitmap(const uint16_t *pixels, int width, int height,
+unsigned max_lines, uint8_t *out, uint16_t *palette) {
+   Quantizer q;
+   int tiles_wide = (width + 7) >> 3;
+   int tiles_high = (height + 7) >> 3;
+   q.num_tiles = (size_t) tiles_wide * tiles_high;
+   q.num_lines = 0;
+
+   // Allocate everything we need
+   q.tiles = (TileColors *) malloc(sizeof(TileColors) * q.num_tiles);
+   q.counts = (uint32_t *) calloc(PALTABLE_SIZE, sizeof(uint32_t));
+   q.list = (ColorCount *) malloc(sizeof(ColorCount) * PALTABLE_SIZE);
+   int failed = q.tiles == NULL || q.counts == NULL || q.list == NULL;
+   for (unsigned i = 0; i < max_lines; i++) {
+      q.lines[i].table = (uint8_t *) malloc(PALTABLE_SIZE);
+      if (q.lines[i].table == NULL) failed = 1;
+   }
+   if (failed) {
+      for (unsigned i = 0; i < max_lines; i++)
+         free(q.lines[i].table);
+      free(q.tiles);
+      free(q.counts);
+      free(q.list);
+      return 0;
+   }
+
+   // Find out which colors each tile uses
+   count_tiles(&q, pixels, width, height);
+
+   // The most common color becomes the background color
+   size_t num_colors = pool_colors(&q, 0);
+   size_t most_common = 0;
+   for (size_t i = 1; i < num_colors; i++) {
+      if (q.list[i].count > q.list[most_common].count)
+         most_common = i;
+   }
+   uint16_t color = q.list[most_common].color;
+   q.background = snap_color(color & 0x1F, color >> 5 & 0x1F, color >> 10);
+
+   // The first line is made from the whole bitmap, then each line after
+   // that starts from whichever tile is the worst fit so far (if there are
+   // any tiles that don't fit perfectly yet)
+   build_line(&q, 0);
+   q.num_lines = 1;
+
+   while (q.num_lines < max_lines) {
+      size_t worst = 0;
+      uint32_t worst_error = 0;
+      for (size_t i = 0; i < q.num_tiles; i++) {
+         uint32_t error = UINT32_MAX;
+         for (unsigned line = 0; line < q.num_lines; line++) {
+            uint32_t temp = get_tile_error(&q.tiles[i], &q.lines[line]);
+            if (error > temp) error = temp;
+         }
+         if (error > worst_error) {
+            worst = i;
+            worst_error = error;
+         }
+      }
+      if (worst_error == 0)
+         break;
+
+      q.tiles[worst].line = q.num_lines;
+      build_line(&q, q.num_lines);
+      q.num_lines++;
+   }
+
+   // Move every tile to the line that suits it best, then make every line
+   // suit its tiles better, until it stops getting better
+   for (unsigned pass = 0; ; pass++) {
+      if (!assign_tiles(&q) || pass == MAX_PASSES)
+         break;
+      for (unsigned line = 0; line < q.num_lines; line++)
+         build_line(&q, line);
+   }
+
+   // Store the lines that ended up being used
+   unsigned remap[MAX_PAL_LINES];
+   unsigned used_lines = 0;
+   for (unsigned line = 0; line < q.num_lines; line++) {
+      if (q.lines[line].num_tiles == 0)
+         continue;
+      memcpy(&palette[used_lines << 4], q.lines[line].colors,
+         sizeof(q.lines[line].colors));
+      remap[line] = used_lines++;
+   }
+
+   // Convert every pixel
+   for (int y = 0; y < height; y++) {
+      const TileColors *tile_row = &q.tiles[(size_t)(y >> 3) * tiles_wide];
+      for (int x = 0; x < width; x++) {
+         unsigned line = tile_row[x >> 3].line;
+         *out++ = remap[line] << 4 | q.lines[line].table[*pixels++];
+      }
+   }
+
+   // Done with everything
+   for (unsigned i = 0; i < max_lines; i++)
+      free(q.lines[i].table);
+   free(q.tiles);
+   free(q.counts);
+   free(q.list);
+   return used_lines;
+}
+
+//***************************************************************************
+// count_tiles [internal]
+// Finds out which colors are used by each tile (and by how many pixels).
+// All tiles start out using the first palette line.
+//---------------------------------------------------------------------------
+// param q: pointer to quantizer
+// param pixels: pixels of the bitmap (BGR 5.5.5)
+// param width: width in pixels
+// param height: height in pixels
+//***************************************************************************
+
+static void count_tiles(Quantizer *q, const uint16_t *pixels,
+int width, int height) {
+   TileColors *tile = q->tiles;
+
+   for (int base_y = 0; base_y < height; base_y += 8)
+   for (int base_x = 0; base_x < width; base_x += 8) {
+      tile->num_colors = 0;
+      tile->line = 0;
+
+      int limit_x = width - base_x < 8 ? width - base_x : 8;
+      int limit_y = height - base_y < 8 ? height - base_y : 8;
+
+      // The counters hold where each color is in the tile's list (plus one)
+      for (int y = 0; y < limit_y; y++) {
+         const uint16_t *src = &pixels[(size_t)(base_y + y) * width + base_x];
+         for (int x = 0; x < limit_x; x++) {
+            uint16_t color = src[x];
+            uint32_t slot = q->counts[color];
+            if (slot == 0) {
+               slot = ++tile->num_colors;
+               q->counts[color] = slot;
+               tile->colors[slot - 1] = color;
+               tile->counts[slot - 1] = 0;
+            }
+            tile->counts[slot - 1]++;
+         }
+      }
+
+      // Leave the counters clear for the next tile
+      for (unsigned i = 0; i < tile->num_colors; i++)
+         q->counts[tile->colors[i]] = 0;
+
+      tile++;
+   }
+}
+
+//***************************************************************************
+// pool_colors [internal]
+// Makes a list of all the colors used by the tiles using a palette line
+//---------------------------------------------------------------------------
+// param q: pointer to quantizer (list goes in q->list)
+// param line: palette line to look for
+// return: number of colors in the list
+//***************************************************************************
+
+static size_t pool_colors(Quantizer *q, int line) {
+   size_t num_colors = 0;
+
+   for (size_t i = 0; i < q->num_tiles; i++) {
+      const TileColors *tile = &q->tiles[i];
+      if (tile->line != (unsigned) line)
+         continue;
+
+      for (unsigned j = 0; j < tile->num_colors; j++) {
+         uint16_t color = tile->colors[j];
+         if (q->counts[color] == 0)
+            q->list[num_colors++].color = color;
+         q->counts[color] += tile->counts[j];
+      }
+   }
+
+   // Fill in the totals (and leave the counters clear for next time)
+   for (size_t i = 0; i < num_colors; i++) {
+      uint16_t color = q->list[i].color;
+      q->list[i].count = q->counts[color];
+      q->counts[color] = 0;
+   }
+
+   return num_colors;
+}
+
+//***************************************************************************
+// build_line [internal]
+// Generates the colors of a palette line from the tiles using it. Color 0
+// is always the background color, and the rest are picked by median cut
+// (any unused colors are filled with the background color too, though
+// pixels never get mapped to them).
+//---------------------------------------------------------------------------
+// param q: pointer to quantizer
+// param line: palette line to generate
+//***************************************************************************
+
+static void build_line(Quantizer *q, unsigned line) {
+   PalLine *ptr = &q->lines[line];
+
+   // Get the colors used by this line, merging together the ones that
+   // round to the same Mega Drive color (so they don't end up taking up
+   // multiple entries) and leaving out the ones that would become the
+   // background color (since it already has its own entry)
+   size_t num_colors = pool_colors(q, line);
+   size_t num_left = 0;
+   for (size_t i = 0; i < num_colors; i++) {
+      uint16_t color = q->list[i].color;
+      uint32_t count = q->list[i].count;
+
+      uint16_t snapped = snap_color(color & 0x1F, color >> 5 & 0x1F,
+         color >> 10);
+      if (snapped == q->background)
+         continue;
+
+      color = expand_color(snapped);
+      if (q->counts[color] == 0) {
+         q->list[num_left].color = color;
+         q->list[num_left].count = 0;
+         q->counts[color] = ++num_left;
+      }
+      q->list[q->counts[color] - 1].count += count;
+   }
+   for (size_t i = 0; i < num_left; i++)
+      q->counts[q->list[i].color] = 0;
+
+   // Pick the colors
+   ptr->colors[0] = q->background;
+   unsigned num_picked = cut_colors(q->list, num_left, &ptr->colors[1], 15);
+   for (unsigned i = num_picked + 1; i < 16; i++)
+      ptr->colors[i] = q->background;
+
+   // Get the look-up table ready to find the nearest colors
+   for (unsigned i = 0; i < 16; i++)
+      ptr->expanded[i] = expand_color(ptr->colors[i]);
+   make_palette_table(ptr->colors, ptr->table);
+
+   // On ties the table picks the last entry, so pixels closest to the
+   // background could end up using one of the unused entries instead and
+   // be opaque on sprites. Make sure they all use color 0.
+   for (unsigned i = 0; i < PALTABLE_SIZE; i++) {
+      if (ptr->colors[ptr->table[i]] == q->background)
+         ptr->table[i] = 0;
+   }
+}
+
+//***************************************************************************
+// cut_colors [internal]
+// Reduces a list of colors using median cut: the colors are split into
+// boxes, and the box with the largest range in any component gets split in
+// half (by pixel count) along that component until there are enough boxes.
+// Each box then becomes the average of its colors (snapped to the colors
+// the Mega Drive can show).
+//---------------------------------------------------------------------------
+// param list: list of colors (gets reordered)
+// param num_colors: number of colors in the list
+// param out: where to store the picked colors (Mega Drive format)
+// param max_colors: maximum number of colors to pick (up to 16)
+// return: number of colors picked
+//***************************************************************************
+
+static unsigned cut_colors(ColorCount *list, size_t num_colors,
+uint16_t *out, unsigned max_colors) {
+   static int (* const compare[])(const void *, const void *) = {
+      compare_red, compare_green, compare_blue
+   };
+
+   if (num_colors == 0)
+      return 0;
+
+   // Start with all colors in the same box
+   size_t start[16];
+   size_t end[16];
+   unsigned num_boxes = 1;
+   start[0] = 0;
+   end[0] = num_colors;
+
+   while (num_boxes < max_colors) {
+      // Look for the box to split
+      unsigned best_box = 0;
+      unsigned best_component = 0;
+      unsigned best_range = 0;
+
+      for (unsigned box = 0; box < num_boxes; box++) {
+         unsigned min[3] = { 0x1F, 0x1F, 0x1F };
+         unsigned max[3] = { 0x00, 0x00, 0x00 };
+         for (size_t i = start[box]; i < end[box]; i++) {
+            for (unsigned c = 0; c < 3; c++) {
+               unsigned value = list[i].color >> (c * 5) & 0x1F;
+               if (min[c] > value) min[c] = value;
+               if (max[c] < value) max[c] = value;
+            }
+         }
+         for (unsigned c = 0; c < 3; c++) {
+            if (end[box] - start[box] >= 2 && max[c] - min[c] > best_range) {
+               best_box = box;
+               best_component = c;
+               best_range = max[c] - min[c];
+            }
+         }
+      }
+
+      // Nothing left that can be split?
+      if (best_range == 0)
+         break;
+
+      // Sort the box along that component and split it where half of its
+      // pixels are on each side
+      size_t first = start[best_box];
+      size_t last = end[best_box];
+      qsort(&list[first], last - first, sizeof(ColorCount),
+         compare[best_component]);
+
+      uint64_t total = 0;
+      for (size_t i = first; i < last; i++)
+         total += list[i].count;
+
+      size_t split = last - 1;
+      uint64_t sum = 0;
+      for (size_t i = first; i < last - 1; i++) {
+         sum += list[i].count;
+         if (sum * 2 >= total) {
+            split = i + 1;
+            break;
+         }
+      }
+
+      end[best_box] = split;
+      start[num_boxes] = split;
+      end[num_boxes] = last;
+      num_boxes++;
+   }
+
+   // Average every box
+   for (unsigned box = 0; box < num_boxes; box++) {
+      uint64_t total = 0;
+      uint64_t sum[3] = { 0, 0, 0 };
+      for (size_t i = start[box]; i < end[box]; i++) {
+         total += list[i].count;
+         for (unsigned c = 0; c < 3; c++)
+            sum[c] += (uint64_t)(list[i].color >> (c * 5) & 0x1F) *
+                      list[i].count;
+      }
+
+      out[box] = snap_color((sum[0] + total / 2) / total,
+                            (sum[1] + total / 2) / total,
+                            (sum[2] + total / 2) / total);
+   }
+
+   return num_boxes;
+}
+
+//***************************************************************************
+// assign_tiles [internal]
+// Moves every tile to whichever palette line suits it best
+//---------------------------------------------------------------------------
+// param q: pointer to quantizer
+// return: non-zero if any tile was moved
+//***************************************************************************
+
+static int assign_tiles(Quantizer *q) {
+   int changed = 0;
+
+   for (unsigned line = 0; line < q->num_lines; line++)
+      q->lines[line].num_tiles = 0;
+
+   for (size_t i = 0; i < q->num_tiles; i++) {
+      TileColors *tile = &q->tiles[i];
+
+      unsigned best = 0;
+      uint32_t best_error = UINT32_MAX;
+      for (unsigned line = 0; line < q->num_lines; line++) {
+         uint32_t error = get_tile_error(tile, &q->lines[line]);
+         if (error < best_error) {
+            best = line;
+            best_error = error;
+         }
+      }
+
+      if (tile->line != best) {
+         tile->line = best;
+         changed = 1;
+      }
+      q->lines[best].num_tiles++;
+   }
+
+   return changed;
+}
+
+//***************************************************************************
+// get_tile_error [internal]
+// Tells how badly a palette line fits a tile
+//---------------------------------------------------------------------------
+// param tile: pointer to tile
+// param line: pointer to palette line
+// return: sum of the distance from every pixel to its nearest color
+//***************************************************************************
+
+static uint32_t get_tile_error(const TileColors *tile, const PalLine *line) {
+   uint32_t error = 0;
+
+   for (unsigned i = 0; i < tile->num_colors; i++) {
+      uint16_t color = tile->colors[i];
+      uint16_t nearest = line->expanded[line->table[color]];
+
+      unsigned diff = 0;
+      for (unsigned c = 0; c < 15; c += 5)
+         diff += abs((color >> c & 0x1F) - (nearest >> c & 0x1F));
+      error += diff * tile->counts[i];
+   }
+
+   return error;
+}
+
+//***************************************************************************
+// snap_color [internal]
+// Rounds a color to the nearest one the Mega Drive can show (nearest as in
+// what make_palette_table would pick, see expand_color)
+//---------------------------------------------------------------------------
+// param r: red component (0 to 31)
+// param g: green component (0 to 31)
+// param b: blue component (0 to 31)
+// return: color (Mega Drive format)
+//***************************************************************************
+
+static uint16_t snap_color(unsigned r, unsigned g, unsigned b) {
+   r = r >= 0x1A ? 7 : (r + 2) >> 2;
+   g = g >= 0x1A ? 7 : (g + 2) >> 2;
+   b = b >= 0x1A ? 7 : (b + 2) >> 2;
+   return b << 9 | g << 5 | r << 1;
+}
+
+//***************************************************************************
+// expand_color [internal]
+// Converts a Mega Drive color into BGR 5.5.5 (the same way as
+// make_palette_table does)
+//---------------------------------------------------------------------------
+// param color: color (Mega Drive format)
+// return: color (BGR 5.5.5)
+//***************************************************************************
+
+static uint16_t expand_color(uint16_t color) {
+   uint16_t b = color >> 9 & 0x07;
+   uint16_t g = color >> 5 & 0x07;
+   uint16_t r = color >> 1 & 0x07;
+   b = b << 2 | b >> 3;
+   g = g << 2 | g >> 3;
+   r = r << 2 | r >> 3;
+   return b << 10 | g << 5 | r;
+}
+
+//***************************************************************************
+// compare_red, compare_green, compare_blue [internal]
+// Callbacks for qsort to sort colors along each component
+//---------------------------------------------------------------------------
+// param a: pointer to first ColorCount
+// param b: pointer to second ColorCount
+// return: <0 if a goes first, >0 if b goes first, 0 if same
+//***************************************************************************
+
+static int compare_red(const void *a, const void *b) {
+   return (((const ColorCount *) a)->color & 0x1F) -
+          (((const ColorCount *) b)->color & 0x1F);
+}
+
+static int compare_green(const void *a, const void *b) {
+   return (((const ColorCount *) a)->color >> 5 & 0x1F) -
+          (((const ColorCount *) b)->color >> 5 & 0x1F);
+}
+
+static int compare_blue(const void *a, const void *b) {
+   return (((const ColorCount *) a)->color >> 10 & 0x1F) -
+          (((const ColorCount *) b)->color >> 10 & 0x1F);
+}
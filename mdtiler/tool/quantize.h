@@ -0,0 +1,33 @@
+//***************************************************************************
+// "quantize.h"
+// Header file for "quantize.c"
+//***************************************************************************
+// mdtiler - Bitmap to tile conversion tool
+//
+// This file is part of mdtiler.
+//
+// mdtiler is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// mdtiler is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with mdtiler.  If not, see <http://www.gnu.org/licenses/>.
+//***************************************************************************
+
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+// Required headers
+#include <stdint.h>
+
+// Function prototypes
+unsigned quantize_bitmap(const uint16_t *, int, int, unsigned, uint8_t *,
+   uint16_t *);
+
+#endif
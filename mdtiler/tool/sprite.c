@@ -24,8 +24,10 @@
 // Required headers
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "main.h"
 #include "offset.h"
+#include "pool.h"
 #include "sprite.h"
 #include "tiles.h"
 
@@ -36,6 +38,19 @@ static size_t sprite_offset = 0;
 static int origin_x = 0;
 static int origin_y = 0;
 
+// Tiles written for sprites so far (used to find repeated tiles when there
+// isn't a tile pool shared by the batch). The first tile in the pool has
+// the tile ID in pool_base, and it's only valid for the format it was made
+// with (the tiles are masked depending on it).
+static TilePool sprite_pool;
+static uint16_t pool_base;
+static Format pool_format;
+static int pool_ready = 0;
+
+// Function prototypes
+static int find_sprite_run(const TilePool *, const uint32_t [][4][8],
+   int, int);
+
 //***************************************************************************
 // set_sprite_origin
 // Takes care of the "origin" command in mdtiler. Changes the origin for
@@ -51,6 +66,33 @@ void set_sprite_origin(int x, int y)
    origin_y = y;
 }
 
+//***************************************************************************
+// get_sprite_origin
+// Retrieves the current origin for sprite mappings
+//---------------------------------------------------------------------------
+// param x: where to store X coordinate of origin
+// param y: where to store Y coordinate of origin
+//***************************************************************************
+
+void get_sprite_origin(int *x, int *y)
+{
+   *x = origin_x;
+   *y = origin_y;
+}
+
+//***************************************************************************
+// is_sprite_pending
+// Checks if there's a sprite mapping in progress that wrote new tiles
+// (i.e. "sprite end" would change the offset)
+//---------------------------------------------------------------------------
+// return: non-zero if pending, zero otherwise
+//***************************************************************************
+
+int is_sprite_pending(void)
+{
+   return sprite_offset != 0;
+}
+
 //***************************************************************************
 // generate_sprite
 // Takes care of the "sprite" command in mdtiler. Generates the sprite
@@ -84,12 +126,64 @@ int x, int y, int width, int height)
    uint16_t sprite_y = temp_y;
 
    // Determine how many tiles the sprite takes up
-   // For now we always insert new sprites (no deduplication attempted)
    size_t num_tiles = width * height;
 
+   // Get every tile in the sprite (in the order they're stored)
+   uint32_t run[16][4][8];
+   for (int tx = 0; tx < width; tx++)
+   for (int ty = 0; ty < height; ty++) {
+      Tile tile;
+      get_tile(in, &tile, x + (tx << 3), y + (ty << 3));
+      get_tile_flips(&tile, run[tx * height + ty]);
+   }
+
+   // Where we look for repeated tiles. If there's a pool shared by the
+   // batch we use that one, otherwise we use our own pool with the tiles
+   // that were written for sprites that can still be referenced by the
+   // current one.
+   TilePool *pool = get_shared_pool();
+   uint16_t base;
+
+   if (pool == NULL) {
+      // We can only reuse tiles if all the tiles written to the pool are
+      // still right before the current tile ID (i.e. nothing changed the
+      // offset or format in the meanwhile, and there's room for all IDs),
+      // otherwise we have to start over from here
+      uint16_t next_id = get_map_offset() + sprite_offset;
+      if (!pool_ready || pool_format != get_output_format() ||
+      next_id != pool_base + sprite_pool.num_tiles ||
+      sprite_pool.num_tiles + num_tiles > POOL_MAX_TILES) {
+         free_pool(&sprite_pool);
+         pool_base = next_id;
+         pool_format = get_output_format();
+         pool_ready = 1;
+      }
+
+      pool = &sprite_pool;
+      base = pool_base;
+   } else {
+      base = get_map_offset();
+   }
+
    // Determine tile ID
-   uint16_t tile_id = sprite_offset + get_map_offset();
-   sprite_offset += num_tiles;
+   // Look if the same tiles were already written (sprites need consecutive
+   // tiles, so the whole sprite has to match, though it can be flipped).
+   uint16_t tile_id;
+   unsigned first_tile = pool->num_tiles;
+   int match = find_sprite_run(pool, run, width, height);
+
+   if (match != -1) {
+      tile_id = base + match;
+      pool->saved += num_tiles;
+   } else {
+      for (size_t i = 0; i < num_tiles; i++) {
+         int errcode = add_pool_tile(pool, run[i]);
+         if (errcode) return errcode;
+      }
+      tile_id = base + first_tile;
+      if (pool == &sprite_pool)
+         sprite_offset += num_tiles;
+   }
 
    // Sprite size
    uint8_t size = (width - 1) * 4 + (height - 1);
@@ -105,8 +199,11 @@ int x, int y, int width, int height)
       return ERR_CANTWRITESPR;
    }
 
-   // Write sprite tiles
-   return write_sprite(in, outgfx, x, y, width, height);
+   // Write sprite tiles (unless they were already there)
+   if (match != -1)
+      return ERR_NONE;
+   else
+      return write_pool_tiles(pool, outgfx, first_tile);
 }
 
 //***************************************************************************
@@ -134,3 +231,56 @@ int generate_sprite_end(FILE *outmap)
    // No error :)
    return ERR_NONE;
 }
+
+//***************************************************************************
+// reset_sprite_pool
+// Forgets all the tiles written for sprites so far (so following sprites
+// won't try to reuse them). Used when the output file changes.
+//***************************************************************************
+
+void reset_sprite_pool(void)
+{
+   free_pool(&sprite_pool);
+   pool_ready = 0;
+}
+
+//***************************************************************************
+// find_sprite_run [internal]
+// Looks for a sprite's tiles in a pool, also trying every way the sprite
+// can be flipped. Note that flipping a sprite flips each tile *and* the
+// order of its columns and/or rows.
+//---------------------------------------------------------------------------
+// param pool: pointer to pool
+// param run: every way each tile can be flipped, in sprite order
+// param width: width in tiles
+// param height: height in tiles
+// return: index of first tile + flip flags (same as VDP), or -1 if none
+//***************************************************************************
+
+static int find_sprite_run(const TilePool *pool, const uint32_t run[][4][8],
+int width, int height)
+{
+   for (unsigned flip = 0; flip < 4; flip++) {
+      // Make the run as it would be stored for the sprite to show up like
+      // this with the given flip (the ways each tile can be flipped end up
+      // swapped around, the one that goes first is the one to look for)
+      uint32_t flipped[16][4][8];
+      for (int tx = 0; tx < width; tx++)
+      for (int ty = 0; ty < height; ty++) {
+         int sx = (flip & 1) ? width - 1 - tx : tx;
+         int sy = (flip & 2) ? height - 1 - ty : ty;
+         for (unsigned i = 0; i < 4; i++) {
+            memcpy(flipped[sx * height + sy][i],
+               run[tx * height + ty][i ^ flip],
+               sizeof(flipped[0][0]));
+         }
+      }
+
+      int match = find_pool_run(pool, flipped, width * height);
+      if (match != -1)
+         return match | flip << 11;
+   }
+
+   // Nope, not there
+   return -1;
+}
@@ -30,7 +30,10 @@
 
 // Function prototypes
 void set_sprite_origin(int, int);
+void get_sprite_origin(int *, int *);
+int is_sprite_pending(void);
 int generate_sprite(const Bitmap *, FILE *, FILE *, int, int, int, int);
 int generate_sprite_end(FILE *);
+void reset_sprite_pool(void);
 
 #endif
@@ -29,12 +29,61 @@
 #include "palette.h"
 #include "tiles.h"
 
+// How many bytes of tiles are gathered before writing them to the file
+#define TILE_BUFFER_SIZE 0x2000
+
+// Where tiles are gathered before writing them
+typedef struct {
+   FILE *file;                         // Output file
+   size_t size;                        // Bytes waiting to be written
+   uint8_t data[TILE_BUFFER_SIZE];     // Tile data
+} TileBuffer;
+
 // Prototype for functions used to fetch tiles
-typedef int TileFunc(const Bitmap *, FILE *, int, int);
+typedef int TileFunc(const Bitmap *, TileBuffer *, int, int);
 
 // Current tile output format
 static Format format = FORMAT_4BPP;
 
+// Function prototypes
+static void fetch_tile_rows(const Bitmap *, uint64_t *, int, int);
+static uint8_t *reserve_tile(TileBuffer *, size_t, int *);
+static int flush_tiles(TileBuffer *);
+
+//***************************************************************************
+// pack_row [internal]
+// Takes a row of pixels (one per byte, leftmost in the highest byte) and
+// packs them into 4bpp (leftmost in the highest nibble). The whole row is
+// done at once, merging pairs of pixels, then pairs of those, etc.
+//---------------------------------------------------------------------------
+// param row: row of pixels
+// return: packed row
+//***************************************************************************
+
+static inline uint32_t pack_row(uint64_t row) {
+   row &= UINT64_C(0x0F0F0F0F0F0F0F0F);
+   row = (row >> 4 | row) & UINT64_C(0x00FF00FF00FF00FF);
+   row = (row >> 8 | row) & UINT64_C(0x0000FFFF0000FFFF);
+   return (uint32_t)(row >> 16 | row);
+}
+
+//***************************************************************************
+// mirror_row [internal]
+// Flips a row of pixels horizontally
+//---------------------------------------------------------------------------
+// param row: row of pixels (one per byte)
+// return: flipped row
+//***************************************************************************
+
+static inline uint64_t mirror_row(uint64_t row) {
+   row = row >> 32 | row << 32;
+   row = (row >> 16 & UINT64_C(0x0000FFFF0000FFFF)) |
+         (row & UINT64_C(0x0000FFFF0000FFFF)) << 16;
+   row = (row >> 8 & UINT64_C(0x00FF00FF00FF00FF)) |
+         (row & UINT64_C(0x00FF00FF00FF00FF)) << 8;
+   return row;
+}
+
 //***************************************************************************
 // get_tile
 // Retrieves the contents of a tile. Format is always 4bpp.
@@ -46,31 +95,26 @@ static Format format = FORMAT_4BPP;
 //***************************************************************************
 
 void get_tile(const Bitmap *in, Tile *out, int bx, int by) {
+   // Retrieve all the pixels in the tile
+   uint64_t rows[8];
+   fetch_tile_rows(in, rows, bx, by);
+
    // To keep track of the flags (palette and priority)
-   uint8_t flags = 0;
+   uint64_t flags = 0;
 
-   // Scan all rows
+   // Convert all rows
    for (int y = 0; y < 8; y++) {
-      // To store the pixels as we fetch them
-      uint32_t normal = 0;    // Left to right
-      uint32_t flipped = 0;   // Right to left
-
-      // Retrieve pixels of this row
-      for (int x = 0; x < 8; x++) {
-         uint8_t pixel = get_pixel(in, bx + x, by + y);
-         flags |= (pixel >> 4) & 0x0F;
-         pixel &= 0x0F;
-         normal = normal << 4 | pixel;
-         flipped = flipped >> 4 | pixel << 28;
-      }
-
-      // Store rows in tile data
-      out->normal[y] = normal;
-      out->flipped[y] = flipped;
+      flags |= rows[y];
+      out->normal[y] = pack_row(rows[y]);
+      out->flipped[y] = pack_row(mirror_row(rows[y]));
    }
 
-   // Store flags
-   out->flags = get_palette_mapping(flags);
+   // Merge the flags from every pixel and store them
+   flags = flags >> 4 & UINT64_C(0x0F0F0F0F0F0F0F0F);
+   flags |= flags >> 32;
+   flags |= flags >> 16;
+   flags |= flags >> 8;
+   out->flags = get_palette_mapping(flags & 0x0F);
 }
 
 //***************************************************************************
@@ -95,37 +139,73 @@ void set_output_format(Format value) {
    format = value;
 }
 
+//***************************************************************************
+// fetch_tile_rows [internal]
+// Retrieves all the pixels in a tile, each row packed into a 64-bit value
+// (leftmost pixel in the highest byte). Tiles that are completely inside
+// the bitmap are read straight from it, only the ones touching the edges
+// need to check every pixel.
+//---------------------------------------------------------------------------
+// param in: input bitmap
+// param rows: where to store rows
+// param bx: base X coordinate (leftmost pixel of tile)
+// param by: base Y coordinate (topmost pixel of tile)
+//***************************************************************************
+
+static void fetch_tile_rows(const Bitmap *in, uint64_t *rows, int bx, int by)
+{
+   // Inside the bitmap?
+   if (bx >= 0 && by >= 0 && bx <= in->width - 8 && by <= in->height - 8) {
+      for (int y = 0; y < 8; y++) {
+         const uint8_t *ptr = &in->rows[by + y][bx];
+         rows[y] = (uint64_t) ptr[0] << 56 | (uint64_t) ptr[1] << 48 |
+                   (uint64_t) ptr[2] << 40 | (uint64_t) ptr[3] << 32 |
+                   (uint64_t) ptr[4] << 24 | (uint64_t) ptr[5] << 16 |
+                   (uint64_t) ptr[6] << 8 | (uint64_t) ptr[7];
+      }
+   }
+
+   // Nope, pixels outside are 0
+   else {
+      for (int y = 0; y < 8; y++) {
+         uint64_t row = 0;
+         for (int x = 0; x < 8; x++)
+            row = row << 8 | get_pixel(in, bx + x, by + y);
+         rows[y] = row;
+      }
+   }
+}
+
 //***************************************************************************
 // write_tile_1bpp
 // Takes a tile from the bitmap and outputs a 1bpp tile
 //---------------------------------------------------------------------------
 // param in: input bitmap
-// param out: output file
+// param out: output buffer
 // param xr: base X coordinate (leftmost pixel of tile)
 // param yr: base Y coordinate (topmost pixel of tile)
 // return: error code
 //***************************************************************************
 
-static int write_tile_1bpp(const Bitmap *in, FILE *out, int bx, int by)
+static int write_tile_1bpp(const Bitmap *in, TileBuffer *out, int bx, int by)
 {
-   // To store the tile data
-   uint8_t data[8];
-
-   // Read the tile from the bitmap to generate the 4bpp data
-   uint8_t *ptr = data;
-   for (int y = 0; y < 8; y++, ptr++) {
-      uint8_t temp = 0;
-      for (int x = 0; x < 8; x++) {
-         temp <<= 1;
-         temp |= get_pixel(in, bx + x, by + y) & 0x01;
-      }
-      *ptr = temp;
+   // Make room for the tile
+   int errcode;
+   uint8_t *ptr = reserve_tile(out, 8, &errcode);
+   if (ptr == NULL)
+      return errcode;
+
+   // Read the tile from the bitmap
+   uint64_t rows[8];
+   fetch_tile_rows(in, rows, bx, by);
+
+   // Gather the lowest bit of each pixel into a byte (the multiplication
+   // moves every bit into the top byte without them overlapping)
+   for (int y = 0; y < 8; y++) {
+      *ptr++ = (rows[y] & UINT64_C(0x0101010101010101)) *
+               UINT64_C(0x0102040810204080) >> 56;
    }
 
-   // Write tile blob into output file
-   if (fwrite(data, 1, 8, out) < 8)
-      return ERR_CANTWRITE;
-
    // Success!
    return ERR_NONE;
 }
@@ -135,28 +215,32 @@ static int write_tile_1bpp(const Bitmap *in, FILE *out, int bx, int by)
 // Takes a tile from the bitmap and outputs a 4bpp tile
 //---------------------------------------------------------------------------
 // param in: input bitmap
-// param out: output file
+// param out: output buffer
 // param xr: base X coordinate (leftmost pixel of tile)
 // param yr: base Y coordinate (topmost pixel of tile)
 // return: error code
 //***************************************************************************
 
-static int write_tile_4bpp(const Bitmap *in, FILE *out, int bx, int by)
+static int write_tile_4bpp(const Bitmap *in, TileBuffer *out, int bx, int by)
 {
-   // To store the tile data
-   uint8_t data[32];
-
-   // Read the tile from the bitmap to generate the 4bpp data
-   uint8_t *ptr = data;
-   for (int y = 0; y < 8; y++)
-   for (int x = 0; x < 8; x += 2) {
-      *ptr++ = (get_pixel(in, bx + x, by + y) << 4) |
-               (get_pixel(in, bx + x + 1, by + y) & 0x0F);
-   }
+   // Make room for the tile
+   int errcode;
+   uint8_t *ptr = reserve_tile(out, 32, &errcode);
+   if (ptr == NULL)
+      return errcode;
 
-   // Write tile blob into output file
-   if (fwrite(data, 1, 32, out) < 32)
-      return ERR_CANTWRITE;
+   // Read the tile from the bitmap
+   uint64_t rows[8];
+   fetch_tile_rows(in, rows, bx, by);
+
+   // Generate the 4bpp data
+   for (int y = 0; y < 8; y++) {
+      uint32_t row = pack_row(rows[y]);
+      *ptr++ = row >> 24;
+      *ptr++ = row >> 16;
+      *ptr++ = row >> 8;
+      *ptr++ = row;
+   }
 
    // Success!
    return ERR_NONE;
@@ -173,7 +257,7 @@ static int write_tile_4bpp(const Bitmap *in, FILE *out, int bx, int by)
 // return: ERR_UNKNOWN
 //***************************************************************************
 
-static int write_tile_error(const Bitmap *in, FILE *out, int bx, int by)
+static int write_tile_error(const Bitmap *in, TileBuffer *out, int bx, int by)
 {
    // To shut up the compiler
    (void) in;
@@ -202,6 +286,47 @@ static inline TileFunc *get_write_func(void) {
    }
 }
 
+//***************************************************************************
+// reserve_tile [internal]
+// Makes room for a tile in the output buffer (writing out what's in it if
+// it's full)
+//---------------------------------------------------------------------------
+// param buffer: pointer to output buffer
+// param size: size of tile in bytes
+// param errcode: where to store error code
+// return: where to store the tile (NULL on failure)
+//***************************************************************************
+
+static uint8_t *reserve_tile(TileBuffer *buffer, size_t size, int *errcode) {
+   if (buffer->size + size > TILE_BUFFER_SIZE) {
+      *errcode = flush_tiles(buffer);
+      if (*errcode) return NULL;
+   }
+
+   uint8_t *ptr = &buffer->data[buffer->size];
+   buffer->size += size;
+   return ptr;
+}
+
+//***************************************************************************
+// flush_tiles [internal]
+// Writes all the tiles in the output buffer into the output file
+//---------------------------------------------------------------------------
+// param buffer: pointer to output buffer
+// return: error code
+//***************************************************************************
+
+static int flush_tiles(TileBuffer *buffer) {
+   size_t size = buffer->size;
+   buffer->size = 0;
+
+   if (size == 0)
+      return ERR_NONE;
+   if (fwrite(buffer->data, 1, size, buffer->file) < size)
+      return ERR_CANTWRITE;
+   return ERR_NONE;
+}
+
 //***************************************************************************
 // write_tilemap
 // Outputs a block of tiles using tilemap ordering
@@ -219,17 +344,20 @@ int write_tilemap(const Bitmap *in, FILE *out, int bx, int by,
 int width, int height) {
    // Determine function we're going to use to fetch tiles
    TileFunc *func = get_write_func();
+   TileBuffer buffer;
+   buffer.file = out;
+   buffer.size = 0;
 
    // Traverse through all tiles in tilemap ordering
    // (left-to-right, then top-to-bottom)
    for (int y = 0; y < height; y++)
    for (int x = 0; x < width; x++) {
-      int errcode = func(in, out, bx + (x << 3), by + (y << 3));
+      int errcode = func(in, &buffer, bx + (x << 3), by + (y << 3));
       if (errcode) return errcode;
    }
 
-   // Success!
-   return ERR_NONE;
+   // Write whatever is left
+   return flush_tiles(&buffer);
 }
 
 //***************************************************************************
@@ -249,6 +377,9 @@ int write_sprite(const Bitmap *in, FILE *out, int bx, int by,
 int width, int height) {
    // Determine function we're going to use to fetch tiles
    TileFunc *func = get_write_func();
+   TileBuffer buffer;
+   buffer.file = out;
+   buffer.size = 0;
 
    // Sprites are at most 4 tiles high, so split sprites into strips that
    // have at most that length
@@ -260,7 +391,7 @@ int width, int height) {
       // (top-to-bottom, then left-to-right)
       for (int x = 0; x < width; x++)
       for (int y = 0; y < strip_height; y++) {
-         int errcode = func(in, out, bx + (x << 3), by + (y << 3));
+         int errcode = func(in, &buffer, bx + (x << 3), by + (y << 3));
          if (errcode) return errcode;
       }
 
@@ -269,6 +400,6 @@ int width, int height) {
       by += strip_height << 3;
    }
 
-   // Success!
-   return ERR_NONE;
+   // Write whatever is left
+   return flush_tiles(&buffer);
 }
@@ -13,5 +13,9 @@
 // Function prototypes
 void decompress_slz(uint8_t *, const uint8_t *);
 void decompress_slz24(uint8_t *, const uint8_t *);
+void decompress_slzx(uint8_t *, const uint8_t *);
+void decompress_slz_chunk(uint8_t *, const uint8_t *, uint16_t);
+void decompress_slz_dict(uint8_t *, const uint8_t *, const uint8_t *,
+                         uint16_t);
 
 #endif
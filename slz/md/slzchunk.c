@@ -0,0 +1,22 @@
+// Required headers
+#include <stdint.h>
+#include "slz.h"
+
+//***************************************************************************
+// decompress_slz_chunk
+// Decompresses a single chunk from a chunked SLZ container
+//---------------------------------------------------------------------------
+// param out: where to store decompressed data
+// param in: pointer to chunked container
+// param id: ID of chunk to decompress (counting from 0)
+//***************************************************************************
+
+void decompress_slz_chunk(uint8_t *out, const uint8_t *in, uint16_t id) {
+   // Look up where the chunk is in the table
+   const uint8_t *ptr = in + 4 + id * 4;
+   uint32_t offset = (uint32_t)(ptr[0]) << 24 | (uint32_t)(ptr[1]) << 16 |
+                     ptr[2] << 8 | ptr[3];
+
+   // Chunks are just SLZ16 data
+   decompress_slz(out, in + offset);
+}
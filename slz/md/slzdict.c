@@ -0,0 +1,79 @@
+// Required headers
+#include <stdint.h>
+
+//***************************************************************************
+// decompress_slz_dict
+// Decompresses data stored in SLZ format that was compressed with a preset
+// dictionary
+//---------------------------------------------------------------------------
+// param out: where to store decompressed data
+// param in: pointer to SLZ-compressed data
+// param dict: pointer to dictionary
+// param dictsize: size of dictionary
+//***************************************************************************
+
+void decompress_slz_dict(uint8_t *out, const uint8_t *in,
+const uint8_t *dict, uint16_t dictsize) {
+   // Strings can start in the dictionary, which goes right before the
+   // start of the output
+   const uint8_t *dict_end = dict + dictsize;
+   uint8_t *start = out;
+
+   // Retrieve uncompressed size
+   uint16_t size = in[0] << 8 | in[1];
+   in += 2;
+   
+   // To store the tokens
+   uint8_t num_tokens = 1;
+   uint8_t tokens;
+   
+   // Go through all compressed data until we're done decompressing
+   while (size != 0) {
+      // Need more tokens?
+      num_tokens--;
+      if (num_tokens == 0) {
+         tokens = *in++;
+         num_tokens = 8;
+      }
+      
+      // Compressed string?
+      if (tokens & 0x80) {
+         // Get distance and length
+         uint16_t dist = in[0] << 8 | in[1];
+         uint8_t len = (dist & 0x0F) + 3;
+         dist = (dist >> 4) + 3;
+         in += 2;
+         
+         // Discount string length from size
+         size -= len;
+         
+         // String starts in the dictionary? Copy it byte by byte, going
+         // to the start of the output once past the dictionary
+         if (out - start < dist) {
+            const uint8_t *ptr = dict_end - (dist - (out - start));
+            while (len-- > 0) {
+               *out++ = *ptr++;
+               if (ptr == dict_end)
+                  ptr = start;
+            }
+         }
+         
+         // Nope, copy it from the output
+         else {
+            const uint8_t *ptr = out - dist;
+            while (len-- > 0)
+               *out++ = *ptr++;
+         }
+      }
+      
+      // Uncompressed byte?
+      else {
+         // Store byte as-is
+         *out++ = *in++;
+         size--;
+      }
+      
+      // Go for next token
+      tokens += tokens;
+   }
+}
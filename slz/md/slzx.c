@@ -0,0 +1,61 @@
+// Required headers
+#include <stdint.h>
+
+//***************************************************************************
+// decompress_slzx
+// Decompresses data stored in SLZX format
+//---------------------------------------------------------------------------
+// param out: where to store decompressed data
+// param in: pointer to SLZX-compressed data
+//***************************************************************************
+
+void decompress_slzx(uint8_t *out, const uint8_t *in) {
+   // Retrieve uncompressed size
+   uint16_t size = in[0] << 8 | in[1];
+   in += 2;
+   
+   // To store the tokens
+   uint8_t num_tokens = 1;
+   uint8_t tokens;
+   
+   // Go through all compressed data until we're done decompressing
+   while (size != 0) {
+      // Need more tokens?
+      num_tokens--;
+      if (num_tokens == 0) {
+         tokens = *in++;
+         num_tokens = 8;
+      }
+      
+      // Compressed string?
+      if (tokens & 0x80) {
+         // Get distance and length
+         // The largest length means the real length is in the next byte
+         uint16_t dist = in[0] << 8 | in[1];
+         uint16_t len = (dist & 0x0F) + 3;
+         dist = (dist >> 4) + 1;
+         in += 2;
+         if (len == 18)
+            len += *in++;
+         
+         // Discount string length from size
+         size -= len;
+         
+         // Copy string (it may overlap with itself, so byte by byte)
+         const uint8_t *ptr = out - dist;
+         do {
+            *out++ = *ptr++;
+         } while (--len);
+      }
+      
+      // Uncompressed byte?
+      else {
+         // Store byte as-is
+         *out++ = *in++;
+         size--;
+      }
+      
+      // Go for next token
+      tokens += tokens;
+   }
+}
@@ -0,0 +1,203 @@
+//***************************************************************************
+// "chunk.c"
+// Handles the chunked container (several SLZ16 streams with an index)
+//***************************************************************************
+// Slz compression tool
+//
+// This file is part of the slz tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+//***************************************************************************
+// The container looks like this (all values are big endian):
+//
+//    word ........... Uncompressed size of each chunk (except the last one)
+//    word ........... Number of chunks
+//    long × chunks .. Offset of each chunk (from the start of the file)
+//    ................ SLZ16 data for each chunk
+//***************************************************************************
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "main.h"
+#include "compress.h"
+#include "decompress.h"
+
+//***************************************************************************
+// compress_chunked
+// Reads an uncompressed blob from a file and outputs a chunked container
+//---------------------------------------------------------------------------
+// param infile: input file
+// param outfile: output file
+// param chunksize: uncompressed size of each chunk
+// param parse: how to pick the strings
+// param threads: how many threads to use when looking for strings
+// return: error code
+//***************************************************************************
+
+int compress_chunked(FILE *infile, FILE *outfile, unsigned chunksize,
+int parse, int threads) {
+   // To store error codes
+   int errcode;
+
+   // THIS SHOULDN'T HAPPEN
+   if (chunksize < 1 || chunksize > 0xFFFF)
+      return ERR_UNKNOWN;
+
+   // Get filesize (sorry, we have to seek here!)
+   if (fseek(infile, 0, SEEK_END)) return ERR_CANTREAD;
+   long eof_pos = ftell(infile);
+   if (eof_pos == -1) return ERR_CANTREAD;
+   size_t filesize = (size_t)(eof_pos);
+   if (fseek(infile, 0, SEEK_SET)) return ERR_CANTREAD;
+
+   // Too large? (this is the same limit as SLZ24, just to keep the offsets
+   // within a sane range)
+   if (filesize > 0xFFFFFF)
+      return ERR_TOOLARGE24;
+
+   // Too many chunks?
+   size_t numchunks = (filesize + chunksize - 1) / chunksize;
+   if (numchunks > 0xFFFF)
+      return ERR_MANYCHUNKS;
+
+   // Allocate memory to store blob
+   uint8_t *blob = (uint8_t *) malloc(sizeof(uint8_t) * (filesize + 1));
+   if (blob == NULL) return ERR_NOMEMORY;
+
+   // Load input file into memory
+   if (fread(blob, 1, filesize, infile) < filesize) {
+      free(blob);
+      return ERR_CANTREAD;
+   }
+
+   // Write header
+   errcode = write_word(outfile, chunksize);
+   if (!errcode) errcode = write_word(outfile, numchunks);
+   if (errcode) { free(blob); return errcode; }
+
+   // Leave room for the offsets, we'll fill them in once we know them
+   size_t i;
+   for (i = 0; i < numchunks && !errcode; i++)
+      errcode = write_long(outfile, 0);
+   if (errcode) { free(blob); return errcode; }
+
+   // To store where each chunk goes
+   uint32_t *offsets = (uint32_t *) malloc(sizeof(uint32_t) *
+                                           (numchunks + 1));
+   if (offsets == NULL) { free(blob); return ERR_NOMEMORY; }
+   uint32_t offset = 4 + numchunks * 4;
+
+   // Compress every chunk on its own
+   for (i = 0; i < numchunks; i++) {
+      size_t start = i * chunksize;
+      size_t size = filesize - start > chunksize ?
+                    chunksize : filesize - start;
+
+      uint8_t *buffer;
+      size_t bufsize;
+      errcode = compress_blob(&blob[start], size, NULL, 0, FORMAT_SLZ16,
+                              parse, threads, &buffer, &bufsize, NULL);
+      if (errcode) break;
+
+      if (fwrite(buffer, 1, bufsize, outfile) < bufsize)
+         errcode = ERR_CANTWRITE;
+      free(buffer);
+      if (errcode) break;
+
+      offsets[i] = offset;
+      offset += bufsize;
+   }
+
+   // Done with the blob
+   free(blob);
+
+   // Go back and fill in the offsets
+   if (!errcode && fseek(outfile, 4, SEEK_SET))
+      errcode = ERR_CANTWRITE;
+   for (i = 0; i < numchunks && !errcode; i++)
+      errcode = write_long(outfile, offsets[i]);
+
+   // Done
+   free(offsets);
+   return errcode;
+}
+
+//***************************************************************************
+// decompress_chunked
+// Reads a chunked container and outputs an uncompressed blob
+//---------------------------------------------------------------------------
+// param infile: input file
+// param outfile: output file
+// return: error code
+//***************************************************************************
+
+int decompress_chunked(FILE *infile, FILE *outfile) {
+   // To store error codes
+   int errcode;
+
+   // Read header
+   uint16_t chunksize, numchunks;
+   errcode = read_word(infile, &chunksize);
+   if (!errcode) errcode = read_word(infile, &numchunks);
+   if (errcode) return errcode;
+
+   // Read the offsets
+   uint32_t *offsets = (uint32_t *) malloc(sizeof(uint32_t) *
+                                           (numchunks + 1));
+   if (offsets == NULL) return ERR_NOMEMORY;
+
+   size_t i;
+   for (i = 0; i < numchunks && !errcode; i++)
+      errcode = read_long(infile, &offsets[i]);
+   if (errcode) { free(offsets); return errcode; }
+
+   // Decompress every chunk
+   for (i = 0; i < numchunks; i++) {
+      // Go to where the chunk is
+      if (fseek(infile, offsets[i], SEEK_SET)) {
+         errcode = ERR_CORRUPT;
+         break;
+      }
+
+      // All chunks but the last one must be exactly the chunk size, and
+      // the last one can't be larger than that
+      uint16_t size;
+      errcode = read_word(infile, &size);
+      if (errcode) break;
+      if (size > chunksize || (size < chunksize && i < numchunks - 1u) ||
+      size == 0) {
+         errcode = ERR_CORRUPT;
+         break;
+      }
+
+      // Decompress the chunk
+      if (fseek(infile, offsets[i], SEEK_SET)) {
+         errcode = ERR_CANTREAD;
+         break;
+      }
+      errcode = decompress(infile, outfile, FORMAT_SLZ16, NULL, 0);
+      if (errcode) break;
+   }
+
+   // Done
+   free(offsets);
+   return errcode;
+}
@@ -0,0 +1,39 @@
+//***************************************************************************
+// "chunk.h"
+// Header file for "chunk.c"
+//***************************************************************************
+// Slz compression tool
+//
+// This file is part of the slz tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+#ifndef CHUNK_H
+#define CHUNK_H
+
+// Required headers
+#include <stdio.h>
+
+// Default size of each chunk
+#define DEFAULT_CHUNK_SIZE 0x1000
+
+// Function prototypes
+int compress_chunked(FILE *, FILE *, unsigned, int, int);
+int decompress_chunked(FILE *, FILE *);
+
+#endif
@@ -30,6 +30,25 @@
 #include <stdlib.h>
 #include <string.h>
 #include "main.h"
+#include "compress.h"
+#include "match.h"
+
+// Function prototypes
+static void optimize_parse(Match *, size_t, int, int);
+
+// Cost of each token when decompressing with DecompressSlz on the 68000
+// These are in 1/8 cycles since fetching the token types (10 cycles) is
+// shared among eight tokens
+#define CYCLES_TOKENS   10          // Fetching a new group of token types
+#define CYCLES_LITERAL  (70*8)      // Uncompressed byte
+#define CYCLES_STRING   (162*8)     // Compressed string (base cost)
+#define CYCLES_PERBYTE  (18*8)      // Compressed string (per byte copied)
+
+// Same for DecompressSlzx (short strings go through the same unrolled copy,
+// long strings go through a loop instead)
+#define CYCLESX_SHORT   (182*8)     // Short string (base cost)
+#define CYCLESX_LONG    (178*8)     // Long string (base cost)
+#define CYCLESX_PERBYTE (28*8)      // Long string (per byte copied)
 
 //***************************************************************************
 // compress
@@ -38,15 +57,16 @@
 // param infile: input file
 // param outfile: output file
 // param format: SLZ variant in use
+// param parse: how to pick the strings
+// param threads: how many threads to use when looking for strings
+// param inplace: whether to report or pad for in-place decompression
+// param dict: preset dictionary (NULL if none)
+// param dictsize: size of the preset dictionary
 // return: error code
 //***************************************************************************
 
-int compress(FILE *infile, FILE *outfile, int format) {
-   // THIS SHOULDN'T HAPPEN
-   // (also this check is to help the compiler optimize)
-   if (format != FORMAT_SLZ16 && format != FORMAT_SLZ24)
-      return ERR_UNKNOWN;
-
+int compress(FILE *infile, FILE *outfile, int format, int parse,
+int threads, int inplace, const uint8_t *dict, size_t dictsize) {
    // To store error codes
    int errcode;
 
@@ -57,23 +77,14 @@ int compress(FILE *infile, FILE *outfile, int format) {
    size_t filesize = (size_t)(eof_pos);
    if (fseek(infile, 0, SEEK_SET)) return ERR_CANTREAD;
 
-   // Empty?
-   if (filesize == 0) {
-      if (format == FORMAT_SLZ16)
-         errcode = write_word(outfile, 0);
-      else
-         errcode = write_tribyte(outfile, 0);
-      return errcode;
-   }
-
    // Too large for SLZ?
-   if (filesize > 0xFFFF && format == FORMAT_SLZ16)
+   if (filesize > 0xFFFF && format != FORMAT_SLZ24)
       return ERR_TOOLARGE16;
    else if (filesize > 0xFFFFFF && format == FORMAT_SLZ24)
       return ERR_TOOLARGE24;
 
    // Allocate memory to store blob
-   uint8_t *blob = (uint8_t *) malloc(sizeof(uint8_t) * filesize);
+   uint8_t *blob = (uint8_t *) malloc(sizeof(uint8_t) * (filesize + 1));
    if (blob == NULL) return ERR_NOMEMORY;
 
    // Load input file into memory
@@ -82,135 +93,329 @@ int compress(FILE *infile, FILE *outfile, int format) {
       return ERR_CANTREAD;
    }
 
-   // Write uncompressed size
-   if (format == FORMAT_SLZ16)
-      errcode = write_word(outfile, (uint16_t)(filesize));
-   else
-      errcode = write_tribyte(outfile, (uint32_t)(filesize));
+   // Compress the blob
+   uint8_t *buffer;
+   size_t bufsize, offset;
+   errcode = compress_blob(blob, filesize, dict, dictsize, format, parse,
+                           threads, &buffer, &bufsize, &offset);
+   free(blob);
    if (errcode) return errcode;
 
+   // Report where to put the data for in-place decompression?
+   if (inplace != INPLACE_NONE)
+      printf("In-place offset: %zu bytes (buffer size: %zu bytes)\n",
+             offset, offset + bufsize);
+
+   // Pad the data so it can be loaded straight into the output buffer?
+   if (inplace == INPLACE_PAD) {
+      size_t i;
+      for (i = 0; i < offset; i++) {
+         if (fputc(0x00, outfile) == EOF) {
+            free(buffer);
+            return ERR_CANTWRITE;
+         }
+      }
+   }
+
+   // Write compressed data into output file
+   if (fwrite(buffer, 1, bufsize, outfile) < bufsize) {
+      free(buffer);
+      return ERR_CANTWRITE;
+   }
+
+   // Success!
+   free(buffer);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// compress_blob
+// Compresses a blob in memory into SLZ. Also works out how far ahead of the
+// output the compressed data must be for in-place decompression to be safe
+// (it's assumed to be placed at the end of the output buffer).
+//---------------------------------------------------------------------------
+// param blob: data to compress
+// param size: size of the data
+// param dict: preset dictionary (NULL if none)
+// param dictsize: size of the preset dictionary
+// param format: SLZ variant in use
+// param parse: how to pick the strings
+// param threads: how many threads to use when looking for strings
+// param output: where to store pointer to compressed data (must be freed)
+// param outsize: where to store size of compressed data
+// param offset: where to store the in-place offset (can be NULL)
+// return: error code
+//***************************************************************************
+
+int compress_blob(const uint8_t *blob, size_t size, const uint8_t *dict,
+size_t dictsize, int format, int parse, int threads, uint8_t **output,
+size_t *outsize, size_t *offset) {
+   // THIS SHOULDN'T HAPPEN
+   // (also this check is to help the compiler optimize)
+   if (format != FORMAT_SLZ16 && format != FORMAT_SLZ24 &&
+   format != FORMAT_SLZX)
+      return ERR_UNKNOWN;
+
+   // To store error codes
+   int errcode;
+
+   // Too large for SLZ?
+   if (size > 0xFFFF && format != FORMAT_SLZ24)
+      return ERR_TOOLARGE16;
+   else if (size > 0xFFFFFF && format == FORMAT_SLZ24)
+      return ERR_TOOLARGE24;
+
+   // If there's a preset dictionary, compress as if it was right before
+   // the data (only as much of it as strings can reach, though)
+   const uint8_t *data = blob;
+   uint8_t *merged = NULL;
+   size_t start = 0;
+   if (dict != NULL && dictsize > 0) {
+      size_t max_dist = format == FORMAT_SLZX ? SLZX_MAX_DIST : MAX_DIST;
+      if (dictsize > max_dist) {
+         dict += dictsize - max_dist;
+         dictsize = max_dist;
+      }
+      merged = (uint8_t *) malloc(dictsize + size);
+      if (merged == NULL) return ERR_NOMEMORY;
+      memcpy(merged, dict, dictsize);
+      memcpy(merged + dictsize, blob, size);
+      data = merged;
+      start = dictsize;
+   }
+   size_t end = start + size;
+
+   // Allocate memory for the compressed data
+   // Worst case is every byte being uncompressed (plus the token types and
+   // the header), strings are never larger than the bytes they replace
+   uint8_t *out = (uint8_t *) malloc(size + size / 8 + 8);
+   if (out == NULL) { free(merged); return ERR_NOMEMORY; }
+
+   // Write uncompressed size
+   size_t outpos;
+   if (format != FORMAT_SLZ24) {
+      out[0] = size >> 8;
+      out[1] = size;
+      outpos = 2;
+   } else {
+      out[0] = size >> 16;
+      out[1] = size >> 8;
+      out[2] = size;
+      outpos = 3;
+   }
+
+   // The greedy parse can look up strings as it goes (it skips over most
+   // positions, so it's faster than looking up all of them even when the
+   // work can be split among threads), but the optimal parse needs to know
+   // all the strings in advance to choose among them.
+   MatchFinder finder;
+   Match *table = NULL;
+   if (parse == PARSE_GREEDY) {
+      errcode = init_match_finder(&finder, data, end, start, format);
+      if (errcode) { free(out); free(merged); return errcode; }
+   } else {
+      table = (Match *) malloc(sizeof(Match) * (end + 1));
+      if (table == NULL) { free(out); free(merged); return ERR_NOMEMORY; }
+      errcode = find_all_matches(data, end, table, threads, format);
+      if (errcode) {
+         free(table);
+         free(out);
+         free(merged);
+         return errcode;
+      }
+      optimize_parse(&table[start], size, parse, format);
+   }
+
    // To store token data
+   // Data for each token gets buffered because the token types need to be
+   // written first
+   size_t token_pos = outpos;
    uint8_t tokens = 0;
    int num_tokens = 0;
 
-   // Buffer to store the compressed data (we need to buffer this because the
-   // tokens need to be written first)
-   uint8_t buffer[0x10];
-   size_t bufsize = 0;
+   // How far ahead the compressed data needs to be so writing never
+   // catches up with data that hasn't been read yet
+   size_t min_offset = 0;
 
    // Scan through all bytes
-   size_t pos = 0;
-   while (pos < filesize) {
-      // Used to store token information
-      int compressed = 0;
-      uint16_t dist = 3;
-      uint8_t len = 2;
+   size_t pos = start;
+   while (pos < end) {
+      // Starting a new group of tokens? Make room for the token types
+      if (num_tokens == 0) {
+         token_pos = outpos;
+         outpos++;
+      }
 
       // Make room for next token
       tokens <<= 1;
       num_tokens++;
 
-      // First byte is always uncompressed
-      // Also if there are too few bytes left, we can't compress them, so
-      // don't bother scanning those either
-      if (pos > 0 && filesize - pos >= 3) {
-         // Determine maximum distance to look for
-         uint16_t max_dist = (uint16_t)(pos > 0x1002 ? 0x1002 : pos);
-
-         // Determine maximum length to check for (to avoid overflow issues)
-         uint8_t max_len = (uint8_t)(filesize - pos > 18 ? 18 : filesize - pos);
-
-         // Pointer to the strings we're going to compare
-         // Making them pointers to help the compiler optimize
-         const uint8_t *target = &blob[pos];
-         const uint8_t *other = &blob[pos - max_dist];
-
-         // Scan for a possible match
-         size_t curr_dist;
-         for (curr_dist = max_dist; curr_dist >= 3; curr_dist--, other++)
-         {
-            // To avoid wasting time on matches that WILL fail...
-            if (*other != *target)
-               continue;
-
-            // Check all lengths that are larger than the longest string we
-            // found so far (don't bother with shorter strings as that'd be
-            // a waste)
-            uint8_t curr_len;
-            for (curr_len = max_len; curr_len > len; curr_len--) {
-               // Did we find a match? (if so, don't bother with smaller
-               // string, also mark the token as compressable)
-               if (!memcmp(other, target, curr_len)) {
-                  dist = (uint16_t)(curr_dist);
-                  len = curr_len;
-                  compressed = 1;
-                  break;
-               }
-            }
-         }
-      }
+      // Look for the string we want to reuse (if any)
+      Match match = table != NULL ?
+                    table[pos] : find_match(&finder, pos);
 
       // Compressed token?
-      if (compressed) {
-         // Skip repeated string in the blob
-         pos += len;
-
+      if (match.len != 0) {
          // Store contents of the token
-         dist -= 3;
-         len -= 3;
-         buffer[bufsize] = dist >> 4;
-         buffer[bufsize+1] = dist << 4 | len;
-         bufsize += 2;
+         // SLZX uses the lowest length value as an escape for a length
+         // stored in an extra byte
+         if (format != FORMAT_SLZX) {
+            uint16_t dist = match.dist - 3;
+            uint8_t len = match.len - 3;
+            out[outpos] = dist >> 4;
+            out[outpos+1] = dist << 4 | len;
+            outpos += 2;
+         } else if (match.len <= SLZX_MAX_SHORT) {
+            uint16_t dist = match.dist - 1;
+            uint8_t len = match.len - 3;
+            out[outpos] = dist >> 4;
+            out[outpos+1] = dist << 4 | len;
+            outpos += 2;
+         } else {
+            uint16_t dist = match.dist - 1;
+            out[outpos] = dist >> 4;
+            out[outpos+1] = dist << 4 | 0x0F;
+            out[outpos+2] = match.len - (SLZX_MAX_SHORT + 1);
+            outpos += 3;
+         }
 
          // Mark token as compressed
          tokens |= 1;
+
+         // Skip repeated string in the blob
+         pos += match.len;
       }
 
       // Uncompressed token?
       else {
-         buffer[bufsize] = blob[pos];
+         out[outpos] = data[pos];
+         outpos++;
          pos++;
-         bufsize++;
       }
 
+      // The last byte written by this token can't go past the data
+      // read so far
+      if (pos - start > outpos && pos - start - outpos > min_offset)
+         min_offset = pos - start - outpos;
+
       // Huh, done with this group of tokens?
       if (num_tokens == 8) {
-         // Write token types
-         if (fwrite(&tokens, 1, 1, outfile) < 1) {
-            free(blob);
-            return ERR_CANTWRITE;
-         }
-
-         // Write buffered data
-         if (fwrite(buffer, 1, bufsize, outfile) < bufsize) {
-            free(blob);
-            return ERR_CANTWRITE;
-         }
-
-         // Reset tokens and buffer
+         out[token_pos] = tokens;
          tokens = 0;
          num_tokens = 0;
-         bufsize = 0;
       }
    }
 
-   // We don't need the blob anymore
-   free(blob);
+   // Done looking for strings
+   if (table) free(table);
+   else deinit_match_finder(&finder);
+   free(merged);
 
    // If there are any tokens left, make sure they're written too
-   if (num_tokens < 8) {
-      // Make sure token types are MSB aligned
-      tokens <<= 8 - num_tokens;
-
-      // Write token types
-      if (fwrite(&tokens, 1, 1, outfile) < 1)
-         return ERR_CANTWRITE;
+   // (the token types are MSB aligned)
+   // Note that if the last group was full, an empty group gets written
+   // anyway (this is what the tool always did, so keep it that way)
+   if (size != 0) {
+      if (num_tokens == 0) {
+         out[outpos] = 0;
+         outpos++;
+      } else
+         out[token_pos] = tokens << (8 - num_tokens);
+   }
 
-      // Write buffered data
-      if (fwrite(buffer, 1, bufsize, outfile) < bufsize)
-         return ERR_CANTWRITE;
+   // Compressed data can't be closer than this, otherwise it wouldn't fit
+   // at the end of the output buffer
+   if (offset != NULL) {
+      *offset = outpos < size ? size - outpos : 0;
+      if (*offset < min_offset)
+         *offset = min_offset;
    }
 
    // Success!
+   *output = out;
+   *outsize = outpos;
    return ERR_NONE;
 }
+
+//***************************************************************************
+// optimize_parse [internal]
+// Picks the sequence of tokens that gives the lowest cost. On input, the
+// table holds the longest string at every position. On output, it holds
+// the token to use at every position where a token starts (length 0 means
+// an uncompressed byte).
+//---------------------------------------------------------------------------
+// param table: strings found at every position
+// param size: size of the data
+// param parse: PARSE_BEST (smallest size) or PARSE_BESTSPEED (fastest)
+// param format: SLZ variant in use
+//***************************************************************************
+
+static void optimize_parse(Match *table, size_t size, int parse,
+int format) {
+   // Weights for the size (in bits) and the time (in cycles) of each token
+   // The second criterion is only used to break ties, so its total must
+   // never be able to exceed the weight of the first one
+   uint64_t size_weight, cycle_weight;
+   if (parse == PARSE_BESTSPEED) {
+      size_weight = 1;
+      cycle_weight = 1ULL << 28;
+   } else {
+      size_weight = 1ULL << 36;
+      cycle_weight = 1;
+   }
+
+   // Cost of each kind of token
+   uint64_t literal_cost = size_weight * 9 +
+                           cycle_weight * (CYCLES_LITERAL + CYCLES_TOKENS);
+   uint64_t string_cost[SLZX_MAX_LEN+1];
+   unsigned len;
+   if (format != FORMAT_SLZX) {
+      for (len = MIN_LEN; len <= MAX_LEN; len++)
+         string_cost[len] = size_weight * 17 +
+                            cycle_weight * (CYCLES_STRING + CYCLES_TOKENS +
+                                            CYCLES_PERBYTE * len);
+   } else {
+      for (len = MIN_LEN; len <= SLZX_MAX_SHORT; len++)
+         string_cost[len] = size_weight * 17 +
+                            cycle_weight * (CYCLESX_SHORT + CYCLES_TOKENS +
+                                            CYCLES_PERBYTE * len);
+      for (; len <= SLZX_MAX_LEN; len++)
+         string_cost[len] = size_weight * 25 +
+                            cycle_weight * (CYCLESX_LONG + CYCLES_TOKENS +
+                                            CYCLESX_PERBYTE * len);
+   }
+
+   // Lowest cost to compress everything from each position onwards
+   // Ran out of memory? Just leave the longest strings in place then (the
+   // output will still be valid, if not optimal)
+   uint64_t *cost = (uint64_t *) malloc(sizeof(uint64_t) * (size + 1));
+   if (cost == NULL) return;
+
+   // Work backwards to find the cheapest way to go from every position to
+   // the end of the data
+   cost[size] = 0;
+   size_t pos = size;
+   while (pos-- > 0) {
+      // Uncompressed byte is always an option
+      uint64_t best = cost[pos + 1] + literal_cost;
+      unsigned best_len = 0;
+
+      // Try every length for the string we found here (a shorter string
+      // at the same distance is always valid too)
+      unsigned max_len = table[pos].len;
+      for (len = MIN_LEN; len <= max_len; len++) {
+         uint64_t curr = cost[pos + len] + string_cost[len];
+         if (curr < best) {
+            best = curr;
+            best_len = len;
+         }
+      }
+
+      // Store the token to use here
+      cost[pos] = best;
+      table[pos].len = (uint16_t)(best_len);
+   }
+
+   // Done with the costs
+   free(cost);
+}
@@ -28,9 +28,13 @@
 #define COMPRESS_H
 
 // Required headers
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // Function prototypes
-int compress(FILE *, FILE *, int);
+int compress(FILE *, FILE *, int, int, int, int, const uint8_t *, size_t);
+int compress_blob(const uint8_t *, size_t, const uint8_t *, size_t, int,
+                  int, int, uint8_t **, size_t *, size_t *);
 
 #endif
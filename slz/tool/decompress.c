@@ -31,6 +31,47 @@
 #include <string.h>
 #include "main.h"
 
+// Size of the buffers used for reading and writing
+#define INBUF_SIZE 0x10000
+#define OUTBUF_SIZE 0x10000
+
+// Longest distance a string can have (anything further back than this can
+// be written out and forgotten)
+#define MAX_DIST 0x1002
+
+// Longest string that can be copied in a single token (SLZX allows longer
+// strings than SLZ16 and SLZ24)
+#define MAX_LEN 273
+
+// Buffer used to read the compressed data in large blocks
+typedef struct {
+   FILE *file;                // File being read
+   size_t pos;                // Position of next byte in buffer
+   size_t size;               // Amount of bytes in buffer
+   uint8_t data[INBUF_SIZE];  // Buffered data
+} InBuffer;
+
+// Function prototypes
+static int refill(InBuffer *);
+
+//***************************************************************************
+// get_byte [internal]
+// Reads the next byte from the compressed data
+//---------------------------------------------------------------------------
+// param in: input buffer
+// param value: where to store the byte
+// return: error code
+//***************************************************************************
+
+static inline int get_byte(InBuffer *in, uint8_t *value) {
+   if (in->pos == in->size) {
+      int errcode = refill(in);
+      if (errcode) return errcode;
+   }
+   *value = in->data[in->pos++];
+   return ERR_NONE;
+}
+
 //***************************************************************************
 // decompress
 // Reads a file in SLZ format and outputs an uncompressed blob
@@ -38,13 +79,17 @@
 // param infile: input file
 // param outfile: output file
 // param format: SLZ variant in use
+// param dict: preset dictionary (NULL if none)
+// param dictsize: size of the preset dictionary
 // return: error code
 //***************************************************************************
 
-int decompress(FILE *infile, FILE *outfile, int format) {
+int decompress(FILE *infile, FILE *outfile, int format,
+const uint8_t *dict, size_t dictsize) {
    // THIS SHOULDN'T HAPPEN
    // (also this check is to help the compiler optimize)
-   if (format != FORMAT_SLZ16 && format != FORMAT_SLZ24)
+   if (format != FORMAT_SLZ16 && format != FORMAT_SLZ24 &&
+   format != FORMAT_SLZX)
       return ERR_UNKNOWN;
 
    // To store error codes
@@ -52,7 +97,7 @@ int decompress(FILE *infile, FILE *outfile, int format) {
 
    // Read uncompressed size
    uint32_t size;
-   if (format == FORMAT_SLZ16) {
+   if (format != FORMAT_SLZ24) {
       uint16_t temp;
       errcode = read_word(infile, &temp);
       size = temp;
@@ -64,79 +109,150 @@ int decompress(FILE *infile, FILE *outfile, int format) {
    if (size == 0)
       return ERR_NONE;
 
-   // Allocate memory to store the data
-   uint8_t *data = (uint8_t *) malloc(sizeof(uint8_t) * size);
-   if (data == NULL)
+   // Allocate memory for the buffers
+   // The output buffer only needs to hold the window that strings can
+   // refer to, plus whatever hasn't been written yet
+   InBuffer *in = (InBuffer *) malloc(sizeof(InBuffer));
+   uint8_t *data = (uint8_t *) malloc(OUTBUF_SIZE + MAX_LEN);
+   if (in == NULL || data == NULL) {
+      free(in);
+      free(data);
       return ERR_NOMEMORY;
+   }
+   in->file = infile;
+   in->pos = 0;
+   in->size = 0;
+
+   // If there's a preset dictionary, put it in the window as if it had
+   // been decompressed right before the data (without writing it out)
+   size_t bufpos = 0;
+   if (dict != NULL) {
+      if (dictsize > MAX_DIST) {
+         dict += dictsize - MAX_DIST;
+         dictsize = MAX_DIST;
+      }
+      memcpy(data, dict, dictsize);
+      bufpos = dictsize;
+   } else
+      dictsize = 0;
+   size_t unwritten = bufpos;
 
    // To store token data
-   uint8_t tokens;
+   uint8_t tokens = 0;
    uint8_t num_tokens = 0;
 
    // Decompress all data
+   // pos is how much we decompressed in total, bufpos is where that is
+   // in the output buffer
    size_t pos = 0;
    while (pos < size) {
       // Need more tokens?
       if (num_tokens == 0) {
          num_tokens = 8;
-         if (fread(&tokens, 1, 1, infile) < 1) {
-            free(data);
-            return ferror(infile) ? ERR_CANTREAD : ERR_CORRUPT;
-         }
+         errcode = get_byte(in, &tokens);
+         if (errcode) break;
       }
 
       // Compressed string?
       if (tokens & 0x80) {
          // Get string information
-         uint16_t info;
-         errcode = read_word(infile, &info);
-         if (errcode) { free(data); return errcode; }
+         uint8_t hi, lo;
+         errcode = get_byte(in, &hi);
+         if (errcode) break;
+         errcode = get_byte(in, &lo);
+         if (errcode) break;
 
          // Get distance and length
-         uint16_t dist = (info >> 4) + 3;
-         uint8_t len = (info & 0x0F) + 3;
+         // In SLZX the largest length means it's in the next byte
+         uint16_t dist, len;
+         if (format != FORMAT_SLZX) {
+            dist = (hi << 4 | lo >> 4) + 3;
+            len = (lo & 0x0F) + 3;
+         } else {
+            dist = (hi << 4 | lo >> 4) + 1;
+            len = (lo & 0x0F) + 3;
+            if (len == 18) {
+               uint8_t extra;
+               errcode = get_byte(in, &extra);
+               if (errcode) break;
+               len += extra;
+            }
+         }
 
          // Er, make sure parameters are valid...
-         if (dist > pos) {
-            free(data);
-            return ERR_CORRUPT;
+         if (dist > pos + dictsize) {
+            errcode = ERR_CORRUPT;
+            break;
          }
 
-         // Copy string!
-         uint8_t *dest = data + pos;
-         uint8_t *src = dest - dist;
+         // Copy string! If it doesn't overlap with itself we can copy it
+         // all at once, otherwise it has to go byte by byte
+         uint8_t *dest = data + bufpos;
+         const uint8_t *src = dest - dist;
+         if (dist >= len)
+            memcpy(dest, src, len);
+         else {
+            uint16_t i;
+            for (i = 0; i < len; i++)
+               dest[i] = src[i];
+         }
          pos += len;
-         while (len-- > 0)
-            *dest++ = *src++;
+         bufpos += len;
       }
 
       // Uncompressed byte?
       else {
-         if (fread(&data[pos], 1, 1, infile) < 1) {
-            free(data);
-            return ferror(infile) ? ERR_CANTREAD : ERR_CORRUPT;
-         }
+         errcode = get_byte(in, &data[bufpos]);
+         if (errcode) break;
          pos++;
+         bufpos++;
       }
 
       // Go for next token
       tokens <<= 1;
       num_tokens--;
+
+      // Output buffer full? Write it out, keeping only the window
+      if (bufpos >= OUTBUF_SIZE) {
+         size_t flush = bufpos - MAX_DIST;
+         if (fwrite(data + unwritten, 1, flush - unwritten, outfile) <
+         flush - unwritten) {
+            errcode = ERR_CANTWRITE;
+            break;
+         }
+         memmove(data, data + flush, MAX_DIST);
+         bufpos = MAX_DIST;
+         unwritten = 0;
+      }
    }
 
    // Not the expected size?
-   if (pos != size) {
-      free(data);
-      return ERR_CORRUPT;
-   }
+   if (!errcode && pos != size)
+      errcode = ERR_CORRUPT;
 
-   // Write decompressed data into output file
-   if (fwrite(data, 1, size, outfile) < size) {
-      free(data);
-      return ERR_CANTWRITE;
-   }
+   // Write whatever is left in the output buffer
+   if (!errcode && fwrite(data + unwritten, 1, bufpos - unwritten, outfile)
+   < bufpos - unwritten)
+      errcode = ERR_CANTWRITE;
 
-   // Success!
+   // Done with the buffers
+   free(in);
    free(data);
+   return errcode;
+}
+
+//***************************************************************************
+// refill [internal]
+// Reads the next block of compressed data into the input buffer
+//---------------------------------------------------------------------------
+// param in: input buffer
+// return: error code
+//***************************************************************************
+
+static int refill(InBuffer *in) {
+   in->pos = 0;
+   in->size = fread(in->data, 1, INBUF_SIZE, in->file);
+   if (in->size == 0)
+      return ferror(in->file) ? ERR_CANTREAD : ERR_CORRUPT;
    return ERR_NONE;
 }
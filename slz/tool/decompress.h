@@ -28,9 +28,11 @@
 #define DECOMPRESS_H
 
 // Required headers
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // Function prototypes
-int decompress(FILE *, FILE *, int);
+int decompress(FILE *, FILE *, int, const uint8_t *, size_t);
 
 #endif
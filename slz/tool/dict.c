@@ -0,0 +1,304 @@
+//***************************************************************************
+// "dict.c"
+// Loads and trains preset dictionaries
+//***************************************************************************
+// Slz compression tool
+//
+// This file is part of the slz tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "dict.h"
+
+// Size of the substrings used to score the data
+#define KMER_SIZE 4
+
+// Size of each segment picked for the dictionary
+#define SEGMENT_SIZE 32
+
+// Size of the table with the substring scores (in bits)
+#define SCORE_BITS 20
+#define SCORE_SIZE (1 << SCORE_BITS)
+
+// Segment picked for the dictionary
+typedef struct {
+   size_t pos;             // Where it is in the corpus
+   uint32_t score;         // How useful it is
+} Segment;
+
+// Function prototypes
+static int load_file(const char *, uint8_t **, size_t *);
+static int compare_segments(const void *, const void *);
+
+//***************************************************************************
+// hash [internal]
+// Computes the hash for the substring starting at the given address
+//---------------------------------------------------------------------------
+// param ptr: pointer to data
+// return: hash value
+//***************************************************************************
+
+static inline uint32_t hash(const uint8_t *ptr) {
+   uint32_t value = ptr[0] << 24 | ptr[1] << 16 | ptr[2] << 8 | ptr[3];
+   return (value * 0x9E3779B1) >> (32 - SCORE_BITS);
+}
+
+//***************************************************************************
+// load_dictionary
+// Loads a preset dictionary from a file
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param dict: where to store pointer to dictionary (must be freed)
+// param dictsize: where to store size of dictionary
+// return: error code
+//***************************************************************************
+
+int load_dictionary(const char *filename, uint8_t **dict, size_t *dictsize) {
+   return load_file(filename, dict, dictsize);
+}
+
+//***************************************************************************
+// train_dictionary
+// Builds a preset dictionary out of the substrings shared by most files in
+// a corpus. Every file is scored by how many files have each substring,
+// then the corpus is split into as many ranges as segments fit in the
+// dictionary, and the best segment of each range is picked (substrings
+// already picked don't count again). The best segments go at the end of
+// the dictionary, since those are the ones that stay in the window longer.
+//---------------------------------------------------------------------------
+// param filenames: names of the files in the corpus
+// param numfiles: number of files in the corpus
+// param outfile: file where to store the dictionary
+// return: error code
+//***************************************************************************
+
+int train_dictionary(const char **filenames, int numfiles, FILE *outfile) {
+   // To store error codes
+   int errcode = ERR_NONE;
+
+   // Allocate memory for the scores
+   // Besides the score, we need to know the last file that had each
+   // substring so we don't count the same file twice
+   uint32_t *score = (uint32_t *) calloc(SCORE_SIZE, sizeof(uint32_t));
+   int *lastfile = (int *) malloc(sizeof(int) * SCORE_SIZE);
+   if (score == NULL || lastfile == NULL) {
+      free(score);
+      free(lastfile);
+      return ERR_NOMEMORY;
+   }
+
+   size_t i;
+   for (i = 0; i < SCORE_SIZE; i++)
+      lastfile[i] = -1;
+
+   // Load the whole corpus
+   uint8_t *corpus = NULL;
+   size_t corpsize = 0;
+   size_t *ends = (size_t *) malloc(sizeof(size_t) * numfiles);
+   if (ends == NULL) errcode = ERR_NOMEMORY;
+
+   int file;
+   for (file = 0; file < numfiles && !errcode; file++) {
+      uint8_t *blob;
+      size_t size;
+      errcode = load_file(filenames[file], &blob, &size);
+      if (errcode) break;
+
+      uint8_t *temp = (uint8_t *) realloc(corpus, corpsize + size + 1);
+      if (temp == NULL) {
+         free(blob);
+         errcode = ERR_NOMEMORY;
+         break;
+      }
+      corpus = temp;
+      memcpy(corpus + corpsize, blob, size);
+      free(blob);
+
+      // Count how many files have each substring
+      size_t pos;
+      for (pos = corpsize; pos + KMER_SIZE <= corpsize + size; pos++) {
+         uint32_t value = hash(&corpus[pos]);
+         if (lastfile[value] != file) {
+            lastfile[value] = file;
+            score[value]++;
+         }
+      }
+
+      corpsize += size;
+      ends[file] = corpsize;
+   }
+
+   // Substrings found in only one file aren't worth anything since that
+   // file can already find them on its own
+   for (i = 0; i < SCORE_SIZE; i++)
+      score[i] = score[i] > 1 ? score[i] - 1 : 0;
+
+   // Work out how many segments we want
+   size_t maxsegs = MAX_DICT_SIZE / SEGMENT_SIZE;
+   Segment *segments = NULL;
+   size_t numsegs = 0;
+   if (!errcode) {
+      segments = (Segment *) malloc(sizeof(Segment) * maxsegs);
+      if (segments == NULL) errcode = ERR_NOMEMORY;
+   }
+
+   // Keep picking segments until the dictionary is full or there's
+   // nothing worth picking anymore
+   size_t numranges = maxsegs;
+   while (!errcode && numsegs < maxsegs && corpsize >= SEGMENT_SIZE) {
+      size_t rangesize = corpsize / numranges;
+      if (rangesize < SEGMENT_SIZE) {
+         rangesize = SEGMENT_SIZE;
+         numranges = corpsize / SEGMENT_SIZE;
+      }
+
+      size_t picked = 0;
+      size_t range;
+      for (range = 0; range < numranges && numsegs < maxsegs; range++) {
+         size_t start = range * rangesize;
+         size_t end = range == numranges - 1 ? corpsize : start + rangesize;
+
+         // Slide a window through the range looking for the segment with
+         // the highest score (segments can't cross files)
+         uint32_t best_score = 0;
+         size_t best_pos = 0;
+         file = 0;
+         size_t pos;
+         for (pos = start; pos + SEGMENT_SIZE <= end; pos++) {
+            while (ends[file] <= pos) file++;
+            if (pos + SEGMENT_SIZE > ends[file]) {
+               pos = ends[file] - 1;
+               continue;
+            }
+
+            uint32_t curr = 0;
+            size_t k;
+            for (k = 0; k + KMER_SIZE <= SEGMENT_SIZE; k++)
+               curr += score[hash(&corpus[pos + k])];
+            if (curr > best_score) {
+               best_score = curr;
+               best_pos = pos;
+            }
+         }
+
+         // Nothing worth it here?
+         if (best_score == 0)
+            continue;
+
+         // Pick this segment, and don't count its substrings again
+         segments[numsegs].pos = best_pos;
+         segments[numsegs].score = best_score;
+         numsegs++;
+         picked++;
+
+         size_t k;
+         for (k = 0; k + KMER_SIZE <= SEGMENT_SIZE; k++)
+            score[hash(&corpus[best_pos + k])] = 0;
+      }
+
+      // Nothing else left?
+      if (picked == 0)
+         break;
+   }
+
+   // Put the best segments last
+   if (!errcode)
+      qsort(segments, numsegs, sizeof(Segment), compare_segments);
+
+   // Write the dictionary
+   for (i = 0; i < numsegs && !errcode; i++) {
+      if (fwrite(&corpus[segments[i].pos], 1, SEGMENT_SIZE, outfile) <
+      SEGMENT_SIZE)
+         errcode = ERR_CANTWRITE;
+   }
+
+   // Done
+   free(segments);
+   free(corpus);
+   free(ends);
+   free(score);
+   free(lastfile);
+   return errcode;
+}
+
+//***************************************************************************
+// load_file [internal]
+// Loads a whole file into memory
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param blob: where to store pointer to data (must be freed)
+// param size: where to store size of data
+// return: error code
+//***************************************************************************
+
+static int load_file(const char *filename, uint8_t **blob, size_t *size) {
+   // Open file
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   // Get filesize (sorry, we have to seek here!)
+   long eof_pos;
+   if (fseek(file, 0, SEEK_END) || (eof_pos = ftell(file)) == -1 ||
+   fseek(file, 0, SEEK_SET)) {
+      fclose(file);
+      return ERR_CANTREAD;
+   }
+   *size = (size_t)(eof_pos);
+
+   // Allocate memory to store blob
+   *blob = (uint8_t *) malloc(*size + 1);
+   if (*blob == NULL) {
+      fclose(file);
+      return ERR_NOMEMORY;
+   }
+
+   // Load file into memory
+   if (fread(*blob, 1, *size, file) < *size) {
+      free(*blob);
+      fclose(file);
+      return ERR_CANTREAD;
+   }
+
+   // Success!
+   fclose(file);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// compare_segments [internal]
+// Sorting function for segments, from worst score to best score
+//---------------------------------------------------------------------------
+// param a: pointer to first segment
+// param b: pointer to second segment
+// return: <0 if a goes first, >0 if b goes first, 0 if equal
+//***************************************************************************
+
+static int compare_segments(const void *a, const void *b) {
+   const Segment *seg1 = (const Segment *) a;
+   const Segment *seg2 = (const Segment *) b;
+   if (seg1->score != seg2->score)
+      return seg1->score < seg2->score ? -1 : 1;
+   return seg1->pos < seg2->pos ? -1 : seg1->pos > seg2->pos ? 1 : 0;
+}
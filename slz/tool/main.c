@@ -31,12 +31,15 @@
 #include "main.h"
 #include "compress.h"
 #include "decompress.h"
+#include "chunk.h"
+#include "dict.h"
 
 // Possible actions
 enum {
    ACTION_DEFAULT,         // No action specified
    ACTION_COMPRESS,        // Compress
    ACTION_DECOMPRESS,      // Decompress
+   ACTION_TRAIN,           // Train a dictionary
    ACTION_TOOMANY          // Too many actions specified
 };
 
@@ -53,11 +56,24 @@ int main(int argc, char **argv) {
    int show_ver = 0;
    int action = ACTION_DEFAULT;
    int format = FORMAT_DEFAULT;
+   int parse = PARSE_DEFAULT;
+   int threads = 1;
+   int inplace = INPLACE_NONE;
+   long chunksize = DEFAULT_CHUNK_SIZE;
+   const char *dictfilename = NULL;
    const char *infilename = NULL;
    const char *outfilename = NULL;
 
+   // When training a dictionary, the first filename is the output and
+   // all the others are the corpus (there can be any amount of them)
+   const char **filenames = (const char **) malloc(sizeof(char *) * argc);
+   int numfiles = 0;
+   if (filenames == NULL) {
+      fprintf(stderr, "Error: ran out of memory\n");
+      return EXIT_FAILURE;
+   }
+
    int scan_ok = 1;
-   int err_manyfiles = 0;
 
    int curr_arg;
    for (curr_arg = 1; curr_arg < argc; curr_arg++) {
@@ -86,6 +102,21 @@ int main(int argc, char **argv) {
             action = action == ACTION_DEFAULT ?
                      ACTION_DECOMPRESS : ACTION_TOOMANY;
 
+         // Train dictionary?
+         else if (!strcmp(arg, "-t") || !strcmp(arg, "--train"))
+            action = action == ACTION_DEFAULT ?
+                     ACTION_TRAIN : ACTION_TOOMANY;
+
+         // Use dictionary?
+         else if (!strcmp(arg, "-D") || !strcmp(arg, "--dict")) {
+            if (curr_arg + 1 < argc)
+               dictfilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
          // Specify format?
          else if (!strcmp(arg, "-16") || !strcmp(arg, "--slz16"))
             format = format == FORMAT_DEFAULT ?
@@ -93,6 +124,53 @@ int main(int argc, char **argv) {
          else if (!strcmp(arg, "-24") || !strcmp(arg, "--slz24"))
             format = format == FORMAT_DEFAULT ?
                      FORMAT_SLZ24 : FORMAT_TOOMANY;
+         else if (!strcmp(arg, "-x") || !strcmp(arg, "--slzx"))
+            format = format == FORMAT_DEFAULT ?
+                     FORMAT_SLZX : FORMAT_TOOMANY;
+         else if (!strcmp(arg, "-k") || !strcmp(arg, "--chunked"))
+            format = format == FORMAT_DEFAULT ?
+                     FORMAT_CHUNKED : FORMAT_TOOMANY;
+
+         // Specify chunk size?
+         else if (!strcmp(arg, "-n") || !strcmp(arg, "--chunk-size")) {
+            char *endptr = NULL;
+            if (curr_arg + 1 < argc)
+               chunksize = strtol(argv[++curr_arg], &endptr, 0);
+            if (endptr == NULL || *endptr != '\0' ||
+            chunksize < 1 || chunksize > 0xFFFF) {
+               fprintf(stderr, "Error: \"%s\" needs a size between 1 and "
+                  "65535\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Specify parse?
+         else if (!strcmp(arg, "-b") || !strcmp(arg, "--best"))
+            parse = parse == PARSE_DEFAULT ?
+                    PARSE_BEST : PARSE_TOOMANY;
+         else if (!strcmp(arg, "-bs") || !strcmp(arg, "--best-speed"))
+            parse = parse == PARSE_DEFAULT ?
+                    PARSE_BESTSPEED : PARSE_TOOMANY;
+
+         // In-place decompression?
+         else if (!strcmp(arg, "-m") || !strcmp(arg, "--margin")) {
+            if (inplace == INPLACE_NONE)
+               inplace = INPLACE_REPORT;
+         }
+         else if (!strcmp(arg, "-i") || !strcmp(arg, "--in-place"))
+            inplace = INPLACE_PAD;
+
+         // Specify amount of threads?
+         else if (!strcmp(arg, "-j") || !strcmp(arg, "--jobs")) {
+            char *endptr = NULL;
+            if (curr_arg + 1 < argc)
+               threads = (int) strtol(argv[++curr_arg], &endptr, 10);
+            if (endptr == NULL || *endptr != '\0' || threads < 1) {
+               fprintf(stderr, "Error: \"%s\" needs a number of threads\n",
+                  arg);
+               errcode = 1;
+            }
+         }
 
          // Unknown argument
          else {
@@ -101,17 +179,18 @@ int main(int argc, char **argv) {
          }
       }
 
-      // Input filename?
-      else if (infilename == NULL)
-         infilename = arg;
-
-      // Output filename?
-      else if (outfilename == NULL)
-         outfilename = arg;
-
-      // Too many files specified?
+      // Filename?
       else
-         err_manyfiles = 1;
+         filenames[numfiles++] = arg;
+   }
+
+   // Get filenames
+   if (action == ACTION_TRAIN) {
+      if (numfiles >= 1) outfilename = filenames[0];
+      if (numfiles >= 2) infilename = filenames[1];
+   } else {
+      if (numfiles >= 1) infilename = filenames[0];
+      if (numfiles >= 2) outfilename = filenames[1];
    }
 
    // Look for error conditions
@@ -125,7 +204,7 @@ int main(int argc, char **argv) {
       } else if (outfilename == NULL) {
          errcode = 1;
          fprintf(stderr, "Error: output filename missing\n");
-      } else if (err_manyfiles) {
+      } else if (numfiles > 2 && action != ACTION_TRAIN) {
          errcode = 1;
          fprintf(stderr, "Error: too many filenames specified\n");
       }
@@ -134,10 +213,24 @@ int main(int argc, char **argv) {
       errcode = 1;
       fprintf(stderr, "Error: too many formats specified\n");
    }
+   if (format == FORMAT_CHUNKED && inplace != INPLACE_NONE) {
+      errcode = 1;
+      fprintf(stderr, "Error: can't use in-place options with chunks\n");
+   }
+   if (format == FORMAT_CHUNKED && dictfilename != NULL) {
+      errcode = 1;
+      fprintf(stderr, "Error: can't use a dictionary with chunks\n");
+   }
+   if (parse == PARSE_TOOMANY) {
+      errcode = 1;
+      fprintf(stderr, "Error: can't specify more than one parse mode\n");
+   }
 
    // If there was an error then quit
-   if (errcode)
+   if (errcode) {
+      free(filenames);
       return EXIT_FAILURE;
+   }
 
    // No action specified?
    if (action == ACTION_DEFAULT)
@@ -147,9 +240,14 @@ int main(int argc, char **argv) {
    if (format == FORMAT_DEFAULT)
       format = FORMAT_SLZ16;
 
+   // No parse specified?
+   if (parse == PARSE_DEFAULT)
+      parse = PARSE_GREEDY;
+
    // Show tool version?
    if (show_ver) {
       puts("1.2b");
+      free(filenames);
       return EXIT_SUCCESS;
    }
 
@@ -158,33 +256,66 @@ int main(int argc, char **argv) {
       printf("Usage:\n"
              "  %s -c <infile> <outfile>\n"
              "  %s -d <infile> <outfile>\n"
+             "  %s -t <dictfile> <infile> [<infile> ...]\n"
              "\n"
              "Options:\n"
              "  -c or --compress ..... Compress a blob into SLZ\n"
              "  -d or --decompress ... Decompress SLZ into a blob\n"
+             "  -t or --train ........ Train a dictionary from many blobs\n"
+             "  -D or --dict <file> .. Use a preset dictionary\n"
              "  -16 or --slz16 ....... Use SLZ16 format (64KB limit)\n"
              "  -24 or --slz24 ....... Use SLZ24 format (16MB limit)\n"
+             "  -x or --slzx ......... Use SLZX format (64KB limit)\n"
+             "  -k or --chunked ...... Use chunked container (SLZ16 chunks)\n"
+             "  -n or --chunk-size <n>  Size of each chunk (default 4096)\n"
+             "  -b or --best ......... Optimal parse (smallest size)\n"
+             "  -bs or --best-speed .. Optimal parse (fastest to decompress)\n"
+             "  -j or --jobs <n> ..... Use <n> threads to compress\n"
+             "  -m or --margin ....... Report in-place decompression offset\n"
+             "  -i or --in-place ..... Pad output for in-place decompression\n"
              "  -h or --help ......... Show this help\n"
              "  -v or --version ...... Show tool version\n"
              "\n"
              "If no option is specified, compression is done by default.\n"
              "If no format is specified, SLZ16 is used by default.\n",
-             argv[0], argv[0]);
+             argv[0], argv[0], argv[0]);
+      free(filenames);
       return EXIT_SUCCESS;
    }
 
-   // Open input file
-   FILE *infile = fopen(infilename, "rb");
-   if (infile == NULL) {
-      fprintf(stderr, "Error: can't open input file \"%s\"\n", infilename);
-      return EXIT_FAILURE;
+   // Load dictionary if needed
+   uint8_t *dict = NULL;
+   size_t dictsize = 0;
+   if (dictfilename != NULL) {
+      if (load_dictionary(dictfilename, &dict, &dictsize)) {
+         fprintf(stderr, "Error: can't load dictionary \"%s\"\n",
+            dictfilename);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Open input file (when training, the corpus files get opened as
+   // they're needed instead)
+   FILE *infile = NULL;
+   if (action != ACTION_TRAIN) {
+      infile = fopen(infilename, "rb");
+      if (infile == NULL) {
+         fprintf(stderr, "Error: can't open input file \"%s\"\n",
+            infilename);
+         free(dict);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
    }
 
    // Open output file
    FILE *outfile = fopen(outfilename, "wb");
    if (outfile == NULL) {
       fprintf(stderr, "Error: can't open output file \"%s\"\n", outfilename);
-      fclose(infile);
+      if (infile) fclose(infile);
+      free(dict);
+      free(filenames);
       return EXIT_FAILURE;
    }
 
@@ -192,12 +323,26 @@ int main(int argc, char **argv) {
    switch (action) {
       // Compress file
       case ACTION_COMPRESS:
-         errcode = compress(infile, outfile, format);
+         if (format == FORMAT_CHUNKED)
+            errcode = compress_chunked(infile, outfile,
+                                       (unsigned)(chunksize),
+                                       parse, threads);
+         else
+            errcode = compress(infile, outfile, format, parse, threads,
+                               inplace, dict, dictsize);
          break;
 
       // Decompress file
       case ACTION_DECOMPRESS:
-         errcode = decompress(infile, outfile, format);
+         if (format == FORMAT_CHUNKED)
+            errcode = decompress_chunked(infile, outfile);
+         else
+            errcode = decompress(infile, outfile, format, dict, dictsize);
+         break;
+
+      // Train dictionary
+      case ACTION_TRAIN:
+         errcode = train_dictionary(filenames + 1, numfiles - 1, outfile);
          break;
 
       // Oops!
@@ -217,6 +362,8 @@ int main(int argc, char **argv) {
             "65,535 bytes"; break;
          case ERR_TOOLARGE24: msg = "input file size can't be over "
             "16,777,215 bytes"; break;
+         case ERR_MANYCHUNKS: msg = "too many chunks (try a larger chunk "
+            "size)"; break;
          case ERR_CORRUPT: msg = "input file isn't valid SLZ"; break;
          case ERR_NOMEMORY: msg = "ran out of memory"; break;
          default: msg = "unknown error"; break;
@@ -228,8 +375,10 @@ int main(int argc, char **argv) {
 
    // Quit program
    fclose(outfile);
-   fclose(infile);
+   if (infile) fclose(infile);
    if (errcode) remove(outfilename);
+   free(dict);
+   free(filenames);
    return errcode ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
@@ -277,6 +426,29 @@ int read_tribyte(FILE *infile, uint32_t *buffer) {
    return ERR_NONE;
 }
 
+//***************************************************************************
+// read_long
+// Reads a 32-bit value from a file
+//---------------------------------------------------------------------------
+// param infile: input file
+// param buffer: where to store value
+// return: error code
+//***************************************************************************
+
+int read_long(FILE *infile, uint32_t *buffer) {
+   // Try to read from input file
+   uint8_t temp[4];
+   if (fread(temp, 1, 4, infile) < 4)
+      return ferror(infile) ? ERR_CANTREAD : ERR_CORRUPT;
+
+   // Parse value
+   *buffer = (uint32_t)(temp[0]) << 24 | temp[1] << 16 |
+             temp[2] << 8 | temp[3];
+
+   // Success!
+   return ERR_NONE;
+}
+
 //***************************************************************************
 // write_word
 // Writes a 16-bit value into a file
@@ -318,3 +490,24 @@ int write_tribyte(FILE *outfile, const uint32_t value) {
    // Success!
    return ERR_NONE;
 }
+
+//***************************************************************************
+// write_long
+// Writes a 32-bit value into a file
+//---------------------------------------------------------------------------
+// param outfile: output file
+// param value: value to be written
+// return: error code
+//***************************************************************************
+
+int write_long(FILE *outfile, const uint32_t value) {
+   // Split value into bytes
+   uint8_t temp[4] = { value >> 24, value >> 16, value >> 8, value & 0xFF };
+
+   // Try to write into file
+   if (fwrite(temp, 1, 4, outfile) < 4)
+      return ERR_CANTWRITE;
+
+   // Success!
+   return ERR_NONE;
+}
@@ -37,6 +37,7 @@ enum {
    ERR_CANTWRITE,       // Can't write into output file
    ERR_TOOLARGE16,      // File is too large for SLZ16
    ERR_TOOLARGE24,      // File is too large for SLZ24
+   ERR_MANYCHUNKS,      // Too many chunks for chunked container
    ERR_CORRUPT,         // File is corrupt?
    ERR_NOMEMORY,        // Ran out of memory
    ERR_UNKNOWN          // Unknown error
@@ -47,13 +48,33 @@ enum {
    FORMAT_DEFAULT,      // No format specified
    FORMAT_SLZ16,        // SLZ16 (16-bit size)
    FORMAT_SLZ24,        // SLZ24 (24-bit size)
+   FORMAT_SLZX,         // SLZX (16-bit size, extended strings)
+   FORMAT_CHUNKED,      // Chunked container (SLZ16 chunks)
    FORMAT_TOOMANY       // Too many formats specified
 };
 
+// Possible ways to parse the data
+enum {
+   PARSE_DEFAULT,       // No parse specified
+   PARSE_GREEDY,        // Always take the longest string
+   PARSE_BEST,          // Optimal parse (smallest size)
+   PARSE_BESTSPEED,     // Optimal parse (fastest decompression)
+   PARSE_TOOMANY        // Too many parses specified
+};
+
+// In-place decompression options
+enum {
+   INPLACE_NONE,        // Don't care about in-place decompression
+   INPLACE_REPORT,      // Report where compressed data can go
+   INPLACE_PAD          // Pad compressed data to be loaded as-is
+};
+
 // Function prototypes
 int read_word(FILE *, uint16_t *);
 int read_tribyte(FILE *, uint32_t *);
+int read_long(FILE *, uint32_t *);
 int write_word(FILE *, const uint16_t);
 int write_tribyte(FILE *, const uint32_t);
+int write_long(FILE *, const uint32_t);
 
 #endif
@@ -0,0 +1,302 @@
+//***************************************************************************
+// "match.c"
+// Looks for repeated strings using hash chains
+//***************************************************************************
+// Slz compression tool
+//
+// This file is part of the slz tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+// Required headers
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "main.h"
+#include "match.h"
+
+// Size of the hash table (in bits)
+#define HASH_BITS 16
+#define HASH_SIZE (1 << HASH_BITS)
+
+// Size of the chain links (must be a power of two larger than MAX_DIST and
+// SLZX_MAX_DIST)
+#define RING_SIZE 0x2000
+#define RING_MASK (RING_SIZE - 1)
+
+// Smallest range worth giving to a thread
+#define MIN_RANGE 0x10000
+
+// Range of positions looked up by a thread
+typedef struct {
+   pthread_t thread;          // Thread doing the job
+   int started;               // Set if the thread was started
+   const uint8_t *blob;       // Data being compressed
+   size_t size;               // Size of the data
+   Match *table;              // Where to store the strings
+   int format;                // Format the strings are for
+   size_t start;              // First position to look up
+   size_t end;                // Position after the last one to look up
+   int errcode;               // Error code
+} Job;
+
+// Function prototypes
+static void *run_job(void *);
+
+//***************************************************************************
+// hash [internal]
+// Computes the hash for the three bytes starting at the given address
+//---------------------------------------------------------------------------
+// param ptr: pointer to data
+// return: hash value
+//***************************************************************************
+
+static inline unsigned hash(const uint8_t *ptr) {
+   uint32_t value = ptr[0] << 16 | ptr[1] << 8 | ptr[2];
+   return (value * 0x9E3779B1) >> (32 - HASH_BITS);
+}
+
+//***************************************************************************
+// init_match_finder
+// Initializes a match finder. Only strings starting at the given position
+// or later can be looked up (the window before it is taken into account).
+//---------------------------------------------------------------------------
+// param finder: pointer to match finder
+// param blob: data being compressed
+// param size: size of the data
+// param start: first position that will be looked up
+// param format: format the strings are for
+// return: error code
+//***************************************************************************
+
+int init_match_finder(MatchFinder *finder, const uint8_t *blob,
+size_t size, size_t start, int format) {
+   // Allocate memory for the chains
+   finder->head = (int32_t *) malloc(sizeof(int32_t) * HASH_SIZE);
+   finder->prev = (int32_t *) malloc(sizeof(int32_t) * RING_SIZE);
+   if (finder->head == NULL || finder->prev == NULL) {
+      free(finder->head);
+      free(finder->prev);
+      return ERR_NOMEMORY;
+   }
+
+   // Chains are empty for now
+   size_t i;
+   for (i = 0; i < HASH_SIZE; i++)
+      finder->head[i] = -1;
+
+   // Set up the limits of the strings
+   if (format == FORMAT_SLZX) {
+      finder->min_dist = SLZX_MIN_DIST;
+      finder->max_dist = SLZX_MAX_DIST;
+      finder->max_len = SLZX_MAX_LEN;
+   } else {
+      finder->min_dist = MIN_DIST;
+      finder->max_dist = MAX_DIST;
+      finder->max_len = MAX_LEN;
+   }
+
+   // Strings can only be as far as the window allows, so don't bother
+   // inserting anything earlier than that
+   finder->blob = blob;
+   finder->size = size;
+   finder->next = start > finder->max_dist ? start - finder->max_dist : 0;
+
+   // Success!
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// find_match
+// Looks for the longest string that can be used at the given position. If
+// several strings are equally long, the closest one is picked. Positions
+// must be looked up in increasing order.
+//---------------------------------------------------------------------------
+// param finder: pointer to match finder
+// param pos: position to look up
+// return: longest string found (length is 0 if none)
+//***************************************************************************
+
+Match find_match(MatchFinder *finder, size_t pos) {
+   Match match = { 0, 0 };
+
+   // First byte is always uncompressed
+   // Also if there are too few bytes left, we can't compress them, so
+   // don't bother scanning those either
+   const size_t size = finder->size;
+   if (pos == 0 || size - pos < MIN_LEN)
+      return match;
+
+   // Add all the positions we skipped into the chains
+   const uint8_t *blob = finder->blob;
+   int32_t *head = finder->head;
+   int32_t *prev = finder->prev;
+   for (; finder->next < pos; finder->next++) {
+      unsigned value = hash(&blob[finder->next]);
+      prev[finder->next & RING_MASK] = head[value];
+      head[value] = (int32_t)(finder->next);
+   }
+
+   // Determine limits of the search
+   const size_t min_dist = finder->min_dist;
+   const size_t max_dist = finder->max_dist;
+   int32_t limit = (int32_t)(pos > max_dist ? pos - max_dist : 0);
+   unsigned max_len = size - pos > finder->max_len ?
+                      finder->max_len : size - pos;
+   unsigned best_len = MIN_LEN - 1;
+
+   // Go through all strings with the same hash, closest first
+   const uint8_t *target = &blob[pos];
+   int32_t curr = head[hash(target)];
+   for (; curr >= limit; curr = prev[curr & RING_MASK]) {
+      // Too close?
+      size_t dist = pos - (size_t)(curr);
+      if (dist < min_dist)
+         continue;
+
+      // To avoid wasting time on strings that can't be any longer than
+      // the one we have already...
+      const uint8_t *other = &blob[curr];
+      if (other[best_len] != target[best_len])
+         continue;
+
+      // Check how long is the string
+      unsigned len = 0;
+      while (len < max_len && other[len] == target[len])
+         len++;
+
+      // Better than what we had?
+      if (len > best_len) {
+         best_len = len;
+         match.dist = (uint16_t)(dist);
+         match.len = (uint16_t)(len);
+         if (len == max_len)
+            break;
+      }
+   }
+
+   // Return whatever we found
+   return match;
+}
+
+//***************************************************************************
+// find_all_matches
+// Looks for the longest string at every position of the data. The work can
+// be split among several threads, each one taking care of its own range of
+// positions (the result is the same regardless of the amount of threads).
+//---------------------------------------------------------------------------
+// param blob: data being compressed
+// param size: size of the data
+// param table: where to store the strings (one entry per byte)
+// param threads: how many threads to use
+// param format: format the strings are for
+// return: error code
+//***************************************************************************
+
+int find_all_matches(const uint8_t *blob, size_t size, Match *table,
+int threads, int format) {
+   // Not worth splitting up tiny amounts of data
+   if (threads < 1)
+      threads = 1;
+   if (size / MIN_RANGE < (size_t)(threads))
+      threads = (int)(size / MIN_RANGE) + 1;
+
+   // Allocate memory for each thread's job
+   Job *jobs = (Job *) malloc(sizeof(Job) * threads);
+   if (jobs == NULL) return ERR_NOMEMORY;
+
+   // Split the data among all threads
+   int i;
+   for (i = 0; i < threads; i++) {
+      jobs[i].blob = blob;
+      jobs[i].size = size;
+      jobs[i].table = table;
+      jobs[i].format = format;
+      jobs[i].start = size * i / threads;
+      jobs[i].end = size * (i+1) / threads;
+      jobs[i].errcode = ERR_NONE;
+   }
+
+   // Start all threads but the first one (we'll take care of that range
+   // ourselves). If a thread can't be started, then do its job here.
+   for (i = 1; i < threads; i++) {
+      if (pthread_create(&jobs[i].thread, NULL, run_job, &jobs[i]))
+         jobs[i].started = 0;
+      else
+         jobs[i].started = 1;
+   }
+   run_job(&jobs[0]);
+
+   // Wait for all threads to finish
+   int errcode = jobs[0].errcode;
+   for (i = 1; i < threads; i++) {
+      if (jobs[i].started)
+         pthread_join(jobs[i].thread, NULL);
+      else
+         run_job(&jobs[i]);
+      if (jobs[i].errcode)
+         errcode = jobs[i].errcode;
+   }
+
+   // Done with the jobs
+   free(jobs);
+   return errcode;
+}
+
+//***************************************************************************
+// run_job [internal]
+// Looks for the longest string at every position in a range
+//---------------------------------------------------------------------------
+// param ptr: pointer to job
+// return: NULL
+//***************************************************************************
+
+static void *run_job(void *ptr) {
+   Job *job = (Job *) ptr;
+
+   // Set up the match finder
+   // It will take into account the window before our range on its own
+   MatchFinder finder;
+   job->errcode = init_match_finder(&finder, job->blob, job->size,
+                                    job->start, job->format);
+   if (job->errcode) return NULL;
+
+   // Look up every position
+   size_t pos;
+   for (pos = job->start; pos < job->end; pos++)
+      job->table[pos] = find_match(&finder, pos);
+
+   // Done with it
+   deinit_match_finder(&finder);
+   return NULL;
+}
+
+//***************************************************************************
+// deinit_match_finder
+// Frees up the resources used by a match finder
+//---------------------------------------------------------------------------
+// param finder: pointer to match finder
+//***************************************************************************
+
+void deinit_match_finder(MatchFinder *finder) {
+   free(finder->head);
+   free(finder->prev);
+   finder->head = NULL;
+   finder->prev = NULL;
+}
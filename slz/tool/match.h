@@ -0,0 +1,69 @@
+//***************************************************************************
+// "match.h"
+// Header file for "match.c"
+//***************************************************************************
+// Slz compression tool
+//
+// This file is part of the slz tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+#ifndef MATCH_H
+#define MATCH_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+
+// Limits of SLZ strings
+#define MIN_DIST 3            // Shortest distance allowed
+#define MAX_DIST 0x1002       // Longest distance allowed
+#define MIN_LEN 3             // Shortest length allowed
+#define MAX_LEN 18            // Longest length allowed
+
+// Limits of SLZX strings (shortest length is the same)
+#define SLZX_MIN_DIST 1       // Shortest distance allowed
+#define SLZX_MAX_DIST 0x1000  // Longest distance allowed
+#define SLZX_MAX_SHORT 17     // Longest length without extra byte
+#define SLZX_MAX_LEN 273      // Longest length allowed
+
+// Longest string found at a given position
+typedef struct {
+   uint16_t dist;             // Distance to string
+   uint16_t len;              // Length of string (0 = no match)
+} Match;
+
+// Hash chains used to look for strings
+typedef struct {
+   const uint8_t *blob;       // Data being compressed
+   size_t size;               // Size of the data
+   size_t next;               // Next position to insert into the chains
+   unsigned min_dist;         // Shortest distance allowed
+   unsigned max_dist;         // Longest distance allowed
+   unsigned max_len;          // Longest length allowed
+   int32_t *head;             // Most recent position for each hash
+   int32_t *prev;             // Previous position with the same hash
+} MatchFinder;
+
+// Function prototypes
+int init_match_finder(MatchFinder *, const uint8_t *, size_t, size_t, int);
+Match find_match(MatchFinder *, size_t);
+int find_all_matches(const uint8_t *, size_t, Match *, int, int);
+void deinit_match_finder(MatchFinder *);
+
+#endif
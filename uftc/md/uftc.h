@@ -13,5 +13,8 @@
 // Function prototypes
 void decompress_uftc(uint16_t *, const uint16_t *, uint16_t, uint16_t);
 void decompress_uftc15(int16_t *, const int16_t *, int16_t, int16_t);
+void decompress_uftc_dict(uint16_t *, const uint16_t *, const uint16_t *,
+                          uint16_t, uint16_t);
+void decompress_uftcx(uint16_t *, const uint16_t *, uint16_t, uint16_t);
 
 #endif
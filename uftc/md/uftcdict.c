@@ -0,0 +1,56 @@
+// Required headers
+#include <stdint.h>
+
+//***************************************************************************
+// decompress_uftc_dict
+// Decompresses tiles stored in UFTC format that use a shared dictionary
+//---------------------------------------------------------------------------
+// param out: where to store decompressed tiles
+// param in: pointer to UFTC tiles (made with -D, no dictionary)
+// param dict: pointer to shared dictionary
+// param start: ID of first tile to decompress (counting from 0)
+// param count: how many tiles to decompress
+//***************************************************************************
+
+void decompress_uftc_dict(uint16_t *out, const uint16_t *in,
+const uint16_t *dict, uint16_t start, uint16_t count) {
+   // Get address of first tile to decompress
+   in += (uint32_t) start << 2;
+   
+   // Dictionary offsets are in bytes
+   const uint8_t *base = (const uint8_t *) dict;
+   
+   // Decompress all tiles
+   for (; count != 0; count--) {
+      // To store pointers to 4x4 blocks
+      const uint16_t *block1, *block2;
+      
+      // Retrieve location in the dictionary of first pair of 4x4 blocks
+      block1 = (const uint16_t *)(base + *in++);
+      block2 = (const uint16_t *)(base + *in++);
+      
+      // Decompress first pair of 4x4 blocks
+      *out++ = *block1++;
+      *out++ = *block2++;
+      *out++ = *block1++;
+      *out++ = *block2++;
+      *out++ = *block1++;
+      *out++ = *block2++;
+      *out++ = *block1++;
+      *out++ = *block2++;
+      
+      // Retrieve location in the dictionary of second pair of 4x4 blocks
+      block1 = (const uint16_t *)(base + *in++);
+      block2 = (const uint16_t *)(base + *in++);
+      
+      // Decompress second pair of 4x4 blocks
+      *out++ = *block1++;
+      *out++ = *block2++;
+      *out++ = *block1++;
+      *out++ = *block2++;
+      *out++ = *block1++;
+      *out++ = *block2++;
+      *out++ = *block1++;
+      *out++ = *block2++;
+   }
+}
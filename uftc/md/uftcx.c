@@ -0,0 +1,79 @@
+// Required headers
+#include <stdint.h>
+
+// Function prototypes
+static uint16_t mirror_row(uint16_t);
+
+//***************************************************************************
+// decompress_uftcx
+// Decompresses tiles stored in UFTC-X format
+//---------------------------------------------------------------------------
+// param out: where to store decompressed tiles
+// param in: pointer to UFTC-X data
+// param start: ID of first tile to decompress (counting from 0)
+// param count: how many tiles to decompress
+//***************************************************************************
+
+void decompress_uftcx(uint16_t *out, const uint16_t *in, uint16_t start,
+uint16_t count) {
+   // Where each 4x4 block goes within a tile (in words)
+   static const uint8_t offsets[] = { 0, 1, 8, 9 };
+   
+   // Get addresses of dictionary and tiles (offsets are in bytes)
+   const uint8_t *dict = (const uint8_t *)(in + 1);
+   const uint8_t *tiles = dict + *in;
+   
+   // Skip the tiles before the first one (repeated tiles take up one word
+   // and the others four words)
+   const uint16_t *ptr = (const uint16_t *) tiles;
+   for (; start != 0; start--)
+      ptr += *ptr & 0x8000 ? 1 : 4;
+   
+   // Decompress all tiles
+   for (; count != 0; count--, out += 16) {
+      // Repeated tile? (then the blocks are in the earlier tile)
+      const uint16_t *entry = ptr;
+      uint16_t flip = 0;
+      if (*ptr & 0x8000) {
+         entry = (const uint16_t *)(tiles + (*ptr & 0x7FFE));
+         flip = *ptr & 1;
+         ptr++;
+      } else {
+         ptr += 4;
+      }
+   
+      // Decompress each 4x4 block (flipping the tile also swaps the left
+      // and right blocks)
+      int i;
+      for (i = 0; i < 4; i++) {
+         uint16_t id = entry[i] ^ flip;
+         const uint16_t *block = (const uint16_t *)(dict + (id & 0xFFFE));
+         uint16_t *dest = out + (offsets[i] ^ flip);
+   
+         if (id & 1) {
+            dest[0] = mirror_row(block[0]);
+            dest[2] = mirror_row(block[1]);
+            dest[4] = mirror_row(block[2]);
+            dest[6] = mirror_row(block[3]);
+         } else {
+            dest[0] = block[0];
+            dest[2] = block[1];
+            dest[4] = block[2];
+            dest[6] = block[3];
+         }
+      }
+   }
+}
+
+//***************************************************************************
+// mirror_row [internal]
+// Flips a row of a 4x4 block horizontally
+//---------------------------------------------------------------------------
+// param row: row to flip (four pixels)
+// return: flipped row
+//***************************************************************************
+
+static uint16_t mirror_row(uint16_t row) {
+   return (row & 0x000F) << 12 | (row & 0x00F0) << 4 |
+          (row & 0x0F00) >> 4 | (row & 0xF000) >> 12;
+}
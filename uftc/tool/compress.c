@@ -24,15 +24,41 @@
 // 3. This notice may not be removed or altered from any source distribution.
 //***************************************************************************
 
+
 // Required headers
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "main.h"
+#include "compress.h"
+#include "dict.h"
+#include "layout.h"
+#include "lossy.h"
+
+// Size of the hash table used to find repeated tiles
+#define HASH_SIZE 0x10000
 
 // Function prototypes
-static int putblock(uint8_t **, size_t *, const uint8_t *, uint16_t *);
+static int read_blocks(FILE *, uint8_t **, size_t *);
+static int read_file(FILE *, uint8_t **, size_t *);
+static int split_blocks(const uint8_t *, size_t, uint8_t **, size_t *);
+static int make_dictionary(const uint8_t *, size_t, int, Dictionary *,
+                           uint32_t *);
+static int build_dictionary(const uint8_t *, size_t, Dictionary *,
+                            uint32_t *);
+static int use_shared(const uint8_t *, size_t, const uint8_t *, size_t,
+                      Dictionary *, uint32_t *);
+static int make_dictionary_x(const uint8_t *, size_t, int, Dictionary *,
+                             uint32_t *);
+static int make_tiles(const uint32_t *, size_t, uint8_t **, size_t *);
+static int make_tiles_x(const uint8_t *, const uint32_t *, size_t,
+                        uint8_t **, size_t *);
+static uint32_t find_tile(const uint8_t *, const uint32_t *,
+                          const uint32_t *, const uint8_t *);
+static uint32_t hash_tile(const uint8_t *);
+static int get_plain_size(const uint8_t *, size_t, int, size_t *);
+static size_t get_inplace_offset(const uint8_t *, size_t, size_t, int);
 
 //***************************************************************************
 // compress
@@ -41,186 +67,824 @@ static int putblock(uint8_t **, size_t *, const uint8_t *, uint16_t *);
 // param infile: input file
 // param outfile: output file
 // param format: format to output for
+// param inplace: whether to pad for in-place decompression
+// param best: set to optimize the dictionary layout
+// param shared: shared dictionary (NULL if none)
+// param sharedsize: size of shared dictionary
+// param lossy: lossy compression settings (NULL if lossless)
+// param report: where to store what to report
 // return: error code
 //***************************************************************************
 
-int compress(FILE *infile, FILE *outfile, int format) {
+int compress(FILE *infile, FILE *outfile, int format, int inplace, int best,
+const uint8_t *shared, size_t sharedsize, const Lossy *lossy,
+CompressReport *report) {
    // To store error codes
    int errcode;
 
-   // To store the dictionary
-   uint8_t *dictionary = NULL;
-   size_t dicsize = 0;
+   // Load input file into memory
+   uint8_t *blob;
+   size_t size;
+   errcode = read_file(infile, &blob, &size);
+   if (errcode) return errcode;
 
-   // To store compressed tiles
-   uint8_t *tiles = NULL;
-   size_t tilesize = 0;
+   // Compress the blob
+   uint8_t *buffer;
+   size_t bufsize, offset;
+   errcode = compress_blob(blob, size, format, best, shared, sharedsize,
+                           lossy, &buffer, &bufsize, &offset, report);
+   free(blob);
+   if (errcode) return errcode;
 
-   // While there're tiles to read...
-   for (;;) {
-      // Read next raw tile, if any
-      uint8_t rawtile[0x20];
-      size_t numread = fread(rawtile, 1, 0x20, infile);
-      if (numread == 0 && feof(infile))
-         break;
-      else if (numread < 0x20)
-         return ferror(infile) ? ERR_CANTREAD : ERR_BADSIZE;
+   // Pad the data so it can be loaded straight into the output buffer?
+   report->offset = offset;
+   if (inplace == INPLACE_PAD) {
+      for (; offset > 0; offset--) {
+         if (fputc(0x00, outfile) == EOF) {
+            free(buffer);
+            return ERR_CANTWRITE;
+         }
+      }
+   }
 
-      // To store block contents
-      uint8_t block[8];
-      uint16_t blockid[4];
+   // Write compressed data into output file
+   if (fwrite(buffer, 1, bufsize, outfile) < bufsize) {
+      free(buffer);
+      return ERR_CANTWRITE;
+   }
 
-      // Look for first block
-      block[0] = rawtile[0];  block[1] = rawtile[1];
-      block[2] = rawtile[4];  block[3] = rawtile[5];
-      block[4] = rawtile[8];  block[5] = rawtile[9];
-      block[6] = rawtile[12]; block[7] = rawtile[13];
+   // Success!
+   free(buffer);
+   return ERR_NONE;
+}
 
-      errcode = putblock(&dictionary, &dicsize, block, &blockid[0]);
-      if (errcode) {
-         if (dictionary) free(dictionary);
-         if (tiles) free(tiles);
-         return errcode;
-      }
+//***************************************************************************
+// compress_blob
+// Compresses a blob of tiles in memory into UFTC. Also works out how far
+// ahead of the output the compressed data must be for in-place
+// decompression to be safe (it's assumed to be placed at the end of the
+// output buffer).
+//---------------------------------------------------------------------------
+// param blob: tiles to compress
+// param size: size of the tiles in bytes
+// param format: format to output for
+// param best: set to optimize the dictionary layout
+// param shared: shared dictionary (NULL if none, in which case only the
+//               compressed tiles are output)
+// param sharedsize: size of shared dictionary
+// param lossy: lossy compression settings (NULL if lossless)
+// param output: where to store pointer to compressed data (must be freed)
+// param outsize: where to store size of compressed data
+// param offset: where to store the in-place offset (can be NULL)
+// param report: where to store what to report (can be NULL)
+// return: error code
+//***************************************************************************
 
-      // Look for second block
-      block[0] = rawtile[2];  block[1] = rawtile[3];
-      block[2] = rawtile[6];  block[3] = rawtile[7];
-      block[4] = rawtile[10]; block[5] = rawtile[11];
-      block[6] = rawtile[14]; block[7] = rawtile[15];
+int compress_blob(const uint8_t *blob, size_t size, int format, int best,
+const uint8_t *shared, size_t sharedsize, const Lossy *lossy,
+uint8_t **output, size_t *outsize, size_t *offset, CompressReport *report) {
+   // To store error codes
+   int errcode;
 
-      errcode = putblock(&dictionary, &dicsize, block, &blockid[1]);
-      if (errcode) {
-         if (dictionary) free(dictionary);
-         if (tiles) free(tiles);
-         return errcode;
-      }
+   // Split all the tiles into 4x4 blocks
+   uint8_t *blocks;
+   size_t numblocks;
+   errcode = split_blocks(blob, size, &blocks, &numblocks);
+   if (errcode) return errcode;
 
-      // Look for third block
-      block[0] = rawtile[16]; block[1] = rawtile[17];
-      block[2] = rawtile[20]; block[3] = rawtile[21];
-      block[4] = rawtile[24]; block[5] = rawtile[25];
-      block[6] = rawtile[28]; block[7] = rawtile[29];
+   if (numblocks == 0) {
+      free(blocks);
+      return ERR_TOOSMALL;
+   }
 
-      errcode = putblock(&dictionary, &dicsize, block, &blockid[2]);
+   // Replace blocks that are close enough to others if lossy compression
+   // was requested
+   if (lossy != NULL) {
+      LossyStats stats;
+      errcode = merge_blocks(blocks, numblocks, lossy, &stats);
       if (errcode) {
-         if (dictionary) free(dictionary);
-         if (tiles) free(tiles);
+         free(blocks);
          return errcode;
       }
+      if (report != NULL)
+         report->lossy = stats;
+   }
 
-      // Look for fourth block
-      block[0] = rawtile[18]; block[1] = rawtile[19];
-      block[2] = rawtile[22]; block[3] = rawtile[23];
-      block[4] = rawtile[26]; block[5] = rawtile[27];
-      block[6] = rawtile[30]; block[7] = rawtile[31];
+   // To store where each block is in the dictionary
+   uint32_t *ids = (uint32_t *) malloc(sizeof(uint32_t) * numblocks);
+   if (ids == NULL) {
+      free(blocks);
+      return ERR_NOMEMORY;
+   }
 
-      errcode = putblock(&dictionary, &dicsize, block, &blockid[3]);
-      if (errcode) {
-         if (dictionary) free(dictionary);
-         if (tiles) free(tiles);
-         return errcode;
-      }
+   // Make the dictionary (or look up the blocks in the shared one)
+   Dictionary dict;
+   if (shared != NULL)
+      errcode = use_shared(blocks, numblocks, shared, sharedsize,
+                           &dict, ids);
+   else if (format == FORMAT_UFTCX)
+      errcode = make_dictionary_x(blocks, numblocks, best, &dict, ids);
+   else
+      errcode = make_dictionary(blocks, numblocks, best, &dict, ids);
+   if (errcode) {
+      free(blocks);
+      free(ids);
+      return errcode;
+   }
 
-      // Put compressed tile into list
-      tilesize += 8;
-      uint8_t *temp = (uint8_t *) realloc(tiles, tilesize);
-      if (temp == NULL) {
-         if (dictionary) free(dictionary);
-         if (tiles) free(tiles);
-         return ERR_NOMEMORY;
-      }
-      tiles = temp;
-      temp = tiles + tilesize - 8;
+   // Make the compressed tiles
+   uint8_t *tiles;
+   size_t tilesize;
+   if (format == FORMAT_UFTCX)
+      errcode = make_tiles_x(blocks, ids, numblocks / 4, &tiles, &tilesize);
+   else
+      errcode = make_tiles(ids, numblocks / 4, &tiles, &tilesize);
+   free(ids);
 
-      *temp++ = blockid[0] >> 8; *temp++ = blockid[0] & 0xFF;
-      *temp++ = blockid[1] >> 8; *temp++ = blockid[1] & 0xFF;
-      *temp++ = blockid[2] >> 8; *temp++ = blockid[2] & 0xFF;
-      *temp++ = blockid[3] >> 8; *temp++ = blockid[3] & 0xFF;
-   }
+   // For UFTC-X also tell how large it'd be as plain UFTC16, so it's easy
+   // to tell which one is better for each asset
+   size_t plainsize = 0;
+   if (!errcode && format == FORMAT_UFTCX)
+      errcode = get_plain_size(blocks, numblocks, best, &plainsize);
+   free(blocks);
 
-   // Check that dictionary is OK
-   if (dicsize == 0)
-      return ERR_TOOSMALL;
-   else if ((dicsize >= 0x8000 && format == FORMAT_UFTC15) ||
-   (dicsize >= 0x10000 && format == FORMAT_UFTC16)) {
-      free(dictionary);
+   if (errcode) {
       free(tiles);
-      return ERR_TOOBIG;
+      free_dictionary(&dict);
+      return errcode;
    }
 
-   // Write dictionary size
-   errcode = write_word(outfile, dicsize);
-   if (errcode) {
+   // We don't need the index anymore
+   uint8_t *dictionary = dict.data;
+   size_t dicsize = dict.size;
+   dict.data = NULL;
+   free_dictionary(&dict);
+
+   // With a shared dictionary only the tiles are output, the dictionary
+   // goes somewhere else
+   if (shared != NULL) {
       free(dictionary);
-      free(tiles);
-      return errcode;
+      if (offset != NULL)
+         *offset = get_inplace_offset(tiles, tilesize, 0, 0);
+      if (report != NULL) {
+         report->size = tilesize;
+         report->plainsize = tilesize;
+      }
+      *output = tiles;
+      *outsize = tilesize;
+      return ERR_NONE;
    }
 
-   // Write dictionary
-   if (fwrite(dictionary, 1, dicsize, outfile) < dicsize) {
+   // Check that dictionary is OK (UFTC-X uses the top bit of the first
+   // word of each tile to tell apart repeated tiles)
+   if ((dicsize >= 0x8000 && format == FORMAT_UFTC15) ||
+   (dicsize >= 0x10000 && format == FORMAT_UFTC16) ||
+   (dicsize >= 0x8000 && format == FORMAT_UFTCX)) {
       free(dictionary);
       free(tiles);
-      return ERR_CANTWRITE;
+      return ERR_TOOBIG;
+   }
+
+   // Tell the size in both formats
+   if (report != NULL) {
+      report->size = 2 + dicsize + tilesize;
+      report->plainsize = format == FORMAT_UFTCX ? plainsize : report->size;
    }
 
-   // Write compressed tiles
-   if (fwrite(tiles, 1, tilesize, outfile) < tilesize) {
+   // Work out where to put the data for in-place decompression
+   if (offset != NULL)
+      *offset = get_inplace_offset(tiles, tilesize, dicsize, 1);
+
+   // Put together the dictionary size, the dictionary and the tiles
+   size_t bufsize = 2 + dicsize + tilesize;
+   uint8_t *buffer = (uint8_t *) malloc(bufsize);
+   if (buffer == NULL) {
       free(dictionary);
       free(tiles);
-      return ERR_CANTWRITE;
+      return ERR_NOMEMORY;
    }
 
+   buffer[0] = dicsize >> 8;
+   buffer[1] = dicsize;
+   memcpy(&buffer[2], dictionary, dicsize);
+   memcpy(&buffer[2 + dicsize], tiles, tilesize);
+
    // We don't need this anymore
    free(dictionary);
    free(tiles);
 
    // Success!
+   *output = buffer;
+   *outsize = bufsize;
    return ERR_NONE;
 }
 
 //***************************************************************************
-// putblock [internal]
-// Looks up for a 4x4 block in the dictionary (adding it if needed), and
-// returns its ID unless something went wrong
+// train_dictionary
+// Builds a dictionary with all the 4x4 blocks used by several tile sets, so
+// they can share it (see the -D option)
+//---------------------------------------------------------------------------
+// param filenames: names of the files with the tile sets
+// param numfiles: number of files
+// param outfile: file where to store the dictionary
+// param format: format to output for
+// param best: set to optimize the dictionary layout
+// return: error code
+//***************************************************************************
+
+int train_dictionary(const char **filenames, int numfiles, FILE *outfile,
+int format, int best) {
+   // To store error codes
+   int errcode;
+
+   // Read the blocks of all the tile sets
+   uint8_t *blocks = NULL;
+   size_t numblocks = 0;
+
+   int i;
+   for (i = 0; i < numfiles; i++) {
+      FILE *infile = fopen(filenames[i], "rb");
+      if (infile == NULL) {
+         free(blocks);
+         return ERR_CANTREAD;
+      }
+
+      uint8_t *more;
+      size_t nummore;
+      errcode = read_blocks(infile, &more, &nummore);
+      fclose(infile);
+      if (errcode) {
+         free(blocks);
+         return errcode;
+      }
+
+      uint8_t *temp = (uint8_t *) realloc(blocks, (numblocks + nummore) * 8);
+      if (temp == NULL && numblocks + nummore > 0) {
+         free(blocks);
+         free(more);
+         return ERR_NOMEMORY;
+      }
+      blocks = temp;
+      memcpy(&blocks[numblocks * 8], more, nummore * 8);
+      numblocks += nummore;
+      free(more);
+   }
+
+   if (numblocks == 0) {
+      free(blocks);
+      return ERR_TOOSMALL;
+   }
+
+   // Make the dictionary
+   uint32_t *ids = (uint32_t *) malloc(sizeof(uint32_t) * numblocks);
+   if (ids == NULL) {
+      free(blocks);
+      return ERR_NOMEMORY;
+   }
+
+   Dictionary dict;
+   errcode = make_dictionary(blocks, numblocks, best, &dict, ids);
+   free(blocks);
+   free(ids);
+   if (errcode) return errcode;
+
+   // Check that it isn't too large
+   if ((dict.size >= 0x8000 && format == FORMAT_UFTC15) ||
+   (dict.size >= 0x10000 && format == FORMAT_UFTC16)) {
+      free_dictionary(&dict);
+      return ERR_TOOBIG;
+   }
+
+   // Write the dictionary (as-is, without size)
+   if (fwrite(dict.data, 1, dict.size, outfile) < dict.size)
+      errcode = ERR_CANTWRITE;
+
+   free_dictionary(&dict);
+   return errcode;
+}
+
+//***************************************************************************
+// read_blocks [internal]
+// Reads all the tiles from a file and splits them into 4x4 blocks (four
+// per tile: top left, top right, bottom left, bottom right)
+//---------------------------------------------------------------------------
+// param infile: input file
+// param blocks: where to store a pointer to the blocks (8 bytes each)
+// param numblocks: where to store the number of blocks
+// return: error code
+//***************************************************************************
+
+static int read_blocks(FILE *infile, uint8_t **blocks, size_t *numblocks) {
+   uint8_t *blob;
+   size_t size;
+   int errcode = read_file(infile, &blob, &size);
+   if (errcode) return errcode;
+
+   errcode = split_blocks(blob, size, blocks, numblocks);
+   free(blob);
+   return errcode;
+}
+
+//***************************************************************************
+// read_file [internal]
+// Loads the whole contents of a file into memory
 //---------------------------------------------------------------------------
-// param dictionary: pointer to dictionary
-// param dicsize: pointer to dictionary size
-// param block: pointer to 4x4 block data
-// param id: where to store block ID
+// param infile: input file
+// param blob: where to store a pointer to the data
+// param size: where to store the size of the data
 // return: error code
 //***************************************************************************
 
-static int putblock(uint8_t **dictionary, size_t *dicsize,
-const uint8_t *block, uint16_t *id) {
-   // Look for a match in the dictionary only if there's a dictionary yet...
-   uint8_t *ptr = *dictionary;
-   if (*dictionary != NULL) {
-      // Look if block is in the dictionary already
-      size_t limit = *dicsize;
-      while (limit >= 8) {
-         // Is it in the dictionary already?
-         if (!memcmp(ptr, block, 8)) {
-            *id = (uint16_t)(ptr - *dictionary);
-            return ERR_NONE;
+static int read_file(FILE *infile, uint8_t **blob, size_t *size) {
+   uint8_t *data = NULL;
+   size_t used = 0;
+   size_t capacity = 0;
+
+   // Read until there isn't anything left (the buffer grows in big steps
+   // so we don't end up reallocating it all the time)
+   for (;;) {
+      if (used == capacity) {
+         size_t newcap = capacity ? capacity * 2 : 0x1000;
+         uint8_t *temp = (uint8_t *) realloc(data, newcap);
+         if (temp == NULL) {
+            free(data);
+            return ERR_NOMEMORY;
          }
+         data = temp;
+         capacity = newcap;
+      }
 
-         // Nope, keep looking
-         ptr += 2;
-         limit -= 2;
-      };
+      used += fread(&data[used], 1, capacity - used, infile);
+      if (used < capacity)
+         break;
    }
 
-   // Block isn't in dictionary, so allocate memory for it
-   *dicsize += 8;
-   ptr = (uint8_t *) realloc(*dictionary, *dicsize);
-   if (ptr == NULL) return ERR_NOMEMORY;
-   *dictionary = ptr;
+   if (ferror(infile)) {
+      free(data);
+      return ERR_CANTREAD;
+   }
 
-   // Store block in dictionary
-   *id = *dicsize - 8;
-   memcpy(*dictionary + *id, block, 8);
+   *blob = data;
+   *size = used;
+   return ERR_NONE;
+}
 
-   // Success!
+//***************************************************************************
+// split_blocks [internal]
+// Splits all the tiles in a blob into 4x4 blocks (four per tile: top left,
+// top right, bottom left, bottom right)
+//---------------------------------------------------------------------------
+// param blob: tiles to split
+// param size: size of the tiles in bytes
+// param blocks: where to store a pointer to the blocks (8 bytes each)
+// param numblocks: where to store the number of blocks
+// return: error code
+//***************************************************************************
+
+static int split_blocks(const uint8_t *blob, size_t size, uint8_t **blocks,
+size_t *numblocks) {
+   // Where each block starts within a tile
+   static const size_t offsets[] = { 0, 2, 16, 18 };
+
+   // Only whole tiles please
+   if (size % 0x20)
+      return ERR_BADSIZE;
+
+   uint8_t *list = (uint8_t *) malloc(size + 1);
+   if (list == NULL)
+      return ERR_NOMEMORY;
+
+   // Split every tile into blocks
+   uint8_t *dest = list;
+   size_t pos;
+   for (pos = 0; pos < size; pos += 0x20) {
+      int i;
+      for (i = 0; i < 4; i++, dest += 8) {
+         const uint8_t *src = &blob[pos + offsets[i]];
+         dest[0] = src[0];  dest[1] = src[1];
+         dest[2] = src[4];  dest[3] = src[5];
+         dest[4] = src[8];  dest[5] = src[9];
+         dest[6] = src[12]; dest[7] = src[13];
+      }
+   }
+
+   *blocks = list;
+   *numblocks = size / 8;
    return ERR_NONE;
 }
+
+//***************************************************************************
+// make_dictionary [internal]
+// Makes a dictionary for a list of blocks, optionally optimizing it
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each)
+// param numblocks: number of blocks
+// param best: set to optimize the dictionary layout
+// param dict: where to store the dictionary
+// param ids: where to store the offset of each block
+// return: error code
+//***************************************************************************
+
+static int make_dictionary(const uint8_t *blocks, size_t numblocks, int best,
+Dictionary *dict, uint32_t *ids) {
+   // Build the dictionary by adding blocks as they show up
+   int errcode = build_dictionary(blocks, numblocks, dict, ids);
+   if (errcode || !best)
+      return errcode;
+
+   // Try to come up with a better layout
+   // Keep whichever dictionary turns out to be smaller
+   Dictionary optimized;
+   errcode = init_dictionary(&optimized);
+   if (!errcode)
+      errcode = optimize_layout(blocks, numblocks, &optimized);
+   if (errcode) {
+      free_dictionary(&optimized);
+      free_dictionary(dict);
+      return errcode;
+   }
+
+   if (optimized.size < dict->size) {
+      Dictionary temp = *dict;
+      *dict = optimized;
+      optimized = temp;
+
+      size_t i;
+      for (i = 0; i < numblocks; i++)
+         ids[i] = find_block(dict, &blocks[i * 8]);
+   }
+
+   free_dictionary(&optimized);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// build_dictionary [internal]
+// Builds a dictionary by adding blocks in the order they show up (unless
+// they're in the dictionary already)
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each)
+// param numblocks: number of blocks
+// param dict: where to store the dictionary
+// param ids: where to store the offset of each block
+// return: error code
+//***************************************************************************
+
+static int build_dictionary(const uint8_t *blocks, size_t numblocks,
+Dictionary *dict, uint32_t *ids) {
+   int errcode = init_dictionary(dict);
+   if (errcode) return errcode;
+
+   size_t i;
+   for (i = 0; i < numblocks; i++) {
+      const uint8_t *block = &blocks[i * 8];
+      ids[i] = find_block(dict, block);
+      if (ids[i] != NO_ENTRY)
+         continue;
+
+      ids[i] = dict->size;
+      errcode = append_dictionary(dict, block, 8);
+      if (errcode) {
+         free_dictionary(dict);
+         return errcode;
+      }
+   }
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// use_shared [internal]
+// Looks up all the blocks in a shared dictionary
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each)
+// param numblocks: number of blocks
+// param shared: shared dictionary
+// param sharedsize: size of shared dictionary
+// param dict: where to store the indexed dictionary
+// param ids: where to store the offset of each block
+// return: error code
+//***************************************************************************
+
+static int use_shared(const uint8_t *blocks, size_t numblocks,
+const uint8_t *shared, size_t sharedsize, Dictionary *dict, uint32_t *ids) {
+   int errcode = init_dictionary(dict);
+   if (errcode) return errcode;
+
+   errcode = append_dictionary(dict, shared, sharedsize);
+   if (errcode) {
+      free_dictionary(dict);
+      return errcode;
+   }
+
+   size_t i;
+   for (i = 0; i < numblocks; i++) {
+      ids[i] = find_block(dict, &blocks[i * 8]);
+      if (ids[i] == NO_ENTRY) {
+         free_dictionary(dict);
+         return ERR_NOTINDICT;
+      }
+   }
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// make_dictionary_x [internal]
+// Makes a dictionary for UFTC-X. A block and its mirror share the same
+// entry, so only one of them is stored. The lowest bit of the offset tells
+// if the block is flipped.
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each)
+// param numblocks: number of blocks
+// param best: set to optimize the dictionary layout
+// param dict: where to store the dictionary
+// param ids: where to store the offset of each block (plus flip flag)
+// return: error code
+//***************************************************************************
+
+static int make_dictionary_x(const uint8_t *blocks, size_t numblocks,
+int best, Dictionary *dict, uint32_t *ids) {
+   // Replace every block with its mirror if the mirror showed up first,
+   // then make the dictionary out of that (keeping the first one that
+   // shows up means fewer flipped blocks, which are slower to decompress)
+   uint8_t *canon = (uint8_t *) malloc(numblocks * 8);
+   if (canon == NULL)
+      return ERR_NOMEMORY;
+
+   Dictionary seen;
+   int errcode = init_dictionary(&seen);
+   if (errcode) {
+      free(canon);
+      return errcode;
+   }
+
+   size_t i;
+   for (i = 0; i < numblocks; i++) {
+      const uint8_t *block = &blocks[i * 8];
+      uint8_t mirrored[8];
+      mirror_block(block, mirrored);
+
+      if (find_block(&seen, block) == NO_ENTRY) {
+         if (find_block(&seen, mirrored) != NO_ENTRY)
+            block = mirrored;
+         else {
+            errcode = append_dictionary(&seen, block, 8);
+            if (errcode) break;
+         }
+      }
+
+      memcpy(&canon[i * 8], block, 8);
+   }
+   free_dictionary(&seen);
+
+   if (!errcode)
+      errcode = make_dictionary(canon, numblocks, best, dict, ids);
+   if (errcode) {
+      free(canon);
+      return errcode;
+   }
+
+   // Mark the blocks that ended up flipped
+   for (i = 0; i < numblocks; i++) {
+      if (memcmp(&canon[i * 8], &blocks[i * 8], 8) != 0)
+         ids[i] |= 1;
+   }
+
+   free(canon);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// make_tiles [internal]
+// Makes the compressed tiles (four block offsets per tile)
+//---------------------------------------------------------------------------
+// param ids: offset of each block in the dictionary
+// param numtiles: number of tiles
+// param tiles: where to store a pointer to the compressed tiles
+// param tilesize: where to store the size of the compressed tiles
+// return: error code
+//***************************************************************************
+
+static int make_tiles(const uint32_t *ids, size_t numtiles, uint8_t **tiles,
+size_t *tilesize) {
+   size_t size = numtiles * 8;
+   uint8_t *buffer = (uint8_t *) malloc(size);
+   *tiles = buffer;
+   if (buffer == NULL)
+      return ERR_NOMEMORY;
+
+   size_t i;
+   for (i = 0; i < numtiles * 4; i++) {
+      buffer[i * 2] = ids[i] >> 8 & 0xFF;
+      buffer[i * 2 + 1] = ids[i] & 0xFF;
+   }
+
+   *tilesize = size;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// make_tiles_x [internal]
+// Makes the compressed tiles for UFTC-X. Tiles that showed up before (as-is
+// or flipped) become a single word referring to the earlier tile, the rest
+// are four block offsets like in UFTC16.
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each, four per tile)
+// param ids: offset of each block in the dictionary (plus flip flag)
+// param numtiles: number of tiles
+// param tiles: where to store a pointer to the compressed tiles
+// param tilesize: where to store the size of the compressed tiles
+// return: error code
+//***************************************************************************
+
+static int make_tiles_x(const uint8_t *blocks, const uint32_t *ids,
+size_t numtiles, uint8_t **tiles, size_t *tilesize) {
+   // Worst case every tile is stored in full
+   uint8_t *buffer = (uint8_t *) malloc(numtiles * 8);
+
+   // Index of the tiles stored in full, to find repeats
+   uint32_t *head = (uint32_t *) malloc(sizeof(uint32_t) * HASH_SIZE);
+   uint32_t *next = (uint32_t *) malloc(sizeof(uint32_t) * numtiles);
+   uint32_t *where = (uint32_t *) malloc(sizeof(uint32_t) * numtiles);
+
+   *tiles = buffer;
+   if (buffer == NULL || head == NULL || next == NULL || where == NULL) {
+      free(head);
+      free(next);
+      free(where);
+      return ERR_NOMEMORY;
+   }
+
+   size_t i;
+   for (i = 0; i < HASH_SIZE; i++)
+      head[i] = NO_ENTRY;
+
+   size_t size = 0;
+   size_t tile;
+   for (tile = 0; tile < numtiles; tile++) {
+      const uint8_t *data = &blocks[tile * 32];
+
+      // Flipping the tile swaps its left and right blocks too
+      uint8_t mirrored[32];
+      mirror_block(&data[8], &mirrored[0]);
+      mirror_block(&data[0], &mirrored[8]);
+      mirror_block(&data[24], &mirrored[16]);
+      mirror_block(&data[16], &mirrored[24]);
+
+      // Did this tile show up already?
+      uint16_t flip = 0;
+      uint32_t found = find_tile(blocks, head, next, data);
+      if (found == NO_ENTRY) {
+         found = find_tile(blocks, head, next, mirrored);
+         flip = 1;
+      }
+      if (found != NO_ENTRY) {
+         uint16_t word = 0x8000 | where[found] | flip;
+         buffer[size++] = word >> 8;
+         buffer[size++] = word & 0xFF;
+         continue;
+      }
+
+      // Nope, store it in full (only tiles within reach of a reference
+      // get indexed)
+      if (size < 0x8000) {
+         uint32_t hash = hash_tile(data);
+         where[tile] = (uint32_t) size;
+         next[tile] = head[hash];
+         head[hash] = (uint32_t) tile;
+      }
+      for (i = 0; i < 4; i++) {
+         uint32_t id = ids[tile * 4 + i];
+         buffer[size++] = id >> 8 & 0xFF;
+         buffer[size++] = id & 0xFF;
+      }
+   }
+
+   free(head);
+   free(next);
+   free(where);
+
+   *tilesize = size;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// find_tile [internal]
+// Looks for a tile among the ones stored in full so far
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each, four per tile)
+// param head: first tile in each hash chain
+// param next: next tile in the same chain (per tile)
+// param data: tile to look for (32 bytes, split into blocks)
+// return: ID of the tile, or NO_ENTRY if not found
+//***************************************************************************
+
+static uint32_t find_tile(const uint8_t *blocks, const uint32_t *head,
+const uint32_t *next, const uint8_t *data) {
+   uint32_t tile;
+   for (tile = head[hash_tile(data)]; tile != NO_ENTRY; tile = next[tile]) {
+      if (memcmp(&blocks[tile * 32], data, 32) == 0)
+         return tile;
+   }
+   return NO_ENTRY;
+}
+
+//***************************************************************************
+// hash_tile [internal]
+// Computes the hash of a tile
+//---------------------------------------------------------------------------
+// param data: tile (32 bytes)
+// return: hash (below HASH_SIZE)
+//***************************************************************************
+
+static uint32_t hash_tile(const uint8_t *data) {
+   uint64_t value = 0;
+   int i;
+   for (i = 0; i < 32; i++)
+      value = (value ^ data[i]) * 0x100000001B3ULL;
+   return (uint32_t)(value >> 32) & (HASH_SIZE - 1);
+}
+
+//***************************************************************************
+// get_plain_size [internal]
+// Works out how large a set of tiles would be as plain UFTC16
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each)
+// param numblocks: number of blocks
+// param best: set to optimize the dictionary layout
+// param size: where to store the size
+// return: error code
+//***************************************************************************
+
+static int get_plain_size(const uint8_t *blocks, size_t numblocks, int best,
+size_t *size) {
+   uint32_t *ids = (uint32_t *) malloc(sizeof(uint32_t) * numblocks);
+   if (ids == NULL)
+      return ERR_NOMEMORY;
+
+   Dictionary dict;
+   int errcode = make_dictionary(blocks, numblocks, best, &dict, ids);
+   free(ids);
+   if (errcode) return errcode;
+
+   *size = 2 + dict.size + numblocks * 2;
+   free_dictionary(&dict);
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// get_inplace_offset [internal]
+// Works out how far ahead of the output buffer the compressed data must be
+// so decompressing it in-place is safe (it's assumed to be placed at the
+// end of the output buffer). The dictionary entries must survive until the
+// last tile using them has been decompressed, and so do the tiles.
+//---------------------------------------------------------------------------
+// param tiles: compressed tiles
+// param tilesize: size of compressed tiles
+// param dicsize: size of dictionary
+// param has_dict: set if the dictionary comes before the tiles (not set for
+//                 a shared dictionary, which is somewhere else)
+// return: offset in bytes
+//***************************************************************************
+
+static size_t get_inplace_offset(const uint8_t *tiles, size_t tilesize,
+size_t dicsize, int has_dict) {
+   // Work out sizes
+   size_t numtiles = tilesize / 8;
+   size_t rawsize = numtiles * 0x20;
+   size_t tilepos = has_dict ? 2 + dicsize : 0;
+   size_t compsize = tilepos + tilesize;
+
+   // Compressed data can't be closer than this, otherwise it wouldn't fit
+   // at the end of the output buffer
+   size_t offset = rawsize > compsize ? rawsize - compsize : 0;
+
+   // Go through all tiles, checking the data they read
+   // Be conservative and assume that all of the tile could have been
+   // written already by the time any of its data is read
+   size_t tile;
+   for (tile = 0; tile < numtiles; tile++) {
+      size_t written = (tile + 1) * 0x20;
+
+      // Check the tile itself
+      size_t pos = tilepos + tile * 8;
+      if (written > pos && written - pos > offset)
+         offset = written - pos;
+
+      // Check the dictionary entries it uses (only the last tile using
+      // each entry matters, but written only goes up so it's fine)
+      if (!has_dict)
+         continue;
+      const uint8_t *ptr = &tiles[tile * 8];
+      int i;
+      for (i = 0; i < 4; i++, ptr += 2) {
+         pos = 2 + (ptr[0] << 8 | ptr[1]);
+         if (written > pos && written - pos > offset)
+            offset = written - pos;
+      }
+   }
+
+   // The 68000 needs the data to be word-aligned
+   return (offset + 1) & ~(size_t)(1);
+}
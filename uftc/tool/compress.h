@@ -28,9 +28,25 @@
 #define COMPRESS_H
 
 // Required headers
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include "lossy.h"
+
+// What compression came up with, for the tool to report
+typedef struct {
+   size_t size;            // Size of the compressed data
+   size_t plainsize;       // Size it'd have as plain UFTC16 (UFTC-X only)
+   size_t offset;          // How far ahead it goes for in-place
+   LossyStats lossy;       // What lossy compression did (if used)
+} CompressReport;
 
 // Function prototypes
-int compress(FILE *, FILE *, int);
+int compress(FILE *, FILE *, int, int, int, const uint8_t *, size_t,
+             const Lossy *, CompressReport *);
+int compress_blob(const uint8_t *, size_t, int, int, const uint8_t *,
+                  size_t, const Lossy *, uint8_t **, size_t *, size_t *,
+                  CompressReport *);
+int train_dictionary(const char **, int, FILE *, int, int);
 
 #endif
@@ -28,7 +28,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "main.h"
+#include "dict.h"
+
+// Function prototypes
+static int decompress_x(FILE *, FILE *, const uint8_t *, uint16_t);
 
 //***************************************************************************
 // decompress
@@ -37,35 +42,59 @@
 // param infile: input file
 // param outfile: output file
 // param format: which format to parse for
+// param shared: shared dictionary (NULL if none)
+// param sharedsize: size of shared dictionary
 // return: error code
 //***************************************************************************
 
-int decompress(FILE *infile, FILE *outfile, int format) {
+int decompress(FILE *infile, FILE *outfile, int format,
+const uint8_t *shared, size_t sharedsize) {
    // To store error codes
    int errcode;
 
-   // Try to read dictionary size
+   // To store the dictionary
+   uint8_t *dictionary = NULL;
    uint16_t dicsize;
-   errcode = read_word(infile, &dicsize);
-   if (errcode) return errcode;
-
-   // Dictionary size must be valid!
-   if (dicsize & 0x0001)
-      return ERR_CORRUPT;
-   if ((dicsize & 0x8000) && format == FORMAT_UFTC15)
-      return ERR_CORRUPT;
-   if (dicsize < 0x0008)
-      return ERR_CORRUPT;
-
-   // Allocate memory for dictionary
-   uint8_t *dictionary = (uint8_t *) malloc(sizeof(uint8_t) * dicsize);
-   if (dictionary == NULL)
-      return ERR_NOMEMORY;
 
-   // Read dictionary into memory
-   if (fread(dictionary, 1, dicsize, infile) < dicsize) {
+   // Using a shared dictionary? (then the file only has the tiles)
+   if (shared != NULL) {
+      if (sharedsize >= 0x8000 && format == FORMAT_UFTC15)
+         return ERR_BADDICT;
+      dicsize = (uint16_t) sharedsize;
+   }
+
+   // Nope, the dictionary is in the file
+   else {
+      // Try to read dictionary size
+      errcode = read_word(infile, &dicsize);
+      if (errcode) return errcode;
+
+      // Dictionary size must be valid!
+      if (dicsize & 0x0001)
+         return ERR_CORRUPT;
+      if ((dicsize & 0x8000) && format != FORMAT_UFTC16)
+         return ERR_CORRUPT;
+      if (dicsize < 0x0008)
+         return ERR_CORRUPT;
+
+      // Allocate memory for dictionary
+      dictionary = (uint8_t *) malloc(sizeof(uint8_t) * dicsize);
+      if (dictionary == NULL)
+         return ERR_NOMEMORY;
+
+      // Read dictionary into memory
+      if (fread(dictionary, 1, dicsize, infile) < dicsize) {
+         free(dictionary);
+         return ferror(infile) ? ERR_CANTREAD : ERR_CORRUPT;
+      }
+   }
+   const uint8_t *dict = shared != NULL ? shared : dictionary;
+
+   // UFTC-X tiles are stored differently
+   if (format == FORMAT_UFTCX) {
+      errcode = decompress_x(infile, outfile, dict, dicsize);
       free(dictionary);
-      return ferror(infile) ? ERR_CANTREAD : ERR_CORRUPT;
+      return errcode;
    }
 
    // Determine location of last entry in dictionary
@@ -78,8 +107,10 @@ int decompress(FILE *infile, FILE *outfile, int format) {
       size_t numread = fread(ctile, 1, 8, infile);
       if (numread == 0 && feof(infile))
          break;
-      if (numread < 8)
+      if (numread < 8) {
+         free(dictionary);
          return ferror(infile) ? ERR_CANTREAD : ERR_CORRUPT;
+      }
 
       // Get positions for each 4x4 block in the dictionary
       uint16_t pos[4];
@@ -89,38 +120,172 @@ int decompress(FILE *infile, FILE *outfile, int format) {
       pos[3] = ctile[6] << 8 | ctile[7];
 
       // Ensure positions are valid
-      if (pos[0] & 0x0001 || pos[0] > limit) return ERR_CORRUPT;
-      if (pos[1] & 0x0001 || pos[1] > limit) return ERR_CORRUPT;
-      if (pos[2] & 0x0001 || pos[2] > limit) return ERR_CORRUPT;
-      if (pos[3] & 0x0001 || pos[3] > limit) return ERR_CORRUPT;
+      if (pos[0] & 0x0001 || pos[0] > limit ||
+      pos[1] & 0x0001 || pos[1] > limit ||
+      pos[2] & 0x0001 || pos[2] > limit ||
+      pos[3] & 0x0001 || pos[3] > limit) {
+         free(dictionary);
+         return ERR_CORRUPT;
+      }
 
       // To store the uncompressed tile
       uint8_t tile[0x20];
       uint8_t *ptr = tile;
 
       // Decompress tile
-      *ptr++ = dictionary[pos[0] + 0]; *ptr++ = dictionary[pos[0] + 1];
-      *ptr++ = dictionary[pos[1] + 0]; *ptr++ = dictionary[pos[1] + 1];
-      *ptr++ = dictionary[pos[0] + 2]; *ptr++ = dictionary[pos[0] + 3];
-      *ptr++ = dictionary[pos[1] + 2]; *ptr++ = dictionary[pos[1] + 3];
-      *ptr++ = dictionary[pos[0] + 4]; *ptr++ = dictionary[pos[0] + 5];
-      *ptr++ = dictionary[pos[1] + 4]; *ptr++ = dictionary[pos[1] + 5];
-      *ptr++ = dictionary[pos[0] + 6]; *ptr++ = dictionary[pos[0] + 7];
-      *ptr++ = dictionary[pos[1] + 6]; *ptr++ = dictionary[pos[1] + 7];
-      *ptr++ = dictionary[pos[2] + 0]; *ptr++ = dictionary[pos[2] + 1];
-      *ptr++ = dictionary[pos[3] + 0]; *ptr++ = dictionary[pos[3] + 1];
-      *ptr++ = dictionary[pos[2] + 2]; *ptr++ = dictionary[pos[2] + 3];
-      *ptr++ = dictionary[pos[3] + 2]; *ptr++ = dictionary[pos[3] + 3];
-      *ptr++ = dictionary[pos[2] + 4]; *ptr++ = dictionary[pos[2] + 5];
-      *ptr++ = dictionary[pos[3] + 4]; *ptr++ = dictionary[pos[3] + 5];
-      *ptr++ = dictionary[pos[2] + 6]; *ptr++ = dictionary[pos[2] + 7];
-      *ptr++ = dictionary[pos[3] + 6]; *ptr++ = dictionary[pos[3] + 7];
+      *ptr++ = dict[pos[0] + 0]; *ptr++ = dict[pos[0] + 1];
+      *ptr++ = dict[pos[1] + 0]; *ptr++ = dict[pos[1] + 1];
+      *ptr++ = dict[pos[0] + 2]; *ptr++ = dict[pos[0] + 3];
+      *ptr++ = dict[pos[1] + 2]; *ptr++ = dict[pos[1] + 3];
+      *ptr++ = dict[pos[0] + 4]; *ptr++ = dict[pos[0] + 5];
+      *ptr++ = dict[pos[1] + 4]; *ptr++ = dict[pos[1] + 5];
+      *ptr++ = dict[pos[0] + 6]; *ptr++ = dict[pos[0] + 7];
+      *ptr++ = dict[pos[1] + 6]; *ptr++ = dict[pos[1] + 7];
+      *ptr++ = dict[pos[2] + 0]; *ptr++ = dict[pos[2] + 1];
+      *ptr++ = dict[pos[3] + 0]; *ptr++ = dict[pos[3] + 1];
+      *ptr++ = dict[pos[2] + 2]; *ptr++ = dict[pos[2] + 3];
+      *ptr++ = dict[pos[3] + 2]; *ptr++ = dict[pos[3] + 3];
+      *ptr++ = dict[pos[2] + 4]; *ptr++ = dict[pos[2] + 5];
+      *ptr++ = dict[pos[3] + 4]; *ptr++ = dict[pos[3] + 5];
+      *ptr++ = dict[pos[2] + 6]; *ptr++ = dict[pos[2] + 7];
+      *ptr++ = dict[pos[3] + 6]; *ptr++ = dict[pos[3] + 7];
 
       // Write decompressed tile to blob
-      if (fwrite(tile, 1, 0x20, outfile) < 0x20)
+      if (fwrite(tile, 1, 0x20, outfile) < 0x20) {
+         free(dictionary);
          return ERR_CANTWRITE;
+      }
    }
 
    // Success!
+   free(dictionary);
    return ERR_NONE;
 }
+
+//***************************************************************************
+// decompress_x [internal]
+// Decompresses the tiles of an UFTC-X file
+//---------------------------------------------------------------------------
+// param infile: input file (right after the dictionary)
+// param outfile: output file
+// param dict: dictionary
+// param dicsize: size of dictionary
+// return: error code
+//***************************************************************************
+
+static int decompress_x(FILE *infile, FILE *outfile, const uint8_t *dict,
+uint16_t dicsize) {
+   // Where each block goes within a tile
+   static const size_t offsets[] = { 0, 2, 16, 18 };
+
+   // Repeated tiles refer to earlier ones by their position in the file,
+   // so we need all the tiles in memory
+   uint8_t *data = NULL;
+   size_t size = 0;
+   size_t capacity = 0;
+   for (;;) {
+      if (size == capacity) {
+         size_t newcap = capacity ? capacity * 2 : 0x1000;
+         uint8_t *temp = (uint8_t *) realloc(data, newcap);
+         if (temp == NULL) {
+            free(data);
+            return ERR_NOMEMORY;
+         }
+         data = temp;
+         capacity = newcap;
+      }
+
+      size_t numread = fread(&data[size], 1, capacity - size, infile);
+      size += numread;
+      if (numread == 0) {
+         if (ferror(infile)) {
+            free(data);
+            return ERR_CANTREAD;
+         }
+         break;
+      }
+   }
+
+   // To know which positions have a tile stored in full (only those can
+   // be referred to)
+   uint8_t *full = (uint8_t *) calloc(size / 2 + 1, 1);
+   if (full == NULL) {
+      free(data);
+      return ERR_NOMEMORY;
+   }
+
+   // Determine location of last entry in dictionary
+   uint16_t limit = dicsize - 0x0008;
+
+   // Go through all the tiles
+   int errcode = ERR_NONE;
+   size_t pos = 0;
+   while (pos < size) {
+      if (size - pos < 2) {
+         errcode = ERR_CORRUPT;
+         break;
+      }
+
+      // Repeated tile? (it can be flipped)
+      const uint8_t *entry;
+      int flip = 0;
+      uint16_t word = data[pos] << 8 | data[pos + 1];
+      if (word & 0x8000) {
+         size_t ref = word & 0x7FFE;
+         if (ref >= pos || !full[ref / 2]) {
+            errcode = ERR_CORRUPT;
+            break;
+         }
+         entry = &data[ref];
+         flip = word & 1;
+         pos += 2;
+      }
+
+      // Nope, it's stored in full
+      else {
+         if (size - pos < 8) {
+            errcode = ERR_CORRUPT;
+            break;
+         }
+         full[pos / 2] = 1;
+         entry = &data[pos];
+         pos += 8;
+      }
+
+      // Put together the tile out of its four blocks (flipping the whole
+      // tile also swaps its left and right blocks)
+      uint8_t tile[0x20];
+      int i;
+      for (i = 0; i < 4; i++) {
+         uint16_t id = entry[i * 2] << 8 | entry[i * 2 + 1];
+         uint16_t offset = id & 0xFFFE;
+         if (offset > limit) {
+            errcode = ERR_CORRUPT;
+            break;
+         }
+
+         uint8_t block[8];
+         if ((id ^ flip) & 1)
+            mirror_block(&dict[offset], block);
+         else
+            memcpy(block, &dict[offset], 8);
+
+         uint8_t *dest = &tile[offsets[i] ^ (flip << 1)];
+         dest[0] = block[0];  dest[1] = block[1];
+         dest[4] = block[2];  dest[5] = block[3];
+         dest[8] = block[4];  dest[9] = block[5];
+         dest[12] = block[6]; dest[13] = block[7];
+      }
+      if (errcode) break;
+
+      // Write decompressed tile to blob
+      if (fwrite(tile, 1, 0x20, outfile) < 0x20) {
+         errcode = ERR_CANTWRITE;
+         break;
+      }
+   }
+
+   free(full);
+   free(data);
+   return errcode;
+}
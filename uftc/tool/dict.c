@@ -0,0 +1,254 @@
+//***************************************************************************
+// "dict.c"
+// Index to look up 4x4 blocks in the dictionary
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "dict.h"
+
+// Size of the hash table used to look up blocks (must be a power of 2)
+#define HASH_SIZE 0x10000
+
+// Function prototypes
+static void index_window(Dictionary *, size_t);
+static uint32_t hash_window(const uint8_t *);
+
+//***************************************************************************
+// init_dictionary
+// Initializes an empty dictionary
+//---------------------------------------------------------------------------
+// param dict: dictionary to initialize
+// return: error code
+//***************************************************************************
+
+int init_dictionary(Dictionary *dict) {
+   dict->data = NULL;
+   dict->size = 0;
+   dict->capacity = 0;
+   dict->next = NULL;
+
+   dict->head = (uint32_t *) malloc(sizeof(uint32_t) * HASH_SIZE);
+   dict->tail = (uint32_t *) malloc(sizeof(uint32_t) * HASH_SIZE);
+   if (dict->head == NULL || dict->tail == NULL) {
+      free(dict->head);
+      free(dict->tail);
+      dict->head = NULL;
+      dict->tail = NULL;
+      return ERR_NOMEMORY;
+   }
+
+   size_t i;
+   for (i = 0; i < HASH_SIZE; i++)
+      dict->head[i] = NO_ENTRY;
+
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// free_dictionary
+// Deallocates everything used by a dictionary
+//---------------------------------------------------------------------------
+// param dict: dictionary to deallocate
+//***************************************************************************
+
+void free_dictionary(Dictionary *dict) {
+   free(dict->data);
+   free(dict->head);
+   free(dict->tail);
+   free(dict->next);
+   dict->data = NULL;
+   dict->head = NULL;
+   dict->tail = NULL;
+   dict->next = NULL;
+}
+
+//***************************************************************************
+// find_block
+// Looks up where a 4x4 block is in the dictionary
+//---------------------------------------------------------------------------
+// param dict: pointer to dictionary
+// param block: pointer to 4x4 block data
+// return: offset of the block or NO_ENTRY if it isn't there
+//***************************************************************************
+
+uint32_t find_block(const Dictionary *dict, const uint8_t *block) {
+   // Windows are added to their chain in order, so the first match is the
+   // lowest offset, same as scanning the whole dictionary would find
+   uint32_t window = dict->head[hash_window(block)];
+   while (window != NO_ENTRY) {
+      if (!memcmp(dict->data + window * 2, block, 8))
+         return window * 2;
+      window = dict->next[window];
+   }
+
+   // Not found...
+   return NO_ENTRY;
+}
+
+//***************************************************************************
+// append_dictionary
+// Adds data at the end of the dictionary and indexes it
+//---------------------------------------------------------------------------
+// param dict: pointer to dictionary
+// param data: data to add
+// param size: size of data (must be even)
+// return: error code
+//***************************************************************************
+
+int append_dictionary(Dictionary *dict, const uint8_t *data, size_t size) {
+   // Make room for the data (memory is allocated in big steps so we don't
+   // end up reallocating it for every block)
+   if (dict->size + size > dict->capacity) {
+      size_t newcap = dict->capacity ? dict->capacity : 0x400;
+      while (dict->size + size > newcap)
+         newcap *= 2;
+
+      uint8_t *temp = (uint8_t *) realloc(dict->data, newcap);
+      if (temp == NULL) return ERR_NOMEMORY;
+      dict->data = temp;
+
+      uint32_t *next = (uint32_t *) realloc(dict->next,
+                                            sizeof(uint32_t) * newcap / 2);
+      if (next == NULL) return ERR_NOMEMORY;
+      dict->next = next;
+
+      dict->capacity = newcap;
+   }
+
+   // Store the data
+   size_t oldsize = dict->size;
+   memcpy(dict->data + dict->size, data, size);
+   dict->size += size;
+
+   // Index the windows that are now complete (including the ones that
+   // overlap the end of what was there before)
+   size_t pos = oldsize >= 6 ? oldsize - 6 : 0;
+   for (; pos + 8 <= dict->size; pos += 2)
+      index_window(dict, pos);
+
+   // Success!
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// load_dictionary
+// Loads a shared dictionary from a file
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param data: where to store pointer to dictionary (must be freed)
+// param size: where to store size of dictionary
+// return: error code
+//***************************************************************************
+
+int load_dictionary(const char *filename, uint8_t **data, size_t *size) {
+   // Open file
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   // Read it all (it can't be larger than 64KB anyway)
+   uint8_t *buffer = (uint8_t *) malloc(0x10001);
+   if (buffer == NULL) {
+      fclose(file);
+      return ERR_NOMEMORY;
+   }
+   *size = fread(buffer, 1, 0x10001, file);
+   if (ferror(file)) {
+      free(buffer);
+      fclose(file);
+      return ERR_CANTREAD;
+   }
+   fclose(file);
+
+   // Make sure it's something block IDs can point into
+   if (*size < 8 || *size > 0xFFFF || *size & 1) {
+      free(buffer);
+      return ERR_BADDICT;
+   }
+
+   // Success!
+   *data = buffer;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// mirror_block
+// Flips a 4x4 block horizontally (as used by UFTC-X)
+//---------------------------------------------------------------------------
+// param block: block to flip (8 bytes)
+// param mirrored: where to store the flipped block (8 bytes)
+//***************************************************************************
+
+void mirror_block(const uint8_t *block, uint8_t *mirrored) {
+   // Each row is two bytes with two pixels each, so the bytes get swapped
+   // and so do the pixels within each byte
+   int i;
+   for (i = 0; i < 8; i += 2) {
+      uint8_t left = block[i];
+      uint8_t right = block[i + 1];
+      mirrored[i] = right << 4 | right >> 4;
+      mirrored[i + 1] = left << 4 | left >> 4;
+   }
+}
+
+//***************************************************************************
+// index_window [internal]
+// Adds a window of the dictionary to the index
+//---------------------------------------------------------------------------
+// param dict: pointer to dictionary
+// param pos: offset where the window starts (must be even)
+//***************************************************************************
+
+static void index_window(Dictionary *dict, size_t pos) {
+   uint32_t window = (uint32_t)(pos / 2);
+   uint32_t hash = hash_window(dict->data + pos);
+
+   dict->next[window] = NO_ENTRY;
+   if (dict->head[hash] == NO_ENTRY)
+      dict->head[hash] = window;
+   else
+      dict->next[dict->tail[hash]] = window;
+   dict->tail[hash] = window;
+}
+
+//***************************************************************************
+// hash_window [internal]
+// Computes the hash of an 8 byte window
+//---------------------------------------------------------------------------
+// param data: pointer to window
+// return: hash (below HASH_SIZE)
+//***************************************************************************
+
+static uint32_t hash_window(const uint8_t *data) {
+   uint64_t value = (uint64_t) data[0] << 56 | (uint64_t) data[1] << 48 |
+                    (uint64_t) data[2] << 40 | (uint64_t) data[3] << 32 |
+                    (uint64_t) data[4] << 24 | (uint64_t) data[5] << 16 |
+                    (uint64_t) data[6] << 8  | (uint64_t) data[7];
+   return (uint32_t)((value * 0x9E3779B97F4A7C15ULL) >> 48) & (HASH_SIZE - 1);
+}
@@ -0,0 +1,56 @@
+//***************************************************************************
+// "dict.h"
+// Definitions for the dictionary index
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+#ifndef DICT_H
+#define DICT_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+
+// Returned by find_block when the block isn't in the dictionary
+#define NO_ENTRY 0xFFFFFFFF
+
+// Dictionary being built, along with an index of every 8 byte window that
+// starts at an even offset (i.e. everything a block ID can point at)
+typedef struct {
+   uint8_t *data;          // Dictionary contents
+   size_t size;            // Size of dictionary in bytes
+   size_t capacity;        // Bytes allocated for the contents
+   uint32_t *head;         // First window in each hash chain
+   uint32_t *tail;         // Last window in each hash chain
+   uint32_t *next;         // Next window in the same chain (per window)
+} Dictionary;
+
+// Function prototypes
+int init_dictionary(Dictionary *);
+void free_dictionary(Dictionary *);
+uint32_t find_block(const Dictionary *, const uint8_t *);
+int append_dictionary(Dictionary *, const uint8_t *, size_t);
+int load_dictionary(const char *, uint8_t **, size_t *);
+void mirror_block(const uint8_t *, uint8_t *);
+
+#endif
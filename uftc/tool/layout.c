@@ -0,0 +1,275 @@
+//***************************************************************************
+// "layout.c"
+// Lays out the dictionary so blocks overlap as much as possible
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "dict.h"
+#include "layout.h"
+
+// Marks a missing link between blocks
+#define NO_LINK ((size_t)(-1))
+
+// Used to sort blocks (keeping track of where they came from)
+typedef struct {
+   uint8_t data[8];        // Block contents (only the part to sort by, the
+                           // rest is zeroed out)
+   size_t index;           // Position in the original list
+} SortedBlock;
+
+// Function prototypes
+static int compare_blocks(const void *, const void *);
+static size_t find_free(size_t *, size_t);
+static size_t get_overlap(const uint8_t *, size_t, const uint8_t *);
+
+//***************************************************************************
+// optimize_layout
+// Builds a dictionary containing all the given 4x4 blocks, ordering them so
+// they overlap as much as possible. This is the greedy shortest common
+// superstring heuristic, restricted to 2 byte alignment since that's where
+// block IDs can point: it keeps joining the end of one run of blocks to the
+// start of another, trying 6 bytes of overlap first, then 4, then 2.
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each)
+// param numblocks: number of blocks
+// param dict: where to store the dictionary (must be empty)
+// return: error code
+//***************************************************************************
+
+int optimize_layout(const uint8_t *blocks, size_t numblocks,
+Dictionary *dict) {
+   // Nothing to do?
+   if (numblocks == 0)
+      return ERR_NONE;
+
+   // Allocate everything we need
+   SortedBlock *sorted = (SortedBlock *) malloc(sizeof(SortedBlock) *
+                                                numblocks);
+   uint8_t *unique = (uint8_t *) malloc(numblocks * 8);
+   size_t *next = (size_t *) malloc(sizeof(size_t) * numblocks);
+   size_t *prev = (size_t *) malloc(sizeof(size_t) * numblocks);
+   size_t *ends = (size_t *) malloc(sizeof(size_t) * numblocks);
+   size_t *overlap = (size_t *) malloc(sizeof(size_t) * numblocks);
+   size_t *jump = (size_t *) malloc(sizeof(size_t) * (numblocks + 1));
+   if (sorted == NULL || unique == NULL || next == NULL || prev == NULL ||
+   ends == NULL || overlap == NULL || jump == NULL) {
+      free(sorted); free(unique); free(next);
+      free(prev); free(ends); free(overlap); free(jump);
+      return ERR_NOMEMORY;
+   }
+
+   // Get rid of repeated blocks, keeping them in the order they first show
+   // up (so the result doesn't depend on how qsort breaks ties)
+   size_t i;
+   for (i = 0; i < numblocks; i++) {
+      memcpy(sorted[i].data, &blocks[i * 8], 8);
+      sorted[i].index = i;
+   }
+   qsort(sorted, numblocks, sizeof(SortedBlock), compare_blocks);
+
+   uint8_t *seen = (uint8_t *) calloc(numblocks, 1);
+   if (seen == NULL) {
+      free(sorted); free(unique); free(next);
+      free(prev); free(ends); free(overlap); free(jump);
+      return ERR_NOMEMORY;
+   }
+   for (i = 0; i < numblocks; i++) {
+      if (i == 0 || memcmp(sorted[i].data, sorted[i-1].data, 8))
+         seen[sorted[i].index] = 1;
+   }
+   size_t numunique = 0;
+   for (i = 0; i < numblocks; i++) {
+      if (seen[i])
+         memcpy(&unique[numunique++ * 8], &blocks[i * 8], 8);
+   }
+   free(seen);
+
+   // Every block starts as a run of its own
+   // ends[] holds the other end of the run for blocks at either end
+   for (i = 0; i < numunique; i++) {
+      next[i] = NO_LINK;
+      prev[i] = NO_LINK;
+      ends[i] = i;
+      overlap[i] = 0;
+   }
+
+   // Join runs, largest overlaps first
+   size_t amount;
+   for (amount = 6; amount >= 2; amount -= 2) {
+      // Sort the blocks that start a run by their first bytes so we can
+      // look them up quickly
+      size_t numheads = 0;
+      for (i = 0; i < numunique; i++) {
+         if (prev[i] != NO_LINK) continue;
+         memset(sorted[numheads].data, 0, 8);
+         memcpy(sorted[numheads].data, &unique[i * 8], amount);
+         sorted[numheads].index = i;
+         numheads++;
+      }
+      qsort(sorted, numheads, sizeof(SortedBlock), compare_blocks);
+
+      // jump[] lets us skip over the runs that got taken already
+      for (i = 0; i <= numheads; i++)
+         jump[i] = i;
+
+      // Try to join the end of every run to the start of another
+      for (i = 0; i < numunique; i++) {
+         if (next[i] != NO_LINK) continue;
+         const uint8_t *suffix = &unique[i * 8 + 8 - amount];
+
+         // Find the first run starting with what this one ends with
+         size_t low = 0;
+         size_t high = numheads;
+         while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (memcmp(sorted[mid].data, suffix, amount) < 0)
+               low = mid + 1;
+            else
+               high = mid;
+         }
+
+         // Take the first one that's still free (and that isn't the start
+         // of this same run, or we'd make a loop)
+         size_t j;
+         for (j = find_free(jump, low); j < numheads;
+         j = find_free(jump, j + 1)) {
+            if (memcmp(sorted[j].data, suffix, amount)) break;
+            size_t head = sorted[j].index;
+            if (head == ends[i]) continue;
+
+            // Join them
+            size_t first = ends[i];
+            size_t last = ends[head];
+            next[i] = head;
+            prev[head] = i;
+            overlap[head] = amount;
+            ends[first] = last;
+            ends[last] = first;
+            jump[j] = j + 1;
+            break;
+         }
+      }
+   }
+
+   // Put the runs into the dictionary first, then the blocks that didn't
+   // join anything (unless they already showed up by chance somewhere in
+   // the middle of what's been added)
+   int errcode = ERR_NONE;
+   int pass;
+   for (pass = 0; pass < 2 && !errcode; pass++) {
+      for (i = 0; i < numunique && !errcode; i++) {
+         if (prev[i] != NO_LINK) continue;
+         int alone = next[i] == NO_LINK;
+         if (alone != pass) continue;
+         if (alone && find_block(dict, &unique[i * 8]) != NO_ENTRY)
+            continue;
+
+         // If the end of the dictionary overlaps with the start of this
+         // run then only add the part of the block that isn't there yet
+         size_t skip = get_overlap(dict->data, dict->size, &unique[i * 8]);
+
+         size_t block;
+         for (block = i; block != NO_LINK && !errcode; block = next[block]) {
+            if (block != i) skip = overlap[block];
+            errcode = append_dictionary(dict, &unique[block * 8 + skip],
+                                        8 - skip);
+         }
+      }
+   }
+
+   // Done with this
+   free(sorted); free(unique); free(next);
+   free(prev); free(ends); free(overlap); free(jump);
+   return errcode;
+}
+
+//***************************************************************************
+// get_overlap [internal]
+// Checks how many bytes at the end of the dictionary match the start of a
+// block (only even amounts, and never the whole block)
+//---------------------------------------------------------------------------
+// param data: dictionary contents
+// param size: dictionary size
+// param block: block to check
+// return: number of bytes that overlap
+//***************************************************************************
+
+static size_t get_overlap(const uint8_t *data, size_t size,
+const uint8_t *block) {
+   size_t amount;
+   for (amount = 6; amount >= 2; amount -= 2) {
+      if (size >= amount && !memcmp(data + size - amount, block, amount))
+         return amount;
+   }
+   return 0;
+}
+
+//***************************************************************************
+// find_free [internal]
+// Finds the first run start from the given position onwards that hasn't
+// been taken yet (shortening the path as it goes)
+//---------------------------------------------------------------------------
+// param jump: list of where to jump to (jump[i] == i if free)
+// param pos: where to start looking
+// return: position of the first free run start
+//***************************************************************************
+
+static size_t find_free(size_t *jump, size_t pos) {
+   size_t found = pos;
+   while (jump[found] != found)
+      found = jump[found];
+
+   while (jump[pos] != found) {
+      size_t temp = jump[pos];
+      jump[pos] = found;
+      pos = temp;
+   }
+
+   return found;
+}
+
+//***************************************************************************
+// compare_blocks [internal]
+// Comparison function used to sort blocks with qsort (ties are broken
+// using the original position).
+//---------------------------------------------------------------------------
+// param ptr1: pointer to first block
+// param ptr2: pointer to second block
+// return: <0 if first goes before, >0 if it goes after
+//***************************************************************************
+
+static int compare_blocks(const void *ptr1, const void *ptr2) {
+   const SortedBlock *block1 = (const SortedBlock *) ptr1;
+   const SortedBlock *block2 = (const SortedBlock *) ptr2;
+
+   int result = memcmp(block1->data, block2->data, 8);
+   if (result) return result;
+
+   return block1->index < block2->index ? -1 : 1;
+}
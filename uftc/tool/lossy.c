@@ -0,0 +1,365 @@
+//***************************************************************************
+// "lossy.c"
+// Merges 4x4 blocks that are almost the same (lossy compression)
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "lossy.h"
+
+// Marks the end of a list
+#define NO_BLOCK ((size_t)(-1))
+
+// Used to sort blocks (keeping track of where they came from)
+typedef struct {
+   uint8_t data[8];        // Block contents
+   size_t index;           // Position in the original list
+} SortedBlock;
+
+// Every different block
+typedef struct {
+   size_t first;           // Where it shows up first
+   size_t count;           // How many times it shows up
+   size_t merged;          // Which block it gets replaced with
+   size_t next;            // Next kept block with the same transparency
+} UniqueBlock;
+
+// Used to sort the different blocks (carries what to sort them by)
+typedef struct {
+   size_t count;           // How many times it shows up
+   size_t first;           // Where it shows up first
+   size_t id;              // Which block it is
+} SortedUnique;
+
+// Function prototypes
+static int compare_blocks(const void *, const void *);
+static int compare_uniques(const void *, const void *);
+static uint16_t get_mask(const uint8_t *);
+static int compare_pixels(const uint8_t *, const uint8_t *, const Lossy *,
+                          unsigned *);
+static unsigned get_distance(unsigned, unsigned, const Lossy *);
+
+//***************************************************************************
+// load_palette
+// Loads the palette used to tell how far apart colors are (32 bytes, each
+// color a big endian word in the same format as the VDP)
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param lossy: where to store the palette
+// return: error code
+//***************************************************************************
+
+int load_palette(const char *filename, Lossy *lossy) {
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   uint8_t buffer[0x20];
+   size_t numread = fread(buffer, 1, sizeof(buffer), file);
+   int errcode = ERR_NONE;
+   if (ferror(file))
+      errcode = ERR_CANTREAD;
+   else if (numread < sizeof(buffer))
+      errcode = ERR_BADPALETTE;
+   fclose(file);
+   if (errcode) return errcode;
+
+   int i;
+   for (i = 0; i < 16; i++)
+      lossy->palette[i] = buffer[i * 2] << 8 | buffer[i * 2 + 1];
+   lossy->has_palette = 1;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// merge_blocks
+// Replaces 4x4 blocks with others that are close enough, so fewer blocks
+// end up in the dictionary. Blocks are checked from most to least common,
+// and each one is replaced with the closest block kept so far (if any is
+// within the budget), otherwise it's kept. Pixels using color 0 are never
+// changed, nor are other pixels changed into color 0.
+//---------------------------------------------------------------------------
+// param blocks: list of blocks (8 bytes each, modified in place)
+// param numblocks: number of blocks
+// param lossy: lossy compression settings
+// param stats: where to store what was done
+// return: error code
+//***************************************************************************
+
+int merge_blocks(uint8_t *blocks, size_t numblocks, const Lossy *lossy,
+LossyStats *stats) {
+   // Find out which blocks are the same
+   SortedBlock *sorted = (SortedBlock *) malloc(sizeof(SortedBlock) *
+                                                numblocks);
+   UniqueBlock *uniques = (UniqueBlock *) malloc(sizeof(UniqueBlock) *
+                                                 numblocks);
+   size_t *ids = (size_t *) malloc(sizeof(size_t) * numblocks);
+   SortedUnique *order = (SortedUnique *) malloc(sizeof(SortedUnique) *
+                                                 numblocks);
+   size_t *heads = (size_t *) malloc(sizeof(size_t) * 0x10000);
+   if (sorted == NULL || uniques == NULL || ids == NULL || order == NULL ||
+   heads == NULL) {
+      free(sorted); free(uniques); free(ids); free(order); free(heads);
+      return ERR_NOMEMORY;
+   }
+
+   size_t i;
+   for (i = 0; i < numblocks; i++) {
+      memcpy(sorted[i].data, &blocks[i * 8], 8);
+      sorted[i].index = i;
+   }
+   qsort(sorted, numblocks, sizeof(SortedBlock), compare_blocks);
+
+   size_t numuniques = 0;
+   for (i = 0; i < numblocks; i++) {
+      if (i == 0 || memcmp(sorted[i].data, sorted[i - 1].data, 8)) {
+         uniques[numuniques].first = sorted[i].index;
+         uniques[numuniques].count = 0;
+         numuniques++;
+      }
+      UniqueBlock *unique = &uniques[numuniques - 1];
+      if (sorted[i].index < unique->first)
+         unique->first = sorted[i].index;
+      unique->count++;
+      ids[sorted[i].index] = numuniques - 1;
+   }
+   free(sorted);
+
+   // Most common blocks go first (they're the ones we want to keep)
+   for (i = 0; i < numuniques; i++) {
+      order[i].count = uniques[i].count;
+      order[i].first = uniques[i].first;
+      order[i].id = i;
+   }
+   qsort(order, numuniques, sizeof(SortedUnique), compare_uniques);
+
+   // Go through every different block and see if it's close enough to
+   // one we're keeping already. Only blocks with color 0 in the same
+   // places can be merged, so keep a list for every combination.
+   for (i = 0; i < 0x10000; i++)
+      heads[i] = NO_BLOCK;
+
+   size_t numkept = 0;
+   for (i = 0; i < numuniques; i++) {
+      size_t id = order[i].id;
+      const uint8_t *block = &blocks[uniques[id].first * 8];
+      uint16_t mask = get_mask(block);
+
+      size_t best = NO_BLOCK;
+      unsigned bestdist = 0;
+      size_t other;
+      for (other = heads[mask]; other != NO_BLOCK;
+      other = uniques[other].next) {
+         unsigned dist;
+         if (compare_pixels(block, &blocks[uniques[other].first * 8],
+         lossy, &dist) > lossy->budget)
+            continue;
+         if (best == NO_BLOCK || dist < bestdist) {
+            best = other;
+            bestdist = dist;
+         }
+      }
+
+      if (best != NO_BLOCK) {
+         uniques[id].merged = best;
+      } else {
+         uniques[id].merged = id;
+         uniques[id].next = heads[mask];
+         heads[mask] = id;
+         numkept++;
+      }
+   }
+   free(order);
+   free(heads);
+
+   // Open the log if needed
+   FILE *log = NULL;
+   if (lossy->logname != NULL) {
+      log = fopen(lossy->logname, "w");
+      if (log == NULL) {
+         free(uniques);
+         free(ids);
+         return ERR_CANTWRITELOG;
+      }
+      fprintf(log, "# tile\tblock\tpixels\tdistance\n");
+   }
+
+   // Replace the blocks (the kept blocks haven't been touched yet since
+   // they're always the first one of their kind)
+   static const char *const names[] = {
+      "top-left", "top-right", "bottom-left", "bottom-right"
+   };
+   size_t changed = 0;
+   size_t pixels = 0;
+   for (i = 0; i < numblocks; i++) {
+      size_t merged = uniques[ids[i]].merged;
+      if (merged == ids[i])
+         continue;
+
+      uint8_t *block = &blocks[i * 8];
+      const uint8_t *replacement = &blocks[uniques[merged].first * 8];
+      unsigned dist;
+      int count = compare_pixels(block, replacement, lossy, &dist);
+      memcpy(block, replacement, 8);
+
+      changed++;
+      pixels += count;
+      if (log != NULL)
+         fprintf(log, "%zu\t%s\t%d\t%u\n", i / 4, names[i % 4], count,
+                 dist);
+   }
+   free(uniques);
+   free(ids);
+
+   // Tell how it went
+   stats->uniques = numuniques;
+   stats->kept = numkept;
+   stats->changed = changed;
+   stats->pixels = pixels;
+
+   if (log != NULL) {
+      int failed = ferror(log);
+      if (fclose(log) || failed)
+         return ERR_CANTWRITELOG;
+   }
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// compare_blocks [internal]
+// Comparison function used to sort blocks with qsort (ties are broken
+// using the original position)
+//---------------------------------------------------------------------------
+// param ptr1: pointer to first block
+// param ptr2: pointer to second block
+// return: <0 if first goes before, >0 if it goes after
+//***************************************************************************
+
+static int compare_blocks(const void *ptr1, const void *ptr2) {
+   const SortedBlock *block1 = (const SortedBlock *) ptr1;
+   const SortedBlock *block2 = (const SortedBlock *) ptr2;
+
+   int result = memcmp(block1->data, block2->data, 8);
+   if (result) return result;
+
+   return block1->index < block2->index ? -1 : 1;
+}
+
+//***************************************************************************
+// compare_uniques [internal]
+// Comparison function used to sort the different blocks with qsort, most
+// common first (ties are broken by which one shows up first)
+//---------------------------------------------------------------------------
+// param ptr1: pointer to first block
+// param ptr2: pointer to second block
+// return: <0 if first goes before, >0 if it goes after
+//***************************************************************************
+
+static int compare_uniques(const void *ptr1, const void *ptr2) {
+   const SortedUnique *block1 = (const SortedUnique *) ptr1;
+   const SortedUnique *block2 = (const SortedUnique *) ptr2;
+
+   if (block1->count != block2->count)
+      return block1->count > block2->count ? -1 : 1;
+   return block1->first < block2->first ? -1 : 1;
+}
+
+//***************************************************************************
+// get_mask [internal]
+// Tells which pixels of a block use color 0
+//---------------------------------------------------------------------------
+// param block: pointer to block
+// return: a bit set for every pixel using color 0
+//***************************************************************************
+
+static uint16_t get_mask(const uint8_t *block) {
+   uint16_t mask = 0;
+   int i;
+   for (i = 0; i < 8; i++) {
+      mask <<= 2;
+      if ((block[i] & 0xF0) == 0) mask |= 2;
+      if ((block[i] & 0x0F) == 0) mask |= 1;
+   }
+   return mask;
+}
+
+//***************************************************************************
+// compare_pixels [internal]
+// Compares the pixels of two blocks
+//---------------------------------------------------------------------------
+// param block1: pointer to first block
+// param block2: pointer to second block
+// param lossy: lossy compression settings (for the palette)
+// param dist: where to store the total color distance
+// return: how many pixels are different
+//***************************************************************************
+
+static int compare_pixels(const uint8_t *block1, const uint8_t *block2,
+const Lossy *lossy, unsigned *dist) {
+   int count = 0;
+   *dist = 0;
+
+   int i;
+   for (i = 0; i < 8; i++) {
+      if ((block1[i] ^ block2[i]) & 0xF0) {
+         count++;
+         *dist += get_distance(block1[i] >> 4, block2[i] >> 4, lossy);
+      }
+      if ((block1[i] ^ block2[i]) & 0x0F) {
+         count++;
+         *dist += get_distance(block1[i] & 0x0F, block2[i] & 0x0F, lossy);
+      }
+   }
+
+   return count;
+}
+
+//***************************************************************************
+// get_distance [internal]
+// Tells how far apart two colors are (squared distance between the RGB
+// values in the palette, or always 1 if there isn't a palette)
+//---------------------------------------------------------------------------
+// param color1: first color index
+// param color2: second color index
+// param lossy: lossy compression settings (for the palette)
+// return: distance
+//***************************************************************************
+
+static unsigned get_distance(unsigned color1, unsigned color2,
+const Lossy *lossy) {
+   if (!lossy->has_palette)
+      return 1;
+
+   uint16_t vdp1 = lossy->palette[color1];
+   uint16_t vdp2 = lossy->palette[color2];
+
+   int red = (vdp1 >> 1 & 7) - (vdp2 >> 1 & 7);
+   int green = (vdp1 >> 5 & 7) - (vdp2 >> 5 & 7);
+   int blue = (vdp1 >> 9 & 7) - (vdp2 >> 9 & 7);
+   return (unsigned)(red * red + green * green + blue * blue);
+}
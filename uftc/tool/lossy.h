@@ -0,0 +1,54 @@
+//***************************************************************************
+// "lossy.h"
+// Merges 4x4 blocks that are almost the same (lossy compression)
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+#ifndef LOSSY_H
+#define LOSSY_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+
+// Settings for lossy compression
+typedef struct {
+   int budget;             // How many pixels can change in a 4x4 block
+   int has_palette;        // Set if a palette was given
+   uint16_t palette[16];   // Palette to measure color distance with
+   const char *logname;    // Where to log what changed (or NULL)
+} Lossy;
+
+// What lossy compression did, for the tool to report
+typedef struct {
+   size_t uniques;         // How many different blocks there were
+   size_t kept;            // How many of them were kept
+   size_t changed;         // How many blocks were replaced
+   size_t pixels;          // How many pixels changed in total
+} LossyStats;
+
+// Function prototypes
+int load_palette(const char *, Lossy *);
+int merge_blocks(uint8_t *, size_t, const Lossy *, LossyStats *);
+
+#endif
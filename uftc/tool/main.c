@@ -32,12 +32,16 @@
 #include "main.h"
 #include "compress.h"
 #include "decompress.h"
+#include "dict.h"
+#include "lossy.h"
+#include "ranges.h"
 
 // Possible actions
 enum {
    ACTION_DEFAULT,         // No action specified
    ACTION_COMPRESS,        // Compress
    ACTION_DECOMPRESS,      // Decompress
+   ACTION_TRAIN,           // Build a shared dictionary
    ACTION_TOOMANY          // Too many actions specified
 };
 
@@ -54,11 +58,30 @@ int main(int argc, char **argv) {
    int show_ver = 0;
    int action = ACTION_DEFAULT;
    int format = FORMAT_DEFAULT;
+   int inplace = INPLACE_NONE;
+   int best = 0;
+   const char *dictfilename = NULL;
+   const char *rangefilename = NULL;
+   const char *tablefilename = NULL;
+   int sprites = 0;
+   long tileoffset = -1;
+   int continuous = 0;
+   int lossy = 0;
+   const char *palfilename = NULL;
+   const char *logfilename = NULL;
    const char *infilename = NULL;
    const char *outfilename = NULL;
 
+   // When building a shared dictionary, the first filename is the output
+   // and all the others are the tile sets (there can be any amount of them)
+   const char **filenames = (const char **) malloc(sizeof(char *) * argc);
+   int numfiles = 0;
+   if (filenames == NULL) {
+      fprintf(stderr, "Error: ran out of memory\n");
+      return EXIT_FAILURE;
+   }
+
    int scan_ok = 1;
-   int err_manyfiles = 0;
 
    int curr_arg;
    for (curr_arg = 1; curr_arg < argc; curr_arg++) {
@@ -87,6 +110,88 @@ int main(int argc, char **argv) {
             action = action == ACTION_DEFAULT ?
                      ACTION_DECOMPRESS : ACTION_TOOMANY;
 
+         // Build shared dictionary?
+         else if (!strcmp(arg, "-t") || !strcmp(arg, "--train"))
+            action = action == ACTION_DEFAULT ?
+                     ACTION_TRAIN : ACTION_TOOMANY;
+
+         // Use shared dictionary?
+         else if (!strcmp(arg, "-D") || !strcmp(arg, "--dict")) {
+            if (curr_arg + 1 < argc)
+               dictfilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Lossy compression?
+         else if (!strcmp(arg, "-l") || !strcmp(arg, "--lossy")) {
+            char *endptr = NULL;
+            if (curr_arg + 1 < argc)
+               lossy = (int) strtol(argv[++curr_arg], &endptr, 10);
+            if (endptr == NULL || *endptr != '\0' || lossy < 1 ||
+            lossy > 16) {
+               fprintf(stderr, "Error: \"%s\" needs a number of pixels "
+                  "from 1 to 16\n", arg);
+               errcode = 1;
+            }
+         }
+         else if (!strcmp(arg, "-p") || !strcmp(arg, "--palette")) {
+            if (curr_arg + 1 < argc)
+               palfilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+         else if (!strcmp(arg, "-L") || !strcmp(arg, "--log")) {
+            if (curr_arg + 1 < argc)
+               logfilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
+         // Make a table of tile ranges?
+         else if (!strcmp(arg, "-r") || !strcmp(arg, "--ranges") ||
+         !strcmp(arg, "-s") || !strcmp(arg, "--sprites")) {
+            if (rangefilename != NULL) {
+               fprintf(stderr, "Error: can't specify more than one range "
+                  "list\n");
+               errcode = 1;
+            }
+            if (curr_arg + 1 < argc) {
+               sprites = arg[1] == 's' || arg[2] == 's';
+               rangefilename = argv[++curr_arg];
+            } else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+         else if (!strcmp(arg, "-o") || !strcmp(arg, "--offset")) {
+            char *endptr = NULL;
+            if (curr_arg + 1 < argc)
+               tileoffset = strtol(argv[++curr_arg], &endptr, 0);
+            if (endptr == NULL || *endptr != '\0' || tileoffset < 0 ||
+            tileoffset > 0x7FF) {
+               fprintf(stderr, "Error: \"%s\" needs a tile ID from 0 to "
+                  "2047\n", arg);
+               errcode = 1;
+            }
+         }
+         else if (!strcmp(arg, "-C") || !strcmp(arg, "--continuous"))
+            continuous = 1;
+         else if (!strcmp(arg, "-T") || !strcmp(arg, "--table")) {
+            if (curr_arg + 1 < argc)
+               tablefilename = argv[++curr_arg];
+            else {
+               fprintf(stderr, "Error: \"%s\" needs a filename\n", arg);
+               errcode = 1;
+            }
+         }
+
          // Specify format?
          else if (!strcmp(arg, "-16") || !strcmp(arg, "--uftc16"))
             format = format == FORMAT_DEFAULT ?
@@ -94,6 +199,21 @@ int main(int argc, char **argv) {
          else if (!strcmp(arg, "-15") || !strcmp(arg, "--uftc15"))
             format = format == FORMAT_DEFAULT ?
                      FORMAT_UFTC15 : FORMAT_TOOMANY;
+         else if (!strcmp(arg, "-x") || !strcmp(arg, "--uftcx"))
+            format = format == FORMAT_DEFAULT ?
+                     FORMAT_UFTCX : FORMAT_TOOMANY;
+
+         // Optimize dictionary layout?
+         else if (!strcmp(arg, "-b") || !strcmp(arg, "--best"))
+            best = 1;
+
+         // In-place decompression?
+         else if (!strcmp(arg, "-m") || !strcmp(arg, "--margin")) {
+            if (inplace == INPLACE_NONE)
+               inplace = INPLACE_REPORT;
+         }
+         else if (!strcmp(arg, "-i") || !strcmp(arg, "--in-place"))
+            inplace = INPLACE_PAD;
 
          // Unknown argument
          else {
@@ -102,17 +222,18 @@ int main(int argc, char **argv) {
          }
       }
 
-      // Input filename?
-      else if (infilename == NULL)
-         infilename = arg;
-
-      // Output filename?
-      else if (outfilename == NULL)
-         outfilename = arg;
-
-      // Too many files specified?
+      // Filename?
       else
-         err_manyfiles = 1;
+         filenames[numfiles++] = arg;
+   }
+
+   // Get filenames
+   if (action == ACTION_TRAIN) {
+      if (numfiles >= 1) outfilename = filenames[0];
+      if (numfiles >= 2) infilename = filenames[1];
+   } else {
+      if (numfiles >= 1) infilename = filenames[0];
+      if (numfiles >= 2) outfilename = filenames[1];
    }
 
    // Look for error conditions
@@ -126,7 +247,7 @@ int main(int argc, char **argv) {
       } else if (outfilename == NULL) {
          errcode = 1;
          fprintf(stderr, "Error: output filename missing\n");
-      } else if (err_manyfiles) {
+      } else if (numfiles > 2 && action != ACTION_TRAIN) {
          errcode = 1;
          fprintf(stderr, "Error: too many filenames specified\n");
       }
@@ -135,10 +256,56 @@ int main(int argc, char **argv) {
       errcode = 1;
       fprintf(stderr, "Error: too many formats specified\n");
    }
+   if (dictfilename != NULL && action == ACTION_TRAIN) {
+      errcode = 1;
+      fprintf(stderr, "Error: can't use a dictionary to build another\n");
+   }
+   if (format == FORMAT_UFTCX && (dictfilename != NULL ||
+   action == ACTION_TRAIN)) {
+      errcode = 1;
+      fprintf(stderr, "Error: UFTC-X can't use shared dictionaries\n");
+   }
+   if ((rangefilename != NULL) != (tablefilename != NULL)) {
+      errcode = 1;
+      fprintf(stderr, "Error: need both a range list and a table to make "
+         "a range table\n");
+   }
+   if (rangefilename != NULL && action != ACTION_DEFAULT &&
+   action != ACTION_COMPRESS) {
+      errcode = 1;
+      fprintf(stderr, "Error: range tables can only be made when "
+         "compressing\n");
+   }
+   if (!sprites && (tileoffset != -1 || continuous)) {
+      errcode = 1;
+      fprintf(stderr, "Error: offset and continuous are only used with a "
+         "sprite mapping\n");
+   }
+   if (!lossy && (palfilename != NULL || logfilename != NULL)) {
+      errcode = 1;
+      fprintf(stderr, "Error: palette and log are only used for lossy "
+         "compression\n");
+   }
+   if (lossy && action != ACTION_DEFAULT && action != ACTION_COMPRESS) {
+      errcode = 1;
+      fprintf(stderr, "Error: lossy compression only works when "
+         "compressing a single file\n");
+   }
+   if (lossy && dictfilename != NULL) {
+      errcode = 1;
+      fprintf(stderr, "Error: can't use lossy compression with a shared "
+         "dictionary\n");
+   }
+   if (format == FORMAT_UFTCX && inplace != INPLACE_NONE) {
+      errcode = 1;
+      fprintf(stderr, "Error: UFTC-X can't be decompressed in-place\n");
+   }
 
    // If there was an error then quit
-   if (errcode)
+   if (errcode) {
+      free(filenames);
       return EXIT_FAILURE;
+   }
 
    // No action specified?
    if (action == ACTION_DEFAULT)
@@ -151,6 +318,7 @@ int main(int argc, char **argv) {
    // Show tool version?
    if (show_ver) {
       puts("1.2b");
+      free(filenames);
       return EXIT_SUCCESS;
    }
 
@@ -159,46 +327,174 @@ int main(int argc, char **argv) {
       printf("Usage:\n"
              "  %s -c <infile> <outfile>\n"
              "  %s -d <infile> <outfile>\n"
+             "  %s -t <dictfile> <infile> [<infile> ...]\n"
              "\n"
              "Options:\n"
              "  -c or --compress ..... Compress a blob into UFTC\n"
              "  -d or --decompress ... Decompress UFTC into a blob\n"
+             "  -t or --train ........ Build a dictionary shared by many blobs\n"
+             "  -D or --dict <file> .. Use a shared dictionary\n"
              "  -16 or --uftc16 ...... Use UFTC16 format (8192 limit)\n"
              "  -15 or --uftc15 ...... Use UFTC15 format (4096 limit)\n"
+             "  -x or --uftcx ........ Use UFTC-X format (flips and repeats)\n"
+             "  -b or --best ......... Optimize dictionary layout\n"
+             "  -l or --lossy <n> .... Merge blocks up to <n> pixels apart\n"
+             "  -p or --palette <file> Palette to tell how close colors are\n"
+             "  -L or --log <file> ... Log which blocks got changed\n"
+             "  -m or --margin ....... Report in-place decompression offset\n"
+             "  -i or --in-place ..... Pad output for in-place decompression\n"
+             "  -r or --ranges <file>  Read tile ranges from a text file\n"
+             "  -s or --sprites <file> Read tile ranges from a sprite mapping\n"
+             "  -o or --offset <n> ... First tile ID in the sprite mapping\n"
+             "  -C or --continuous ... Sprite mapping used continuous offsets\n"
+             "  -T or --table <file> . Write a table of the tile ranges\n"
              "  -h or --help ......... Show this help\n"
              "  -v or --version ...... Show tool version\n"
              "\n"
              "If no option is specified, compression is done by default.\n"
              "If no format is specified, UFTC16 is used by default.\n",
-             argv[0], argv[0]);
+             argv[0], argv[0], argv[0]);
+      free(filenames);
       return EXIT_SUCCESS;
    }
 
-   // Open input file
-   FILE *infile = fopen(infilename, "rb");
-   if (infile == NULL) {
-      fprintf(stderr, "Error: can't open input file \"%s\"\n", infilename);
-      return EXIT_FAILURE;
+   // Load the tile ranges if needed
+   RangeList ranges = { NULL, 0 };
+   if (rangefilename != NULL) {
+      errcode = sprites ? load_sprite_ranges(rangefilename, &ranges,
+                             tileoffset == -1 ? 0 : (uint32_t) tileoffset,
+                             continuous) :
+                load_ranges(rangefilename, &ranges);
+      if (errcode) {
+         if (errcode == ERR_SPRITEOFFSET)
+            fprintf(stderr, "Error: a frame in \"%s\" doesn't match the "
+               "tile offset (check -o and -C)\n", rangefilename);
+         else if (errcode == ERR_SPRITEGAP)
+            fprintf(stderr, "Error: a frame in \"%s\" doesn't use "
+               "consecutive tiles\n", rangefilename);
+         else if (errcode == ERR_BADRANGES)
+            fprintf(stderr, "Error: \"%s\" isn't a valid %s\n",
+               rangefilename, sprites ? "sprite mapping" : "range list");
+         else
+            fprintf(stderr, "Error: can't load ranges from \"%s\"\n",
+               rangefilename);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Get lossy compression settings if needed
+   Lossy lossyinfo;
+   lossyinfo.budget = lossy;
+   lossyinfo.has_palette = 0;
+   lossyinfo.logname = logfilename;
+   if (palfilename != NULL) {
+      errcode = load_palette(palfilename, &lossyinfo);
+      if (errcode) {
+         if (errcode == ERR_BADPALETTE)
+            fprintf(stderr, "Error: \"%s\" isn't a valid palette\n",
+               palfilename);
+         else
+            fprintf(stderr, "Error: can't load palette \"%s\"\n",
+               palfilename);
+         free_ranges(&ranges);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Load shared dictionary if needed
+   uint8_t *dict = NULL;
+   size_t dictsize = 0;
+   if (dictfilename != NULL) {
+      errcode = load_dictionary(dictfilename, &dict, &dictsize);
+      if (!errcode && dictsize >= 0x8000 && format == FORMAT_UFTC15)
+         errcode = ERR_BADDICT;
+      if (errcode) {
+         if (errcode == ERR_BADDICT)
+            fprintf(stderr, "Error: \"%s\" isn't a valid dictionary\n",
+               dictfilename);
+         else
+            fprintf(stderr, "Error: can't load dictionary \"%s\"\n",
+               dictfilename);
+         free(dict);
+         free_ranges(&ranges);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
+   }
+
+   // Open input file (when building a dictionary, the tile sets get opened
+   // as they're needed instead)
+   FILE *infile = NULL;
+   if (action != ACTION_TRAIN) {
+      infile = fopen(infilename, "rb");
+      if (infile == NULL) {
+         fprintf(stderr, "Error: can't open input file \"%s\"\n",
+            infilename);
+         free(dict);
+         free_ranges(&ranges);
+         free(filenames);
+         return EXIT_FAILURE;
+      }
    }
 
    // Open output file
    FILE *outfile = fopen(outfilename, "wb");
    if (outfile == NULL) {
       fprintf(stderr, "Error: can't open output file \"%s\"\n", outfilename);
-      fclose(infile);
+      if (infile) fclose(infile);
+      free(dict);
+      free_ranges(&ranges);
+      free(filenames);
       return EXIT_FAILURE;
    }
 
    // Perform the requested action
+   CompressReport report;
    switch (action) {
       // Compress file
       case ACTION_COMPRESS:
-         errcode = compress(infile, outfile, format);
+         errcode = compress(infile, outfile, format, inplace, best,
+                            dict, dictsize, lossy ? &lossyinfo : NULL,
+                            &report);
+
+         // Report what lossy compression did
+         if (!errcode && lossy) {
+            printf("Lossy: %zu different blocks merged into %zu, "
+                   "%zu blocks changed (%zu pixels)\n",
+                   report.lossy.uniques, report.lossy.kept,
+                   report.lossy.changed, report.lossy.pixels);
+         }
+
+         // Report where to put the data for in-place decompression
+         if (!errcode && inplace != INPLACE_NONE) {
+            printf("In-place offset: %zu bytes (buffer size: %zu bytes)\n",
+                   report.offset, report.offset + report.size);
+         }
+
+         // Report the size in both formats, so it's easy to tell which
+         // one is better for each asset
+         if (!errcode && format == FORMAT_UFTCX) {
+            printf("UFTC16 size: %zu bytes\n", report.plainsize);
+            printf("UFTC-X size: %zu bytes\n", report.size);
+         }
+
+         // The whole input was read, so we know how many tiles there are
+         if (!errcode && rangefilename != NULL)
+            errcode = write_ranges(tablefilename, &ranges,
+                                   (size_t) ftell(infile) / 0x20);
          break;
 
       // Decompress file
       case ACTION_DECOMPRESS:
-         errcode = decompress(infile, outfile, format);
+         errcode = decompress(infile, outfile, format, dict, dictsize);
+         break;
+
+      // Build shared dictionary
+      case ACTION_TRAIN:
+         errcode = train_dictionary(filenames + 1, numfiles - 1, outfile,
+                                    format, best);
          break;
 
       // Oops!
@@ -219,6 +515,12 @@ int main(int argc, char **argv) {
          case ERR_TOOSMALL: msg = "input file needs to have at least one "
             "tile"; break;
          case ERR_TOOBIG: msg = "output file is too big for UFTC"; break;
+         case ERR_NOTINDICT: msg = "input file has blocks that aren't in "
+            "the dictionary"; break;
+         case ERR_BADDICT: msg = "dictionary is too big for UFTC15"; break;
+         case ERR_RANGEOVER: msg = "a tile range goes past the last "
+            "tile"; break;
+         case ERR_CANTWRITELOG: msg = "can't write the lossy log"; break;
          case ERR_CORRUPT: msg = "input file isn't valid UFTC"; break;
          case ERR_NOMEMORY: msg = "ran out of memory"; break;
          default: msg = "unknown error"; break;
@@ -230,8 +532,11 @@ int main(int argc, char **argv) {
 
    // Quit program
    fclose(outfile);
-   fclose(infile);
+   if (infile) fclose(infile);
    if (errcode) remove(outfilename);
+   free(dict);
+   free_ranges(&ranges);
+   free(filenames);
    return errcode ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
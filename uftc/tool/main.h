@@ -38,6 +38,14 @@ enum {
    ERR_BADSIZE,         // Input file isn't suitable
    ERR_TOOSMALL,        // Input file must contain at least one tile
    ERR_TOOBIG,          // Dictionary has become too big
+   ERR_NOTINDICT,       // Block missing from the shared dictionary
+   ERR_BADDICT,         // Shared dictionary isn't valid
+   ERR_BADRANGES,       // Range list isn't valid
+   ERR_RANGEOVER,       // Range goes past the last tile
+   ERR_SPRITEOFFSET,    // Sprite tiles don't match the offset
+   ERR_SPRITEGAP,       // Sprite frame doesn't use consecutive tiles
+   ERR_BADPALETTE,      // Palette file isn't valid
+   ERR_CANTWRITELOG,    // Can't write the lossy log
    ERR_CORRUPT,         // File is corrupt?
    ERR_NOMEMORY,        // Ran out of memory
    ERR_UNKNOWN          // Unknown error
@@ -48,9 +56,17 @@ enum {
    FORMAT_DEFAULT,      // No format specified
    FORMAT_UFTC15,       // UFTC15 (15-bit offsets)
    FORMAT_UFTC16,       // UFTC16 (16-bit offsets)
+   FORMAT_UFTCX,        // UFTC-X (flipped blocks and repeated tiles)
    FORMAT_TOOMANY       // Too many formats specified
 };
 
+// In-place decompression options
+enum {
+   INPLACE_NONE,        // Don't care about in-place decompression
+   INPLACE_REPORT,      // Report where compressed data can go
+   INPLACE_PAD          // Pad compressed data to be loaded as-is
+};
+
 // Function prototypes
 int read_word(FILE *, uint16_t *);
 int write_word(FILE *, const uint16_t);
@@ -0,0 +1,474 @@
+//***************************************************************************
+// "ranges.c"
+// Tables telling where each group of tiles (e.g. animation frames) starts
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+// Required headers
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "ranges.h"
+
+// Tiles used by a sprite
+typedef struct {
+   uint32_t first;         // ID of first tile
+   uint32_t last;          // ID past the last tile
+} TileRun;
+
+// Function prototypes
+static int add_range(RangeList *, const char *, uint32_t, uint32_t);
+static int get_frame_tiles(TileRun *, size_t, uint32_t, int, uint32_t *,
+                           uint32_t *);
+static int compare_runs(const void *, const void *);
+static int parse_number(const char *, uint32_t *);
+static int write_asm(FILE *, const RangeList *);
+static int write_c(FILE *, const RangeList *);
+static int write_binary(FILE *, const RangeList *);
+
+//***************************************************************************
+// load_ranges
+// Loads a list of ranges from a text file. Each line has the name of the
+// range and either the number of tiles (then it starts right after the
+// previous range) or the first tile and the number of tiles. Anything
+// after a # is a comment.
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param ranges: where to store the ranges (must be freed)
+// return: error code
+//***************************************************************************
+
+int load_ranges(const char *filename, RangeList *ranges) {
+   ranges->list = NULL;
+   ranges->size = 0;
+
+   // Open file
+   FILE *file = fopen(filename, "r");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   // Go through all lines
+   int errcode = ERR_NONE;
+   uint32_t next = 0;
+   char line[0x100];
+   while (fgets(line, sizeof(line), file) != NULL) {
+      // Line too long?
+      size_t length = strlen(line);
+      if (length == sizeof(line) - 1 && line[length - 1] != '\n' &&
+      !feof(file)) {
+         errcode = ERR_BADRANGES;
+         break;
+      }
+
+      // Get rid of comments
+      char *comment = strchr(line, '#');
+      if (comment != NULL)
+         *comment = '\0';
+
+      // Split the line into tokens
+      char *tokens[4];
+      int numtokens = 0;
+      char *token;
+      for (token = strtok(line, " \t\r\n"); token != NULL;
+      token = strtok(NULL, " \t\r\n")) {
+         if (numtokens == 4) break;
+         tokens[numtokens++] = token;
+      }
+
+      // Blank line?
+      if (numtokens == 0)
+         continue;
+
+      // Get where the range is
+      uint32_t start = next;
+      uint32_t count;
+      if (numtokens == 2) {
+         if (parse_number(tokens[1], &count))
+            errcode = ERR_BADRANGES;
+      } else if (numtokens == 3) {
+         if (parse_number(tokens[1], &start) ||
+         parse_number(tokens[2], &count))
+            errcode = ERR_BADRANGES;
+      } else
+         errcode = ERR_BADRANGES;
+      if (errcode) break;
+
+      errcode = add_range(ranges, tokens[0], start, count);
+      if (errcode) break;
+      next = start + count;
+   }
+
+   if (!errcode && ferror(file))
+      errcode = ERR_CANTREAD;
+   fclose(file);
+
+   if (errcode)
+      free_ranges(ranges);
+   return errcode;
+}
+
+//***************************************************************************
+// load_sprite_ranges
+// Makes a list of ranges out of a sprite mapping made by mdtiler, one range
+// per frame, going from the lowest to the highest tile used by the frame.
+// If the offset wasn't continuous, every frame starts at the offset and
+// its tiles come right after the ones of the previous frame (which is how
+// mdtiler outputs them). If it was continuous (or the sprites were in a
+// pool), the tile IDs are counted from the offset. Either way the tiles
+// used by each frame must be consecutive.
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param ranges: where to store the ranges (must be freed)
+// param offset: tile ID of the first tile
+// param continuous: set if the offset was continuous
+// return: error code
+//***************************************************************************
+
+int load_sprite_ranges(const char *filename, RangeList *ranges,
+uint32_t offset, int continuous) {
+   ranges->list = NULL;
+   ranges->size = 0;
+
+   // Open file
+   FILE *file = fopen(filename, "rb");
+   if (file == NULL)
+      return ERR_CANTREAD;
+
+   // Go through all the frames
+   int errcode = ERR_NONE;
+   TileRun *runs = NULL;
+   size_t numruns = 0;
+   size_t maxruns = 0;
+   uint32_t next = 0;
+   for (;;) {
+      // Read next entry (the sentinel is only one word)
+      uint8_t entry[8];
+      size_t numread = fread(entry, 1, 2, file);
+      if (numread == 0 && feof(file))
+         break;
+      if (numread < 2) {
+         errcode = ferror(file) ? ERR_CANTREAD : ERR_BADRANGES;
+         break;
+      }
+
+      // End of frame?
+      if (entry[0] == 0x80 && entry[1] == 0x00) {
+         uint32_t start, count;
+         errcode = get_frame_tiles(runs, numruns, offset, continuous,
+                                   &start, &count);
+         if (errcode) break;
+         if (!continuous && count != 0) {
+            start = next;
+            next += count;
+         }
+
+         char name[0x20];
+         sprintf(name, "frame%u", (unsigned) ranges->size);
+         errcode = add_range(ranges, name, start, count);
+         if (errcode) break;
+         numruns = 0;
+         continue;
+      }
+
+      // Check which tiles are used by this sprite (the tile ID is the
+      // lower 11 bits, the rest are flags)
+      if (fread(&entry[2], 1, 6, file) < 6) {
+         errcode = ferror(file) ? ERR_CANTREAD : ERR_BADRANGES;
+         break;
+      }
+      if (numruns == maxruns) {
+         maxruns = maxruns ? maxruns * 2 : 0x20;
+         TileRun *temp = (TileRun *) realloc(runs, sizeof(TileRun) *
+                                                   maxruns);
+         if (temp == NULL) {
+            errcode = ERR_NOMEMORY;
+            break;
+         }
+         runs = temp;
+      }
+      runs[numruns].first = (entry[4] << 8 | entry[5]) & 0x7FF;
+      runs[numruns].last = runs[numruns].first +
+         ((entry[7] >> 2 & 3) + 1) * ((entry[7] & 3) + 1);
+      numruns++;
+   }
+
+   // Every frame must have ended with the sentinel
+   if (!errcode && numruns != 0)
+      errcode = ERR_BADRANGES;
+
+   free(runs);
+   fclose(file);
+   if (errcode)
+      free_ranges(ranges);
+   return errcode;
+}
+
+//***************************************************************************
+// write_ranges
+// Writes a table with the first tile and number of tiles of each range. If
+// the filename ends in .h it's written as C, if it ends in .asm, .inc, .s
+// or .68k it's written as assembly, otherwise it's binary (two big endian
+// words per range).
+//---------------------------------------------------------------------------
+// param filename: name of file
+// param ranges: ranges to write
+// param numtiles: number of tiles in the compressed data
+// return: error code
+//***************************************************************************
+
+int write_ranges(const char *filename, const RangeList *ranges,
+size_t numtiles) {
+   // Make sure the ranges make sense first (the routines take words)
+   size_t i;
+   for (i = 0; i < ranges->size; i++) {
+      const Range *range = &ranges->list[i];
+      if (range->start > numtiles || range->count > numtiles - range->start)
+         return ERR_RANGEOVER;
+      if (range->start > 0xFFFF || range->count > 0xFFFF)
+         return ERR_RANGEOVER;
+   }
+
+   // Open file
+   FILE *file = fopen(filename, "wb");
+   if (file == NULL)
+      return ERR_CANTWRITE;
+
+   // Write the table in whatever format fits
+   const char *ext = strrchr(filename, '.');
+   if (ext == NULL) ext = "";
+
+   int errcode;
+   if (!strcmp(ext, ".h"))
+      errcode = write_c(file, ranges);
+   else if (!strcmp(ext, ".asm") || !strcmp(ext, ".inc") ||
+   !strcmp(ext, ".s") || !strcmp(ext, ".68k"))
+      errcode = write_asm(file, ranges);
+   else
+      errcode = write_binary(file, ranges);
+
+   if (fclose(file) && !errcode)
+      errcode = ERR_CANTWRITE;
+   return errcode;
+}
+
+//***************************************************************************
+// free_ranges
+// Frees a list of ranges
+//---------------------------------------------------------------------------
+// param ranges: list to free
+//***************************************************************************
+
+void free_ranges(RangeList *ranges) {
+   size_t i;
+   for (i = 0; i < ranges->size; i++)
+      free(ranges->list[i].name);
+   free(ranges->list);
+
+   ranges->list = NULL;
+   ranges->size = 0;
+}
+
+//***************************************************************************
+// add_range [internal]
+// Adds a range to a list
+//---------------------------------------------------------------------------
+// param ranges: list of ranges
+// param name: name of the range
+// param start: ID of first tile
+// param count: number of tiles
+// return: error code
+//***************************************************************************
+
+static int add_range(RangeList *ranges, const char *name, uint32_t start,
+uint32_t count) {
+   Range *temp = (Range *) realloc(ranges->list,
+                                   sizeof(Range) * (ranges->size + 1));
+   if (temp == NULL)
+      return ERR_NOMEMORY;
+   ranges->list = temp;
+
+   Range *range = &ranges->list[ranges->size];
+   range->name = (char *) malloc(strlen(name) + 1);
+   if (range->name == NULL)
+      return ERR_NOMEMORY;
+   strcpy(range->name, name);
+   range->start = start;
+   range->count = count;
+
+   ranges->size++;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// get_frame_tiles [internal]
+// Works out which tiles are used by a frame of a sprite mapping
+//---------------------------------------------------------------------------
+// param runs: tiles used by each sprite in the frame (gets sorted)
+// param numruns: number of sprites in the frame
+// param offset: tile ID of the first tile
+// param continuous: set if the offset was continuous
+// param start: where to store the first tile (relative to the offset)
+// param count: where to store the number of tiles
+// return: error code
+//***************************************************************************
+
+static int get_frame_tiles(TileRun *runs, size_t numruns, uint32_t offset,
+int continuous, uint32_t *start, uint32_t *count) {
+   *start = 0;
+   *count = 0;
+   if (numruns == 0)
+      return ERR_NONE;
+
+   // Sprites can share tiles, so join them together and make sure there
+   // aren't any gaps left
+   qsort(runs, numruns, sizeof(TileRun), compare_runs);
+   uint32_t low = runs[0].first;
+   uint32_t high = runs[0].last;
+   size_t i;
+   for (i = 1; i < numruns; i++) {
+      if (runs[i].first > high)
+         return ERR_SPRITEGAP;
+      if (runs[i].last > high)
+         high = runs[i].last;
+   }
+
+   // Without a continuous offset every frame starts at the offset
+   if (low < offset || (!continuous && low != offset))
+      return ERR_SPRITEOFFSET;
+
+   *start = low - offset;
+   *count = high - low;
+   return ERR_NONE;
+}
+
+//***************************************************************************
+// compare_runs [internal]
+// Comparison function used to sort the tiles used by sprites with qsort
+//---------------------------------------------------------------------------
+// param ptr1: pointer to first run
+// param ptr2: pointer to second run
+// return: <0 if first goes before, >0 if it goes after, 0 if same
+//***************************************************************************
+
+static int compare_runs(const void *ptr1, const void *ptr2) {
+   const TileRun *run1 = (const TileRun *) ptr1;
+   const TileRun *run2 = (const TileRun *) ptr2;
+
+   if (run1->first != run2->first)
+      return run1->first < run2->first ? -1 : 1;
+   if (run1->last != run2->last)
+      return run1->last < run2->last ? -1 : 1;
+   return 0;
+}
+
+//***************************************************************************
+// parse_number [internal]
+// Parses a number in a range list
+//---------------------------------------------------------------------------
+// param str: string to parse
+// param value: where to store the value
+// return: 0 on success, -1 if it isn't a valid number
+//***************************************************************************
+
+static int parse_number(const char *str, uint32_t *value) {
+   if (!isdigit((unsigned char) *str))
+      return -1;
+
+   char *endptr;
+   unsigned long temp = strtoul(str, &endptr, 0);
+   if (*endptr != '\0' || temp > 0xFFFFFFFFUL)
+      return -1;
+
+   *value = (uint32_t) temp;
+   return 0;
+}
+
+//***************************************************************************
+// write_asm [internal]
+// Writes a range table as assembly (one dc.w per range)
+//---------------------------------------------------------------------------
+// param file: output file
+// param ranges: ranges to write
+// return: error code
+//***************************************************************************
+
+static int write_asm(FILE *file, const RangeList *ranges) {
+   fprintf(file, "; First tile and number of tiles of each range\n");
+
+   size_t i;
+   for (i = 0; i < ranges->size; i++) {
+      const Range *range = &ranges->list[i];
+      fprintf(file, "    dc.w    %u, %u\t\t; %s\n", (unsigned) range->start,
+              (unsigned) range->count, range->name);
+   }
+
+   return ferror(file) ? ERR_CANTWRITE : ERR_NONE;
+}
+
+//***************************************************************************
+// write_c [internal]
+// Writes a range table as C (one initializer per range, meant to be
+// included inside an array of { start, count } pairs)
+//---------------------------------------------------------------------------
+// param file: output file
+// param ranges: ranges to write
+// return: error code
+//***************************************************************************
+
+static int write_c(FILE *file, const RangeList *ranges) {
+   fprintf(file, "// First tile and number of tiles of each range\n");
+
+   size_t i;
+   for (i = 0; i < ranges->size; i++) {
+      const Range *range = &ranges->list[i];
+      fprintf(file, "{ %u, %u },\t\t// %s\n", (unsigned) range->start,
+              (unsigned) range->count, range->name);
+   }
+
+   return ferror(file) ? ERR_CANTWRITE : ERR_NONE;
+}
+
+//***************************************************************************
+// write_binary [internal]
+// Writes a range table as binary (two big endian words per range)
+//---------------------------------------------------------------------------
+// param file: output file
+// param ranges: ranges to write
+// return: error code
+//***************************************************************************
+
+static int write_binary(FILE *file, const RangeList *ranges) {
+   size_t i;
+   for (i = 0; i < ranges->size; i++) {
+      const Range *range = &ranges->list[i];
+      int errcode = write_word(file, (uint16_t) range->start);
+      if (!errcode)
+         errcode = write_word(file, (uint16_t) range->count);
+      if (errcode) return errcode;
+   }
+
+   return ERR_NONE;
+}
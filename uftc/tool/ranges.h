@@ -0,0 +1,53 @@
+//***************************************************************************
+// "ranges.h"
+// Tables telling where each group of tiles (e.g. animation frames) starts
+//***************************************************************************
+// Uftc compression tool
+//
+// This file is part of the uftc tool.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//***************************************************************************
+
+
+#ifndef RANGES_H
+#define RANGES_H
+
+// Required headers
+#include <stddef.h>
+#include <stdint.h>
+
+// A group of tiles that gets decompressed together
+typedef struct {
+   char *name;             // Name of the range (for comments)
+   uint32_t start;         // ID of first tile
+   uint32_t count;         // Number of tiles
+} Range;
+
+// List of ranges
+typedef struct {
+   Range *list;            // All the ranges
+   size_t size;            // Number of ranges
+} RangeList;
+
+// Function prototypes
+int load_ranges(const char *, RangeList *);
+int load_sprite_ranges(const char *, RangeList *, uint32_t, int);
+int write_ranges(const char *, const RangeList *, size_t);
+void free_ranges(RangeList *);
+
+#endif